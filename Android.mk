@@ -17,9 +17,37 @@ LOCAL_PATH := $(call my-dir)
 
 local_src_files := \
     JNIHelp.cpp \
+    JNIHelpStats.cpp \
+    JniAccessPolicy.cpp \
+    JniBytes.cpp \
+    JniCallRecorder.cpp \
+    JniCheck.cpp \
     JniConstants.cpp \
+    JniCriticalMonitor.cpp \
+    JniHandleTable.cpp \
+    JniListenerRegistry.cpp \
+    JniRingBuffer.cpp \
+    JniScratch.cpp \
+    JniStringCache.cpp \
+    JniStringKernels.cpp \
     toStringArray.cpp
 
+# Modules that start threads, wait on clocks or map memory in ways the NDK
+# API level of the compat build does not offer (pthread_condattr_setclock,
+# for one, is API 21). Only the platform and host builds include them.
+local_platform_src_files := \
+    JniBufferPool.cpp \
+    JniDispatcher.cpp \
+    JniMappedFile.cpp \
+    JniParallel.cpp
+
+# Build with NATIVEHELPER_ENABLE_USDT=true to include the static tracepoints
+# described in JniTrace.h. This needs <sys/sdt.h>, so the NDK build never
+# includes them.
+local_usdt_cflags :=
+ifeq ($(NATIVEHELPER_ENABLE_USDT),true)
+local_usdt_cflags := -DNATIVEHELPER_ENABLE_USDT
+endif
 
 #
 # Build for the target (device).
@@ -28,12 +56,14 @@ local_src_files := \
 include $(CLEAR_VARS)
 LOCAL_SRC_FILES := \
     $(local_src_files) \
-    JniInvocation.cpp
+    $(local_platform_src_files) \
+    JniInvocation.cpp \
+    JavaVMOptions.cpp
 LOCAL_SHARED_LIBRARIES := liblog
 LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE := libnativehelper
 LOCAL_CLANG := true
-LOCAL_CFLAGS := -Werror -fvisibility=protected
+LOCAL_CFLAGS := -Werror -fvisibility=protected $(local_usdt_cflags)
 LOCAL_C_INCLUDES := libcore/include
 LOCAL_SHARED_LIBRARIES += libcutils libdl
 LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
@@ -43,7 +73,7 @@ include $(BUILD_SHARED_LIBRARY)
 #
 # NDK-only build for the target (device), using libc++.
 # - Relies only on NDK exposed functionality.
-# - This doesn't include JniInvocation.
+# - This doesn't include JniInvocation, JavaVMOptions or local_platform_src_files.
 #
 
 include $(CLEAR_VARS)
@@ -73,8 +103,10 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_CLANG := true
 LOCAL_SRC_FILES := \
     $(local_src_files) \
-    JniInvocation.cpp
-LOCAL_CFLAGS := -Werror -fvisibility=protected
+    $(local_platform_src_files) \
+    JniInvocation.cpp \
+    JavaVMOptions.cpp
+LOCAL_CFLAGS := -Werror -fvisibility=protected $(local_usdt_cflags)
 LOCAL_C_INCLUDES := libcore/include
 LOCAL_SHARED_LIBRARIES := liblog
 LOCAL_LDFLAGS := -ldl
@@ -93,8 +125,10 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_CLANG := true
 LOCAL_SRC_FILES := \
     $(local_src_files) \
-    JniInvocation.cpp
-LOCAL_CFLAGS := -Werror -fvisibility=protected
+    $(local_platform_src_files) \
+    JniInvocation.cpp \
+    JavaVMOptions.cpp
+LOCAL_CFLAGS := -Werror -fvisibility=protected $(local_usdt_cflags)
 LOCAL_C_INCLUDES := libcore/include
 LOCAL_STATIC_LIBRARIES := liblog
 LOCAL_LDFLAGS := -ldl
@@ -104,7 +138,8 @@ include $(BUILD_HOST_STATIC_LIBRARY)
 
 
 #
-# Tests.
+# Tests and benchmarks.
 #
 
 include $(LOCAL_PATH)/tests/Android.mk
+include $(LOCAL_PATH)/benchmarks/Android.mk
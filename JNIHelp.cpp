@@ -23,15 +23,18 @@
 
 #include "JniConstants.h"
 #include "JNIHelp.h"
+#include "JNIHelpStats-priv.h"
+#include "JniCheck.h"
+#include "JniScratch.h"
+#include "JniTrace.h"
 #include "ALog-priv.h"
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
-#include <string>
-
 /**
  * Equivalent to ScopedLocalRef, but for C_JNIEnv instead. (And slightly more powerful.)
  */
@@ -65,6 +68,67 @@ private:
     DISALLOW_COPY_AND_ASSIGN(scoped_local_ref);
 };
 
+/**
+ * A string built in the thread's scratch arena, for the exception text the
+ * helpers format. Text that doesn't fit once the arena is exhausted is
+ * dropped.
+ */
+class scratch_string {
+public:
+    scratch_string() : mChars(NULL), mLength(0), mCapacity(0) {
+    }
+
+    ~scratch_string() {
+        jniScratchFree(mChars);
+    }
+
+    scratch_string& operator=(const char* s) {
+        mLength = 0;
+        return *this += s;
+    }
+
+    scratch_string& operator+=(const char* s) {
+        size_t length = strlen(s);
+        if (mLength + length >= mCapacity && !grow(mLength + length + 1)) {
+            return *this;
+        }
+        memcpy(mChars + mLength, s, length + 1);
+        mLength += length;
+        return *this;
+    }
+
+    const char* c_str() const {
+        return (mChars != NULL) ? mChars : "";
+    }
+
+private:
+    bool grow(size_t capacity) {
+        if (capacity < 2 * mCapacity) {
+            capacity = 2 * mCapacity;
+        }
+        if (capacity < 128) {
+            capacity = 128;
+        }
+        char* chars = static_cast<char*>(jniScratchAlloc(capacity));
+        if (chars == NULL) {
+            return false;
+        }
+        if (mChars != NULL) {
+            memcpy(chars, mChars, mLength + 1);
+            jniScratchFree(mChars);
+        }
+        mChars = chars;
+        mCapacity = capacity;
+        return true;
+    }
+
+    char* mChars;
+    size_t mLength;
+    size_t mCapacity;
+
+    DISALLOW_COPY_AND_ASSIGN(scratch_string);
+};
+
 static jclass findClass(C_JNIEnv* env, const char* className) {
     JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
     return (*env)->FindClass(e, className);
@@ -74,8 +138,12 @@ extern "C" int jniRegisterNativeMethods(C_JNIEnv* env, const char* className,
     const JNINativeMethod* gMethods, int numMethods)
 {
     JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
+    JNI_LIGHT_CHECK(env, "jniRegisterNativeMethods");
 
     ALOGV("Registering %s's %d native methods...", className, numMethods);
+#if JNI_TRACE_ENABLED
+    const uint64_t start = JNI_TRACE_ARMED(register_natives) ? jniTraceNanoTime() : 0;
+#endif
 
     scoped_local_ref<jclass> c(env, findClass(env, className));
     if (c.get() == NULL) {
@@ -104,6 +172,9 @@ extern "C" int jniRegisterNativeMethods(C_JNIEnv* env, const char* className,
         e->FatalError(msg);
     }
 
+    jniHelpCount(kNativeMethodsRegistered, numMethods);
+    JNI_TRACE3(register_natives, className, numMethods,
+               (start != 0) ? jniTraceNanoTime() - start : 0);
     return 0;
 }
 
@@ -112,7 +183,7 @@ extern "C" int jniRegisterNativeMethods(C_JNIEnv* env, const char* className,
  * be populated with the "binary" class name and, if present, the
  * exception message.
  */
-static bool getExceptionSummary(C_JNIEnv* env, jthrowable exception, std::string& result) {
+static bool getExceptionSummary(C_JNIEnv* env, jthrowable exception, scratch_string& result) {
     JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
 
     /* get the name of the exception's class */
@@ -163,7 +234,7 @@ static bool getExceptionSummary(C_JNIEnv* env, jthrowable exception, std::string
 /*
  * Returns an exception (with stack trace) as a string.
  */
-static bool getStackTrace(C_JNIEnv* env, jthrowable exception, std::string& result) {
+static bool getStackTrace(C_JNIEnv* env, jthrowable exception, scratch_string& result) {
     JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
 
     scoped_local_ref<jclass> stringWriterClass(env, findClass(env, "java/io/StringWriter"));
@@ -223,14 +294,17 @@ static bool getStackTrace(C_JNIEnv* env, jthrowable exception, std::string& resu
 
 extern "C" int jniThrowException(C_JNIEnv* env, const char* className, const char* msg) {
     JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
+    JNI_LIGHT_CHECK(env, "jniThrowException");
+    JNI_TRACE2(throw_exception, className, msg);
 
     if ((*env)->ExceptionCheck(e)) {
         /* TODO: consider creating the new exception with this as "cause" */
         scoped_local_ref<jthrowable> exception(env, (*env)->ExceptionOccurred(e));
         (*env)->ExceptionClear(e);
+        jniHelpCount(kPendingExceptionsDiscarded);
 
         if (exception.get() != NULL) {
-            std::string text;
+            scratch_string text;
             getExceptionSummary(env, exception.get(), text);
             ALOGW("Discarding pending exception (%s) to throw %s", text.c_str(), className);
         }
@@ -249,13 +323,27 @@ extern "C" int jniThrowException(C_JNIEnv* env, const char* className, const cha
         return -1;
     }
 
+    jniHelpCountException(className);
     return 0;
 }
 
 int jniThrowExceptionFmt(C_JNIEnv* env, const char* className, const char* fmt, va_list args) {
     char msgBuf[512];
-    vsnprintf(msgBuf, sizeof(msgBuf), fmt, args);
-    return jniThrowException(env, className, msgBuf);
+    va_list retryArgs;
+    va_copy(retryArgs, args);
+    int length = vsnprintf(msgBuf, sizeof(msgBuf), fmt, args);
+    if (length < static_cast<int>(sizeof(msgBuf))) {
+        va_end(retryArgs);
+        return jniThrowException(env, className, msgBuf);
+    }
+    // Only messages too long for the stack buffer are formatted again, in scratch.
+    ScopedScratch scratch;
+    char* longBuf = scratch.alloc<char>(length + 1);
+    if (longBuf != NULL) {
+        vsnprintf(longBuf, length + 1, fmt, retryArgs);
+    }
+    va_end(retryArgs);
+    return jniThrowException(env, className, (longBuf != NULL) ? longBuf : msgBuf);
 }
 
 int jniThrowNullPointerException(C_JNIEnv* env, const char* msg) {
@@ -272,14 +360,15 @@ int jniThrowIOException(C_JNIEnv* env, int errnum) {
     return jniThrowException(env, "java/io/IOException", message);
 }
 
-static std::string jniGetStackTrace(C_JNIEnv* env, jthrowable exception) {
+static void jniGetStackTrace(C_JNIEnv* env, jthrowable exception, scratch_string& trace) {
     JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
 
     scoped_local_ref<jthrowable> currentException(env, (*env)->ExceptionOccurred(e));
     if (exception == NULL) {
         exception = currentException.get();
         if (exception == NULL) {
-          return "<no pending exception>";
+          trace = "<no pending exception>";
+          return;
         }
     }
 
@@ -287,21 +376,22 @@ static std::string jniGetStackTrace(C_JNIEnv* env, jthrowable exception) {
         (*env)->ExceptionClear(e);
     }
 
-    std::string trace;
     if (!getStackTrace(env, exception, trace)) {
         (*env)->ExceptionClear(e);
         getExceptionSummary(env, exception, trace);
     }
+    jniHelpCount(kStackTracesFormatted);
 
     if (currentException.get() != NULL) {
         (*env)->Throw(e, currentException.get()); // rethrow
     }
-
-    return trace;
 }
 
 void jniLogException(C_JNIEnv* env, int priority, const char* tag, jthrowable exception) {
-    std::string trace(jniGetStackTrace(env, exception));
+    JNI_LIGHT_CHECK(env, "jniLogException");
+    JNI_TRACE2(log_exception, priority, tag);
+    scratch_string trace;
+    jniGetStackTrace(env, exception, trace);
     __android_log_write(priority, tag, trace.c_str());
 }
 
@@ -324,18 +414,21 @@ const char* jniStrError(int errnum, char* buf, size_t buflen) {
 
 jobject jniCreateFileDescriptor(C_JNIEnv* env, int fd) {
     JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
+    JNI_LIGHT_CHECK(env, "jniCreateFileDescriptor");
     static jmethodID ctor = e->GetMethodID(JniConstants::fileDescriptorClass, "<init>", "()V");
     jobject fileDescriptor = (*env)->NewObject(e, JniConstants::fileDescriptorClass, ctor);
     // NOTE: NewObject ensures that an OutOfMemoryError will be seen by the Java
     // caller if the alloc fails, so we just return NULL when that happens.
     if (fileDescriptor != NULL)  {
         jniSetFileDescriptorOfFD(env, fileDescriptor, fd);
+        jniHelpCount(kFileDescriptorsCreated);
     }
     return fileDescriptor;
 }
 
 int jniGetFDFromFileDescriptor(C_JNIEnv* env, jobject fileDescriptor) {
     JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
+    JNI_LIGHT_CHECK(env, "jniGetFDFromFileDescriptor");
     static jfieldID fid = e->GetFieldID(JniConstants::fileDescriptorClass, "descriptor", "I");
     if (fileDescriptor != NULL) {
         return (*env)->GetIntField(e, fileDescriptor, fid);
@@ -346,12 +439,14 @@ int jniGetFDFromFileDescriptor(C_JNIEnv* env, jobject fileDescriptor) {
 
 void jniSetFileDescriptorOfFD(C_JNIEnv* env, jobject fileDescriptor, int value) {
     JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
+    JNI_LIGHT_CHECK(env, "jniSetFileDescriptorOfFD");
     static jfieldID fid = e->GetFieldID(JniConstants::fileDescriptorClass, "descriptor", "I");
     (*env)->SetIntField(e, fileDescriptor, fid, value);
 }
 
 jobject jniGetReferent(C_JNIEnv* env, jobject ref) {
     JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
+    JNI_LIGHT_CHECK(env, "jniGetReferent");
     static jmethodID get = e->GetMethodID(JniConstants::referenceClass, "get", "()Ljava/lang/Object;");
     return (*env)->CallObjectMethod(e, ref, get);
 }
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVEHELPER_JNIHELPSTATS_PRIV_H_
+#define NATIVEHELPER_JNIHELPSTATS_PRIV_H_
+
+#include <stdint.h>
+
+/*
+ * Counting side of jniHelpGetStats, for use inside the library. Keep in
+ * step with JniHelpStats in JNIHelp.h.
+ */
+enum JniHelpCounter {
+    kExceptionsThrown,
+    kPendingExceptionsDiscarded,
+    kStackTracesFormatted,
+    kNativeMethodsRegistered,
+    kFileDescriptorsCreated,
+    kArrayBytesCopied,
+    kArrayBytesPinned,
+    kJniHelpCounterCount,
+};
+
+/* Adds delta to the calling thread's shard of counter. */
+void jniHelpCount(JniHelpCounter counter, uint64_t delta = 1);
+
+/* Counts a thrown exception, in total and for its class. */
+void jniHelpCountException(const char* className);
+
+/* Records how many global references JniConstants holds. */
+void jniHelpSetConstantsGlobalRefs(uint64_t count);
+
+#endif  /* NATIVEHELPER_JNIHELPSTATS_PRIV_H_ */
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "JNIHelp.h"
+#include "JNIHelpStats-priv.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include <vector>
+
+/*
+ * Each thread counts into its own shard, found through a thread-local
+ * pointer, so an increment is a relaxed load and store with no shared cache
+ * line. Readers sum the shards of live threads plus what exited threads left
+ * behind; a pthread key retires a shard when its thread exits.
+ *
+ * Exception classes are interned on first throw in a fixed table of names
+ * shared by all threads, and shards count throws by table index, so counting
+ * one takes no lock and allocates nothing. Classes that do not fit are
+ * counted together.
+ */
+namespace {
+
+const size_t kExceptionClasses = 256;
+const size_t kExceptionNameBytes = 124;
+const size_t kOtherExceptions = kExceptionClasses - 1;  // The last index.
+const char kOtherExceptionsName[] = "(other)";
+
+enum { kClassEmpty, kClassWriting, kClassReady };
+
+struct ExceptionClass {
+    int state;
+    char name[kExceptionNameBytes];
+};
+
+struct Shard {
+    uint64_t counters[kJniHelpCounterCount];
+    uint64_t exceptions[kExceptionClasses];
+};
+
+ExceptionClass gExceptionClasses[kOtherExceptions];
+
+pthread_once_t gOnce = PTHREAD_ONCE_INIT;
+pthread_key_t gShardKey;
+__thread Shard* tShard;
+
+// Guards the globals below. They are never freed, so that threads exiting
+// during process teardown can still retire their shards.
+pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+std::vector<Shard*>* gShards;
+Shard gRetired;
+
+uint64_t gConstantsGlobalRefs;
+
+void retireShard(void* value) {
+    Shard* shard = static_cast<Shard*>(value);
+    pthread_mutex_lock(&gLock);
+    for (int i = 0; i < kJniHelpCounterCount; ++i) {
+        gRetired.counters[i] += shard->counters[i];
+    }
+    for (size_t i = 0; i < kExceptionClasses; ++i) {
+        gRetired.exceptions[i] += shard->exceptions[i];
+    }
+    for (size_t i = 0; i < gShards->size(); ++i) {
+        if ((*gShards)[i] == shard) {
+            gShards->erase(gShards->begin() + i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&gLock);
+    tShard = NULL;
+    delete shard;
+}
+
+void initStats() {
+    pthread_key_create(&gShardKey, retireShard);
+    gShards = new std::vector<Shard*>;
+}
+
+Shard* currentShard() {
+    Shard* shard = tShard;
+    if (__builtin_expect(shard != NULL, 1)) {
+        return shard;
+    }
+    pthread_once(&gOnce, initStats);
+    shard = new Shard();
+    pthread_setspecific(gShardKey, shard);
+    tShard = shard;
+    pthread_mutex_lock(&gLock);
+    gShards->push_back(shard);
+    pthread_mutex_unlock(&gLock);
+    return shard;
+}
+
+// Only this thread writes its shard; the atomics keep readers tear-free.
+void increment(uint64_t* value, uint64_t delta) {
+    __atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED) + delta, __ATOMIC_RELAXED);
+}
+
+// Returns className's index in gExceptionClasses, adding it if need be, or
+// kOtherExceptions if it is too long or the table is full.
+size_t internException(const char* className) {
+    const size_t length = strlen(className);
+    if (length >= kExceptionNameBytes) {
+        return kOtherExceptions;
+    }
+    uint32_t hash = 2166136261u;  // FNV-1a.
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(className[i])) * 16777619u;
+    }
+    for (size_t probe = 0; probe < kOtherExceptions; ++probe) {
+        ExceptionClass& entry = gExceptionClasses[(hash + probe) % kOtherExceptions];
+        int state = __atomic_load_n(&entry.state, __ATOMIC_ACQUIRE);
+        if (state == kClassEmpty &&
+                __atomic_compare_exchange_n(&entry.state, &state, kClassWriting, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            memcpy(entry.name, className, length + 1);
+            __atomic_store_n(&entry.state, kClassReady, __ATOMIC_RELEASE);
+            return &entry - gExceptionClasses;
+        }
+        while (state == kClassWriting) {
+            sched_yield();
+            state = __atomic_load_n(&entry.state, __ATOMIC_ACQUIRE);
+        }
+        if (memcmp(entry.name, className, length + 1) == 0) {
+            return &entry - gExceptionClasses;
+        }
+    }
+    return kOtherExceptions;
+}
+
+}  // namespace
+
+void jniHelpCount(JniHelpCounter counter, uint64_t delta) {
+    increment(&currentShard()->counters[counter], delta);
+}
+
+void jniHelpCountException(const char* className) {
+    Shard* shard = currentShard();
+    increment(&shard->counters[kExceptionsThrown], 1);
+    increment(&shard->exceptions[internException(className)], 1);
+}
+
+void jniHelpSetConstantsGlobalRefs(uint64_t count) {
+    __atomic_store_n(&gConstantsGlobalRefs, count, __ATOMIC_RELAXED);
+}
+
+extern "C" void jniHelpCountArrayBytes(size_t bytes, jboolean isCopy) {
+    jniHelpCount(isCopy ? kArrayBytesCopied : kArrayBytesPinned, bytes);
+}
+
+extern "C" void jniHelpGetStats(JniHelpStats* stats) {
+    pthread_once(&gOnce, initStats);
+    uint64_t totals[kJniHelpCounterCount];
+    pthread_mutex_lock(&gLock);
+    memcpy(totals, gRetired.counters, sizeof(totals));
+    for (size_t i = 0; i < gShards->size(); ++i) {
+        for (int j = 0; j < kJniHelpCounterCount; ++j) {
+            totals[j] += __atomic_load_n(&(*gShards)[i]->counters[j], __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&gLock);
+
+    stats->exceptionsThrown = totals[kExceptionsThrown];
+    stats->pendingExceptionsDiscarded = totals[kPendingExceptionsDiscarded];
+    stats->stackTracesFormatted = totals[kStackTracesFormatted];
+    stats->nativeMethodsRegistered = totals[kNativeMethodsRegistered];
+    stats->fileDescriptorsCreated = totals[kFileDescriptorsCreated];
+    stats->constantsGlobalRefs = __atomic_load_n(&gConstantsGlobalRefs, __ATOMIC_RELAXED);
+    stats->arrayBytesCopied = totals[kArrayBytesCopied];
+    stats->arrayBytesPinned = totals[kArrayBytesPinned];
+}
+
+extern "C" void jniHelpGetExceptionCounts(
+        void (*visit)(const char* className, uint64_t count, void* context), void* context) {
+    pthread_once(&gOnce, initStats);
+    uint64_t counts[kExceptionClasses];
+    pthread_mutex_lock(&gLock);
+    memcpy(counts, gRetired.exceptions, sizeof(counts));
+    for (size_t i = 0; i < gShards->size(); ++i) {
+        for (size_t j = 0; j < kExceptionClasses; ++j) {
+            counts[j] += __atomic_load_n(&(*gShards)[i]->exceptions[j], __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&gLock);
+
+    // Called without locks held, so visit may use the helpers. A counted
+    // class was interned first, so its name is ready.
+    for (size_t i = 0; i < kExceptionClasses; ++i) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        if (i == kOtherExceptions) {
+            visit(kOtherExceptionsName, counts[i], context);
+        } else if (__atomic_load_n(&gExceptionClasses[i].state, __ATOMIC_ACQUIRE) == kClassReady) {
+            visit(gExceptionClasses[i].name, counts[i], context);
+        }
+    }
+}
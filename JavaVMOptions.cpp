@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JavaVMOptions.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <utility>
+
+#define LOG_TAG "JavaVMOptions"
+#include "cutils/log.h"
+
+// Blob layout, in native byte order: kBlobMagic, kBlobVersion, the option
+// count, then that many NUL-terminated option strings.
+static const uint32_t kBlobMagic = 0x4f4d564a;  // "JVMO"
+static const uint32_t kBlobVersion = 1;
+static const size_t kBlobHeaderSize = 3 * sizeof(uint32_t);
+
+static const char* const kHooks[] = { "vfprintf", "exit", "abort" };
+
+static bool IsHook(const char* option) {
+  for (size_t i = 0; i < sizeof(kHooks) / sizeof(kHooks[0]); ++i) {
+    if (strcmp(option, kHooks[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if option is one of the sizes, which have no separator
+// between name and value.
+static bool IsSizeOption(const char* option) {
+  return strncmp(option, "-Xms", 4) == 0 || strncmp(option, "-Xmx", 4) == 0 ||
+         strncmp(option, "-Xss", 4) == 0 || strncmp(option, "-Xmn", 4) == 0;
+}
+
+// Returns the length of the prefix that identifies the option, counting the
+// terminating NUL when the whole string is the key.
+static size_t KeyLength(const char* option) {
+  if (IsSizeOption(option)) {
+    return 4;
+  }
+  const char* equals = strchr(option, '=');
+  if (equals != NULL) {
+    return equals - option + 1;
+  }
+  return strlen(option) + 1;
+}
+
+static bool SameKey(const char* lhs, const char* rhs) {
+  size_t length = KeyLength(lhs);
+  return length == KeyLength(rhs) && memcmp(lhs, rhs, length) == 0;
+}
+
+static bool IsValidSize(const char* value) {
+  const char* p = value;
+  while (*p >= '0' && *p <= '9') {
+    ++p;
+  }
+  if (p == value) {
+    return false;
+  }
+  if (*p != '\0' && strchr("kKmMgG", *p) != NULL) {
+    ++p;
+  }
+  return *p == '\0' && strtoull(value, NULL, 10) > 0;
+}
+
+static uint64_t NanoTime() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+JavaVMOptions::JavaVMOptions() : blob_(NULL), blob_size_(0) {
+  memset(&init_args_, 0, sizeof(init_args_));
+}
+
+JavaVMOptions::~JavaVMOptions() {
+  if (blob_ != NULL) {
+    munmap(const_cast<char*>(blob_), blob_size_);
+  }
+}
+
+const char* JavaVMOptions::String(const Entry& entry) const {
+  return (entry.in_blob ? blob_ : &arena_[0]) + entry.offset;
+}
+
+const char* JavaVMOptions::Get(size_t i) const {
+  return String(entries_[i]);
+}
+
+void JavaVMOptions::AddEntry(const Entry& entry) {
+  const char* option = String(entry);
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (SameKey(String(entries_[i]), option)) {
+      // The superseded string stays in the arena until this object goes away.
+      entries_.erase(entries_.begin() + i);
+      break;
+    }
+  }
+  entries_.push_back(entry);
+}
+
+void JavaVMOptions::Add(const char* option, void* extra_info) {
+  Entry entry;
+  entry.offset = arena_.size();
+  entry.in_blob = false;
+  entry.extra_info = extra_info;
+  arena_.insert(arena_.end(), option, option + strlen(option) + 1);
+  AddEntry(entry);
+}
+
+bool JavaVMOptions::LoadFile(const char* path) {
+  FILE* file = fopen(path, "re");
+  if (file == NULL) {
+    ALOGE("Failed to open %s: %s", path, strerror(errno));
+    return false;
+  }
+  // getline rather than a fixed buffer, so that long options, like
+  // classpaths, are never split into two.
+  char* line = NULL;
+  size_t capacity = 0;
+  ssize_t length;
+  while ((length = getline(&line, &capacity, file)) != -1) {
+    char* begin = line;
+    while (*begin == ' ' || *begin == '\t') {
+      ++begin;
+    }
+    char* end = line + length;
+    while (end > begin && strchr(" \t\r\n", end[-1]) != NULL) {
+      --end;
+    }
+    *end = '\0';
+    if (begin != end && *begin != '#') {
+      Add(begin);
+    }
+  }
+  free(line);
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+bool JavaVMOptions::LoadBlob(const char* path) {
+  if (blob_ != NULL) {
+    ALOGE("Failed to load %s: a blob is already loaded", path);
+    return false;
+  }
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    ALOGE("Failed to open %s: %s", path, strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < kBlobHeaderSize) {
+    ALOGE("Failed to load %s: not an option blob", path);
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    ALOGE("Failed to map %s: %s", path, strerror(errno));
+    return false;
+  }
+  const char* blob = static_cast<const char*>(map);
+  uint32_t header[3];
+  memcpy(header, blob, sizeof(header));
+  if (header[0] != kBlobMagic || header[1] != kBlobVersion) {
+    ALOGE("Failed to load %s: bad magic or version", path);
+    munmap(map, size);
+    return false;
+  }
+
+  // Check every string before adding any, so that a bad blob adds nothing.
+  std::vector<size_t> offsets;
+  size_t offset = kBlobHeaderSize;
+  for (uint32_t i = 0; i < header[2]; ++i) {
+    const void* nul = (offset < size) ? memchr(blob + offset, '\0', size - offset) : NULL;
+    if (nul == NULL) {
+      ALOGE("Failed to load %s: truncated at option %" PRIu32, path, i);
+      munmap(map, size);
+      return false;
+    }
+    offsets.push_back(offset);
+    offset = static_cast<const char*>(nul) - blob + 1;
+  }
+
+  blob_ = blob;
+  blob_size_ = size;
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    Entry entry;
+    entry.offset = offsets[i];
+    entry.in_blob = true;
+    entry.extra_info = NULL;
+    AddEntry(entry);
+  }
+  return true;
+}
+
+bool JavaVMOptions::WriteBlob(const char* path) const {
+  std::vector<char> blob(kBlobHeaderSize);
+  uint32_t count = 0;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    const char* option = String(entries_[i]);
+    if (IsHook(option)) {
+      continue;  // The extra_info pointers are meaningless in another process.
+    }
+    blob.insert(blob.end(), option, option + strlen(option) + 1);
+    ++count;
+  }
+  const uint32_t header[3] = { kBlobMagic, kBlobVersion, count };
+  memcpy(&blob[0], header, sizeof(header));
+
+  FILE* file = fopen(path, "we");
+  if (file == NULL) {
+    ALOGE("Failed to create %s: %s", path, strerror(errno));
+    return false;
+  }
+  bool ok = fwrite(&blob[0], 1, blob.size(), file) == blob.size();
+  ok = (fclose(file) == 0) && ok;
+  if (!ok) {
+    ALOGE("Failed to write %s: %s", path, strerror(errno));
+  }
+  return ok;
+}
+
+bool JavaVMOptions::Validate(std::string* error) const {
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    const char* option = String(entries_[i]);
+    const char* problem = NULL;
+    if (*option == '\0') {
+      problem = "empty option";
+    } else if (IsHook(option)) {
+      if (entries_[i].extra_info == NULL) {
+        problem = "hook without extra_info";
+      }
+    } else if (*option != '-') {
+      problem = "option does not start with '-'";
+    } else if (IsSizeOption(option) && !IsValidSize(option + 4)) {
+      problem = "invalid size";
+    } else {
+      for (const char* p = option; *p != '\0'; ++p) {
+        if (static_cast<unsigned char>(*p) < 0x20) {
+          problem = "control character in option";
+          break;
+        }
+      }
+    }
+    if (problem != NULL) {
+      if (error != NULL) {
+        *error = std::string(problem) + ": \"" + option + "\"";
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+const JavaVMInitArgs* JavaVMOptions::GetInitArgs(jint version, bool ignore_unrecognized) {
+  options_.resize(entries_.size());
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    options_[i].optionString = const_cast<char*>(String(entries_[i]));
+    options_[i].extraInfo = entries_[i].extra_info;
+  }
+  init_args_.version = version;
+  init_args_.nOptions = options_.size();
+  init_args_.options = options_.empty() ? NULL : &options_[0];
+  init_args_.ignoreUnrecognized = ignore_unrecognized ? JNI_TRUE : JNI_FALSE;
+  return &init_args_;
+}
+
+uint64_t JavaVMOptions::Fingerprint() const {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    // Include the NUL so that {"ab", "c"} and {"a", "bc"} differ.
+    const char* option = String(entries_[i]);
+    size_t length = strlen(option) + 1;
+    for (size_t j = 0; j < length; ++j) {
+      hash ^= static_cast<unsigned char>(option[j]);
+      hash *= 0x100000001b3ULL;
+    }
+  }
+  return hash;
+}
+
+jint JavaVMOptions::CreateJavaVM(JavaVM** p_vm, JNIEnv** p_env, const char* stats_path) {
+  const JavaVMInitArgs* args = GetInitArgs();
+  uint64_t start = NanoTime();
+  jint result = JNI_CreateJavaVM(p_vm, p_env, const_cast<JavaVMInitArgs*>(args));
+  uint64_t elapsed = NanoTime() - start;
+  if (result == JNI_OK && stats_path != NULL) {
+    RecordStartup(stats_path, Fingerprint(), elapsed);
+  }
+  return result;
+}
+
+// Reads "fingerprint ns" lines, skipping any that do not parse.
+static void ReadStartupStats(const char* stats_path,
+                             std::vector<std::pair<uint64_t, uint64_t> >* stats) {
+  FILE* file = fopen(stats_path, "re");
+  if (file == NULL) {
+    return;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    uint64_t fingerprint;
+    uint64_t ns;
+    if (sscanf(line, "%" SCNx64 " %" SCNu64, &fingerprint, &ns) == 2) {
+      stats->push_back(std::make_pair(fingerprint, ns));
+    }
+  }
+  fclose(file);
+}
+
+bool JavaVMOptions::RecordStartup(const char* stats_path, uint64_t fingerprint, uint64_t ns) {
+  std::vector<std::pair<uint64_t, uint64_t> > stats;
+  ReadStartupStats(stats_path, &stats);
+  bool found = false;
+  for (size_t i = 0; i < stats.size(); ++i) {
+    if (stats[i].first == fingerprint) {
+      if (ns >= stats[i].second) {
+        return true;  // Nothing to update.
+      }
+      stats[i].second = ns;
+      found = true;
+    }
+  }
+  if (!found) {
+    stats.push_back(std::make_pair(fingerprint, ns));
+  }
+
+  // Replace the file atomically so that concurrent launchers never see a
+  // partial one; if two race, one update is lost, which only costs a sample.
+  // Each writes its own temporary file, in the same directory so that the
+  // rename stays on one file system.
+  std::string temp_path = std::string(stats_path) + ".XXXXXX";
+  int fd = mkostemp(&temp_path[0], O_CLOEXEC);
+  if (fd == -1) {
+    ALOGW("Failed to create %s: %s", temp_path.c_str(), strerror(errno));
+    return false;
+  }
+  // mkostemp creates the file 0600; keep the stats readable by other users.
+  fchmod(fd, 0644);
+  FILE* file = fdopen(fd, "w");
+  if (file == NULL) {
+    ALOGW("Failed to open %s: %s", temp_path.c_str(), strerror(errno));
+    close(fd);
+    unlink(temp_path.c_str());
+    return false;
+  }
+  for (size_t i = 0; i < stats.size(); ++i) {
+    fprintf(file, "%016" PRIx64 " %" PRIu64 "\n", stats[i].first, stats[i].second);
+  }
+  if (fclose(file) != 0 || rename(temp_path.c_str(), stats_path) != 0) {
+    ALOGW("Failed to update %s: %s", stats_path, strerror(errno));
+    unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool JavaVMOptions::GetFastestStartup(const char* stats_path, uint64_t* fingerprint,
+                                      uint64_t* ns) {
+  std::vector<std::pair<uint64_t, uint64_t> > stats;
+  ReadStartupStats(stats_path, &stats);
+  if (stats.empty()) {
+    return false;
+  }
+  size_t best = 0;
+  for (size_t i = 1; i < stats.size(); ++i) {
+    if (stats[i].second < stats[best].second) {
+      best = i;
+    }
+  }
+  *fingerprint = stats[best].first;
+  *ns = stats[best].second;
+  return true;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JniAccessPolicy"
+
+#include "JniAccessPolicy.h"
+#include "ALog-priv.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+namespace {
+
+// Calls of each eligible strategy before a size class settles on the
+// fastest, and how often (in calls) the least-tried one is retried after.
+const uint64_t kExploreCalls = 4;
+const uint64_t kRetryInterval = 64;
+const uint64_t kDecayCalls = 1024;
+
+const char* const kStrategyNames[kJniAccessStrategyCount] = {
+    "region", "elements", "critical",
+};
+
+const char* const kSizeClassNames[JNI_ACCESS_SIZE_CLASSES] = {
+    "<=256B", "<=4KiB", "<=64KiB", ">64KiB",
+};
+
+JniAccessPolicy gPolicy = kJniAccessAdaptive;
+
+// Sites that have recorded a measurement, newest first. Sites are static and
+// are never removed.
+JniAccessSite* gSites;
+
+int sizeClass(size_t bytes) {
+    if (bytes <= 256) {
+        return 0;
+    } else if (bytes <= 4096) {
+        return 1;
+    } else if (bytes <= 65536) {
+        return 2;
+    }
+    return 3;
+}
+
+void registerSite(JniAccessSite* site) {
+    int expected = 0;
+    if (__atomic_load_n(&site->registered, __ATOMIC_RELAXED) != 0 ||
+            !__atomic_compare_exchange_n(&site->registered, &expected, 1, false,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return;
+    }
+    JniAccessSite* head = __atomic_load_n(&gSites, __ATOMIC_RELAXED);
+    do {
+        site->next = head;
+    } while (!__atomic_compare_exchange_n(&gSites, &head, site, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+}  // namespace
+
+void jniSetAccessPolicy(JniAccessPolicy policy) {
+    __atomic_store_n(&gPolicy, policy, __ATOMIC_RELAXED);
+}
+
+uint64_t jniAccessNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+JniAccessStrategy jniAccessChoose(JniAccessSite* site, size_t bytes, int flags,
+                                  int regionFits, uint64_t* startNs) {
+    const bool eligible[kJniAccessStrategyCount] = {
+        regionFits != 0, true, (flags & JNI_ACCESS_NO_JNI_CALLS) != 0,
+    };
+    JniAccessStrategy choice;
+    switch (__atomic_load_n(&gPolicy, __ATOMIC_RELAXED)) {
+    case kJniAccessFixed:
+        *startNs = 0;
+        return regionFits ? kJniAccessRegion : kJniAccessElements;
+    case kJniAccessForceRegion:
+        choice = regionFits ? kJniAccessRegion : kJniAccessElements;
+        break;
+    case kJniAccessForceElements:
+        choice = kJniAccessElements;
+        break;
+    case kJniAccessForceCritical:
+        choice = eligible[kJniAccessCritical] ? kJniAccessCritical : kJniAccessElements;
+        break;
+    default: {
+        const JniAccessStats* stats = site->stats[sizeClass(bytes)];
+        int best = -1;
+        double bestMean = 0;
+        int fewest = -1;
+        uint64_t fewestCalls = 0;
+        uint64_t total = 0;
+        for (int s = 0; s < kJniAccessStrategyCount; ++s) {
+            if (!eligible[s]) {
+                continue;
+            }
+            uint64_t calls = __atomic_load_n(&stats[s].calls, __ATOMIC_RELAXED);
+            uint64_t ns = __atomic_load_n(&stats[s].ns, __ATOMIC_RELAXED);
+            total += calls;
+            if (fewest < 0 || calls < fewestCalls) {
+                fewest = s;
+                fewestCalls = calls;
+            }
+            if (calls >= kExploreCalls) {
+                double mean = static_cast<double>(ns) / calls;
+                if (best < 0 || mean < bestMean) {
+                    best = s;
+                    bestMean = mean;
+                }
+            }
+        }
+        bool explore = best < 0 || fewestCalls < kExploreCalls || total % kRetryInterval == 0;
+        choice = static_cast<JniAccessStrategy>(explore ? fewest : best);
+        break;
+    }
+    }
+    *startNs = jniAccessNow();
+    return choice;
+}
+
+void jniAccessRecord(JniAccessSite* site, JniAccessStrategy strategy, size_t bytes,
+                     jboolean isCopy, uint64_t ns) {
+    registerSite(site);
+    JniAccessStats* stats = &site->stats[sizeClass(bytes)][strategy];
+    uint64_t calls = __atomic_add_fetch(&stats->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->ns, ns, __ATOMIC_RELAXED);
+    if (isCopy) {
+        __atomic_fetch_add(&stats->copies, 1, __ATOMIC_RELAXED);
+    }
+    if (calls >= kDecayCalls) {
+        // Racing records may be lost; the ratios are what matter.
+        __atomic_store_n(&stats->calls, calls / 2, __ATOMIC_RELAXED);
+        __atomic_store_n(&stats->ns, __atomic_load_n(&stats->ns, __ATOMIC_RELAXED) / 2,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&stats->copies, __atomic_load_n(&stats->copies, __ATOMIC_RELAXED) / 2,
+                         __ATOMIC_RELAXED);
+    }
+}
+
+void jniGetAccessSites(void (*visit)(const JniAccessSite* site, void* context),
+                       void* context) {
+    for (const JniAccessSite* site = __atomic_load_n(&gSites, __ATOMIC_ACQUIRE);
+            site != NULL; site = site->next) {
+        visit(site, context);
+    }
+}
+
+struct LogContext {
+    int priority;
+    const char* tag;
+};
+
+static void logSite(const JniAccessSite* site, void* context) {
+    LogContext* log = static_cast<LogContext*>(context);
+    __android_log_print(log->priority, log->tag, "%s:", site->name);
+    for (int c = 0; c < JNI_ACCESS_SIZE_CLASSES; ++c) {
+        for (int s = 0; s < kJniAccessStrategyCount; ++s) {
+            const JniAccessStats& stats = site->stats[c][s];
+            uint64_t calls = __atomic_load_n(&stats.calls, __ATOMIC_RELAXED);
+            if (calls == 0) {
+                continue;
+            }
+            uint64_t ns = __atomic_load_n(&stats.ns, __ATOMIC_RELAXED);
+            uint64_t copies = __atomic_load_n(&stats.copies, __ATOMIC_RELAXED);
+            __android_log_print(log->priority, log->tag,
+                                "  %-8s %-8s %8" PRIu64 " calls, %8" PRIu64 " ns mean, %3"
+                                PRIu64 "%% copies",
+                                kSizeClassNames[c], kStrategyNames[s], calls, ns / calls,
+                                100 * copies / calls);
+        }
+    }
+}
+
+void jniLogAccessSites(int priority, const char* tag) {
+    LogContext log = { priority, tag };
+    jniGetAccessSites(logSite, &log);
+}
@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JniBufferPool"
+
+#include "JniBufferPool.h"
+#include "JNIHelp.h"
+#include "ALog-priv.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <new>
+
+/*
+ * Slabs are committed one after another in a single reserved range of
+ * address space, so that a block's slab, and so its size class, follows from
+ * its address: releasing a buffer needs no header and no lookup, and an
+ * address from elsewhere is recognized by a range check.
+ *
+ * Free blocks are linked through their first word. Each thread caches up to
+ * about 256KiB of free blocks per class and exchanges them with the shared
+ * lists, under the class's lock, half a cache at a time. Counters live in
+ * the thread caches, so the fast paths touch no shared lines.
+ */
+namespace {
+
+const size_t kMinClassShift = 9;
+const size_t kSlabSize = 2 * 1024 * 1024;
+#if defined(__LP64__)
+const size_t kArenaBytes = static_cast<size_t>(4) << 30;
+#else
+const size_t kArenaBytes = 256 * 1024 * 1024;
+#endif
+const size_t kMaxSlabs = kArenaBytes / kSlabSize;
+const size_t kCacheBytes = 256 * 1024;
+const size_t kMaxCachedBlocks = 32;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct SharedClass {
+    pthread_mutex_t lock;
+    FreeBlock* free;
+    size_t count;
+    size_t slabs;
+    // Counters of threads that have exited.
+    uint64_t allocations;
+    uint64_t cacheHits;
+    uint64_t releases;
+} __attribute__((aligned(64)));
+
+struct ThreadCache {
+    FreeBlock* free[JNI_BUFFER_POOL_CLASSES];
+    size_t count[JNI_BUFFER_POOL_CLASSES];
+    uint64_t allocations[JNI_BUFFER_POOL_CLASSES];
+    uint64_t cacheHits[JNI_BUFFER_POOL_CLASSES];
+    uint64_t releases[JNI_BUFFER_POOL_CLASSES];
+    ThreadCache* prev;
+    ThreadCache* next;
+};
+
+pthread_once_t gOnce = PTHREAD_ONCE_INIT;
+pthread_key_t gCacheKey;
+char* gArena;  // NULL if the reservation failed.
+SharedClass gClasses[JNI_BUFFER_POOL_CLASSES];
+int gFlags;
+
+// Guards gSlabCount's increments; each slab's class is set before the count
+// that covers it is published.
+pthread_mutex_t gSlabLock = PTHREAD_MUTEX_INITIALIZER;
+size_t gSlabCount;
+uint8_t gSlabClass[kMaxSlabs];
+
+// Guards the list of live thread caches, for the statistics.
+pthread_mutex_t gCachesLock = PTHREAD_MUTEX_INITIALIZER;
+ThreadCache* gCaches;
+
+size_t blockSize(size_t sizeClass) {
+    return static_cast<size_t>(1) << (kMinClassShift + sizeClass);
+}
+
+size_t classFor(size_t capacity) {
+    if (capacity <= blockSize(0)) {
+        return 0;
+    }
+    return (8 * sizeof(unsigned long long)) - __builtin_clzll(capacity - 1) - kMinClassShift;
+}
+
+size_t cacheLimit(size_t sizeClass) {
+    size_t limit = kCacheBytes / blockSize(sizeClass);
+    return (limit == 0) ? 1 : (limit > kMaxCachedBlocks) ? kMaxCachedBlocks : limit;
+}
+
+// Relaxed, since only the owning thread writes and readers want a snapshot.
+void increment(uint64_t* counter) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+// Gives every block to the shared lists and folds the counters into them.
+void destroyCache(void* value) {
+    ThreadCache* cache = static_cast<ThreadCache*>(value);
+    pthread_mutex_lock(&gCachesLock);
+    for (size_t c = 0; c < JNI_BUFFER_POOL_CLASSES; ++c) {
+        SharedClass& shared = gClasses[c];
+        pthread_mutex_lock(&shared.lock);
+        while (cache->free[c] != NULL) {
+            FreeBlock* block = cache->free[c];
+            cache->free[c] = block->next;
+            block->next = shared.free;
+            shared.free = block;
+            shared.count++;
+        }
+        shared.allocations += cache->allocations[c];
+        shared.cacheHits += cache->cacheHits[c];
+        shared.releases += cache->releases[c];
+        pthread_mutex_unlock(&shared.lock);
+    }
+    if (cache->prev != NULL) {
+        cache->prev->next = cache->next;
+    } else {
+        gCaches = cache->next;
+    }
+    if (cache->next != NULL) {
+        cache->next->prev = cache->prev;
+    }
+    pthread_mutex_unlock(&gCachesLock);
+    delete cache;
+}
+
+void init() {
+    pthread_key_create(&gCacheKey, destroyCache);
+    for (size_t c = 0; c < JNI_BUFFER_POOL_CLASSES; ++c) {
+        pthread_mutex_init(&gClasses[c].lock, NULL);
+    }
+    // Address space only, aligned to a slab so that slabs can be huge pages.
+    void* reserved = mmap(NULL, kArenaBytes + kSlabSize, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED) {
+        ALOGE("Could not reserve %zu bytes for the buffer pool: %s", kArenaBytes,
+              strerror(errno));
+        return;
+    }
+    const uintptr_t start = reinterpret_cast<uintptr_t>(reserved);
+    const uintptr_t aligned = (start + kSlabSize - 1) & ~(kSlabSize - 1);
+    if (aligned != start) {
+        munmap(reserved, aligned - start);
+    }
+    munmap(reinterpret_cast<void*>(aligned + kArenaBytes), kSlabSize - (aligned - start));
+    gArena = reinterpret_cast<char*>(aligned);
+}
+
+ThreadCache* getCache() {
+    ThreadCache* cache = static_cast<ThreadCache*>(pthread_getspecific(gCacheKey));
+    if (cache == NULL) {
+        cache = new (std::nothrow) ThreadCache();
+        if (cache == NULL) {
+            return NULL;
+        }
+        pthread_setspecific(gCacheKey, cache);
+        pthread_mutex_lock(&gCachesLock);
+        cache->next = gCaches;
+        if (gCaches != NULL) {
+            gCaches->prev = cache;
+        }
+        gCaches = cache;
+        pthread_mutex_unlock(&gCachesLock);
+    }
+    return cache;
+}
+
+// Commits the next slab and adds its blocks to the shared list. Called with
+// the class's lock held.
+bool addSlab(size_t sizeClass) {
+    if (gArena == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&gSlabLock);
+    const size_t index = gSlabCount;
+    char* slab = gArena + index * kSlabSize;
+    bool ok = index < kMaxSlabs &&
+            mmap(slab, kSlabSize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED;
+    if (ok) {
+#ifdef MADV_HUGEPAGE
+        if ((__atomic_load_n(&gFlags, __ATOMIC_RELAXED) & JNI_BUFFER_POOL_HUGEPAGES) != 0) {
+            madvise(slab, kSlabSize, MADV_HUGEPAGE);
+        }
+#endif
+        gSlabClass[index] = sizeClass;
+        __atomic_store_n(&gSlabCount, index + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&gSlabLock);
+    if (!ok) {
+        return false;
+    }
+
+    SharedClass& shared = gClasses[sizeClass];
+    const size_t size = blockSize(sizeClass);
+    for (size_t offset = kSlabSize; offset > 0; offset -= size) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + offset - size);
+        block->next = shared.free;
+        shared.free = block;
+    }
+    shared.count += kSlabSize / size;
+    shared.slabs++;
+    return true;
+}
+
+// Moves up to count blocks from the shared list to the cache, adding a slab
+// if the shared list is empty.
+bool refill(ThreadCache* cache, size_t sizeClass, size_t count) {
+    SharedClass& shared = gClasses[sizeClass];
+    pthread_mutex_lock(&shared.lock);
+    if (shared.free == NULL && !addSlab(sizeClass)) {
+        pthread_mutex_unlock(&shared.lock);
+        return false;
+    }
+    for (size_t i = 0; i < count && shared.free != NULL; ++i) {
+        FreeBlock* block = shared.free;
+        shared.free = block->next;
+        shared.count--;
+        block->next = cache->free[sizeClass];
+        cache->free[sizeClass] = block;
+        cache->count[sizeClass]++;
+    }
+    pthread_mutex_unlock(&shared.lock);
+    return true;
+}
+
+void spill(ThreadCache* cache, size_t sizeClass, size_t count) {
+    SharedClass& shared = gClasses[sizeClass];
+    pthread_mutex_lock(&shared.lock);
+    for (size_t i = 0; i < count; ++i) {
+        FreeBlock* block = cache->free[sizeClass];
+        cache->free[sizeClass] = block->next;
+        cache->count[sizeClass]--;
+        block->next = shared.free;
+        shared.free = block;
+        shared.count++;
+    }
+    pthread_mutex_unlock(&shared.lock);
+}
+
+void* allocateBlock(size_t sizeClass) {
+    ThreadCache* cache = getCache();
+    if (cache == NULL) {
+        return NULL;
+    }
+    if (cache->free[sizeClass] != NULL) {
+        increment(&cache->cacheHits[sizeClass]);
+    } else if (!refill(cache, sizeClass, (cacheLimit(sizeClass) + 1) / 2)) {
+        return NULL;
+    }
+    FreeBlock* block = cache->free[sizeClass];
+    cache->free[sizeClass] = block->next;
+    cache->count[sizeClass]--;
+    increment(&cache->allocations[sizeClass]);
+    return block;
+}
+
+void releaseBlock(void* address, size_t sizeClass) {
+    ThreadCache* cache = getCache();
+    FreeBlock* block = static_cast<FreeBlock*>(address);
+    if (cache == NULL) {
+        SharedClass& shared = gClasses[sizeClass];
+        pthread_mutex_lock(&shared.lock);
+        block->next = shared.free;
+        shared.free = block;
+        shared.count++;
+        shared.releases++;
+        pthread_mutex_unlock(&shared.lock);
+        return;
+    }
+    block->next = cache->free[sizeClass];
+    cache->free[sizeClass] = block;
+    increment(&cache->releases[sizeClass]);
+    const size_t limit = cacheLimit(sizeClass);
+    if (++cache->count[sizeClass] > limit) {
+        spill(cache, sizeClass, (limit + 1) / 2);
+    }
+}
+
+// Returns the class of the block at address, or -1 if it is not one.
+int classOfBlock(const void* address) {
+    const char* p = static_cast<const char*>(address);
+    if (gArena == NULL || p < gArena) {
+        return -1;
+    }
+    const size_t offset = p - gArena;
+    if (offset / kSlabSize >= __atomic_load_n(&gSlabCount, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    const size_t sizeClass = gSlabClass[offset / kSlabSize];
+    return (offset % blockSize(sizeClass) == 0) ? static_cast<int>(sizeClass) : -1;
+}
+
+}  // namespace
+
+int jniAllocatePooledBuffer(JNIEnv* env, size_t capacity, JniPooledBuffer* buffer) {
+    if (capacity == 0 || capacity > JNI_BUFFER_POOL_MAX_SIZE) {
+        jniThrowExceptionFmt(env, "java/lang/IllegalArgumentException",
+                             "Bad pooled buffer capacity: %zu", capacity);
+        return -1;
+    }
+    pthread_once(&gOnce, init);
+    const size_t sizeClass = classFor(capacity);
+    void* address = allocateBlock(sizeClass);
+    if (address == NULL) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Buffer pool exhausted");
+        return -1;
+    }
+    jobject object = env->NewDirectByteBuffer(address, capacity);
+    if (object == NULL) {
+        releaseBlock(address, sizeClass);
+        if (!env->ExceptionCheck()) {
+            jniThrowException(env, "java/lang/OutOfMemoryError", "Could not create buffer");
+        }
+        return -1;
+    }
+    buffer->buffer = object;
+    buffer->address = address;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+void jniReleasePooledBuffer(JNIEnv* env, const JniPooledBuffer* buffer) {
+    releaseBlock(buffer->address, classFor(buffer->capacity));
+    env->DeleteLocalRef(buffer->buffer);
+}
+
+int jniReleasePooledByteBuffer(JNIEnv* env, jobject buffer) {
+    if (buffer == NULL) {
+        return -1;
+    }
+    pthread_once(&gOnce, init);
+    void* address = env->GetDirectBufferAddress(buffer);
+    const int sizeClass = (address != NULL) ? classOfBlock(address) : -1;
+    if (sizeClass < 0) {
+        return -1;
+    }
+    releaseBlock(address, sizeClass);
+    return 0;
+}
+
+void jniSetBufferPoolFlags(int flags) {
+    __atomic_store_n(&gFlags, flags, __ATOMIC_RELAXED);
+}
+
+void jniGetBufferPoolStats(JniBufferPoolStats stats[JNI_BUFFER_POOL_CLASSES]) {
+    pthread_once(&gOnce, init);
+    pthread_mutex_lock(&gCachesLock);
+    for (size_t c = 0; c < JNI_BUFFER_POOL_CLASSES; ++c) {
+        SharedClass& shared = gClasses[c];
+        pthread_mutex_lock(&shared.lock);
+        stats[c].blockSize = blockSize(c);
+        stats[c].allocations = shared.allocations;
+        stats[c].cacheHits = shared.cacheHits;
+        stats[c].releases = shared.releases;
+        stats[c].slabs = shared.slabs;
+        stats[c].sharedBlocks = shared.count;
+        pthread_mutex_unlock(&shared.lock);
+        for (ThreadCache* cache = gCaches; cache != NULL; cache = cache->next) {
+            stats[c].allocations += __atomic_load_n(&cache->allocations[c], __ATOMIC_RELAXED);
+            stats[c].cacheHits += __atomic_load_n(&cache->cacheHits[c], __ATOMIC_RELAXED);
+            stats[c].releases += __atomic_load_n(&cache->releases[c], __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&gCachesLock);
+}
@@ -0,0 +1,650 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JniBytes.h"
+#include "JNIHelp.h"
+#include "JniScratch.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#define JNI_BYTES_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define JNI_BYTES_NEON 1
+#include <arm_neon.h>
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+#endif
+
+namespace {
+
+// Each kernel set provides these; the ones without a vector version use the
+// scalar one.
+struct Kernels {
+    JniBytesIsa isa;
+    uint32_t (*crc32c)(uint32_t crc, const uint8_t* p, size_t size);
+    uint32_t (*adler32)(uint32_t adler, const uint8_t* p, size_t size);
+    void (*toHex)(char* out, const uint8_t* p, size_t size);
+    // Flips bit 5 of the bytes in [first, last], i.e. one ASCII case.
+    void (*flipCase)(uint8_t* out, const uint8_t* p, size_t size, uint8_t first, uint8_t last);
+    // Reverses the bytes of each of count elements of width 2, 4 or 8.
+    void (*swap)(uint8_t* out, const uint8_t* p, size_t count, size_t width);
+};
+
+const char kHexDigits[] = "0123456789abcdef";
+const char kBase64Digits[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Largest n such that 255n(n+1)/2 + (n+1)(kAdlerBase-1) fits in 32 bits, as
+// in zlib: Adler sums may be reduced only once per kAdlerBlock bytes.
+const uint32_t kAdlerBase = 65521;
+const size_t kAdlerBlock = 5552;
+
+// Slice-by-8 tables for CRC32C (Castagnoli, reflected 0x82F63B78).
+uint32_t gCrcTable[8][256];
+
+int8_t gHexValues[256];
+int8_t gBase64Values[256];
+
+void initTables() {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+        }
+        gCrcTable[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (int k = 1; k < 8; ++k) {
+            uint32_t crc = gCrcTable[k - 1][i];
+            gCrcTable[k][i] = (crc >> 8) ^ gCrcTable[0][crc & 0xff];
+        }
+    }
+    memset(gHexValues, -1, sizeof(gHexValues));
+    for (int i = 0; i < 16; ++i) {
+        gHexValues[static_cast<uint8_t>(kHexDigits[i])] = i;
+        if (i >= 10) {
+            gHexValues['A' + i - 10] = i;
+        }
+    }
+    memset(gBase64Values, -1, sizeof(gBase64Values));
+    for (int i = 0; i < 64; ++i) {
+        gBase64Values[static_cast<uint8_t>(kBase64Digits[i])] = i;
+    }
+}
+
+uint32_t crc32cScalar(uint32_t crc, const uint8_t* p, size_t size) {
+    while (size > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+        crc = (crc >> 8) ^ gCrcTable[0][(crc ^ *p++) & 0xff];
+        --size;
+    }
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, p, 4);
+        memcpy(&high, p + 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        low = __builtin_bswap32(low);
+        high = __builtin_bswap32(high);
+#endif
+        low ^= crc;
+        crc = gCrcTable[7][low & 0xff] ^ gCrcTable[6][(low >> 8) & 0xff] ^
+              gCrcTable[5][(low >> 16) & 0xff] ^ gCrcTable[4][low >> 24] ^
+              gCrcTable[3][high & 0xff] ^ gCrcTable[2][(high >> 8) & 0xff] ^
+              gCrcTable[1][(high >> 16) & 0xff] ^ gCrcTable[0][high >> 24];
+    }
+    while (size-- > 0) {
+        crc = (crc >> 8) ^ gCrcTable[0][(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+uint32_t adler32Scalar(uint32_t adler, const uint8_t* p, size_t size) {
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+    while (size > 0) {
+        size_t n = (size < kAdlerBlock) ? size : kAdlerBlock;
+        size -= n;
+        for (; n >= 4; n -= 4, p += 4) {
+            s1 += p[0]; s2 += s1;
+            s1 += p[1]; s2 += s1;
+            s1 += p[2]; s2 += s1;
+            s1 += p[3]; s2 += s1;
+        }
+        while (n-- > 0) {
+            s1 += *p++;
+            s2 += s1;
+        }
+        s1 %= kAdlerBase;
+        s2 %= kAdlerBase;
+    }
+    return (s2 << 16) | s1;
+}
+
+void toHexScalar(char* out, const uint8_t* p, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        out[2 * i] = kHexDigits[p[i] >> 4];
+        out[2 * i + 1] = kHexDigits[p[i] & 0xf];
+    }
+}
+
+void flipCaseScalar(uint8_t* out, const uint8_t* p, size_t size, uint8_t first, uint8_t last) {
+    const uint8_t span = last - first;
+    for (size_t i = 0; i < size; ++i) {
+        uint8_t c = p[i];
+        out[i] = (static_cast<uint8_t>(c - first) <= span) ? (c ^ 0x20) : c;
+    }
+}
+
+void swapScalar(uint8_t* out, const uint8_t* p, size_t count, size_t width) {
+    for (size_t i = 0; i < count; ++i, p += width, out += width) {
+        if (width == 2) {
+            uint16_t value;
+            memcpy(&value, p, 2);
+            value = __builtin_bswap16(value);
+            memcpy(out, &value, 2);
+        } else if (width == 4) {
+            uint32_t value;
+            memcpy(&value, p, 4);
+            value = __builtin_bswap32(value);
+            memcpy(out, &value, 4);
+        } else {
+            uint64_t value;
+            memcpy(&value, p, 8);
+            value = __builtin_bswap64(value);
+            memcpy(out, &value, 8);
+        }
+    }
+}
+
+const Kernels kScalarKernels = {
+    kJniBytesScalar, crc32cScalar, adler32Scalar, toHexScalar, flipCaseScalar, swapScalar,
+};
+
+#if defined(JNI_BYTES_X86)
+
+__attribute__((target("sse4.2")))
+uint32_t crc32cSse42(uint32_t crc, const uint8_t* p, size_t size) {
+    while (size > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        --size;
+    }
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+#endif
+    for (; size >= 4; size -= 4, p += 4) {
+        uint32_t word;
+        memcpy(&word, p, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    while (size-- > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+// For each run of 16-byte blocks, s1 gains the byte sums and s2 gains the
+// byte sums weighted 16..1, plus 16 times s1 as it stood before each block.
+__attribute__((target("ssse3")))
+uint32_t adler32Ssse3(uint32_t adler, const uint8_t* p, size_t size) {
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+    size_t blocks = size / 16;
+    size -= blocks * 16;
+    const __m128i weights = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    while (blocks > 0) {
+        size_t n = (blocks < kAdlerBlock / 16) ? blocks : kAdlerBlock / 16;
+        blocks -= n;
+        __m128i prefix = _mm_set_epi32(0, 0, 0, s1 * n);
+        __m128i sum1 = zero;
+        __m128i sum2 = _mm_set_epi32(0, 0, 0, s2);
+        for (; n > 0; --n, p += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            prefix = _mm_add_epi32(prefix, sum1);
+            sum1 = _mm_add_epi32(sum1, _mm_sad_epu8(bytes, zero));
+            sum2 = _mm_add_epi32(sum2,
+                    _mm_madd_epi16(_mm_maddubs_epi16(bytes, weights), ones));
+        }
+        sum2 = _mm_add_epi32(sum2, _mm_slli_epi32(prefix, 4));
+        sum1 = _mm_add_epi32(sum1, _mm_shuffle_epi32(sum1, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(2, 3, 0, 1)));
+        s1 = (s1 + static_cast<uint32_t>(_mm_cvtsi128_si32(sum1))) % kAdlerBase;
+        s2 = static_cast<uint32_t>(_mm_cvtsi128_si32(sum2)) % kAdlerBase;
+    }
+    return adler32Scalar((s2 << 16) | s1, p, size);
+}
+
+__attribute__((target("ssse3")))
+void toHexSsse3(char* out, const uint8_t* p, size_t size) {
+    const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kHexDigits));
+    const __m128i mask = _mm_set1_epi8(0xf);
+    for (; size >= 16; size -= 16, p += 16, out += 32) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), mask));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(high, low));
+    }
+    toHexScalar(out, p, size);
+}
+
+// Bytes in [first, last] are those that land below first - 128 + span + 1
+// when shifted into the signed range.
+__attribute__((target("sse2")))
+void flipCaseSse2(uint8_t* out, const uint8_t* p, size_t size, uint8_t first, uint8_t last) {
+    const __m128i shift = _mm_set1_epi8(static_cast<char>(0x80 - first));
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(-128 + (last - first) + 1));
+    const __m128i bit = _mm_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i in = _mm_cmplt_epi8(_mm_add_epi8(bytes, shift), limit);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_xor_si128(bytes, _mm_and_si128(in, bit)));
+    }
+    flipCaseScalar(out + i, p + i, size - i, first, last);
+}
+
+// Byte shuffles that reverse each 2, 4 or 8 byte element of a vector.
+const uint8_t kSwapShuffles[3][16] = {
+    { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 },
+    { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+    { 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 },
+};
+
+inline const uint8_t* swapShuffle(size_t width) {
+    return kSwapShuffles[(width == 2) ? 0 : (width == 4) ? 1 : 2];
+}
+
+__attribute__((target("ssse3")))
+void swapSsse3(uint8_t* out, const uint8_t* p, size_t count, size_t width) {
+    const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(swapShuffle(width)));
+    size_t bytes = count * width;
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_shuffle_epi8(v, shuffle));
+    }
+    swapScalar(out + i, p + i, (bytes - i) / width, width);
+}
+
+__attribute__((target("avx2")))
+uint32_t adler32Avx2(uint32_t adler, const uint8_t* p, size_t size) {
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+    size_t blocks = size / 32;
+    size -= blocks * 32;
+    const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21,
+                                             20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9,
+                                             8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i zero = _mm256_setzero_si256();
+    while (blocks > 0) {
+        size_t n = (blocks < kAdlerBlock / 32) ? blocks : kAdlerBlock / 32;
+        blocks -= n;
+        __m256i prefix = _mm256_setr_epi32(s1 * n, 0, 0, 0, 0, 0, 0, 0);
+        __m256i sum1 = zero;
+        __m256i sum2 = _mm256_setr_epi32(s2, 0, 0, 0, 0, 0, 0, 0);
+        for (; n > 0; --n, p += 32) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            prefix = _mm256_add_epi32(prefix, sum1);
+            sum1 = _mm256_add_epi32(sum1, _mm256_sad_epu8(bytes, zero));
+            sum2 = _mm256_add_epi32(sum2,
+                    _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, weights), ones));
+        }
+        sum2 = _mm256_add_epi32(sum2, _mm256_slli_epi32(prefix, 5));
+        __m128i fold1 = _mm_add_epi32(_mm256_castsi256_si128(sum1),
+                                      _mm256_extracti128_si256(sum1, 1));
+        __m128i fold2 = _mm_add_epi32(_mm256_castsi256_si128(sum2),
+                                      _mm256_extracti128_si256(sum2, 1));
+        fold1 = _mm_add_epi32(fold1, _mm_shuffle_epi32(fold1, _MM_SHUFFLE(1, 0, 3, 2)));
+        fold2 = _mm_add_epi32(fold2, _mm_shuffle_epi32(fold2, _MM_SHUFFLE(1, 0, 3, 2)));
+        fold2 = _mm_add_epi32(fold2, _mm_shuffle_epi32(fold2, _MM_SHUFFLE(2, 3, 0, 1)));
+        s1 = (s1 + static_cast<uint32_t>(_mm_cvtsi128_si32(fold1))) % kAdlerBase;
+        s2 = static_cast<uint32_t>(_mm_cvtsi128_si32(fold2)) % kAdlerBase;
+    }
+    return adler32Ssse3((s2 << 16) | s1, p, size);
+}
+
+__attribute__((target("avx2")))
+void toHexAvx2(char* out, const uint8_t* p, size_t size) {
+    const __m256i digits = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(kHexDigits)));
+    const __m256i mask = _mm256_set1_epi8(0xf);
+    for (; size >= 32; size -= 32, p += 32, out += 64) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i high = _mm256_shuffle_epi8(digits,
+                _mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask));
+        __m256i low = _mm256_shuffle_epi8(digits, _mm256_and_si256(bytes, mask));
+        // The unpacks work within 128-bit lanes; put the lanes back in order.
+        __m256i first = _mm256_unpacklo_epi8(high, low);
+        __m256i second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+                            _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32),
+                            _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    toHexSsse3(out, p, size);
+}
+
+__attribute__((target("avx2")))
+void flipCaseAvx2(uint8_t* out, const uint8_t* p, size_t size, uint8_t first, uint8_t last) {
+    const __m256i shift = _mm256_set1_epi8(static_cast<char>(0x80 - first));
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(-128 + (last - first) + 1));
+    const __m256i bit = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i in = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(bytes, shift));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            _mm256_xor_si256(bytes, _mm256_and_si256(in, bit)));
+    }
+    flipCaseSse2(out + i, p + i, size - i, first, last);
+}
+
+__attribute__((target("avx2")))
+void swapAvx2(uint8_t* out, const uint8_t* p, size_t count, size_t width) {
+    const __m256i shuffle = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(swapShuffle(width))));
+    size_t bytes = count * width;
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_shuffle_epi8(v, shuffle));
+    }
+    swapSsse3(out + i, p + i, (bytes - i) / width, width);
+}
+
+const Kernels kSse42Kernels = {
+    kJniBytesSse42, crc32cSse42, adler32Ssse3, toHexSsse3, flipCaseSse2, swapSsse3,
+};
+
+const Kernels kAvx2Kernels = {
+    kJniBytesAvx2, crc32cSse42, adler32Avx2, toHexAvx2, flipCaseAvx2, swapAvx2,
+};
+
+#endif  // JNI_BYTES_X86
+
+#if defined(JNI_BYTES_NEON)
+
+#if defined(__ARM_FEATURE_CRC32)
+uint32_t crc32cArm(uint32_t crc, const uint8_t* p, size_t size) {
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc = __crc32cd(crc, word);
+    }
+    while (size-- > 0) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+#else
+#define crc32cArm crc32cScalar
+#endif
+
+void toHexNeon(char* out, const uint8_t* p, size_t size) {
+    const uint8x16_t digits = vld1q_u8(reinterpret_cast<const uint8_t*>(kHexDigits));
+    const uint8x16_t mask = vdupq_n_u8(0xf);
+    for (; size >= 16; size -= 16, p += 16, out += 32) {
+        uint8x16_t bytes = vld1q_u8(p);
+        uint8x16x2_t pairs;
+        pairs.val[0] = vqtbl1q_u8(digits, vshrq_n_u8(bytes, 4));
+        pairs.val[1] = vqtbl1q_u8(digits, vandq_u8(bytes, mask));
+        vst2q_u8(reinterpret_cast<uint8_t*>(out), pairs);
+    }
+    toHexScalar(out, p, size);
+}
+
+void flipCaseNeon(uint8_t* out, const uint8_t* p, size_t size, uint8_t first, uint8_t last) {
+    const uint8x16_t base = vdupq_n_u8(first);
+    const uint8x16_t span = vdupq_n_u8(last - first);
+    const uint8x16_t bit = vdupq_n_u8(0x20);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t bytes = vld1q_u8(p + i);
+        uint8x16_t in = vcleq_u8(vsubq_u8(bytes, base), span);
+        vst1q_u8(out + i, veorq_u8(bytes, vandq_u8(in, bit)));
+    }
+    flipCaseScalar(out + i, p + i, size - i, first, last);
+}
+
+void swapNeon(uint8_t* out, const uint8_t* p, size_t count, size_t width) {
+    size_t bytes = count * width;
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        uint8x16_t v = vld1q_u8(p + i);
+        v = (width == 2) ? vrev16q_u8(v) : (width == 4) ? vrev32q_u8(v) : vrev64q_u8(v);
+        vst1q_u8(out + i, v);
+    }
+    swapScalar(out + i, p + i, (bytes - i) / width, width);
+}
+
+const Kernels kNeonKernels = {
+    kJniBytesNeon, crc32cArm, adler32Scalar, toHexNeon, flipCaseNeon, swapNeon,
+};
+
+#endif  // JNI_BYTES_NEON
+
+pthread_once_t gOnce = PTHREAD_ONCE_INIT;
+const Kernels* gKernels = &kScalarKernels;
+
+const Kernels* kernelsFor(JniBytesIsa isa) {
+    switch (isa) {
+#if defined(JNI_BYTES_X86)
+    case kJniBytesAvx2:
+        if (__builtin_cpu_supports("avx2")) {
+            return &kAvx2Kernels;
+        }
+        break;
+    case kJniBytesSse42:
+        if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("ssse3")) {
+            return &kSse42Kernels;
+        }
+        break;
+#endif
+#if defined(JNI_BYTES_NEON)
+    case kJniBytesNeon:
+        return &kNeonKernels;
+#endif
+    default:
+        break;
+    }
+    return &kScalarKernels;
+}
+
+void initKernels() {
+    initTables();
+#if defined(JNI_BYTES_X86)
+    __builtin_cpu_init();
+    gKernels = kernelsFor(kJniBytesAvx2);
+    if (gKernels == &kScalarKernels) {
+        gKernels = kernelsFor(kJniBytesSse42);
+    }
+#elif defined(JNI_BYTES_NEON)
+    gKernels = kernelsFor(kJniBytesNeon);
+#endif
+}
+
+inline const Kernels* kernels() {
+    pthread_once(&gOnce, initKernels);
+    return gKernels;
+}
+
+jstring newAsciiString(JNIEnv* env, size_t length, void (*encode)(char*, const void*, size_t),
+                       const void* data, size_t size) {
+    ScopedScratch scratch;
+    char* chars = scratch.alloc<char>(length + 1);
+    if (chars == NULL) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Could not allocate string");
+        return NULL;
+    }
+    encode(chars, data, size);
+    chars[length] = '\0';
+    return env->NewStringUTF(chars);
+}
+
+void encodeBase64(char* out, const void* data, size_t size) {
+    jniBytesToBase64(out, data, size);
+}
+
+}  // namespace
+
+JniBytesIsa jniBytesIsa() {
+    return kernels()->isa;
+}
+
+JniBytesIsa jniBytesSetIsa(JniBytesIsa isa) {
+    kernels();
+    gKernels = kernelsFor(isa);
+    return gKernels->isa;
+}
+
+ptrdiff_t jniBytesIndexOf(const void* data, size_t size, uint8_t value) {
+    const void* found = memchr(data, value, size);
+    return (found != NULL) ? static_cast<const uint8_t*>(found) - static_cast<const uint8_t*>(data)
+                           : -1;
+}
+
+int jniBytesEqual(const void* a, const void* b, size_t size) {
+    return memcmp(a, b, size) == 0;
+}
+
+uint32_t jniBytesCrc32c(uint32_t crc, const void* data, size_t size) {
+    return ~kernels()->crc32c(~crc, static_cast<const uint8_t*>(data), size);
+}
+
+uint32_t jniBytesAdler32(uint32_t adler, const void* data, size_t size) {
+    return kernels()->adler32(adler, static_cast<const uint8_t*>(data), size);
+}
+
+void jniBytesToHex(char* out, const void* data, size_t size) {
+    kernels()->toHex(out, static_cast<const uint8_t*>(data), size);
+}
+
+ptrdiff_t jniBytesFromHex(void* out, const char* hex, size_t length) {
+    if ((length & 1) != 0) {
+        return -1;
+    }
+    kernels();
+    uint8_t* bytes = static_cast<uint8_t*>(out);
+    const uint8_t* digits = reinterpret_cast<const uint8_t*>(hex);
+    for (size_t i = 0; i < length; i += 2) {
+        int high = gHexValues[digits[i]];
+        int low = gHexValues[digits[i + 1]];
+        if ((high | low) < 0) {
+            return -1;
+        }
+        bytes[i / 2] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return length / 2;
+}
+
+size_t jniBytesToBase64(char* out, const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    char* start = out;
+    for (; size >= 3; size -= 3, p += 3, out += 4) {
+        uint32_t group = (p[0] << 16) | (p[1] << 8) | p[2];
+        out[0] = kBase64Digits[group >> 18];
+        out[1] = kBase64Digits[(group >> 12) & 0x3f];
+        out[2] = kBase64Digits[(group >> 6) & 0x3f];
+        out[3] = kBase64Digits[group & 0x3f];
+    }
+    if (size > 0) {
+        uint32_t group = (p[0] << 16) | ((size == 2) ? (p[1] << 8) : 0);
+        out[0] = kBase64Digits[group >> 18];
+        out[1] = kBase64Digits[(group >> 12) & 0x3f];
+        out[2] = (size == 2) ? kBase64Digits[(group >> 6) & 0x3f] : '=';
+        out[3] = '=';
+        out += 4;
+    }
+    return out - start;
+}
+
+ptrdiff_t jniBytesFromBase64(void* out, const char* base64, size_t length) {
+    if ((length & 3) != 0) {
+        return -1;
+    }
+    kernels();
+    uint8_t* bytes = static_cast<uint8_t*>(out);
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(base64);
+    size_t padding = 0;
+    if (length > 0 && p[length - 1] == '=') {
+        padding = (p[length - 2] == '=') ? 2 : 1;
+    }
+    size_t written = 0;
+    for (size_t i = 0; i < length; i += 4) {
+        const bool last = (i + 4 == length);
+        int a = gBase64Values[p[i]];
+        int b = gBase64Values[p[i + 1]];
+        int c = (last && padding == 2) ? 0 : gBase64Values[p[i + 2]];
+        int d = (last && padding >= 1) ? 0 : gBase64Values[p[i + 3]];
+        if ((a | b | c | d) < 0) {
+            return -1;
+        }
+        uint32_t group = (a << 18) | (b << 12) | (c << 6) | d;
+        bytes[written++] = static_cast<uint8_t>(group >> 16);
+        if (!last || padding < 2) {
+            bytes[written++] = static_cast<uint8_t>(group >> 8);
+        }
+        if (!last || padding < 1) {
+            bytes[written++] = static_cast<uint8_t>(group);
+        }
+    }
+    return written;
+}
+
+void jniBytesToLowerAscii(void* out, const void* in, size_t size) {
+    kernels()->flipCase(static_cast<uint8_t*>(out), static_cast<const uint8_t*>(in), size,
+                        'A', 'Z');
+}
+
+void jniBytesToUpperAscii(void* out, const void* in, size_t size) {
+    kernels()->flipCase(static_cast<uint8_t*>(out), static_cast<const uint8_t*>(in), size,
+                        'a', 'z');
+}
+
+void jniBytesSwap16(void* out, const void* in, size_t count) {
+    kernels()->swap(static_cast<uint8_t*>(out), static_cast<const uint8_t*>(in), count, 2);
+}
+
+void jniBytesSwap32(void* out, const void* in, size_t count) {
+    kernels()->swap(static_cast<uint8_t*>(out), static_cast<const uint8_t*>(in), count, 4);
+}
+
+void jniBytesSwap64(void* out, const void* in, size_t count) {
+    kernels()->swap(static_cast<uint8_t*>(out), static_cast<const uint8_t*>(in), count, 8);
+}
+
+jstring jniBytesToHexString(JNIEnv* env, const void* data, size_t size) {
+    return newAsciiString(env, 2 * size, jniBytesToHex, data, size);
+}
+
+jstring jniBytesToBase64String(JNIEnv* env, const void* data, size_t size) {
+    return newAsciiString(env, JNI_BASE64_ENCODED_SIZE(size), encodeBase64, data, size);
+}
@@ -0,0 +1,475 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JniCallRecorder"
+
+#include "JniCallRecorder.h"
+#include "ALog-priv.h"
+
+#include <errno.h>
+#include <new>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+const char kTraceMagic[4] = { 'J', 'N', 'I', 'T' };
+const uint8_t kTraceVersion = 2;
+
+// The largest record: id and type, then two LEB128 values.
+const size_t kMaxRecordSize = 2 + 10 + 10;
+const size_t kBufferSize = 8192;
+// A thread writes out its buffer once it is this full, unless it is inside a
+// critical region, where it holds off until the buffer is actually full.
+const size_t kFlushThreshold = kBufferSize / 2;
+
+// Each thread that makes recorded calls gathers its records here and writes
+// them to the trace as one block at a time. The owning thread is the only
+// one that appends; lock is only ever contended by Stop and thread exit.
+struct ThreadBuffer {
+  pthread_mutex_t lock;
+  pid_t tid;
+  uint64_t session;  // Of the records in data; stale ones are dropped.
+  int criticalDepth;
+  size_t used;
+  uint64_t records;
+  uint8_t data[kBufferSize];
+  ThreadBuffer* prev;
+  ThreadBuffer* next;
+};
+
+// Guards everything below except gOriginal and gHooked, which are set once
+// by the first Attach and never change afterwards, so that a hook running
+// concurrently with Stop or a later Attach always finds a valid table.
+// gRecording and gSession are also read without it.
+pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+const JNINativeInterface* gOriginal;
+JNINativeInterface gHooked;
+FILE* gTrace;
+uint64_t gRecords;
+bool gRecording;
+uint64_t gSession;  // Changes at every Start and Stop.
+
+// Guards the list of thread buffers, so that Stop can flush each one while
+// its thread can't free it. Taken before a buffer's lock, which is taken
+// before gLock.
+pthread_mutex_t gBuffersLock = PTHREAD_MUTEX_INITIALIZER;
+ThreadBuffer* gBuffers;
+pthread_once_t gBufferKeyOnce = PTHREAD_ONCE_INIT;
+pthread_key_t gBufferKey;
+bool gBufferKeyValid;
+
+uint64_t NanoTime() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+uint8_t* PutLeb128(uint8_t* out, uint64_t value) {
+  while (value >= 0x80) {
+    *out++ = static_cast<uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = static_cast<uint8_t>(value);
+  return out;
+}
+
+// Writes the buffer's records as one block, if they belong to the trace
+// being recorded, and empties it. Called with the buffer's lock held.
+void Flush(ThreadBuffer* buffer) {
+  if (buffer->used == 0) {
+    return;
+  }
+  uint8_t header[10 + 10];
+  uint8_t* end = PutLeb128(PutLeb128(header, buffer->tid), buffer->used);
+  pthread_mutex_lock(&gLock);
+  if (gTrace != NULL && buffer->session == gSession) {
+    fwrite(header, 1, end - header, gTrace);
+    fwrite(buffer->data, 1, buffer->used, gTrace);
+    gRecords += buffer->records;
+  }
+  pthread_mutex_unlock(&gLock);
+  buffer->used = 0;
+  buffer->records = 0;
+}
+
+void DestroyBuffer(void* value) {
+  ThreadBuffer* buffer = static_cast<ThreadBuffer*>(value);
+  pthread_mutex_lock(&gBuffersLock);
+  if (buffer->prev != NULL) {
+    buffer->prev->next = buffer->next;
+  } else {
+    gBuffers = buffer->next;
+  }
+  if (buffer->next != NULL) {
+    buffer->next->prev = buffer->prev;
+  }
+  pthread_mutex_unlock(&gBuffersLock);
+  pthread_mutex_lock(&buffer->lock);
+  Flush(buffer);
+  pthread_mutex_unlock(&buffer->lock);
+  pthread_mutex_destroy(&buffer->lock);
+  delete buffer;
+}
+
+void CreateBufferKey() {
+  gBufferKeyValid = pthread_key_create(&gBufferKey, DestroyBuffer) == 0;
+}
+
+ThreadBuffer* GetBuffer() {
+  pthread_once(&gBufferKeyOnce, CreateBufferKey);
+  if (!gBufferKeyValid) {
+    return NULL;
+  }
+  ThreadBuffer* buffer = static_cast<ThreadBuffer*>(pthread_getspecific(gBufferKey));
+  if (buffer == NULL) {
+    buffer = new (std::nothrow) ThreadBuffer();
+    if (buffer == NULL) {
+      return NULL;
+    }
+    pthread_mutex_init(&buffer->lock, NULL);
+    buffer->tid = gettid();
+    pthread_setspecific(gBufferKey, buffer);
+    pthread_mutex_lock(&gBuffersLock);
+    buffer->next = gBuffers;
+    if (gBuffers != NULL) {
+      gBuffers->prev = buffer;
+    }
+    gBuffers = buffer;
+    pthread_mutex_unlock(&gBuffersLock);
+  }
+  return buffer;
+}
+
+// criticalChange is +1 for a call that enters a critical region and -1 for
+// one that leaves it.
+void Record(JniCallId id, JniCallType type, uint64_t size, uint64_t ns,
+            int criticalChange = 0) {
+  if (!__atomic_load_n(&gRecording, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  ThreadBuffer* buffer = GetBuffer();
+  if (buffer == NULL) {
+    return;
+  }
+  const uint64_t session = __atomic_load_n(&gSession, __ATOMIC_ACQUIRE);
+  pthread_mutex_lock(&buffer->lock);
+  if (buffer->session != session) {
+    buffer->used = 0;
+    buffer->records = 0;
+    buffer->session = session;
+  }
+  uint8_t* record = buffer->data + buffer->used;
+  record[0] = static_cast<uint8_t>(id);
+  record[1] = static_cast<uint8_t>(type);
+  buffer->used = PutLeb128(PutLeb128(record + 2, size), ns) - buffer->data;
+  buffer->records++;
+  buffer->criticalDepth += criticalChange;
+  if (buffer->used > kBufferSize - kMaxRecordSize ||
+      (buffer->used >= kFlushThreshold && buffer->criticalDepth <= 0)) {
+    Flush(buffer);
+  }
+  pthread_mutex_unlock(&buffer->lock);
+}
+
+// Times the enclosing scope and records it as one call.
+class TimedCall {
+ public:
+  explicit TimedCall(JniCallId id, uint64_t size = 0, JniCallType type = kJniCallTypeNone,
+                     int criticalChange = 0)
+      : id_(id), type_(type), size_(size), criticalChange_(criticalChange),
+        start_(NanoTime()) {
+  }
+
+  ~TimedCall() {
+    Record(id_, type_, size_, NanoTime() - start_, criticalChange_);
+  }
+
+ private:
+  const JniCallId id_;
+  const JniCallType type_;
+  const uint64_t size_;
+  const int criticalChange_;
+  const uint64_t start_;
+};
+
+// Sizes are looked up through the original table, so the lookups are
+// neither timed nor recorded.
+uint64_t ArrayLength(JNIEnv* env, jarray array) {
+  return (array != NULL) ? gOriginal->GetArrayLength(env, array) : 0;
+}
+
+uint64_t StringLength(JNIEnv* env, jstring string) {
+  return (string != NULL) ? gOriginal->GetStringLength(env, string) : 0;
+}
+
+jclass FindClass(JNIEnv* env, const char* name) {
+  TimedCall call(kJniCallFindClass);
+  return gOriginal->FindClass(env, name);
+}
+
+jint ThrowNew(JNIEnv* env, jclass clazz, const char* message) {
+  TimedCall call(kJniCallThrowNew);
+  return gOriginal->ThrowNew(env, clazz, message);
+}
+
+jobject NewObject(JNIEnv* env, jclass clazz, jmethodID method, ...) {
+  va_list args;
+  va_start(args, method);
+  jobject result;
+  {
+    TimedCall call(kJniCallNewObject);
+    result = gOriginal->NewObjectV(env, clazz, method, args);
+  }
+  va_end(args);
+  return result;
+}
+
+jboolean IsInstanceOf(JNIEnv* env, jobject object, jclass clazz) {
+  TimedCall call(kJniCallIsInstanceOf);
+  return gOriginal->IsInstanceOf(env, object, clazz);
+}
+
+void DeleteLocalRef(JNIEnv* env, jobject ref) {
+  TimedCall call(kJniCallDeleteLocalRef);
+  gOriginal->DeleteLocalRef(env, ref);
+}
+
+jint GetIntField(JNIEnv* env, jobject object, jfieldID field) {
+  TimedCall call(kJniCallGetIntField);
+  return gOriginal->GetIntField(env, object, field);
+}
+
+void SetIntField(JNIEnv* env, jobject object, jfieldID field, jint value) {
+  TimedCall call(kJniCallSetIntField);
+  gOriginal->SetIntField(env, object, field, value);
+}
+
+jsize GetArrayLength(JNIEnv* env, jarray array) {
+  TimedCall call(kJniCallGetArrayLength);
+  return gOriginal->GetArrayLength(env, array);
+}
+
+#define ARRAY_HOOKS(PRIMITIVE_TYPE, NAME, CALL_TYPE) \
+  PRIMITIVE_TYPE* Get##NAME##ArrayElements(JNIEnv* env, PRIMITIVE_TYPE##Array array, \
+                                           jboolean* isCopy) { \
+    TimedCall call(kJniCallGetArrayElements, ArrayLength(env, array), CALL_TYPE); \
+    return gOriginal->Get##NAME##ArrayElements(env, array, isCopy); \
+  } \
+  void Release##NAME##ArrayElements(JNIEnv* env, PRIMITIVE_TYPE##Array array, \
+                                    PRIMITIVE_TYPE* elements, jint mode) { \
+    TimedCall call(kJniCallReleaseArrayElements, ArrayLength(env, array), CALL_TYPE); \
+    gOriginal->Release##NAME##ArrayElements(env, array, elements, mode); \
+  } \
+  void Get##NAME##ArrayRegion(JNIEnv* env, PRIMITIVE_TYPE##Array array, jsize start, \
+                              jsize length, PRIMITIVE_TYPE* buffer) { \
+    TimedCall call(kJniCallGetArrayRegion, length, CALL_TYPE); \
+    gOriginal->Get##NAME##ArrayRegion(env, array, start, length, buffer); \
+  }
+
+ARRAY_HOOKS(jboolean, Boolean, kJniCallTypeBoolean)
+ARRAY_HOOKS(jbyte, Byte, kJniCallTypeByte)
+ARRAY_HOOKS(jchar, Char, kJniCallTypeChar)
+ARRAY_HOOKS(jshort, Short, kJniCallTypeShort)
+ARRAY_HOOKS(jint, Int, kJniCallTypeInt)
+ARRAY_HOOKS(jlong, Long, kJniCallTypeLong)
+ARRAY_HOOKS(jfloat, Float, kJniCallTypeFloat)
+ARRAY_HOOKS(jdouble, Double, kJniCallTypeDouble)
+#undef ARRAY_HOOKS
+
+void* GetPrimitiveArrayCritical(JNIEnv* env, jarray array, jboolean* isCopy) {
+  TimedCall call(kJniCallGetPrimitiveArrayCritical, ArrayLength(env, array),
+                 kJniCallTypeNone, 1);
+  return gOriginal->GetPrimitiveArrayCritical(env, array, isCopy);
+}
+
+void ReleasePrimitiveArrayCritical(JNIEnv* env, jarray array, void* elements, jint mode) {
+  TimedCall call(kJniCallReleasePrimitiveArrayCritical, 0, kJniCallTypeNone, -1);
+  gOriginal->ReleasePrimitiveArrayCritical(env, array, elements, mode);
+}
+
+jstring NewStringUTF(JNIEnv* env, const char* bytes) {
+  TimedCall call(kJniCallNewStringUTF, (bytes != NULL) ? strlen(bytes) : 0);
+  return gOriginal->NewStringUTF(env, bytes);
+}
+
+const char* GetStringUTFChars(JNIEnv* env, jstring string, jboolean* isCopy) {
+  TimedCall call(kJniCallGetStringUTFChars, StringLength(env, string));
+  return gOriginal->GetStringUTFChars(env, string, isCopy);
+}
+
+void ReleaseStringUTFChars(JNIEnv* env, jstring string, const char* chars) {
+  TimedCall call(kJniCallReleaseStringUTFChars, StringLength(env, string));
+  gOriginal->ReleaseStringUTFChars(env, string, chars);
+}
+
+const jchar* GetStringChars(JNIEnv* env, jstring string, jboolean* isCopy) {
+  TimedCall call(kJniCallGetStringChars, StringLength(env, string));
+  return gOriginal->GetStringChars(env, string, isCopy);
+}
+
+void ReleaseStringChars(JNIEnv* env, jstring string, const jchar* chars) {
+  TimedCall call(kJniCallReleaseStringChars, StringLength(env, string));
+  gOriginal->ReleaseStringChars(env, string, chars);
+}
+
+const jchar* GetStringCritical(JNIEnv* env, jstring string, jboolean* isCopy) {
+  TimedCall call(kJniCallGetStringCritical, StringLength(env, string), kJniCallTypeNone, 1);
+  return gOriginal->GetStringCritical(env, string, isCopy);
+}
+
+void ReleaseStringCritical(JNIEnv* env, jstring string, const jchar* chars) {
+  TimedCall call(kJniCallReleaseStringCritical, 0, kJniCallTypeNone, -1);
+  gOriginal->ReleaseStringCritical(env, string, chars);
+}
+
+jobjectArray NewObjectArray(JNIEnv* env, jsize length, jclass clazz, jobject initial) {
+  TimedCall call(kJniCallNewObjectArray, length);
+  return gOriginal->NewObjectArray(env, length, clazz, initial);
+}
+
+void SetObjectArrayElement(JNIEnv* env, jobjectArray array, jsize index, jobject value) {
+  TimedCall call(kJniCallSetObjectArrayElement);
+  gOriginal->SetObjectArrayElement(env, array, index, value);
+}
+
+void* GetDirectBufferAddress(JNIEnv* env, jobject buffer) {
+  TimedCall call(kJniCallGetDirectBufferAddress);
+  return gOriginal->GetDirectBufferAddress(env, buffer);
+}
+
+jint RegisterNatives(JNIEnv* env, jclass clazz, const JNINativeMethod* methods,
+                     jint count) {
+  TimedCall call(kJniCallRegisterNatives, count);
+  return gOriginal->RegisterNatives(env, clazz, methods, count);
+}
+
+void InstallHooks(JNINativeInterface* table) {
+  table->FindClass = FindClass;
+  table->ThrowNew = ThrowNew;
+  table->NewObject = NewObject;
+  table->IsInstanceOf = IsInstanceOf;
+  table->DeleteLocalRef = DeleteLocalRef;
+  table->GetIntField = GetIntField;
+  table->SetIntField = SetIntField;
+  table->GetArrayLength = GetArrayLength;
+#define INSTALL_ARRAY_HOOKS(NAME) \
+  table->Get##NAME##ArrayElements = Get##NAME##ArrayElements; \
+  table->Release##NAME##ArrayElements = Release##NAME##ArrayElements; \
+  table->Get##NAME##ArrayRegion = Get##NAME##ArrayRegion
+  INSTALL_ARRAY_HOOKS(Boolean);
+  INSTALL_ARRAY_HOOKS(Byte);
+  INSTALL_ARRAY_HOOKS(Char);
+  INSTALL_ARRAY_HOOKS(Short);
+  INSTALL_ARRAY_HOOKS(Int);
+  INSTALL_ARRAY_HOOKS(Long);
+  INSTALL_ARRAY_HOOKS(Float);
+  INSTALL_ARRAY_HOOKS(Double);
+#undef INSTALL_ARRAY_HOOKS
+  table->GetPrimitiveArrayCritical = GetPrimitiveArrayCritical;
+  table->ReleasePrimitiveArrayCritical = ReleasePrimitiveArrayCritical;
+  table->NewStringUTF = NewStringUTF;
+  table->GetStringUTFChars = GetStringUTFChars;
+  table->ReleaseStringUTFChars = ReleaseStringUTFChars;
+  table->GetStringChars = GetStringChars;
+  table->ReleaseStringChars = ReleaseStringChars;
+  table->GetStringCritical = GetStringCritical;
+  table->ReleaseStringCritical = ReleaseStringCritical;
+  table->NewObjectArray = NewObjectArray;
+  table->SetObjectArrayElement = SetObjectArrayElement;
+  table->GetDirectBufferAddress = GetDirectBufferAddress;
+  table->RegisterNatives = RegisterNatives;
+}
+
+}  // namespace
+
+bool JniCallRecorder::Start(const char* path) {
+  pthread_mutex_lock(&gLock);
+  bool ok = false;
+  if (gTrace != NULL) {
+    ALOGE("Already recording a trace");
+  } else {
+    gTrace = fopen(path, "we");
+    if (gTrace == NULL) {
+      ALOGE("Could not open %s: %s", path, strerror(errno));
+    } else {
+      fwrite(kTraceMagic, 1, sizeof(kTraceMagic), gTrace);
+      fwrite(&kTraceVersion, 1, 1, gTrace);
+      gRecords = 0;
+      __atomic_store_n(&gSession, gSession + 1, __ATOMIC_RELEASE);
+      __atomic_store_n(&gRecording, true, __ATOMIC_RELEASE);
+      ok = true;
+    }
+  }
+  pthread_mutex_unlock(&gLock);
+  return ok;
+}
+
+bool JniCallRecorder::Attach(JNIEnv* env) {
+  pthread_mutex_lock(&gLock);
+  bool ok = true;
+  if (gOriginal == NULL) {
+    gOriginal = env->functions;
+    gHooked = *gOriginal;
+    InstallHooks(&gHooked);
+  }
+  if (env->functions == gOriginal) {
+    env->functions = &gHooked;
+  } else if (env->functions != &gHooked) {
+    ALOGE("Cannot attach an env with a different function table (CheckJNI?)");
+    ok = false;
+  }
+  pthread_mutex_unlock(&gLock);
+  return ok;
+}
+
+void JniCallRecorder::Detach(JNIEnv* env) {
+  pthread_mutex_lock(&gLock);
+  if (env->functions == &gHooked) {
+    env->functions = gOriginal;
+  }
+  pthread_mutex_unlock(&gLock);
+}
+
+uint64_t JniCallRecorder::Stop() {
+  // Stop new records, then write out what every thread has gathered. A call
+  // that was already being recorded may still be flushed by its thread
+  // before the file is closed below; if not, it is dropped with its session.
+  __atomic_store_n(&gRecording, false, __ATOMIC_RELEASE);
+  pthread_mutex_lock(&gBuffersLock);
+  for (ThreadBuffer* buffer = gBuffers; buffer != NULL; buffer = buffer->next) {
+    pthread_mutex_lock(&buffer->lock);
+    Flush(buffer);
+    pthread_mutex_unlock(&buffer->lock);
+  }
+  pthread_mutex_unlock(&gBuffersLock);
+
+  pthread_mutex_lock(&gLock);
+  uint64_t records = gRecords;
+  __atomic_store_n(&gSession, gSession + 1, __ATOMIC_RELEASE);
+  if (gTrace != NULL) {
+    if (fclose(gTrace) != 0) {
+      ALOGE("Error writing trace: %s", strerror(errno));
+    }
+    gTrace = NULL;
+  }
+  pthread_mutex_unlock(&gLock);
+  return records;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JniCheck"
+
+#include "JniCheck.h"
+#include "ALog-priv.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+
+// Default visibility rather than the library's protected, so that
+// executables can refer to it through a copy relocation.
+__attribute__((visibility("default"))) int jniLightCheckEnabled = 0;
+
+namespace {
+
+struct ThreadState {
+    // Thread state from an earlier enable is stale: counts may have been
+    // missed while the checks were off.
+    uint32_t generation;
+    C_JNIEnv* env;
+    int criticalDepth;
+    int localRefs;
+    int localRefHighWater;
+    bool warnedLocalRefs;
+};
+
+pthread_once_t gOnce = PTHREAD_ONCE_INIT;
+pthread_key_t gStateKey;
+uint32_t gGeneration;
+int gAbortOnFailure;
+int gLocalRefLimit = 256;
+uint64_t gFailures;
+
+void freeState(void* state) {
+    delete static_cast<ThreadState*>(state);
+}
+
+void initState() {
+    pthread_key_create(&gStateKey, freeState);
+}
+
+ThreadState* currentState() {
+    pthread_once(&gOnce, initState);
+    ThreadState* state = static_cast<ThreadState*>(pthread_getspecific(gStateKey));
+    if (state == NULL) {
+        state = new ThreadState;
+        state->generation = ~__atomic_load_n(&gGeneration, __ATOMIC_RELAXED);
+        pthread_setspecific(gStateKey, state);
+    }
+    uint32_t generation = __atomic_load_n(&gGeneration, __ATOMIC_RELAXED);
+    if (state->generation != generation) {
+        state->generation = generation;
+        state->env = NULL;
+        state->criticalDepth = 0;
+        state->localRefs = 0;
+        state->localRefHighWater = 0;
+        state->warnedLocalRefs = false;
+    }
+    return state;
+}
+
+__attribute__((format(printf, 1, 2)))
+void fail(const char* fmt, ...) {
+    __atomic_fetch_add(&gFailures, 1, __ATOMIC_RELAXED);
+    va_list args;
+    va_start(args, fmt);
+    __android_log_vprint(ANDROID_LOG_ERROR, LOG_TAG, fmt, args);
+    va_end(args);
+    if (__atomic_load_n(&gAbortOnFailure, __ATOMIC_RELAXED)) {
+        abort();
+    }
+}
+
+}  // namespace
+
+void jniSetLightCheck(int enabled) {
+    if (enabled) {
+        __atomic_fetch_add(&gGeneration, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&jniLightCheckEnabled, enabled ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+void jniSetLightCheckAbort(int abortOnFailure) {
+    __atomic_store_n(&gAbortOnFailure, abortOnFailure, __ATOMIC_RELAXED);
+}
+
+void jniSetLightCheckLocalRefLimit(int limit) {
+    __atomic_store_n(&gLocalRefLimit, limit, __ATOMIC_RELAXED);
+}
+
+uint64_t jniLightCheckFailures() {
+    return __atomic_load_n(&gFailures, __ATOMIC_RELAXED);
+}
+
+int jniLightCheckLocalRefHighWater() {
+    return currentState()->localRefHighWater;
+}
+
+void jniLightCheckEntry(C_JNIEnv* env, const char* function) {
+    ThreadState* state = currentState();
+    if (state->criticalDepth > 0) {
+        fail("%s called inside a critical region", function);
+    }
+    if (env == state->env) {
+        return;
+    }
+    // First use on this thread, or a different env: ask the VM which env is
+    // this thread's. GetJavaVM does not depend on the calling thread.
+    JNIEnv* e = reinterpret_cast<JNIEnv*>(env);
+    JavaVM* vm = NULL;
+    void* threadEnv = NULL;
+    if ((*env)->GetJavaVM(e, &vm) != JNI_OK ||
+            vm->GetEnv(&threadEnv, JNI_VERSION_1_6) != JNI_OK) {
+        fail("%s called with JNIEnv %p on a thread not attached to the VM", function, env);
+        return;
+    }
+    if (threadEnv != e) {
+        fail("%s called with JNIEnv %p, but this thread's JNIEnv is %p", function, env,
+             threadEnv);
+        return;
+    }
+    state->env = env;
+}
+
+void jniLightCheckCriticalEnter() {
+    ++currentState()->criticalDepth;
+}
+
+void jniLightCheckCriticalExit() {
+    ThreadState* state = currentState();
+    if (state->criticalDepth > 0) {
+        --state->criticalDepth;
+    }
+}
+
+void jniLightCheckLocalRef(int delta) {
+    ThreadState* state = currentState();
+    state->localRefs += delta;
+    if (state->localRefs < 0) {
+        // Acquired while the checks were off.
+        state->localRefs = 0;
+    }
+    if (state->localRefs > state->localRefHighWater) {
+        state->localRefHighWater = state->localRefs;
+        int limit = __atomic_load_n(&gLocalRefLimit, __ATOMIC_RELAXED);
+        if (state->localRefHighWater > limit && !state->warnedLocalRefs) {
+            state->warnedLocalRefs = true;
+            fail("More than %d local references held by ScopedLocalRef on this thread", limit);
+        }
+    }
+}
@@ -17,7 +17,9 @@
 #define LOG_TAG "JniConstants"
 
 #include "ALog-priv.h"
+#include "JNIHelpStats-priv.h"
 #include "JniConstants.h"
+#include "JniTrace.h"
 #include "ScopedLocalRef.h"
 
 #include <stdlib.h>
@@ -77,6 +79,8 @@ jclass JniConstants::structUtsnameClass;
 jclass JniConstants::unixSocketAddressClass;
 jclass JniConstants::zipEntryClass;
 
+static uint64_t gGlobalRefs;
+
 static jclass findClass(JNIEnv* env, const char* name) {
     ScopedLocalRef<jclass> localClass(env, env->FindClass(name));
     jclass result = reinterpret_cast<jclass>(env->NewGlobalRef(localClass.get()));
@@ -84,10 +88,14 @@ static jclass findClass(JNIEnv* env, const char* name) {
         ALOGE("failed to find class '%s'", name);
         abort();
     }
+    ++gGlobalRefs;
     return result;
 }
 
 void JniConstants::init(JNIEnv* env) {
+#if JNI_TRACE_ENABLED
+    const uint64_t start = JNI_TRACE_ARMED(constants_init) ? jniTraceNanoTime() : 0;
+#endif
     bigDecimalClass = findClass(env, "java/math/BigDecimal");
     booleanClass = findClass(env, "java/lang/Boolean");
     byteClass = findClass(env, "java/lang/Byte");
@@ -142,4 +150,6 @@ void JniConstants::init(JNIEnv* env) {
     structUtsnameClass = findClass(env, "android/system/StructUtsname");
     unixSocketAddressClass = findClass(env, "android/system/UnixSocketAddress");
     zipEntryClass = findClass(env, "java/util/zip/ZipEntry");
+    jniHelpSetConstantsGlobalRefs(gGlobalRefs);
+    JNI_TRACE1(constants_init, (start != 0) ? jniTraceNanoTime() - start : 0);
 }
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JniCriticalMonitor"
+
+#include "JniCriticalMonitor.h"
+#include "ALog-priv.h"
+
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <time.h>
+
+// Default visibility rather than the library's protected, so that
+// executables can refer to it through a copy relocation.
+__attribute__((visibility("default"))) uint64_t jniCriticalHoldThresholdNs = 0;
+
+namespace {
+
+// Recorded holds are rare, so everything below is updated with plain atomics
+// and no locks. Sites are kept in an open-addressed table keyed by acquire
+// address; a slot's key never changes once claimed.
+const size_t kSiteCount = 256;
+
+struct Site {
+    uintptr_t address;
+    uint64_t count;
+    uint64_t maxNs;
+    size_t maxBytes;
+};
+
+uint64_t gHistogram[JNI_CRITICAL_HISTOGRAM_BUCKETS];
+Site gSites[kSiteCount];
+uint64_t gUnattributed;
+
+Site* findSite(uintptr_t address) {
+    size_t start = (address >> 2) % kSiteCount;
+    for (size_t i = 0; i < kSiteCount; ++i) {
+        Site* site = &gSites[(start + i) % kSiteCount];
+        uintptr_t current = __atomic_load_n(&site->address, __ATOMIC_ACQUIRE);
+        if (current == 0) {
+            uintptr_t expected = 0;
+            if (__atomic_compare_exchange_n(&site->address, &expected, address, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return site;
+            }
+            current = expected;
+        }
+        if (current == address) {
+            return site;
+        }
+    }
+    return NULL;
+}
+
+int bucketFor(uint64_t ns) {
+    return (ns == 0) ? 0 : 63 - __builtin_clzll(ns);
+}
+
+}  // namespace
+
+void jniSetCriticalHoldThreshold(uint64_t ns) {
+    __atomic_store_n(&jniCriticalHoldThresholdNs, ns, __ATOMIC_RELAXED);
+}
+
+uint64_t jniCriticalMonitorNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+__attribute__((noinline)) const void* jniCriticalMonitorSite() {
+    return __builtin_return_address(0);
+}
+
+void jniCriticalMonitorRecord(const void* site, uint64_t startNs, size_t bytes) {
+    uint64_t ns = jniCriticalMonitorNow() - startNs;
+    uint64_t threshold = __atomic_load_n(&jniCriticalHoldThresholdNs, __ATOMIC_RELAXED);
+    if (threshold == 0 || ns < threshold) {
+        return;
+    }
+    __atomic_fetch_add(&gHistogram[bucketFor(ns)], 1, __ATOMIC_RELAXED);
+
+    Site* entry = findSite(reinterpret_cast<uintptr_t>(site));
+    if (entry == NULL) {
+        __atomic_fetch_add(&gUnattributed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    __atomic_fetch_add(&entry->count, 1, __ATOMIC_RELAXED);
+    uint64_t maxNs = __atomic_load_n(&entry->maxNs, __ATOMIC_RELAXED);
+    while (ns > maxNs) {
+        if (__atomic_compare_exchange_n(&entry->maxNs, &maxNs, ns, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            // Not updated together with maxNs; racing holds may pair them up wrongly.
+            __atomic_store_n(&entry->maxBytes, bytes, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+}
+
+void jniGetCriticalHoldHistogram(uint64_t buckets[JNI_CRITICAL_HISTOGRAM_BUCKETS]) {
+    for (int i = 0; i < JNI_CRITICAL_HISTOGRAM_BUCKETS; ++i) {
+        buckets[i] = __atomic_load_n(&gHistogram[i], __ATOMIC_RELAXED);
+    }
+}
+
+uint64_t jniGetCriticalHoldSites(void (*visit)(const void* site, const char* symbol,
+                                               uint64_t count, uint64_t maxNs,
+                                               size_t maxBytes, void* context),
+                                 void* context) {
+    for (size_t i = 0; i < kSiteCount; ++i) {
+        uintptr_t address = __atomic_load_n(&gSites[i].address, __ATOMIC_ACQUIRE);
+        uint64_t count = __atomic_load_n(&gSites[i].count, __ATOMIC_RELAXED);
+        if (address == 0 || count == 0) {
+            continue;
+        }
+        const void* site = reinterpret_cast<const void*>(address);
+        Dl_info info;
+        const char* symbol = (dladdr(site, &info) != 0) ? info.dli_sname : NULL;
+        visit(site, symbol, count, __atomic_load_n(&gSites[i].maxNs, __ATOMIC_RELAXED),
+              __atomic_load_n(&gSites[i].maxBytes, __ATOMIC_RELAXED), context);
+    }
+    return __atomic_load_n(&gUnattributed, __ATOMIC_RELAXED);
+}
+
+struct LogContext {
+    int priority;
+    const char* tag;
+};
+
+static void logSite(const void* site, const char* symbol, uint64_t count, uint64_t maxNs,
+                    size_t maxBytes, void* context) {
+    LogContext* log = static_cast<LogContext*>(context);
+    __android_log_print(log->priority, log->tag,
+                        "  %p %s: %" PRIu64 " holds, longest %" PRIu64 " ns over %zu bytes",
+                        site, (symbol != NULL) ? symbol : "?", count, maxNs, maxBytes);
+}
+
+void jniLogCriticalHolds(int priority, const char* tag) {
+    uint64_t buckets[JNI_CRITICAL_HISTOGRAM_BUCKETS];
+    jniGetCriticalHoldHistogram(buckets);
+    __android_log_print(priority, tag, "Critical holds over %" PRIu64 " ns:",
+                        __atomic_load_n(&jniCriticalHoldThresholdNs, __ATOMIC_RELAXED));
+    for (int i = 0; i < JNI_CRITICAL_HISTOGRAM_BUCKETS; ++i) {
+        if (buckets[i] != 0) {
+            __android_log_print(priority, tag, "  [%" PRIu64 ", %" PRIu64 ") ns: %" PRIu64,
+                                static_cast<uint64_t>(1) << i,
+                                (i == 63) ? UINT64_MAX : static_cast<uint64_t>(1) << (i + 1),
+                                buckets[i]);
+        }
+    }
+    LogContext log = { priority, tag };
+    uint64_t unattributed = jniGetCriticalHoldSites(logSite, &log);
+    if (unattributed != 0) {
+        __android_log_print(priority, tag, "  %" PRIu64 " holds from untracked sites",
+                            unattributed);
+    }
+}
@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JniDispatcher"
+
+#include "JniDispatcher.h"
+#include "JNIHelp.h"
+#include "JniRingBuffer.h"
+#include "ScopedLocalFrame.h"
+#include "ALog-priv.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <new>
+
+/*
+ * Producers only touch the ring, plus the lock when they must wake the
+ * dispatcher thread or wait for room. The thread drains the ring into the
+ * batch, delivers full batches at once, and otherwise sleeps until the
+ * batch's deadline, a flush, a wakeup from a producer that found it idle,
+ * or one from a producer that has queued a batch's worth.
+ */
+struct JniDispatcher {
+    JniDispatcherOptions options;
+    JavaVM* vm;
+    jobject target;       // Global references.
+    jobject batchObject;
+    jmethodID method;
+    JniRingBuffer* ring;
+    size_t wakeBacklog;   // Ring bytes that make up a full batch.
+    int sizeWakePending;  // Set by the producer that wakes the thread for a full batch.
+
+    pthread_t thread;
+    uint8_t* batch;       // Only used by the thread.
+    size_t batchCount;
+    uint64_t batchStartNs;
+    uint64_t drained;     // Events taken from the ring so far.
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;  // Signaled for the thread.
+    pthread_cond_t done;  // Broadcast for producers and flushers.
+    int started;          // 1 once attached, -1 if attaching failed.
+    bool wakeRequested;
+    bool stopping;
+    uint64_t drains;      // Bumped whenever the thread frees ring space.
+    size_t roomWaiters;
+    uint64_t flushRequested;
+    uint64_t flushCompleted;
+    uint64_t flushPosted;  // How many events the latest flush waits for.
+
+    JniDispatcherStats stats;
+};
+
+namespace {
+
+enum Reason {
+    kFull,
+    kLate,
+    kFlushed,
+};
+
+uint64_t nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Stats are written by one thread at a time, and read by any.
+void add(uint64_t* counter, uint64_t amount) {
+    __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+}
+
+size_t roundUpToPowerOfTwo(size_t n) {
+    size_t result = 1;
+    while (result < n) {
+        result <<= 1;
+    }
+    return result;
+}
+
+void signalWork(JniDispatcher* d) {
+    pthread_mutex_lock(&d->lock);
+    d->wakeRequested = true;
+    pthread_cond_signal(&d->work);
+    pthread_mutex_unlock(&d->lock);
+}
+
+void appendEvent(int32_t, const void* data, size_t length, void* context) {
+    JniDispatcher* d = static_cast<JniDispatcher*>(context);
+    if (d->batchCount == 0) {
+        d->batchStartNs = nowNs();
+    }
+    memcpy(d->batch + d->batchCount * length, data, length);
+    d->batchCount++;
+    d->drained++;
+}
+
+// Moves events from the ring to the batch, as many as fit. Returns whether
+// the batch is full, in which case the ring may hold more.
+bool drain(JniDispatcher* d) {
+    const size_t room = d->options.maxBatch - d->batchCount;
+    const size_t count = jniRingBufferRead(d->ring, appendEvent, d, room);
+    if (count != 0) {
+        __atomic_store_n(&d->sizeWakePending, 0, __ATOMIC_RELAXED);
+        pthread_mutex_lock(&d->lock);
+        d->drains++;
+        if (d->roomWaiters != 0) {
+            pthread_cond_broadcast(&d->done);
+        }
+        pthread_mutex_unlock(&d->lock);
+    }
+    return count == room;
+}
+
+void deliver(JNIEnv* env, JniDispatcher* d, Reason reason) {
+    const size_t count = d->batchCount;
+    d->batchCount = 0;
+    ScopedLocalFrame frame(env);
+    if ((d->options.flags & JNI_DISPATCH_LONG_ARRAY) != 0) {
+        env->SetLongArrayRegion(static_cast<jlongArray>(d->batchObject), 0,
+                                static_cast<jsize>(count * d->options.eventSize / sizeof(jlong)),
+                                reinterpret_cast<const jlong*>(d->batch));
+    }
+    env->CallVoidMethod(d->target, d->method, d->batchObject, static_cast<jint>(count));
+    if (env->ExceptionCheck()) {
+        jthrowable exception = env->ExceptionOccurred();
+        env->ExceptionClear();
+        jniLogException(env, ANDROID_LOG_WARN, LOG_TAG, exception);
+        add(&d->stats.exceptions, 1);
+    }
+    add(&d->stats.delivered, count);
+    add(&d->stats.batches, 1);
+    add(reason == kFull ? &d->stats.fullBatches :
+        reason == kLate ? &d->stats.lateBatches : &d->stats.flushedBatches, 1);
+}
+
+// Sleeps until woken, or until deadlineNs if it is non-zero.
+void waitForWork(JniDispatcher* d, uint64_t flushTarget, uint64_t deadlineNs) {
+    struct timespec deadline;
+    deadline.tv_sec = deadlineNs / 1000000000;
+    deadline.tv_nsec = deadlineNs % 1000000000;
+    pthread_mutex_lock(&d->lock);
+    while (!d->wakeRequested && !d->stopping && d->flushRequested == flushTarget) {
+        if (deadlineNs == 0) {
+            pthread_cond_wait(&d->work, &d->lock);
+        } else if (pthread_cond_timedwait(&d->work, &d->lock, &deadline) != 0) {
+            break;
+        }
+    }
+    d->wakeRequested = false;
+    pthread_mutex_unlock(&d->lock);
+}
+
+void run(JNIEnv* env, JniDispatcher* d) {
+    while (true) {
+        pthread_mutex_lock(&d->lock);
+        const uint64_t flushTarget = d->flushRequested;
+        const uint64_t flushPosted = d->flushPosted;
+        const bool stopping = d->stopping;
+        pthread_mutex_unlock(&d->lock);
+
+        while (drain(d)) {
+            deliver(env, d, kFull);
+        }
+        if (flushTarget != d->flushCompleted || stopping) {
+            // Events posted before the flush may sit behind records that
+            // other producers have claimed but not yet committed.
+            while (d->drained < flushPosted || (stopping && jniRingBufferBacklog(d->ring) != 0)) {
+                if (drain(d)) {
+                    deliver(env, d, kFull);
+                } else {
+                    sched_yield();
+                }
+            }
+            if (d->batchCount != 0) {
+                deliver(env, d, kFlushed);
+            }
+            pthread_mutex_lock(&d->lock);
+            d->flushCompleted = flushTarget;
+            pthread_cond_broadcast(&d->done);
+            pthread_mutex_unlock(&d->lock);
+            if (stopping) {
+                return;
+            }
+            continue;
+        }
+        if (d->batchCount != 0) {
+            const uint64_t deadlineNs = d->batchStartNs + d->options.maxLatencyNs;
+            if (nowNs() >= deadlineNs) {
+                deliver(env, d, kLate);
+                continue;
+            }
+            waitForWork(d, flushTarget, deadlineNs);
+        } else if (jniRingBufferPrepareWait(d->ring) != 0) {
+            waitForWork(d, flushTarget, 0);
+        }
+    }
+}
+
+void* dispatcherThread(void* arg) {
+    JniDispatcher* d = static_cast<JniDispatcher*>(arg);
+    JavaVMAttachArgs args = { JNI_VERSION_1_6, const_cast<char*>("JniDispatcher"), NULL };
+    JNIEnv* env = NULL;
+    const bool attached = d->vm->AttachCurrentThread(&env, &args) == JNI_OK;
+    pthread_mutex_lock(&d->lock);
+    d->started = attached ? 1 : -1;
+    pthread_cond_broadcast(&d->done);
+    pthread_mutex_unlock(&d->lock);
+    if (!attached) {
+        return NULL;
+    }
+    run(env, d);
+    env->DeleteGlobalRef(d->target);
+    env->DeleteGlobalRef(d->batchObject);
+    d->vm->DetachCurrentThread();
+    return NULL;
+}
+
+void freeDispatcher(JNIEnv* env, JniDispatcher* d) {
+    if (env != NULL) {
+        if (d->target != NULL) {
+            env->DeleteGlobalRef(d->target);
+        }
+        if (d->batchObject != NULL) {
+            env->DeleteGlobalRef(d->batchObject);
+        }
+    }
+    jniRingBufferDestroy(d->ring);
+    free(d->batch);
+    pthread_cond_destroy(&d->done);
+    pthread_cond_destroy(&d->work);
+    pthread_mutex_destroy(&d->lock);
+    delete d;
+}
+
+}  // namespace
+
+JniDispatcher* jniDispatcherCreate(JNIEnv* env, jobject target, const char* methodName,
+                                   const JniDispatcherOptions* options) {
+    const bool longs = (options->flags & JNI_DISPATCH_LONG_ARRAY) != 0;
+    if (options->eventSize == 0 || options->maxBatch == 0 || options->queueBatches == 0 ||
+            options->maxBatch > INT32_MAX / options->eventSize ||
+            (longs && options->eventSize % sizeof(jlong) != 0) ||
+            (options->flags & ~(JNI_DISPATCH_LONG_ARRAY | JNI_DISPATCH_DROP_WHEN_FULL)) != 0) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "Bad dispatcher options");
+        return NULL;
+    }
+    if (target == NULL) {
+        jniThrowNullPointerException(env, "target == null");
+        return NULL;
+    }
+    jclass targetClass = env->GetObjectClass(target);
+    jmethodID method = env->GetMethodID(targetClass, methodName,
+                                        longs ? "([JI)V" : "(Ljava/nio/ByteBuffer;I)V");
+    env->DeleteLocalRef(targetClass);
+    if (method == NULL) {
+        return NULL;
+    }
+
+    JniDispatcher* d = new (std::nothrow) JniDispatcher();
+    if (d == NULL) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Could not allocate dispatcher");
+        return NULL;
+    }
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_condattr_t monotonic;
+    pthread_condattr_init(&monotonic);
+    pthread_condattr_setclock(&monotonic, CLOCK_MONOTONIC);
+    pthread_cond_init(&d->work, &monotonic);
+    pthread_condattr_destroy(&monotonic);
+    pthread_cond_init(&d->done, NULL);
+    d->options = *options;
+    d->method = method;
+
+    // Room for queueBatches batches in the ring, each event with its record header.
+    const size_t batchBytes = options->eventSize * options->maxBatch;
+    const size_t recordBytes = (JNI_RING_RECORD_HEADER + options->eventSize + 7) & ~7;
+    size_t capacity = options->queueBatches * options->maxBatch * recordBytes;
+    if (capacity < 8 * (recordBytes + JNI_RING_RECORD_HEADER)) {
+        capacity = 8 * (recordBytes + JNI_RING_RECORD_HEADER);
+    }
+    d->ring = jniRingBufferCreate(env, roundUpToPowerOfTwo(capacity < 4096 ? 4096 : capacity),
+                                  JNI_RING_MPSC, NULL);
+    d->wakeBacklog = options->maxBatch * recordBytes;
+    d->batch = static_cast<uint8_t*>(malloc(batchBytes));
+    if (d->ring == NULL || d->batch == NULL) {
+        if (!env->ExceptionCheck()) {
+            jniThrowException(env, "java/lang/OutOfMemoryError", "Could not allocate dispatcher");
+        }
+        freeDispatcher(env, d);
+        return NULL;
+    }
+    jobject batchObject = longs ? env->NewLongArray(batchBytes / sizeof(jlong))
+                                : env->NewDirectByteBuffer(d->batch, batchBytes);
+    if (batchObject == NULL) {
+        freeDispatcher(env, d);
+        return NULL;
+    }
+    d->batchObject = env->NewGlobalRef(batchObject);
+    env->DeleteLocalRef(batchObject);
+    d->target = env->NewGlobalRef(target);
+    if (d->batchObject == NULL || d->target == NULL || env->GetJavaVM(&d->vm) != JNI_OK) {
+        freeDispatcher(env, d);
+        return NULL;
+    }
+
+    if (pthread_create(&d->thread, NULL, dispatcherThread, d) != 0) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Could not start dispatcher thread");
+        freeDispatcher(env, d);
+        return NULL;
+    }
+    pthread_mutex_lock(&d->lock);
+    while (d->started == 0) {
+        pthread_cond_wait(&d->done, &d->lock);
+    }
+    pthread_mutex_unlock(&d->lock);
+    if (d->started < 0) {
+        pthread_join(d->thread, NULL);
+        jniThrowException(env, "java/lang/IllegalStateException",
+                          "Could not attach dispatcher thread");
+        freeDispatcher(env, d);
+        return NULL;
+    }
+    return d;
+}
+
+int jniDispatcherPost(JniDispatcher* d, const void* event) {
+    bool stalled = false;
+    uint64_t drains = 0;
+    while (true) {
+        const int result = jniRingBufferWrite(d->ring, 0, event, d->options.eventSize);
+        if (result != JNI_RING_FULL) {
+            add(&d->stats.posted, 1);
+            if (result == JNI_RING_WAKE) {
+                signalWork(d);
+            } else if (jniRingBufferBacklog(d->ring) >= d->wakeBacklog &&
+                    __atomic_exchange_n(&d->sizeWakePending, 1, __ATOMIC_RELAXED) == 0) {
+                signalWork(d);
+            }
+            return 0;
+        }
+        // The thread itself, posting from the Java method, would wait forever.
+        if ((d->options.flags & JNI_DISPATCH_DROP_WHEN_FULL) != 0 ||
+                pthread_equal(pthread_self(), d->thread)) {
+            add(&d->stats.dropped, 1);
+            return JNI_DISPATCH_DROPPED;
+        }
+        // Note the drain count before trying again, so that a drain between
+        // that try and the wait is not missed.
+        pthread_mutex_lock(&d->lock);
+        if (!stalled) {
+            stalled = true;
+            drains = d->drains;
+            add(&d->stats.stalls, 1);
+            pthread_mutex_unlock(&d->lock);
+            continue;
+        }
+        d->roomWaiters++;
+        d->wakeRequested = true;
+        pthread_cond_signal(&d->work);
+        while (d->drains == drains && !d->stopping) {
+            pthread_cond_wait(&d->done, &d->lock);
+        }
+        d->roomWaiters--;
+        drains = d->drains;
+        pthread_mutex_unlock(&d->lock);
+    }
+}
+
+int jniDispatcherFlush(JniDispatcher* d) {
+    if (pthread_equal(pthread_self(), d->thread)) {
+        return -1;
+    }
+    const uint64_t posted = __atomic_load_n(&d->stats.posted, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&d->lock);
+    if (posted > d->flushPosted) {
+        d->flushPosted = posted;
+    }
+    const uint64_t target = ++d->flushRequested;
+    pthread_cond_signal(&d->work);
+    while (d->flushCompleted < target) {
+        pthread_cond_wait(&d->done, &d->lock);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+void jniDispatcherDestroy(JniDispatcher* d) {
+    if (d == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&d->lock);
+    d->stopping = true;
+    pthread_cond_signal(&d->work);
+    pthread_cond_broadcast(&d->done);
+    pthread_mutex_unlock(&d->lock);
+    pthread_join(d->thread, NULL);
+    // The thread has deleted the global references.
+    freeDispatcher(NULL, d);
+}
+
+void jniDispatcherGetStats(JniDispatcher* d, JniDispatcherStats* stats) {
+    // Every field is a uint64_t.
+    uint64_t* out = reinterpret_cast<uint64_t*>(stats);
+    const uint64_t* in = reinterpret_cast<const uint64_t*>(&d->stats);
+    for (size_t i = 0; i < sizeof(*stats) / sizeof(uint64_t); ++i) {
+        out[i] = __atomic_load_n(&in[i], __ATOMIC_RELAXED);
+    }
+}
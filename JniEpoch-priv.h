@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVEHELPER_JNIEPOCH_PRIV_H_
+#define NATIVEHELPER_JNIEPOCH_PRIV_H_
+
+#include "JniThreadIndex-priv.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Epoch-based reclamation for structures that readers walk without locks.
+ *
+ * Readers count themselves in their thread's stripe, under the parity of the
+ * epoch they saw, for as long as they look at shared data. Writers, one at a
+ * time, advance the epoch only once no reader is counted under the parity
+ * before the current one, so when the epoch is E only readers that entered
+ * in E - 1 or E remain. Something unlinked and then retired in epoch E can
+ * be freed once the epoch reaches E + 2. New readers never hold back the
+ * parity being drained, so a steady stream of them cannot starve writers.
+ *
+ * Instances must be 64-byte aligned for the stripes to sit on their own cache
+ * lines: statics are, heap instances need an aligned allocation.
+ */
+class JniEpoch {
+public:
+    JniEpoch() : mEpoch(0) {
+        for (size_t i = 0; i < kStripes; ++i) {
+            mStripes[i].active[0] = 0;
+            mStripes[i].active[1] = 0;
+        }
+    }
+
+    // Counts the caller as a reader until it passes the result to exit().
+    int* enter() {
+        Stripe& stripe = mStripes[jniThreadIndex() % kStripes];
+        int* counter = &stripe.active[__atomic_load_n(&mEpoch, __ATOMIC_SEQ_CST) & 1];
+        __atomic_fetch_add(counter, 1, __ATOMIC_SEQ_CST);
+        return counter;
+    }
+
+    static void exit(int* counter) {
+        __atomic_fetch_sub(counter, 1, __ATOMIC_RELEASE);
+    }
+
+    // The epoch to stamp on something just unlinked. Writers only.
+    uint64_t current() const {
+        return mEpoch;
+    }
+
+    // Whether something retired in epoch retired can no longer be seen.
+    bool reclaimable(uint64_t retired) const {
+        return retired + 2 <= mEpoch;
+    }
+
+    // Moves to the next epoch if every reader of the previous one has left.
+    // Writers only.
+    bool tryAdvance() {
+        const int previous = (mEpoch - 1) & 1;
+        for (size_t i = 0; i < kStripes; ++i) {
+            if (__atomic_load_n(&mStripes[i].active[previous], __ATOMIC_SEQ_CST) != 0) {
+                return false;
+            }
+        }
+        __atomic_store_n(&mEpoch, mEpoch + 1, __ATOMIC_SEQ_CST);
+        return true;
+    }
+
+private:
+    static const size_t kStripes = 16;
+
+    struct Stripe {
+        int active[2];
+    } __attribute__((aligned(64)));
+
+    Stripe mStripes[kStripes];
+    uint64_t mEpoch;
+
+    // Disallow copy and assignment.
+    JniEpoch(const JniEpoch&);
+    void operator=(const JniEpoch&);
+};
+
+#endif  /* NATIVEHELPER_JNIEPOCH_PRIV_H_ */
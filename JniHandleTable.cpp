@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JniHandleTable.h"
+#include "JNIHelp.h"
+
+#include <new>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * A slot's generation is odd while it is live and even while it is free.
+ * Only the thread that holds a free slot writes its pointer, with release
+ * semantics, before publishing the next odd generation; removal moves the
+ * generation from odd to even with a compare-and-swap. A reader that sees
+ * the handle's generation both before and after loading the pointer knows
+ * the pointer belongs to that generation.
+ */
+namespace {
+
+const size_t kChunkSlots = 4096;
+const size_t kCachedSlots = 64;
+const uint32_t kNoSlot = UINT32_MAX;
+
+struct Slot {
+    uint32_t generation;
+    uint32_t nextFree;  // While free and on the table's list.
+    void* pointer;
+};
+
+// A thread's free slots for one table. Each is on two lists: its table's,
+// under the table's lock, and its thread's, which only that thread walks.
+struct ThreadCache {
+    JniHandleTable* table;  // NULL once the table is destroyed.
+    size_t count;
+    uint32_t indices[kCachedSlots];
+    uint64_t adds;
+    uint64_t removes;
+    ThreadCache* prev;
+    ThreadCache* next;
+    ThreadCache* threadNext;
+};
+
+}  // namespace
+
+struct JniHandleTable {
+    size_t maxHandles;
+    Slot** chunks;  // Filled in as slots are first used; never freed before the table.
+
+    // Guards the free list, the unused slots, chunk creation and the caches.
+    pthread_mutex_t lock;
+    uint32_t freeHead;
+    size_t used;  // Slots ever handed out; the rest are fresh.
+    ThreadCache* caches;
+    // Counters of threads that have exited, or had no cache.
+    uint64_t adds;
+    uint64_t removes;
+};
+
+namespace {
+
+// Relaxed, since only the owning thread writes and readers want a snapshot.
+void increment(uint64_t* counter) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+Slot* slotAt(const JniHandleTable* table, uint32_t index) {
+    Slot* chunk = __atomic_load_n(&table->chunks[index / kChunkSlots], __ATOMIC_ACQUIRE);
+    return (chunk != NULL) ? &chunk[index % kChunkSlots] : NULL;
+}
+
+// Called with the lock held.
+void pushFree(JniHandleTable* table, uint32_t index) {
+    slotAt(table, index)->nextFree = table->freeHead;
+    table->freeHead = index;
+}
+
+// One key for every table, whose value is the thread's list of caches, most
+// recently used first; pthread keys are too few to give each table its own.
+pthread_once_t gCacheKeyOnce = PTHREAD_ONCE_INIT;
+pthread_key_t gCacheKey;
+bool gCacheKeyValid;
+
+// Gives every slot back to the table and folds the counters into it.
+void destroyCache(ThreadCache* cache) {
+    JniHandleTable* table = cache->table;
+    pthread_mutex_lock(&table->lock);
+    while (cache->count > 0) {
+        pushFree(table, cache->indices[--cache->count]);
+    }
+    table->adds += cache->adds;
+    table->removes += cache->removes;
+    if (cache->prev != NULL) {
+        cache->prev->next = cache->next;
+    } else {
+        table->caches = cache->next;
+    }
+    if (cache->next != NULL) {
+        cache->next->prev = cache->prev;
+    }
+    pthread_mutex_unlock(&table->lock);
+    delete cache;
+}
+
+// Runs at thread exit. Tables in use cannot be destroyed meanwhile, so a
+// cache's table is either live or already NULL.
+void destroyThreadCaches(void* value) {
+    ThreadCache* cache = static_cast<ThreadCache*>(value);
+    while (cache != NULL) {
+        ThreadCache* next = cache->threadNext;
+        if (__atomic_load_n(&cache->table, __ATOMIC_ACQUIRE) != NULL) {
+            destroyCache(cache);
+        } else {
+            delete cache;
+        }
+        cache = next;
+    }
+}
+
+void createCacheKey() {
+    gCacheKeyValid = pthread_key_create(&gCacheKey, destroyThreadCaches) == 0;
+}
+
+ThreadCache* getCache(JniHandleTable* table) {
+    pthread_once(&gCacheKeyOnce, createCacheKey);
+    if (!gCacheKeyValid) {
+        return NULL;
+    }
+    ThreadCache* head = static_cast<ThreadCache*>(pthread_getspecific(gCacheKey));
+    if (head != NULL && __atomic_load_n(&head->table, __ATOMIC_RELAXED) == table) {
+        return head;
+    }
+    // Look further, freeing the caches of destroyed tables on the way, and
+    // move the one found to the front.
+    ThreadCache** link = &head;
+    ThreadCache* cache = NULL;
+    while (*link != NULL) {
+        ThreadCache* candidate = *link;
+        JniHandleTable* owner = __atomic_load_n(&candidate->table, __ATOMIC_ACQUIRE);
+        if (owner == NULL) {
+            *link = candidate->threadNext;
+            delete candidate;
+        } else if (owner == table) {
+            *link = candidate->threadNext;
+            cache = candidate;
+        } else {
+            link = &candidate->threadNext;
+        }
+    }
+    if (cache == NULL) {
+        cache = new (std::nothrow) ThreadCache();
+        if (cache == NULL) {
+            pthread_setspecific(gCacheKey, head);
+            return NULL;
+        }
+        cache->table = table;
+        pthread_mutex_lock(&table->lock);
+        cache->next = table->caches;
+        if (table->caches != NULL) {
+            table->caches->prev = cache;
+        }
+        table->caches = cache;
+        pthread_mutex_unlock(&table->lock);
+    }
+    cache->threadNext = head;
+    pthread_setspecific(gCacheKey, cache);
+    return cache;
+}
+
+// Moves up to half a cache of free slots to the cache, using fresh slots
+// once the free list is empty. Returns false if the table is full.
+bool refill(JniHandleTable* table, ThreadCache* cache) {
+    pthread_mutex_lock(&table->lock);
+    while (cache->count < kCachedSlots / 2) {
+        uint32_t index;
+        if (table->freeHead != kNoSlot) {
+            index = table->freeHead;
+            table->freeHead = slotAt(table, index)->nextFree;
+        } else if (table->used < table->maxHandles) {
+            index = table->used;
+            Slot** chunk = &table->chunks[index / kChunkSlots];
+            if (*chunk == NULL) {
+                Slot* slots = static_cast<Slot*>(calloc(kChunkSlots, sizeof(Slot)));
+                if (slots == NULL) {
+                    break;
+                }
+                __atomic_store_n(chunk, slots, __ATOMIC_RELEASE);
+            }
+            table->used++;
+        } else {
+            break;
+        }
+        cache->indices[cache->count++] = index;
+    }
+    pthread_mutex_unlock(&table->lock);
+    return cache->count > 0;
+}
+
+void spill(JniHandleTable* table, ThreadCache* cache, size_t count) {
+    pthread_mutex_lock(&table->lock);
+    for (size_t i = 0; i < count; ++i) {
+        pushFree(table, cache->indices[--cache->count]);
+    }
+    pthread_mutex_unlock(&table->lock);
+}
+
+void release(JniHandleTable* table, uint32_t index) {
+    ThreadCache* cache = getCache(table);
+    if (cache == NULL) {
+        pthread_mutex_lock(&table->lock);
+        pushFree(table, index);
+        table->removes++;
+        pthread_mutex_unlock(&table->lock);
+        return;
+    }
+    increment(&cache->removes);
+    cache->indices[cache->count++] = index;
+    if (cache->count == kCachedSlots) {
+        spill(table, cache, kCachedSlots / 2);
+    }
+}
+
+}  // namespace
+
+JniHandleTable* jniHandleTableCreate(JNIEnv* env, size_t maxHandles) {
+    if (maxHandles == 0 || maxHandles > JNI_HANDLE_TABLE_MAX_HANDLES) {
+        char message[64];
+        snprintf(message, sizeof(message), "Bad handle table size: %zu", maxHandles);
+        jniThrowException(env, "java/lang/IllegalArgumentException", message);
+        return NULL;
+    }
+    JniHandleTable* table = new (std::nothrow) JniHandleTable();
+    if (table != NULL) {
+        table->chunks = static_cast<Slot**>(
+                calloc((maxHandles + kChunkSlots - 1) / kChunkSlots, sizeof(Slot*)));
+    }
+    if (table == NULL || table->chunks == NULL) {
+        if (table != NULL) {
+            free(table->chunks);
+        }
+        delete table;
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Could not allocate handle table");
+        return NULL;
+    }
+    table->maxHandles = maxHandles;
+    pthread_mutex_init(&table->lock, NULL);
+    table->freeHead = kNoSlot;
+    return table;
+}
+
+void jniHandleTableDestroy(JniHandleTable* table) {
+    if (table == NULL) {
+        return;
+    }
+    // The caches stay on their threads' lists, which only those threads may
+    // change; marking them orphaned lets each thread free its own later.
+    ThreadCache* cache = table->caches;
+    while (cache != NULL) {
+        ThreadCache* next = cache->next;
+        __atomic_store_n(&cache->table, static_cast<JniHandleTable*>(NULL), __ATOMIC_RELEASE);
+        cache = next;
+    }
+    for (size_t i = 0; i < (table->maxHandles + kChunkSlots - 1) / kChunkSlots; ++i) {
+        free(table->chunks[i]);
+    }
+    free(table->chunks);
+    pthread_mutex_destroy(&table->lock);
+    delete table;
+}
+
+jlong jniHandleTableAdd(JNIEnv* env, JniHandleTable* table, void* pointer) {
+    if (pointer == NULL) {
+        jniThrowNullPointerException(env, "pointer == null");
+        return 0;
+    }
+    ThreadCache* cache = getCache(table);
+    if (cache == NULL) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Could not allocate handle");
+        return 0;
+    }
+    if (cache->count == 0 && !refill(table, cache)) {
+        char message[64];
+        snprintf(message, sizeof(message), "Handle table full: %zu handles", table->maxHandles);
+        jniThrowException(env, "java/lang/IllegalStateException", message);
+        return 0;
+    }
+    const uint32_t index = cache->indices[--cache->count];
+    Slot* slot = slotAt(table, index);
+    const uint32_t generation = __atomic_load_n(&slot->generation, __ATOMIC_RELAXED) + 1;
+    increment(&cache->adds);
+    __atomic_store_n(&slot->pointer, pointer, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->generation, generation, __ATOMIC_RELEASE);
+    return static_cast<jlong>((static_cast<uint64_t>(generation) << 32) | index);
+}
+
+void* jniHandleTableGet(const JniHandleTable* table, jlong handle) {
+    const uint32_t index = static_cast<uint32_t>(handle);
+    const uint32_t generation = static_cast<uint32_t>(static_cast<uint64_t>(handle) >> 32);
+    if ((generation & 1) == 0 || index >= table->maxHandles) {
+        return NULL;
+    }
+    Slot* slot = slotAt(table, index);
+    if (slot == NULL || __atomic_load_n(&slot->generation, __ATOMIC_ACQUIRE) != generation) {
+        return NULL;
+    }
+    void* pointer = __atomic_load_n(&slot->pointer, __ATOMIC_RELAXED);
+    // A pointer stored for a later generation makes the check below fail.
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->generation, __ATOMIC_RELAXED) != generation) {
+        return NULL;
+    }
+    return pointer;
+}
+
+void* jniHandleTableResolve(JNIEnv* env, const JniHandleTable* table, jlong handle) {
+    void* pointer = jniHandleTableGet(table, handle);
+    if (pointer == NULL) {
+        char message[64];
+        snprintf(message, sizeof(message), "Stale native handle: %#llx",
+                 static_cast<unsigned long long>(handle));
+        jniThrowException(env, "java/lang/IllegalStateException", message);
+    }
+    return pointer;
+}
+
+void* jniHandleTableRemove(JniHandleTable* table, jlong handle) {
+    void* pointer = jniHandleTableGet(table, handle);
+    if (pointer == NULL) {
+        return NULL;
+    }
+    const uint32_t index = static_cast<uint32_t>(handle);
+    uint32_t generation = static_cast<uint32_t>(static_cast<uint64_t>(handle) >> 32);
+    if (!__atomic_compare_exchange_n(&slotAt(table, index)->generation, &generation,
+                                     generation + 1, false, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_RELAXED)) {
+        return NULL;  // Another thread removed it first.
+    }
+    if (generation == UINT32_MAX) {
+        // Its next generation would wrap to an old one, so the slot is never reused.
+        pthread_mutex_lock(&table->lock);
+        table->removes++;
+        pthread_mutex_unlock(&table->lock);
+    } else {
+        release(table, index);
+    }
+    return pointer;
+}
+
+size_t jniHandleTableSize(JniHandleTable* table) {
+    pthread_mutex_lock(&table->lock);
+    uint64_t adds = table->adds;
+    uint64_t removes = table->removes;
+    for (ThreadCache* cache = table->caches; cache != NULL; cache = cache->next) {
+        adds += __atomic_load_n(&cache->adds, __ATOMIC_RELAXED);
+        removes += __atomic_load_n(&cache->removes, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&table->lock);
+    // The counters are read one by one, so a removal may show before its add.
+    return (adds > removes) ? adds - removes : 0;
+}
@@ -18,28 +18,45 @@
 #include "JniInvocation.h"
 
 #include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <cstddef>
+#include <string>
+#include <vector>
 
 #define LOG_TAG "JniInvocation"
 #include "cutils/log.h"
 
+#include "JniTrace.h"
+
 #ifdef __ANDROID__
 #include "cutils/properties.h"
+#elif !defined(PROPERTY_VALUE_MAX)
+// The buffer size GetLibrary documents, as cutils/properties.h has it.
+#define PROPERTY_VALUE_MAX 92
 #endif
 
 JniInvocation* JniInvocation::jni_invocation_ = NULL;
 
 JniInvocation::JniInvocation() :
     handle_(NULL),
+    prefetch_library_(false),
     JNI_GetDefaultJavaVMInitArgs_(NULL),
     JNI_CreateJavaVM_(NULL),
     JNI_GetCreatedJavaVMs_(NULL) {
 
   LOG_ALWAYS_FATAL_IF(jni_invocation_ != NULL, "JniInvocation instance already initialized");
   jni_invocation_ = this;
+  memset(&timings_, 0, sizeof(timings_));
 }
 
 JniInvocation::~JniInvocation() {
@@ -53,12 +70,124 @@ JniInvocation::~JniInvocation() {
 static const char* kLibrarySystemProperty = "persist.sys.dalvik.vm.lib.2";
 static const char* kDebuggableSystemProperty = "ro.debuggable";
 static const char* kDebuggableFallback = "0";  // Not debuggable.
+#elif !defined(MOE)
+static const char* kLibraryEnvironmentVariable = "JNI_INVOCATION_LIBRARY";
+static const char* kConfigEnvironmentVariable = "JNI_INVOCATION_CONFIG";
 #endif
 static const char* kLibraryFallback = "libart.so";
 
 template<typename T> void UNUSED(const T&) {}
 
+#if !defined(__ANDROID__) && !defined(MOE)
+// Reads the runtime libraries listed in the file named by
+// JNI_INVOCATION_CONFIG: one per line, blank lines and lines starting with
+// '#' ignored, surrounding whitespace trimmed.
+static void ReadConfigLibraries(std::vector<std::string>* libraries) {
+  const char* config = getenv(kConfigEnvironmentVariable);
+  if (config == NULL || *config == '\0') {
+    return;
+  }
+  FILE* file = fopen(config, "re");
+  if (file == NULL) {
+    ALOGW("Failed to open %s=%s: %s", kConfigEnvironmentVariable, config, strerror(errno));
+    return;
+  }
+  char line[PATH_MAX];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    const char* begin = line;
+    while (*begin == ' ' || *begin == '\t') {
+      ++begin;
+    }
+    const char* end = begin + strlen(begin);
+    while (end > begin && strchr(" \t\r\n", end[-1]) != NULL) {
+      --end;
+    }
+    if (begin != end && *begin != '#') {
+      libraries->push_back(std::string(begin, end));
+    }
+  }
+  fclose(file);
+}
+#endif
+
+static uint64_t NanoTime() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+// Finds the file dlopen would load for a bare library name, searching
+// LD_LIBRARY_PATH and then the system library directory. Returns false if
+// it cannot be found; dlopen may still succeed through other mechanisms
+// (DT_RUNPATH, namespaces), in which case nothing is prefetched.
+static bool FindLibraryFile(const char* library, char* path, size_t size) {
+  if (strchr(library, '/') != NULL) {
+    snprintf(path, size, "%s", library);
+    return access(path, R_OK) == 0;
+  }
+  const char* search_path = getenv("LD_LIBRARY_PATH");
+  while (search_path != NULL && *search_path != '\0') {
+    const char* end = strchr(search_path, ':');
+    size_t length = (end != NULL) ? static_cast<size_t>(end - search_path) : strlen(search_path);
+    if (length > 0) {
+      snprintf(path, size, "%.*s/%s", static_cast<int>(length), search_path, library);
+      if (access(path, R_OK) == 0) {
+        return true;
+      }
+    }
+    search_path = (end != NULL) ? end + 1 : NULL;
+  }
+#ifdef __ANDROID__
+#ifdef __LP64__
+  snprintf(path, size, "/system/lib64/%s", library);
+#else
+  snprintf(path, size, "/system/lib/%s", library);
+#endif
+  return access(path, R_OK) == 0;
+#else
+  return false;
+#endif
+}
+
+void JniInvocation::PrefetchLibrary(const char* library) {
+  char path[PATH_MAX];
+  uint64_t start = NanoTime();
+  bool found = FindLibraryFile(library, path, sizeof(path));
+  timings_.resolve_library_ns += NanoTime() - start;
+  if (!found) {
+    ALOGV("Not prefetching %s: file not found", library);
+    return;
+  }
+
+  start = NanoTime();
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    ALOGW("Failed to open %s for prefetch: %s", path, strerror(errno));
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0) {
+#if defined(__linux__)
+    // Starts sequential reads of the whole file into the page cache. The
+    // call can return before they complete, but most of the pages dlopen
+    // touches are then resident or already on their way, rather than each
+    // faulting in on its own.
+    if (readahead(fd, 0, st.st_size) == -1) {
+      ALOGW("Failed to prefetch %s: %s", path, strerror(errno));
+    }
+#else
+    UNUSED(st);
+#endif
+  }
+  close(fd);
+  timings_.prefetch_ns = NanoTime() - start;
+}
+
 const char* JniInvocation::GetLibrary(const char* library, char* buffer) {
+  return GetLibrary(library, buffer, PROPERTY_VALUE_MAX);
+}
+
+const char* JniInvocation::GetLibrary(const char* library, char* buffer, size_t buffer_size) {
 #ifndef MOE
 #ifdef __ANDROID__
   const char* default_library;
@@ -77,7 +206,7 @@ const char* JniInvocation::GetLibrary(const char* library, char* buffer) {
     // Debuggable build.
     // Accept the library parameter. For the case it is NULL, load the default
     // library from the system property.
-    if (buffer != NULL) {
+    if (buffer != NULL && buffer_size >= PROPERTY_VALUE_MAX) {
       property_get(kLibrarySystemProperty, buffer, kLibraryFallback);
       default_library = buffer;
     } else {
@@ -86,8 +215,25 @@ const char* JniInvocation::GetLibrary(const char* library, char* buffer) {
     }
   }
 #else
-  UNUSED(buffer);
-  const char* default_library = kLibraryFallback;
+  // Host. Prefer JNI_INVOCATION_LIBRARY, then the first entry of the
+  // JNI_INVOCATION_CONFIG file (read into the buffer), then the fallback.
+  const char* default_library = getenv(kLibraryEnvironmentVariable);
+  if (default_library == NULL || *default_library == '\0') {
+    default_library = kLibraryFallback;
+    if (buffer != NULL) {
+      std::vector<std::string> libraries;
+      ReadConfigLibraries(&libraries);
+      for (size_t i = 0; i < libraries.size(); ++i) {
+        if (libraries[i].size() < buffer_size) {
+          snprintf(buffer, buffer_size, "%s", libraries[i].c_str());
+          default_library = buffer;
+          break;
+        }
+        ALOGW("Ignoring %s entry longer than %zu bytes: %s", kConfigEnvironmentVariable,
+              buffer_size - 1, libraries[i].c_str());
+      }
+    }
+  }
 #endif
   if (library == NULL) {
     library = default_library;
@@ -101,15 +247,27 @@ bool JniInvocation::Init(const char* library) {
 #ifdef __ANDROID__
   char buffer[PROPERTY_VALUE_MAX];
 #else
-  char* buffer = NULL;
+  char buffer[PATH_MAX];
 #endif
-  library = GetLibrary(library, buffer);
+  memset(&timings_, 0, sizeof(timings_));
+  uint64_t start = NanoTime();
+#if JNI_TRACE_ENABLED
+  const uint64_t init_start = start;
+#endif
+  library = GetLibrary(library, buffer, sizeof(buffer));
+  timings_.resolve_library_ns = NanoTime() - start;
+
+  if (prefetch_library_) {
+    PrefetchLibrary(library);
+  }
 
+  start = NanoTime();
   handle_ = dlopen(library, RTLD_NOW);
   if (handle_ == NULL) {
     if (strcmp(library, kLibraryFallback) == 0) {
       // Nothing else to try.
       ALOGE("Failed to dlopen %s: %s", library, dlerror());
+      JNI_TRACE3(invocation_init, library, 0, NanoTime() - init_start);
       return false;
     }
     // Note that this is enough to get something like the zygote
@@ -123,22 +281,81 @@ bool JniInvocation::Init(const char* library) {
     handle_ = dlopen(library, RTLD_NOW);
     if (handle_ == NULL) {
       ALOGE("Failed to dlopen %s: %s", library, dlerror());
+      JNI_TRACE3(invocation_init, library, 0, NanoTime() - init_start);
       return false;
     }
   }
+  timings_.dlopen_ns = NanoTime() - start;
+
+  start = NanoTime();
   if (!FindSymbol(reinterpret_cast<void**>(&JNI_GetDefaultJavaVMInitArgs_),
-                  "JNI_GetDefaultJavaVMInitArgs")) {
+                  "JNI_GetDefaultJavaVMInitArgs") ||
+      !FindSymbol(reinterpret_cast<void**>(&JNI_CreateJavaVM_),
+                  "JNI_CreateJavaVM") ||
+      !FindSymbol(reinterpret_cast<void**>(&JNI_GetCreatedJavaVMs_),
+                  "JNI_GetCreatedJavaVMs")) {
+    JNI_TRACE3(invocation_init, library, 0, NanoTime() - init_start);
     return false;
   }
-  if (!FindSymbol(reinterpret_cast<void**>(&JNI_CreateJavaVM_),
-                  "JNI_CreateJavaVM")) {
-    return false;
+  timings_.find_symbols_ns = NanoTime() - start;
+  ALOGV("Loaded %s: resolve %" PRIu64 "ns, prefetch %" PRIu64 "ns, dlopen %" PRIu64 "ns, "
+        "dlsym %" PRIu64 "ns", library, timings_.resolve_library_ns, timings_.prefetch_ns,
+        timings_.dlopen_ns, timings_.find_symbols_ns);
+  JNI_TRACE3(invocation_init, library, 1, NanoTime() - init_start);
+  return true;
+}
+
+std::vector<std::string> JniInvocation::GetCandidateLibraries() {
+  std::vector<std::string> candidates;
+#if defined(MOE)
+  // The embedder always names its runtime; there is nothing to enumerate.
+#elif defined(__ANDROID__)
+  char buffer[PROPERTY_VALUE_MAX];
+  candidates.push_back(GetLibrary(NULL, buffer));
+#else
+  const char* library = getenv(kLibraryEnvironmentVariable);
+  if (library != NULL && *library != '\0') {
+    candidates.push_back(library);
   }
-  if (!FindSymbol(reinterpret_cast<void**>(&JNI_GetCreatedJavaVMs_),
-                  "JNI_GetCreatedJavaVMs")) {
+  ReadConfigLibraries(&candidates);
+  candidates.push_back(kLibraryFallback);
+  // Keep the first occurrence of each.
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    for (size_t j = candidates.size() - 1; j > i; --j) {
+      if (candidates[j] == candidates[i]) {
+        candidates.erase(candidates.begin() + j);
+      }
+    }
+  }
+#endif
+  return candidates;
+}
+
+bool JniInvocation::ValidateLibrary(const char* library, std::string* error) {
+  void* handle = dlopen(library, RTLD_NOW | RTLD_LOCAL);
+  if (handle == NULL) {
+    if (error != NULL) {
+      *error = dlerror();
+    }
     return false;
   }
-  return true;
+  static const char* const kSymbols[] = {
+    "JNI_GetDefaultJavaVMInitArgs",
+    "JNI_CreateJavaVM",
+    "JNI_GetCreatedJavaVMs",
+  };
+  bool valid = true;
+  for (size_t i = 0; i < sizeof(kSymbols) / sizeof(kSymbols[0]); ++i) {
+    if (dlsym(handle, kSymbols[i]) == NULL) {
+      if (error != NULL) {
+        *error = std::string("missing symbol ") + kSymbols[i];
+      }
+      valid = false;
+      break;
+    }
+  }
+  dlclose(handle);
+  return valid;
 }
 
 jint JniInvocation::JNI_GetDefaultJavaVMInitArgs(void* vmargs) {
@@ -146,7 +363,10 @@ jint JniInvocation::JNI_GetDefaultJavaVMInitArgs(void* vmargs) {
 }
 
 jint JniInvocation::JNI_CreateJavaVM(JavaVM** p_vm, JNIEnv** p_env, void* vm_args) {
-  return JNI_CreateJavaVM_(p_vm, p_env, vm_args);
+  uint64_t start = NanoTime();
+  jint result = JNI_CreateJavaVM_(p_vm, p_env, vm_args);
+  timings_.create_java_vm_ns = NanoTime() - start;
+  return result;
 }
 
 jint JniInvocation::JNI_GetCreatedJavaVMs(JavaVM** vms, jsize size, jsize* vm_count) {
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JniListenerRegistry.h"
+#include "JNIHelp.h"
+#include "JniEpoch-priv.h"
+#include "ScopedGlobalRef.h"
+
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+// owners holds ScopedGlobalRefs, which only move (and so only fit in a
+// std::vector) in C++11. The public header is plain C and has no such need.
+#if __cplusplus < 201103L
+#error "JniListenerRegistry.cpp must be built as C++11 or later"
+#endif
+
+/*
+ * Emitters enter the registry's JniEpoch while they look at a snapshot, and
+ * a snapshot or listener reference retired in epoch E is freed once the
+ * epoch reaches E + 2 (see JniEpoch-priv.h).
+ */
+namespace {
+
+struct Snapshot {
+    size_t count;
+    jobject listeners[1];  // Global references owned by JniListenerRegistry::owners.
+};
+
+struct Retired {
+    Retired* next;
+    uint64_t epoch;
+    Snapshot* snapshot;
+    ScopedGlobalRef<jobject> listener;  // Of a removed listener, if any.
+};
+
+Snapshot* allocateSnapshot(size_t count) {
+    Snapshot* snapshot = static_cast<Snapshot*>(
+            malloc(sizeof(Snapshot) + (count - 1) * sizeof(jobject)));
+    if (snapshot != NULL) {
+        snapshot->count = count;
+    }
+    return snapshot;
+}
+
+}  // namespace
+
+struct JniListenerRegistry {
+    JniEpoch readers;
+    Snapshot* current;  // NULL when there are no listeners.
+    int retiredPending;  // A hint for readers that reclaim() has work.
+
+    // Guards everything below, changes to current, and the writer side of readers.
+    pthread_mutex_t lock;
+    std::vector<ScopedGlobalRef<jobject> > owners;  // In the same order as current.
+    Retired* retired;  // Newest first.
+};
+
+namespace {
+
+// Frees what no reader can see any more, advancing the epoch as far as the
+// readers allow. Never waits. Called with the lock held.
+void reclaim(JniListenerRegistry* r) {
+    while (r->retired != NULL && r->readers.tryAdvance()) {
+        Retired** link = &r->retired;
+        while (*link != NULL && !r->readers.reclaimable((*link)->epoch)) {
+            link = &(*link)->next;
+        }
+        Retired* old = *link;
+        *link = NULL;
+        while (old != NULL) {
+            Retired* next = old->next;
+            free(old->snapshot);
+            delete old;  // Deletes the removed listener's global reference.
+            old = next;
+        }
+    }
+    __atomic_store_n(&r->retiredPending, r->retired != NULL, __ATOMIC_RELAXED);
+}
+
+// Frees everything retired so far, yielding without the lock until the
+// readers in the way have left.
+void reclaimAll(JniListenerRegistry* r) {
+    for (;;) {
+        pthread_mutex_lock(&r->lock);
+        reclaim(r);
+        const bool done = r->retired == NULL;
+        pthread_mutex_unlock(&r->lock);
+        if (done) {
+            return;
+        }
+        sched_yield();
+    }
+}
+
+// Makes next current and retires the old snapshot, with the reference of
+// the listener it lost if any. Called with the lock held.
+void publish(JniListenerRegistry* r, Snapshot* next, Retired* retired) {
+    retired->snapshot = r->current;
+    __atomic_store_n(&r->current, next, __ATOMIC_SEQ_CST);
+    retired->epoch = r->readers.current();
+    retired->next = r->retired;
+    r->retired = retired;
+    reclaim(r);
+}
+
+ssize_t indexOf(JNIEnv* env, JniListenerRegistry* r, jobject listener) {
+    for (size_t i = 0; i < r->owners.size(); ++i) {
+        if (env->IsSameObject(r->owners[i].get(), listener)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+}  // namespace
+
+JniListenerRegistry* jniListenerRegistryCreate(JNIEnv* env) {
+    // Plain new need not honor the reader stripes' cache line alignment.
+    void* memory;
+    if (posix_memalign(&memory, alignof(JniListenerRegistry), sizeof(JniListenerRegistry)) != 0) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Could not allocate registry");
+        return NULL;
+    }
+    JniListenerRegistry* r = new (memory) JniListenerRegistry();
+    pthread_mutex_init(&r->lock, NULL);
+    return r;
+}
+
+void jniListenerRegistryDestroy(JNIEnv*, JniListenerRegistry* r) {
+    if (r == NULL) {
+        return;
+    }
+    reclaimAll(r);
+    pthread_mutex_destroy(&r->lock);
+    free(r->current);
+    r->~JniListenerRegistry();
+    free(r);
+}
+
+int jniListenerRegistryAdd(JNIEnv* env, JniListenerRegistry* r, jobject listener) {
+    if (listener == NULL) {
+        jniThrowNullPointerException(env, "listener == null");
+        return -1;
+    }
+    pthread_mutex_lock(&r->lock);
+    if (indexOf(env, r, listener) != -1) {
+        pthread_mutex_unlock(&r->lock);
+        return 1;
+    }
+    ScopedGlobalRef<jobject> owner(env, listener);
+    const size_t count = r->owners.size();
+    Snapshot* next = allocateSnapshot(count + 1);
+    Retired* retired = new (std::nothrow) Retired();
+    if (owner.get() == NULL || next == NULL || retired == NULL) {
+        pthread_mutex_unlock(&r->lock);
+        free(next);
+        delete retired;
+        if (!env->ExceptionCheck()) {
+            jniThrowException(env, "java/lang/OutOfMemoryError", "Could not add listener");
+        }
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        next->listeners[i] = r->owners[i].get();
+    }
+    next->listeners[count] = owner.get();
+    r->owners.push_back(std::move(owner));
+    publish(r, next, retired);
+    pthread_mutex_unlock(&r->lock);
+    return 0;
+}
+
+int jniListenerRegistryRemove(JNIEnv* env, JniListenerRegistry* r, jobject listener) {
+    pthread_mutex_lock(&r->lock);
+    const ssize_t index = indexOf(env, r, listener);
+    const size_t count = r->owners.size();
+    Snapshot* next = NULL;
+    Retired* retired = NULL;
+    if (index != -1) {
+        next = count > 1 ? allocateSnapshot(count - 1) : NULL;
+        retired = new (std::nothrow) Retired();
+    }
+    if (retired == NULL || (count > 1 && next == NULL)) {
+        // Not there, or out of memory: either way it stays.
+        pthread_mutex_unlock(&r->lock);
+        free(next);
+        delete retired;
+        return -1;
+    }
+    for (size_t i = 0, j = 0; i < count; ++i) {
+        if (i != static_cast<size_t>(index)) {
+            next->listeners[j++] = r->owners[i].get();
+        }
+    }
+    retired->listener = std::move(r->owners[index]);
+    r->owners.erase(r->owners.begin() + index);
+    publish(r, next, retired);
+    pthread_mutex_unlock(&r->lock);
+    return 0;
+}
+
+size_t jniListenerRegistryForEach(JNIEnv* env, JniListenerRegistry* r,
+                                  void (*visit)(JNIEnv* env, jobject listener, void* context),
+                                  void* context) {
+    int* reader = r->readers.enter();
+    const Snapshot* snapshot = __atomic_load_n(&r->current, __ATOMIC_SEQ_CST);
+    size_t visited = 0;
+    if (snapshot != NULL) {
+        while (visited < snapshot->count) {
+            visit(env, snapshot->listeners[visited++], context);
+            if (env->ExceptionCheck()) {
+                break;
+            }
+        }
+    }
+    JniEpoch::exit(reader);
+
+    // Removals are reclaimed by whoever passes by next; emitters never wait for it.
+    if (__atomic_load_n(&r->retiredPending, __ATOMIC_RELAXED) != 0 &&
+            pthread_mutex_trylock(&r->lock) == 0) {
+        reclaim(r);
+        pthread_mutex_unlock(&r->lock);
+    }
+    return visited;
+}
+
+size_t jniListenerRegistrySize(JniListenerRegistry* r) {
+    pthread_mutex_lock(&r->lock);
+    const size_t size = r->owners.size();
+    pthread_mutex_unlock(&r->lock);
+    return size;
+}
+
+void jniListenerRegistrySynchronize(JNIEnv*, JniListenerRegistry* r) {
+    reclaimAll(r);
+}
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JniMappedFile"
+
+#include "JniMappedFile.h"
+#include "JNIHelp.h"
+#include "ALog-priv.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// The registry is a list: mappings are few, and it is only walked to map,
+// unmap and report.
+struct Mapping {
+    JniMapping info;
+    void* base;  // Page-aligned start of the mmap, at or before info.address.
+    size_t mapLength;
+    Mapping* prev;
+    Mapping* next;
+};
+
+pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+Mapping* gMappings;
+size_t gCount;
+JniMappingCleanerHook gCleanerHook;
+
+void addMapping(Mapping* mapping) {
+    pthread_mutex_lock(&gLock);
+    mapping->prev = NULL;
+    mapping->next = gMappings;
+    if (gMappings != NULL) {
+        gMappings->prev = mapping;
+    }
+    gMappings = mapping;
+    gCount++;
+    pthread_mutex_unlock(&gLock);
+}
+
+// Removes and returns the mapping at address, or NULL.
+Mapping* removeMapping(const void* address) {
+    pthread_mutex_lock(&gLock);
+    Mapping* mapping = gMappings;
+    while (mapping != NULL && mapping->info.address != address) {
+        mapping = mapping->next;
+    }
+    if (mapping != NULL) {
+        if (mapping->prev != NULL) {
+            mapping->prev->next = mapping->next;
+        } else {
+            gMappings = mapping->next;
+        }
+        if (mapping->next != NULL) {
+            mapping->next->prev = mapping->prev;
+        }
+        gCount--;
+    }
+    pthread_mutex_unlock(&gLock);
+    return mapping;
+}
+
+int unmap(const void* address) {
+    Mapping* mapping = removeMapping(address);
+    if (mapping == NULL) {
+        return -1;
+    }
+    if (munmap(mapping->base, mapping->mapLength) == -1) {
+        ALOGE("munmap(%p, %zu) failed: %s", mapping->base, mapping->mapLength, strerror(errno));
+    }
+    free(mapping);
+    return 0;
+}
+
+void advise(void* base, size_t length, int advice) {
+    // Only hints: a kernel that does not know one is no reason to fail.
+    if ((advice & JNI_MAP_ADVISE_SEQUENTIAL) != 0) {
+        madvise(base, length, MADV_SEQUENTIAL);
+    }
+    if ((advice & JNI_MAP_ADVISE_WILLNEED) != 0) {
+        madvise(base, length, MADV_WILLNEED);
+    }
+#ifdef MADV_HUGEPAGE
+    if ((advice & JNI_MAP_ADVISE_HUGEPAGE) != 0) {
+        madvise(base, length, MADV_HUGEPAGE);
+    }
+#endif
+}
+
+jobject newBuffer(JNIEnv* env, void* address, size_t length, bool readOnly) {
+    jobject buffer = env->NewDirectByteBuffer(address, length);
+    if (buffer == NULL || !readOnly) {
+        return buffer;
+    }
+    jclass bufferClass = env->GetObjectClass(buffer);
+    jmethodID asReadOnlyBuffer = env->GetMethodID(bufferClass, "asReadOnlyBuffer",
+                                                  "()Ljava/nio/ByteBuffer;");
+    env->DeleteLocalRef(bufferClass);
+    jobject readOnlyBuffer = NULL;
+    if (asReadOnlyBuffer != NULL) {
+        readOnlyBuffer = env->CallObjectMethod(buffer, asReadOnlyBuffer);
+    }
+    env->DeleteLocalRef(buffer);
+    return readOnlyBuffer;
+}
+
+}  // namespace
+
+jobject jniMapFileDescriptor(JNIEnv* env, jobject fileDescriptor, off64_t offset, size_t length,
+                             int prot, int advice) {
+    const void* caller = __builtin_return_address(0);
+    if (fileDescriptor == NULL) {
+        jniThrowNullPointerException(env, "fileDescriptor == null");
+        return NULL;
+    }
+    // Java buffers are indexed by int.
+    if (offset < 0 || length == 0 || length > INT32_MAX ||
+            offset > INT64_MAX - static_cast<off64_t>(length)) {
+        jniThrowExceptionFmt(env, "java/lang/IllegalArgumentException",
+                             "Bad mapping range: offset %jd, length %zu",
+                             static_cast<intmax_t>(offset), length);
+        return NULL;
+    }
+    if ((prot & PROT_READ) == 0 || (prot & ~(PROT_READ | PROT_WRITE)) != 0) {
+        jniThrowExceptionFmt(env, "java/lang/IllegalArgumentException",
+                             "Bad mapping protection: %#x", prot);
+        return NULL;
+    }
+    const int fd = jniGetFDFromFileDescriptor(env, fileDescriptor);
+    if (fd < 0) {
+        jniThrowIOException(env, EBADF);
+        return NULL;
+    }
+
+    // Pages past the end of the file fault with SIGBUS when touched, so the
+    // range has to exist first. Like FileChannel.map, a read-write mapping
+    // extends the file and a read-only one fails.
+    const off64_t end = offset + static_cast<off64_t>(length);
+    struct stat64 st;
+    if (fstat64(fd, &st) == -1) {
+        jniThrowIOException(env, errno);
+        return NULL;
+    }
+    if (end > st.st_size) {
+        if ((prot & PROT_WRITE) == 0) {
+            jniThrowExceptionFmt(env, "java/io/IOException",
+                                 "Read-only mapping ends at %jd, past the end of the file at %jd",
+                                 static_cast<intmax_t>(end), static_cast<intmax_t>(st.st_size));
+            return NULL;
+        }
+        if (ftruncate64(fd, end) == -1) {
+            jniThrowIOException(env, errno);
+            return NULL;
+        }
+    }
+
+    const off64_t pageSize = sysconf(_SC_PAGESIZE);
+    const size_t delta = offset % pageSize;
+    const size_t mapLength = delta + length;
+    void* base = mmap64(NULL, mapLength, prot, MAP_SHARED, fd, offset - delta);
+    if (base == MAP_FAILED) {
+        jniThrowIOException(env, errno);
+        return NULL;
+    }
+    advise(base, mapLength, advice);
+
+    Mapping* mapping = static_cast<Mapping*>(malloc(sizeof(Mapping)));
+    if (mapping == NULL) {
+        munmap(base, mapLength);
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Could not allocate mapping");
+        return NULL;
+    }
+    void* address = static_cast<char*>(base) + delta;
+    mapping->info.address = address;
+    mapping->info.length = length;
+    mapping->info.fd = fd;
+    mapping->info.offset = offset;
+    mapping->info.prot = prot;
+    mapping->info.caller = caller;
+    mapping->base = base;
+    mapping->mapLength = mapLength;
+    addMapping(mapping);
+
+    jobject buffer = newBuffer(env, address, length, (prot & PROT_WRITE) == 0);
+    if (buffer == NULL) {
+        if (!env->ExceptionCheck()) {
+            jniThrowException(env, "java/lang/OutOfMemoryError", "Could not create buffer");
+        }
+        unmap(address);
+        return NULL;
+    }
+    JniMappingCleanerHook hook = __atomic_load_n(&gCleanerHook, __ATOMIC_ACQUIRE);
+    if (hook != NULL && (hook(env, buffer, address, length) != 0 || env->ExceptionCheck())) {
+        env->DeleteLocalRef(buffer);
+        unmap(address);
+        return NULL;
+    }
+    return buffer;
+}
+
+void jniSetMappingCleanerHook(JniMappingCleanerHook hook) {
+    __atomic_store_n(&gCleanerHook, hook, __ATOMIC_RELEASE);
+}
+
+int jniUnmapDirectBuffer(JNIEnv* env, jobject buffer) {
+    if (buffer == NULL) {
+        return -1;
+    }
+    void* address = env->GetDirectBufferAddress(buffer);
+    return (address != NULL) ? unmap(address) : -1;
+}
+
+int jniUnmapAddress(const void* address) {
+    return unmap(address);
+}
+
+size_t jniGetMappings(void (*visit)(const JniMapping* mapping, void* context), void* context) {
+    pthread_mutex_lock(&gLock);
+    const size_t count = gCount;
+    if (visit != NULL) {
+        for (Mapping* mapping = gMappings; mapping != NULL; mapping = mapping->next) {
+            visit(&mapping->info, context);
+        }
+    }
+    pthread_mutex_unlock(&gLock);
+    return count;
+}
+
+namespace {
+
+struct LogContext {
+    int priority;
+    const char* tag;
+};
+
+void logMapping(const JniMapping* mapping, void* context) {
+    const LogContext* log = static_cast<const LogContext*>(context);
+    __android_log_print(log->priority, log->tag,
+                        "  %p: %zu bytes of fd %d at %jd, %s, mapped from %p",
+                        mapping->address, mapping->length, mapping->fd,
+                        static_cast<intmax_t>(mapping->offset),
+                        (mapping->prot & PROT_WRITE) != 0 ? "read-write" : "read-only",
+                        mapping->caller);
+}
+
+}  // namespace
+
+void jniLogMappings(int priority, const char* tag) {
+    LogContext log = { priority, tag };
+    pthread_mutex_lock(&gLock);
+    __android_log_print(priority, tag, "%zu live mappings:", gCount);
+    for (Mapping* mapping = gMappings; mapping != NULL; mapping = mapping->next) {
+        logMapping(&mapping->info, &log);
+    }
+    pthread_mutex_unlock(&gLock);
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JniParallel"
+
+#include "JniParallel.h"
+#include "ALog-priv.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t kCacheLine = 64;
+// Chunks per participating thread, so that uneven chunks balance out.
+const size_t kChunksPerThread = 4;
+
+struct Job {
+    size_t count;
+    size_t head;   // Elements before the first cache line boundary.
+    size_t chunkSize;
+    size_t chunks;
+    void (*task)(size_t begin, size_t end, void* context, JniParallelError* error);
+    void* context;
+    size_t next;    // Next chunk to claim.
+    size_t done;    // Chunks finished or skipped.
+    int failed;
+    JniParallelError error;
+    int active;     // Workers inside runChunks; guarded by gLock.
+};
+
+// Guards everything below. gJob is the loop in progress, if any; workers
+// wait on gWork for gGeneration to change, and the caller waits on gDone
+// for the last worker to leave its job.
+pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t gWork = PTHREAD_COND_INITIALIZER;
+pthread_cond_t gDone = PTHREAD_COND_INITIALIZER;
+Job* gJob;
+uint64_t gGeneration;
+int gStarted;
+int gWanted = -1;  // -1 until set or defaulted.
+
+void runChunks(Job* job) {
+    for (;;) {
+        size_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= job->chunks) {
+            return;
+        }
+        if (__atomic_load_n(&job->failed, __ATOMIC_ACQUIRE) == 0) {
+            size_t begin = (i == 0) ? 0 : job->head + i * job->chunkSize;
+            size_t end = job->head + (i + 1) * job->chunkSize;
+            if (end > job->count || i + 1 == job->chunks) {
+                end = job->count;
+            }
+            JniParallelError error = { NULL, NULL };
+            job->task(begin, end, job->context, &error);
+            int expected = 0;
+            if (error.className != NULL &&
+                    __atomic_compare_exchange_n(&job->failed, &expected, 1, false,
+                                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                job->error = error;
+            }
+        }
+        __atomic_fetch_add(&job->done, 1, __ATOMIC_RELEASE);
+    }
+}
+
+void* workerMain(void* arg) {
+    const int index = static_cast<int>(reinterpret_cast<intptr_t>(arg));
+    uint64_t seen = 0;
+    pthread_mutex_lock(&gLock);
+    for (;;) {
+        // Workers beyond a lowered count stay idle.
+        while (gGeneration == seen || gJob == NULL || index >= gWanted) {
+            seen = gGeneration;
+            pthread_cond_wait(&gWork, &gLock);
+        }
+        seen = gGeneration;
+        Job* job = gJob;
+        job->active++;
+        pthread_mutex_unlock(&gLock);
+        runChunks(job);
+        pthread_mutex_lock(&gLock);
+        job->active--;
+        pthread_cond_broadcast(&gDone);
+    }
+    return NULL;
+}
+
+int wantedWorkers() {
+    if (gWanted < 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        gWanted = (cpus > 1) ? static_cast<int>(cpus - 1) : 0;
+    }
+    return gWanted;
+}
+
+// Starts workers up to the wanted count. Called with gLock held.
+void startWorkers() {
+    while (gStarted < wantedWorkers()) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_t thread;
+        int rc = pthread_create(&thread, &attr, workerMain,
+                                reinterpret_cast<void*>(static_cast<intptr_t>(gStarted)));
+        pthread_attr_destroy(&attr);
+        if (rc != 0) {
+            ALOGW("Could not start a parallel worker: error %d", rc);
+            gWanted = gStarted;
+            break;
+        }
+        gStarted++;
+    }
+}
+
+}  // namespace
+
+void jniSetParallelWorkers(int count) {
+    pthread_mutex_lock(&gLock);
+    gWanted = (count > 0) ? count : 0;
+    pthread_mutex_unlock(&gLock);
+}
+
+int jniParallelWorkers() {
+    pthread_mutex_lock(&gLock);
+    int workers = wantedWorkers();
+    pthread_mutex_unlock(&gLock);
+    return workers;
+}
+
+int jniParallelRun(const void* base, size_t count, size_t elementSize, size_t grain,
+                   void (*task)(size_t begin, size_t end, void* context,
+                                JniParallelError* error),
+                   void* context, JniParallelError* error) {
+    Job job;
+    job.count = count;
+    job.task = task;
+    job.context = context;
+    job.next = 0;
+    job.done = 0;
+    job.failed = 0;
+    job.error.className = NULL;
+    job.error.message = NULL;
+    job.active = 0;
+
+    // Only one loop uses the pool at a time; others, and nested loops, run
+    // inline rather than wait for it with a critical region held. gLock is
+    // only ever held briefly, so taking it is no such wait; the pool is busy
+    // exactly when gJob is set.
+    bool pooled = false;
+    size_t threads = 1;
+    pthread_mutex_lock(&gLock);
+    if (gJob == NULL && wantedWorkers() > 0) {
+        startWorkers();
+        pooled = gStarted > 0;
+        threads = gWanted + 1;
+    }
+    if (!pooled) {
+        pthread_mutex_unlock(&gLock);
+    }
+
+    // Elements per cache line, and the elements before the first boundary.
+    size_t lineElements = (elementSize > 0 && elementSize < kCacheLine &&
+                           kCacheLine % elementSize == 0) ? kCacheLine / elementSize : 1;
+    size_t misalignment = reinterpret_cast<uintptr_t>(base) % kCacheLine;
+    job.head = (lineElements > 1 && misalignment % elementSize == 0)
+            ? ((kCacheLine - misalignment) % kCacheLine) / elementSize : 0;
+    if (job.head > count) {
+        job.head = count;
+    }
+    size_t chunkSize = (count - job.head) / (threads * kChunksPerThread);
+    if (chunkSize < grain) {
+        chunkSize = grain;
+    }
+    chunkSize = (chunkSize + lineElements - 1) / lineElements * lineElements;
+    if (chunkSize == 0) {
+        chunkSize = lineElements;
+    }
+    job.chunkSize = chunkSize;
+    job.chunks = (count - job.head + chunkSize - 1) / chunkSize;
+    if (job.chunks == 0) {
+        job.chunks = 1;
+    }
+
+    if (pooled && job.chunks > 1) {
+        gJob = &job;
+        gGeneration++;
+        pthread_cond_broadcast(&gWork);
+        pthread_mutex_unlock(&gLock);
+        runChunks(&job);
+        pthread_mutex_lock(&gLock);
+        while (__atomic_load_n(&job.done, __ATOMIC_ACQUIRE) < job.chunks || job.active > 0) {
+            pthread_cond_wait(&gDone, &gLock);
+        }
+        gJob = NULL;
+        pthread_mutex_unlock(&gLock);
+    } else {
+        if (pooled) {
+            pthread_mutex_unlock(&gLock);
+        }
+        runChunks(&job);
+    }
+
+    if (job.failed) {
+        *error = job.error;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JniRingBuffer.h"
+#include "JNIHelp.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+
+struct JniRingBuffer {
+    int32_t magic;
+    int32_t flags;
+    int64_t capacity;
+    char pad0[JNI_RING_HEAD_OFFSET - 16];
+    int64_t head;
+    char pad1[JNI_RING_TAIL_OFFSET - JNI_RING_HEAD_OFFSET - 8];
+    int64_t tail;
+    char pad2[JNI_RING_WAITING_OFFSET - JNI_RING_TAIL_OFFSET - 8];
+    int32_t waiting;
+    char pad3[JNI_RING_DATA_OFFSET - JNI_RING_WAITING_OFFSET - 4];
+};
+
+static_assert(offsetof(JniRingBuffer, head) == JNI_RING_HEAD_OFFSET, "head");
+static_assert(offsetof(JniRingBuffer, tail) == JNI_RING_TAIL_OFFSET, "tail");
+static_assert(offsetof(JniRingBuffer, waiting) == JNI_RING_WAITING_OFFSET, "waiting");
+static_assert(sizeof(JniRingBuffer) == JNI_RING_DATA_OFFSET, "data");
+
+namespace {
+
+const size_t kMinCapacity = 4096;
+// Record lengths, at most an eighth of this, must fit in an int32.
+const size_t kMaxCapacity = static_cast<size_t>(1) << 30;
+const size_t kAlignment = 8;
+
+struct RecordHeader {
+    int32_t length;
+    int32_t type;
+};
+
+uint8_t* data(JniRingBuffer* ring) {
+    return reinterpret_cast<uint8_t*>(ring) + JNI_RING_DATA_OFFSET;
+}
+
+RecordHeader* recordAt(JniRingBuffer* ring, int64_t position) {
+    return reinterpret_cast<RecordHeader*>(data(ring) + (position & (ring->capacity - 1)));
+}
+
+size_t alignUp(size_t bytes) {
+    return (bytes + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+}  // namespace
+
+JniRingBuffer* jniRingBufferCreate(JNIEnv* env, size_t capacity, int flags, jobject* buffer) {
+    if (capacity < kMinCapacity || capacity > kMaxCapacity || (capacity & (capacity - 1)) != 0) {
+        jniThrowExceptionFmt(env, "java/lang/IllegalArgumentException",
+                             "Bad ring buffer capacity: %zu", capacity);
+        return NULL;
+    }
+    if ((flags & ~JNI_RING_MPSC) != 0) {
+        jniThrowExceptionFmt(env, "java/lang/IllegalArgumentException",
+                             "Bad ring buffer flags: %#x", flags);
+        return NULL;
+    }
+    // Anonymous memory comes zeroed, as the record protocol needs.
+    const size_t size = JNI_RING_DATA_OFFSET + capacity;
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Could not allocate ring buffer");
+        return NULL;
+    }
+    JniRingBuffer* ring = static_cast<JniRingBuffer*>(memory);
+    ring->magic = JNI_RING_MAGIC;
+    ring->flags = flags;
+    ring->capacity = capacity;
+    if (buffer != NULL) {
+        *buffer = env->NewDirectByteBuffer(memory, size);
+        if (*buffer == NULL) {
+            munmap(memory, size);
+            return NULL;
+        }
+    }
+    return ring;
+}
+
+JniRingBuffer* jniRingBufferFromBuffer(JNIEnv* env, jobject buffer) {
+    JniRingBuffer* ring = (buffer != NULL)
+            ? static_cast<JniRingBuffer*>(env->GetDirectBufferAddress(buffer)) : NULL;
+    if (ring == NULL || env->GetDirectBufferCapacity(buffer) < JNI_RING_DATA_OFFSET ||
+            ring->magic != JNI_RING_MAGIC ||
+            env->GetDirectBufferCapacity(buffer) != JNI_RING_DATA_OFFSET + ring->capacity) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "Not a ring buffer");
+        return NULL;
+    }
+    return ring;
+}
+
+void jniRingBufferDestroy(JniRingBuffer* ring) {
+    if (ring != NULL) {
+        munmap(ring, JNI_RING_DATA_OFFSET + ring->capacity);
+    }
+}
+
+size_t jniRingBufferMaxPayload(const JniRingBuffer* ring) {
+    return ring->capacity / 8 - JNI_RING_RECORD_HEADER;
+}
+
+void* jniRingBufferClaim(JniRingBuffer* ring, int32_t type, size_t length) {
+    if (length > jniRingBufferMaxPayload(ring)) {
+        return NULL;
+    }
+    const int64_t capacity = ring->capacity;
+    const int64_t recordLength = alignUp(JNI_RING_RECORD_HEADER + length);
+    const bool shared = (ring->flags & JNI_RING_MPSC) != 0;
+    int64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    int64_t padding;
+    while (true) {
+        // A record never wraps: the rest of the data area is padded instead.
+        const int64_t toEnd = capacity - (tail & (capacity - 1));
+        padding = (recordLength > toEnd) ? toEnd : 0;
+        // Acquire, so that the consumer's zeroing is done before we write.
+        const int64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail + padding + recordLength - head > capacity) {
+            return NULL;
+        }
+        if (!shared) {
+            __atomic_store_n(&ring->tail, tail + padding + recordLength, __ATOMIC_RELEASE);
+            break;
+        }
+        if (__atomic_compare_exchange_n(&ring->tail, &tail, tail + padding + recordLength,
+                                        true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (padding != 0) {
+        RecordHeader* filler = recordAt(ring, tail);
+        filler->type = JNI_RING_PADDING;
+        __atomic_store_n(&filler->length, static_cast<int32_t>(padding), __ATOMIC_RELEASE);
+        tail += padding;
+    }
+    // The negated length marks the record as claimed but not committed.
+    RecordHeader* header = recordAt(ring, tail);
+    header->type = type;
+    __atomic_store_n(&header->length, -static_cast<int32_t>(JNI_RING_RECORD_HEADER + length),
+                     __ATOMIC_RELAXED);
+    return header + 1;
+}
+
+int jniRingBufferCommit(JniRingBuffer* ring, void* payload) {
+    RecordHeader* header = static_cast<RecordHeader*>(payload) - 1;
+    const int32_t length = -__atomic_load_n(&header->length, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->length, length, __ATOMIC_RELEASE);
+    // Pairs with the fence in jniRingBufferPrepareWait: either the consumer
+    // sees the record, or we see it waiting.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED) != 0 &&
+            __atomic_exchange_n(&ring->waiting, 0, __ATOMIC_RELAXED) != 0) {
+        return JNI_RING_WAKE;
+    }
+    return 0;
+}
+
+int jniRingBufferWrite(JniRingBuffer* ring, int32_t type, const void* data, size_t length) {
+    void* payload = jniRingBufferClaim(ring, type, length);
+    if (payload == NULL) {
+        return JNI_RING_FULL;
+    }
+    memcpy(payload, data, length);
+    return jniRingBufferCommit(ring, payload);
+}
+
+size_t jniRingBufferRead(JniRingBuffer* ring,
+                         void (*handle)(int32_t type, const void* data, size_t length,
+                                        void* context),
+                         void* context, size_t limit) {
+    int64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    const int64_t start = head;
+    size_t count = 0;
+    while (count < limit && head - start < ring->capacity) {
+        RecordHeader* header = recordAt(ring, head);
+        const int32_t length = __atomic_load_n(&header->length, __ATOMIC_ACQUIRE);
+        if (length <= 0) {
+            break;
+        }
+        if (header->type != JNI_RING_PADDING) {
+            handle(header->type, header + 1, length - JNI_RING_RECORD_HEADER, context);
+            count++;
+        }
+        const size_t recordLength = alignUp(length);
+        memset(header, 0, recordLength);
+        head += recordLength;
+    }
+    if (head != start) {
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    }
+    return count;
+}
+
+int jniRingBufferPrepareWait(JniRingBuffer* ring) {
+    __atomic_store_n(&ring->waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    RecordHeader* header = recordAt(ring, __atomic_load_n(&ring->head, __ATOMIC_RELAXED));
+    if (__atomic_load_n(&header->length, __ATOMIC_ACQUIRE) > 0) {
+        __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+        return 0;
+    }
+    return 1;
+}
+
+size_t jniRingBufferBacklog(const JniRingBuffer* ring) {
+    const int64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    const int64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    return tail - head;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "JniScratch"
+
+#include "JniScratch.h"
+#include "ALog-priv.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <new>
+#include <vector>
+
+/*
+ * The arena is a list of chunks, of which 'current' holds the top of the
+ * stack and the ones after it are spares, and a stack of blocks recording
+ * where each allocation starts. Popping a block moves the top back to its
+ * start, possibly in an earlier chunk.
+ */
+namespace {
+
+const size_t kAlignment = 16;
+const size_t kChunkSize = 64 * 1024;
+const size_t kRetainedBytes = 256 * 1024;
+
+struct Chunk {
+    Chunk* next;
+    size_t capacity;
+
+    char* data() {
+        return reinterpret_cast<char*>(this) + kAlignment;
+    }
+};
+
+struct Block {
+    char* start;
+    Chunk* chunk;
+    bool live;
+};
+
+struct Arena {
+    Chunk* first;
+    Chunk* current;
+    char* top;
+    size_t retained;
+    std::vector<Block> blocks;
+};
+
+pthread_once_t gOnce = PTHREAD_ONCE_INIT;
+pthread_key_t gArenaKey;
+
+void freeChunks(Chunk* chunk) {
+    while (chunk != NULL) {
+        Chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void destroyArena(void* value) {
+    Arena* arena = static_cast<Arena*>(value);
+    freeChunks(arena->first);
+    delete arena;
+}
+
+void initArenaKey() {
+    pthread_key_create(&gArenaKey, destroyArena);
+}
+
+Arena* getArena() {
+    pthread_once(&gOnce, initArenaKey);
+    Arena* arena = static_cast<Arena*>(pthread_getspecific(gArenaKey));
+    if (arena == NULL) {
+        arena = new (std::nothrow) Arena();
+        if (arena == NULL) {
+            return NULL;
+        }
+        arena->blocks.reserve(64);
+        pthread_setspecific(gArenaKey, arena);
+    }
+    return arena;
+}
+
+// Keeps the first kRetainedBytes of chunks of an empty arena.
+void trim(Arena* arena) {
+    arena->current = arena->first;
+    if (arena->first == NULL) {
+        return;
+    }
+    arena->top = arena->first->data();
+    size_t kept = arena->first->capacity;
+    Chunk* last = arena->first;
+    while (last->next != NULL && kept + last->next->capacity <= kRetainedBytes) {
+        last = last->next;
+        kept += last->capacity;
+    }
+    freeChunks(last->next);
+    last->next = NULL;
+    arena->retained = kept;
+}
+
+// Pops the blocks from depth up, and any freed ones just below them.
+void popTo(Arena* arena, size_t depth) {
+    if (depth >= arena->blocks.size()) {
+        return;
+    }
+    while (depth > 0 && !arena->blocks[depth - 1].live) {
+        --depth;
+    }
+    const Block& block = arena->blocks[depth];
+    arena->current = block.chunk;
+    arena->top = block.start;
+    arena->blocks.resize(depth);
+    if (depth == 0) {
+        trim(arena);
+    }
+}
+
+}  // namespace
+
+void* jniScratchAlloc(size_t bytes) {
+    Arena* arena = getArena();
+    if (arena == NULL || bytes > SIZE_MAX - kChunkSize) {
+        return NULL;
+    }
+    // Never empty, so that every block has its own start.
+    size_t size = (bytes == 0) ? kAlignment : (bytes + kAlignment - 1) & ~(kAlignment - 1);
+    Chunk* chunk = arena->current;
+    if (chunk == NULL || size > static_cast<size_t>(chunk->data() + chunk->capacity - arena->top)) {
+        // The remainder of the current chunk stays unused until the top
+        // returns to it.
+        Chunk* next = (chunk != NULL) ? chunk->next : arena->first;
+        if (next == NULL || next->capacity < size) {
+            size_t capacity = (size > kChunkSize) ? size : kChunkSize;
+            Chunk* fresh = static_cast<Chunk*>(malloc(kAlignment + capacity));
+            if (fresh == NULL) {
+                return NULL;
+            }
+            fresh->capacity = capacity;
+            fresh->next = next;
+            if (chunk != NULL) {
+                chunk->next = fresh;
+            } else {
+                arena->first = fresh;
+            }
+            arena->retained += capacity;
+            next = fresh;
+        }
+        arena->current = next;
+        arena->top = next->data();
+    }
+    Block block = { arena->top, arena->current, true };
+    arena->blocks.push_back(block);
+    arena->top += size;
+    return block.start;
+}
+
+void jniScratchFree(void* p) {
+    Arena* arena = getArena();
+    if (arena == NULL || p == NULL) {
+        return;
+    }
+    size_t depth = arena->blocks.size();
+    size_t i = depth;
+    while (i > 0 && !(arena->blocks[i - 1].start == p && arena->blocks[i - 1].live)) {
+        --i;
+    }
+    if (i == 0) {
+        // Freed on another thread, or already released to a checkpoint.
+        ALOGE("jniScratchFree(%p): not a live block of this thread's arena", p);
+        return;
+    }
+    arena->blocks[i - 1].live = false;
+    if (!arena->blocks.empty() && !arena->blocks.back().live) {
+        popTo(arena, depth - 1);
+    }
+}
+
+size_t jniScratchMark() {
+    Arena* arena = getArena();
+    return (arena != NULL) ? arena->blocks.size() : 0;
+}
+
+void jniScratchRelease(size_t mark) {
+    Arena* arena = getArena();
+    if (arena != NULL) {
+        popTo(arena, mark);
+    }
+}
+
+size_t jniScratchRetainedBytes() {
+    Arena* arena = getArena();
+    return (arena != NULL) ? arena->retained : 0;
+}
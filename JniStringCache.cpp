@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JniStringCache.h"
+#include "JNIHelp.h"
+#include "JniBytes.h"
+#include "JniEpoch-priv.h"
+#include "JniScratch.h"
+#include "JniThreadIndex-priv.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Entries are immutable once published in a bucket slot. Writers hold gLock;
+ * readers only enter gEpoch while they look at entries. An evicted entry is
+ * unlinked first and retired, and its global reference is deleted once
+ * gEpoch shows that no reader can still hold it (see JniEpoch-priv.h).
+ * Nobody waits for that: whoever passes by next with gLock frees what it can.
+ */
+namespace {
+
+const size_t kBucketCount = 1024;
+const size_t kBucketSlots = 8;
+const size_t kHitStripes = 16;
+const size_t kDefaultBudget = 256 * 1024;
+// A String's object header and fields, roughly, on top of its chars.
+const size_t kJavaStringOverhead = 24;
+
+struct Entry {
+    uint32_t hash;
+    uint32_t length;
+    jstring string;  // A global reference.
+    int referenced;  // Set by hits, cleared by the eviction sweep.
+    Entry* nextRetired;
+    uint64_t retiredEpoch;
+    char bytes[1];
+};
+
+struct Bucket {
+    Entry* slots[kBucketSlots];
+} __attribute__((aligned(64)));
+
+struct HitStripe {
+    uint64_t hits;
+} __attribute__((aligned(64)));
+
+Bucket gBuckets[kBucketCount];
+JniEpoch gEpoch;
+HitStripe gHits[kHitStripes];
+int gRetiredPending;  // A hint for readers that reclaim() has work.
+
+// Guards the slots against concurrent writers, gEpoch's writer side, and
+// everything below.
+pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+size_t gBudget = kDefaultBudget;
+size_t gBytes;
+size_t gEntries;
+uint64_t gMisses;
+uint64_t gEvictions;
+size_t gClockHand;
+Entry* gRetired;  // Newest first.
+
+size_t entryBytes(size_t length) {
+    // Native copy plus the String's chars, at two bytes each at worst.
+    return sizeof(Entry) + length + kJavaStringOverhead + 2 * length;
+}
+
+bool matches(const Entry* entry, uint32_t hash, const char* utf8, size_t length) {
+    return entry->hash == hash && entry->length == length &&
+            memcmp(entry->bytes, utf8, length) == 0;
+}
+
+// Deletes the retired entries no reader can see any more, advancing the
+// epoch as far as the readers allow. Never waits. Called with gLock held.
+void reclaim(JNIEnv* env) {
+    while (gRetired != NULL && gEpoch.tryAdvance()) {
+        Entry** link = &gRetired;
+        while (*link != NULL && !gEpoch.reclaimable((*link)->retiredEpoch)) {
+            link = &(*link)->nextRetired;
+        }
+        Entry* old = *link;
+        *link = NULL;
+        while (old != NULL) {
+            Entry* next = old->nextRetired;
+            env->DeleteGlobalRef(old->string);
+            free(old);
+            old = next;
+        }
+    }
+    __atomic_store_n(&gRetiredPending, gRetired != NULL, __ATOMIC_RELAXED);
+}
+
+jstring lookup(JNIEnv* env, uint32_t hash, const char* utf8, size_t length) {
+    int* reader = gEpoch.enter();
+    const Bucket& bucket = gBuckets[hash % kBucketCount];
+    jstring result = NULL;
+    for (size_t i = 0; i < kBucketSlots; ++i) {
+        Entry* entry = __atomic_load_n(&bucket.slots[i], __ATOMIC_SEQ_CST);
+        if (entry != NULL && matches(entry, hash, utf8, length)) {
+            // Avoid dirtying the line on every hit.
+            if (__atomic_load_n(&entry->referenced, __ATOMIC_RELAXED) == 0) {
+                __atomic_store_n(&entry->referenced, 1, __ATOMIC_RELAXED);
+            }
+            result = reinterpret_cast<jstring>(env->NewLocalRef(entry->string));
+            break;
+        }
+    }
+    JniEpoch::exit(reader);
+    if (result != NULL) {
+        // Threads past the stripe count share stripes, so this must not lose counts.
+        __atomic_fetch_add(&gHits[jniThreadIndex() % kHitStripes].hits, 1, __ATOMIC_RELAXED);
+    }
+
+    // Evictions are reclaimed by whoever passes by next; lookups never wait for it.
+    if (__atomic_load_n(&gRetiredPending, __ATOMIC_RELAXED) != 0 &&
+            pthread_mutex_trylock(&gLock) == 0) {
+        reclaim(env);
+        pthread_mutex_unlock(&gLock);
+    }
+    return result;
+}
+
+// Unlinks and retires the entry in slot. Called with gLock held.
+void evict(Entry** slot) {
+    Entry* entry = *slot;
+    __atomic_store_n(slot, static_cast<Entry*>(NULL), __ATOMIC_SEQ_CST);
+    gBytes -= entryBytes(entry->length);
+    gEntries--;
+    gEvictions++;
+    entry->nextRetired = gRetired;
+    entry->retiredEpoch = gEpoch.current();
+    gRetired = entry;
+}
+
+// CLOCK over all slots: entries hit since the hand last passed get another
+// round. Called with gLock held.
+void evictDownTo(size_t budget) {
+    while (gBytes > budget && gEntries > 0) {
+        Entry** slot = &gBuckets[gClockHand / kBucketSlots].slots[gClockHand % kBucketSlots];
+        gClockHand = (gClockHand + 1) % (kBucketCount * kBucketSlots);
+        Entry* entry = *slot;
+        if (entry == NULL) {
+            continue;
+        }
+        if (__atomic_load_n(&entry->referenced, __ATOMIC_RELAXED) != 0) {
+            __atomic_store_n(&entry->referenced, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+        evict(slot);
+    }
+}
+
+// Picks a slot for a new entry in bucket, evicting one if it is full.
+// Called with gLock held.
+Entry** claimSlot(Bucket& bucket, uint32_t hash) {
+    for (size_t i = 0; i < kBucketSlots; ++i) {
+        if (bucket.slots[i] == NULL) {
+            return &bucket.slots[i];
+        }
+    }
+    Entry** victim = &bucket.slots[(hash / kBucketCount) % kBucketSlots];
+    for (size_t i = 0; i < kBucketSlots; ++i) {
+        if (__atomic_load_n(&bucket.slots[i]->referenced, __ATOMIC_RELAXED) == 0) {
+            victim = &bucket.slots[i];
+            break;
+        }
+    }
+    evict(victim);
+    return victim;
+}
+
+jstring insert(JNIEnv* env, uint32_t hash, const char* terminated, size_t length) {
+    jstring local = env->NewStringUTF(terminated);
+    if (local == NULL) {
+        return NULL;
+    }
+    jstring global = reinterpret_cast<jstring>(env->NewGlobalRef(local));
+    Entry* entry = (global != NULL) ? static_cast<Entry*>(malloc(sizeof(Entry) + length))
+                                    : NULL;
+    if (entry == NULL) {
+        // Still usable, just not cached.
+        if (global != NULL) {
+            env->DeleteGlobalRef(global);
+        }
+        return local;
+    }
+    entry->hash = hash;
+    entry->length = length;
+    entry->string = global;
+    entry->referenced = 0;
+    entry->nextRetired = NULL;
+    memcpy(entry->bytes, terminated, length);
+
+    pthread_mutex_lock(&gLock);
+    gMisses++;
+    Bucket& bucket = gBuckets[hash % kBucketCount];
+    for (size_t i = 0; i < kBucketSlots; ++i) {
+        Entry* existing = bucket.slots[i];
+        if (existing != NULL && matches(existing, hash, terminated, length)) {
+            // Another thread got there first; hand out its String instead.
+            jstring shared = reinterpret_cast<jstring>(env->NewLocalRef(existing->string));
+            pthread_mutex_unlock(&gLock);
+            env->DeleteGlobalRef(global);
+            free(entry);
+            if (shared != NULL) {
+                env->DeleteLocalRef(local);
+                return shared;
+            }
+            return local;
+        }
+    }
+    Entry** slot = claimSlot(bucket, hash);
+    __atomic_store_n(slot, entry, __ATOMIC_SEQ_CST);
+    gBytes += entryBytes(length);
+    gEntries++;
+    evictDownTo(gBudget);
+    reclaim(env);
+    pthread_mutex_unlock(&gLock);
+    return local;
+}
+
+jstring getCachedString(JNIEnv* env, const char* utf8, size_t length, bool terminated) {
+    const uint32_t hash = jniBytesCrc32c(0, utf8, length);
+    jstring cached = lookup(env, hash, utf8, length);
+    if (cached != NULL) {
+        return cached;
+    }
+    if (terminated) {
+        return insert(env, hash, utf8, length);
+    }
+    ScopedScratch scratch;
+    char* copy = scratch.alloc<char>(length + 1);
+    if (copy == NULL) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Could not allocate string");
+        return NULL;
+    }
+    memcpy(copy, utf8, length);
+    copy[length] = '\0';
+    return insert(env, hash, copy, length);
+}
+
+}  // namespace
+
+jstring jniGetCachedString(JNIEnv* env, const char* utf8, size_t length) {
+    return getCachedString(env, utf8, length, false);
+}
+
+jstring jniGetCachedStringUTF(JNIEnv* env, const char* utf8) {
+    if (utf8 == NULL) {
+        return NULL;
+    }
+    return getCachedString(env, utf8, strlen(utf8), true);
+}
+
+void jniSetStringCacheBudget(JNIEnv* env, size_t bytes) {
+    pthread_mutex_lock(&gLock);
+    gBudget = bytes;
+    evictDownTo(gBudget);
+    reclaim(env);
+    pthread_mutex_unlock(&gLock);
+}
+
+void jniGetStringCacheStats(JniStringCacheStats* stats) {
+    uint64_t hits = 0;
+    for (size_t i = 0; i < kHitStripes; ++i) {
+        hits += __atomic_load_n(&gHits[i].hits, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_lock(&gLock);
+    stats->hits = hits;
+    stats->misses = gMisses;
+    stats->evictions = gEvictions;
+    stats->entries = gEntries;
+    stats->bytes = gBytes;
+    stats->budget = gBudget;
+    pthread_mutex_unlock(&gLock);
+}
+
+void jniClearStringCache(JNIEnv* env) {
+    pthread_mutex_lock(&gLock);
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        for (size_t j = 0; j < kBucketSlots; ++j) {
+            if (gBuckets[i].slots[j] != NULL) {
+                evict(&gBuckets[i].slots[j]);
+            }
+        }
+    }
+    reclaim(env);
+    bool done = gRetired == NULL;
+    pthread_mutex_unlock(&gLock);
+    // Lookups under way finish quickly and later ones don't hold the epoch
+    // back, so this ends soon; gLock is free meanwhile.
+    while (!done) {
+        sched_yield();
+        pthread_mutex_lock(&gLock);
+        reclaim(env);
+        done = gRetired == NULL;
+        pthread_mutex_unlock(&gLock);
+    }
+}
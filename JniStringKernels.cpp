@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JniStringKernels.h"
+#include "JniBytes.h"
+#include "JniScratch.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#define JNI_STRINGS_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define JNI_STRINGS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+struct StringKernels {
+    // Continues a hash over n more chars.
+    uint32_t (*hash)(uint32_t h, const jchar* p, size_t n);
+    // Returns the index of the first differing char, or n.
+    size_t (*mismatch)(const jchar* a, const jchar* b, size_t n);
+    bool (*equalsAscii)(const jchar* p, const uint8_t* ascii, size_t n);
+};
+
+// 31^k mod 2^32; String.hashCode relies on int overflow.
+constexpr uint32_t pow31(unsigned k) {
+    return (k == 0) ? 1 : 31 * pow31(k - 1);
+}
+
+uint32_t hashScalar(uint32_t h, const jchar* p, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        h = 31 * h + p[i];
+    }
+    return h;
+}
+
+size_t mismatchScalar(const jchar* a, const jchar* b, size_t n) {
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+bool equalsAsciiScalar(const jchar* p, const uint8_t* ascii, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (p[i] != ascii[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const StringKernels kScalarKernels = { hashScalar, mismatchScalar, equalsAsciiScalar };
+
+#if defined(JNI_STRINGS_X86)
+
+// Lane j of each accumulator holds the hash of every eighth char from j,
+// scaled by 31^8 per step; weighting lane j by 31^(7-j) at the end gives
+// the hash of the whole run.
+__attribute__((target("sse4.2")))
+uint32_t hashSse42(uint32_t h, const jchar* p, size_t n) {
+    const __m128i step = _mm_set1_epi32(pow31(8));
+    __m128i low = _mm_setzero_si128();
+    __m128i high = _mm_setzero_si128();
+    uint32_t scale = 1;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        low = _mm_add_epi32(_mm_mullo_epi32(low, step), _mm_cvtepu16_epi32(chars));
+        high = _mm_add_epi32(_mm_mullo_epi32(high, step),
+                             _mm_cvtepu16_epi32(_mm_srli_si128(chars, 8)));
+        scale *= pow31(8);
+    }
+    if (i > 0) {
+        low = _mm_mullo_epi32(low, _mm_setr_epi32(pow31(7), pow31(6), pow31(5), pow31(4)));
+        high = _mm_mullo_epi32(high, _mm_setr_epi32(pow31(3), pow31(2), 31, 1));
+        __m128i sum = _mm_add_epi32(low, high);
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        h = h * scale + static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+    }
+    return hashScalar(h, p + i, n - i);
+}
+
+__attribute__((target("sse4.2")))
+size_t mismatchSse42(const jchar* a, const jchar* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        unsigned equal = _mm_movemask_epi8(_mm_cmpeq_epi16(x, y));
+        if (equal != 0xffff) {
+            return i + __builtin_ctz(~equal) / 2;
+        }
+    }
+    return i + mismatchScalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse4.2")))
+bool equalsAsciiSse42(const jchar* p, const uint8_t* ascii, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i wide = _mm_cvtepu8_epi16(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ascii + i)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(chars, wide)) != 0xffff) {
+            return false;
+        }
+    }
+    return equalsAsciiScalar(p + i, ascii + i, n - i);
+}
+
+__attribute__((target("avx2")))
+uint32_t hashAvx2(uint32_t h, const jchar* p, size_t n) {
+    const __m256i step = _mm256_set1_epi32(pow31(16));
+    __m256i low = _mm256_setzero_si256();
+    __m256i high = _mm256_setzero_si256();
+    uint32_t scale = 1;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        low = _mm256_add_epi32(_mm256_mullo_epi32(low, step),
+                               _mm256_cvtepu16_epi32(_mm256_castsi256_si128(chars)));
+        high = _mm256_add_epi32(_mm256_mullo_epi32(high, step),
+                                _mm256_cvtepu16_epi32(_mm256_extracti128_si256(chars, 1)));
+        scale *= pow31(16);
+    }
+    if (i > 0) {
+        low = _mm256_mullo_epi32(low, _mm256_setr_epi32(pow31(15), pow31(14), pow31(13),
+                pow31(12), pow31(11), pow31(10), pow31(9), pow31(8)));
+        high = _mm256_mullo_epi32(high, _mm256_setr_epi32(pow31(7), pow31(6), pow31(5),
+                pow31(4), pow31(3), pow31(2), 31, 1));
+        __m256i sum256 = _mm256_add_epi32(low, high);
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sum256),
+                                    _mm256_extracti128_si256(sum256, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        h = h * scale + static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+    }
+    return hashSse42(h, p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+size_t mismatchAvx2(const jchar* a, const jchar* b, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        unsigned equal = _mm256_movemask_epi8(_mm256_cmpeq_epi16(x, y));
+        if (equal != 0xffffffff) {
+            return i + __builtin_ctz(~equal) / 2;
+        }
+    }
+    return i + mismatchSse42(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+bool equalsAsciiAvx2(const jchar* p, const uint8_t* ascii, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i wide = _mm256_cvtepu8_epi16(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(ascii + i)));
+        if (static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(chars, wide))) !=
+                0xffffffff) {
+            return false;
+        }
+    }
+    return equalsAsciiSse42(p + i, ascii + i, n - i);
+}
+
+const StringKernels kSse42Kernels = { hashSse42, mismatchSse42, equalsAsciiSse42 };
+const StringKernels kAvx2Kernels = { hashAvx2, mismatchAvx2, equalsAsciiAvx2 };
+
+#endif  // JNI_STRINGS_X86
+
+#if defined(JNI_STRINGS_NEON)
+
+uint32_t hashNeon(uint32_t h, const jchar* p, size_t n) {
+    const uint32x4_t step = vdupq_n_u32(pow31(8));
+    uint32x4_t low = vdupq_n_u32(0);
+    uint32x4_t high = vdupq_n_u32(0);
+    uint32_t scale = 1;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t chars = vld1q_u16(p + i);
+        low = vmlaq_u32(vmovl_u16(vget_low_u16(chars)), low, step);
+        high = vmlaq_u32(vmovl_u16(vget_high_u16(chars)), high, step);
+        scale *= pow31(8);
+    }
+    if (i > 0) {
+        const uint32_t lowWeights[] = { pow31(7), pow31(6), pow31(5), pow31(4) };
+        const uint32_t highWeights[] = { pow31(3), pow31(2), 31, 1 };
+        uint32x4_t sum = vaddq_u32(vmulq_u32(low, vld1q_u32(lowWeights)),
+                                   vmulq_u32(high, vld1q_u32(highWeights)));
+        h = h * scale + vaddvq_u32(sum);
+    }
+    return hashScalar(h, p + i, n - i);
+}
+
+size_t mismatchNeon(const jchar* a, const jchar* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        if (vminvq_u16(vceqq_u16(vld1q_u16(a + i), vld1q_u16(b + i))) != 0xffff) {
+            break;
+        }
+    }
+    return i + mismatchScalar(a + i, b + i, n - i);
+}
+
+bool equalsAsciiNeon(const jchar* p, const uint8_t* ascii, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        if (vminvq_u16(vceqq_u16(vld1q_u16(p + i), vmovl_u8(vld1_u8(ascii + i)))) != 0xffff) {
+            return false;
+        }
+    }
+    return equalsAsciiScalar(p + i, ascii + i, n - i);
+}
+
+const StringKernels kNeonKernels = { hashNeon, mismatchNeon, equalsAsciiNeon };
+
+#endif  // JNI_STRINGS_NEON
+
+// Follows whatever jniBytesSetIsa last selected.
+const StringKernels* kernels() {
+    switch (jniBytesIsa()) {
+#if defined(JNI_STRINGS_X86)
+    case kJniBytesAvx2:
+        return &kAvx2Kernels;
+    case kJniBytesSse42:
+        return &kSse42Kernels;
+#endif
+#if defined(JNI_STRINGS_NEON)
+    case kJniBytesNeon:
+        return &kNeonKernels;
+#endif
+    default:
+        return &kScalarKernels;
+    }
+}
+
+// Decodes one UTF-8 sequence into one or two chars; returns how many, or 0
+// if the sequence is malformed.
+int decodeUtf8(const uint8_t** utf8, const uint8_t* end, jchar* out) {
+    const uint8_t* p = *utf8;
+    uint32_t c = *p++;
+    int extra;
+    uint32_t min;
+    if (c < 0x80) {
+        extra = 0;
+        min = 0;
+    } else if ((c & 0xe0) == 0xc0) {
+        extra = 1;
+        min = 0x80;
+        c &= 0x1f;
+    } else if ((c & 0xf0) == 0xe0) {
+        extra = 2;
+        min = 0x800;
+        c &= 0x0f;
+    } else if ((c & 0xf8) == 0xf0) {
+        extra = 3;
+        min = 0x10000;
+        c &= 0x07;
+    } else {
+        return 0;
+    }
+    if (end - p < extra) {
+        return 0;
+    }
+    for (int i = 0; i < extra; ++i, ++p) {
+        if ((*p & 0xc0) != 0x80) {
+            return 0;
+        }
+        c = (c << 6) | (*p & 0x3f);
+    }
+    if (c < min || c > 0x10ffff) {
+        return 0;
+    }
+    *utf8 = p;
+    if (c < 0x10000) {
+        out[0] = static_cast<jchar>(c);
+        return 1;
+    }
+    c -= 0x10000;
+    out[0] = static_cast<jchar>(0xd800 + (c >> 10));
+    out[1] = static_cast<jchar>(0xdc00 + (c & 0x3ff));
+    return 2;
+}
+
+// Copies a string's chars into a stack buffer if it is short, else into
+// scratch storage.
+class StringRegion {
+public:
+    StringRegion(JNIEnv* env, jstring string, size_t length) : mChars(mInline) {
+        if (length > sizeof(mInline) / sizeof(mInline[0])) {
+            mChars = mScratch.alloc<jchar>(length);
+        }
+        if (mChars != NULL) {
+            env->GetStringRegion(string, 0, length, mChars);
+        }
+    }
+
+    const jchar* get() const {
+        return mChars;
+    }
+
+private:
+    ScopedScratch mScratch;
+    jchar mInline[128];
+    jchar* mChars;
+};
+
+}  // namespace
+
+jint jniStringHashCode(const jchar* chars, size_t length) {
+    return static_cast<jint>(kernels()->hash(0, chars, length));
+}
+
+jint jniStringCompare(const jchar* a, size_t aLength, const jchar* b, size_t bLength) {
+    size_t common = (aLength < bLength) ? aLength : bLength;
+    size_t i = kernels()->mismatch(a, b, common);
+    if (i < common) {
+        return static_cast<jint>(a[i]) - static_cast<jint>(b[i]);
+    }
+    return static_cast<jint>(aLength) - static_cast<jint>(bLength);
+}
+
+int jniStringEqualsAsciiChars(const jchar* chars, size_t length, const char* ascii,
+                              size_t asciiLength) {
+    return length == asciiLength &&
+            kernels()->equalsAscii(chars, reinterpret_cast<const uint8_t*>(ascii), length);
+}
+
+int jniStringEqualsUtf8Chars(const jchar* chars, size_t length, const char* utf8,
+                             size_t utf8Length) {
+    // A UTF-8 string has at least as many bytes as it has chars.
+    if (length > utf8Length) {
+        return 0;
+    }
+    const StringKernels* k = kernels();
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(utf8);
+    const uint8_t* end = p + utf8Length;
+    size_t i = 0;
+    while (p < end) {
+        // Compare each run of ASCII bytes in one go.
+        const uint8_t* run = p;
+        while (p < end && *p < 0x80) {
+            ++p;
+        }
+        size_t runLength = p - run;
+        if (runLength > length - i || !k->equalsAscii(chars + i, run, runLength)) {
+            return 0;
+        }
+        i += runLength;
+        if (p == end) {
+            break;
+        }
+        jchar decoded[2];
+        int n = decodeUtf8(&p, end, decoded);
+        if (n == 0 || static_cast<size_t>(n) > length - i) {
+            return 0;
+        }
+        for (int j = 0; j < n; ++j) {
+            if (chars[i++] != decoded[j]) {
+                return 0;
+            }
+        }
+    }
+    return i == length;
+}
+
+jboolean jniStringEqualsAscii(JNIEnv* env, jstring string, const char* ascii) {
+    if (string == NULL) {
+        return JNI_FALSE;
+    }
+    size_t asciiLength = strlen(ascii);
+    size_t length = env->GetStringLength(string);
+    if (length != asciiLength) {
+        return JNI_FALSE;
+    }
+    StringRegion chars(env, string, length);
+    return chars.get() != NULL && jniStringEqualsAsciiChars(chars.get(), length, ascii, length);
+}
+
+jboolean jniStringEqualsUtf8(JNIEnv* env, jstring string, const char* utf8) {
+    if (string == NULL) {
+        return JNI_FALSE;
+    }
+    size_t utf8Length = strlen(utf8);
+    size_t length = env->GetStringLength(string);
+    // Each char takes at most three bytes; a surrogate pair takes four.
+    if (length > utf8Length || 3 * length < utf8Length) {
+        return JNI_FALSE;
+    }
+    StringRegion chars(env, string, length);
+    return chars.get() != NULL &&
+            jniStringEqualsUtf8Chars(chars.get(), length, utf8, utf8Length);
+}
+
+jint jniStringHashCodeOf(JNIEnv* env, jstring string) {
+    if (string == NULL) {
+        return 0;
+    }
+    size_t length = env->GetStringLength(string);
+    StringRegion chars(env, string, length);
+    return (chars.get() != NULL) ? jniStringHashCode(chars.get(), length) : 0;
+}
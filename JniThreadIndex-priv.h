@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVEHELPER_JNITHREADINDEX_PRIV_H_
+#define NATIVEHELPER_JNITHREADINDEX_PRIV_H_
+
+#include <stddef.h>
+
+/*
+ * Returns the calling thread's index, assigned in order on its first call,
+ * for spreading threads evenly over striped counters: the first n threads
+ * to call land on n different stripes of n.
+ */
+inline size_t jniThreadIndex() {
+    static size_t next;
+    static __thread size_t index;  // One past the thread's index; 0 until assigned.
+    if (__builtin_expect(index == 0, 0)) {
+        index = __atomic_add_fetch(&next, 1, __ATOMIC_RELAXED);
+    }
+    return index - 1;
+}
+
+#endif  /* NATIVEHELPER_JNITHREADINDEX_PRIV_H_ */
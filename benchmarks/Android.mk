@@ -0,0 +1,84 @@
+# Copyright (C) 2016 Intel Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Host benchmarks. They start a VM through JniInvocation; see BenchmarkVm.h.
+LOCAL_PATH := $(call my-dir)
+
+benchmark_vm_src_files := BenchmarkVm.cpp
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := ScopedHelpers_benchmark
+LOCAL_MODULE_TAGS := optional
+LOCAL_CLANG := true
+LOCAL_SRC_FILES := \
+    $(benchmark_vm_src_files) \
+    ScopedHelpers_benchmark.cpp
+LOCAL_CFLAGS := -Werror
+LOCAL_SHARED_LIBRARIES := libnativehelper
+LOCAL_STATIC_LIBRARIES := libgoogle-benchmark
+LOCAL_MULTILIB := both
+LOCAL_MODULE_STEM_32 := $(LOCAL_MODULE)32
+LOCAL_MODULE_STEM_64 := $(LOCAL_MODULE)64
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := ByteKernels_benchmark
+LOCAL_MODULE_TAGS := optional
+LOCAL_CLANG := true
+LOCAL_SRC_FILES := \
+    $(benchmark_vm_src_files) \
+    ByteKernels_benchmark.cpp
+LOCAL_CFLAGS := -Werror
+LOCAL_SHARED_LIBRARIES := libnativehelper
+LOCAL_STATIC_LIBRARIES := libgoogle-benchmark
+LOCAL_MULTILIB := both
+LOCAL_MODULE_STEM_32 := $(LOCAL_MODULE)32
+LOCAL_MODULE_STEM_64 := $(LOCAL_MODULE)64
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libnativehelper-benchmarks
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := $(call all-java-files-under, src)
+include $(BUILD_HOST_DALVIK_JAVA_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := JniTransition_benchmark
+LOCAL_MODULE_TAGS := optional
+LOCAL_CLANG := true
+LOCAL_SRC_FILES := \
+    $(benchmark_vm_src_files) \
+    JniTransition_benchmark.cpp
+LOCAL_CFLAGS := -Werror
+LOCAL_SHARED_LIBRARIES := libnativehelper liblog
+LOCAL_REQUIRED_MODULES := libnativehelper-benchmarks
+LOCAL_MULTILIB := both
+LOCAL_MODULE_STEM_32 := $(LOCAL_MODULE)32
+LOCAL_MODULE_STEM_64 := $(LOCAL_MODULE)64
+include $(BUILD_HOST_EXECUTABLE)
+
+# Replays traces written by JniCallRecorder; see JniReplay.cpp.
+include $(CLEAR_VARS)
+LOCAL_MODULE := JniReplay
+LOCAL_MODULE_TAGS := optional
+LOCAL_CLANG := true
+LOCAL_SRC_FILES := \
+    $(benchmark_vm_src_files) \
+    JniReplay.cpp
+LOCAL_CFLAGS := -Werror
+LOCAL_SHARED_LIBRARIES := libnativehelper
+LOCAL_MULTILIB := both
+LOCAL_MODULE_STEM_32 := $(LOCAL_MODULE)32
+LOCAL_MODULE_STEM_64 := $(LOCAL_MODULE)64
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BenchmarkVm.h"
+
+#include <JniConstants.h>
+#include <JniInvocation.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+static void ListRuntimes() {
+    std::vector<std::string> candidates = JniInvocation::GetCandidateLibraries();
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        std::string error;
+        if (JniInvocation::ValidateLibrary(candidates[i].c_str(), &error)) {
+            printf("%s\tok\n", candidates[i].c_str());
+        } else {
+            printf("%s\tunusable: %s\n", candidates[i].c_str(), error.c_str());
+        }
+    }
+}
+
+bool StartBenchmarkVm(int* argc, char** argv, JavaVM** vm, JNIEnv** env) {
+    static const char kRuntimeFlag[] = "--runtime=";
+    static const char kVmOptionFlag[] = "--vm-option=";
+
+    const char* library = NULL;
+    std::vector<JavaVMOption> options;
+    int kept = 1;
+    for (int i = 1; i < *argc; ++i) {
+        if (strncmp(argv[i], kRuntimeFlag, sizeof(kRuntimeFlag) - 1) == 0) {
+            library = argv[i] + sizeof(kRuntimeFlag) - 1;
+        } else if (strcmp(argv[i], "--list-runtimes") == 0) {
+            ListRuntimes();
+            exit(EXIT_SUCCESS);
+        } else if (strncmp(argv[i], kVmOptionFlag, sizeof(kVmOptionFlag) - 1) == 0) {
+            JavaVMOption option;
+            option.optionString = argv[i] + sizeof(kVmOptionFlag) - 1;
+            option.extraInfo = NULL;
+            options.push_back(option);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+
+    // The VM lives until the process exits.
+    JniInvocation* jni_invocation = new JniInvocation;
+    if (!jni_invocation->Init(library)) {
+        fprintf(stderr, "Failed to initialize JNI invocation API from %s\n",
+                JniInvocation::GetLibrary(library, NULL));
+        return false;
+    }
+
+    JavaVMInitArgs init_args;
+    init_args.version = JNI_VERSION_1_6;
+    init_args.nOptions = options.size();
+    init_args.options = options.empty() ? NULL : &options[0];
+    init_args.ignoreUnrecognized = JNI_FALSE;
+    if (JNI_CreateJavaVM(vm, env, &init_args) != JNI_OK) {
+        fprintf(stderr, "Failed to create the VM\n");
+        return false;
+    }
+    JniConstants::init(*env);
+    return true;
+}
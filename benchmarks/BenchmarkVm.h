@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BENCHMARK_VM_H_included
+#define BENCHMARK_VM_H_included
+
+#include <jni.h>
+
+// Starts the VM used by the benchmark binaries through JniInvocation.
+//
+// Consumes these flags from argv, leaving everything else in place:
+//
+//   --runtime=LIBRARY     the JNI implementation to load; by default whatever
+//                         JniInvocation::GetLibrary selects, which on the
+//                         host honors JNI_INVOCATION_LIBRARY and
+//                         JNI_INVOCATION_CONFIG.
+//   --list-runtimes       print JniInvocation's candidate runtimes, whether
+//                         each one is usable, and exit.
+//   --vm-option=OPTION    passed to JNI_CreateJavaVM; may be repeated, e.g.
+//                         --vm-option=-Xbootclasspath:... for host ART.
+//
+// JniConstants is initialized before returning. Returns false, after
+// printing the reason, if the VM could not be started.
+bool StartBenchmarkVm(int* argc, char** argv, JavaVM** vm, JNIEnv** env);
+
+#endif  // BENCHMARK_VM_H_included
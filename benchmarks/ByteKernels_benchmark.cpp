@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of the JniBytes.h and JniStringKernels.h kernels on each
+// instruction set this CPU supports, and of the byte[]-to-String encoders
+// and jstring key matching end to end.
+//
+//   ByteKernels_benchmark --vm-option=-Xbootclasspath:...
+//       --benchmark_filter=Crc32c
+//
+// Kernel benchmarks are labeled with the instruction set; ones this CPU
+// lacks are skipped.
+
+#include <JNIHelp.h>
+#include <JniBytes.h>
+#include <JniConstants.h>
+#include <JniStringKernels.h>
+#include <ScopedBytes.h>
+#include <ScopedLocalRef.h>
+#include <ScopedUtfChars.h>
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "BenchmarkVm.h"
+
+static JNIEnv* gEnv;
+
+static const char* const kIsaNames[] = { "scalar", "sse4.2", "avx2", "neon" };
+
+static void KernelArgs(benchmark::internal::Benchmark* b) {
+    const int sizes[] = { 16, 256, 4096, 65536, 1 << 20 };
+    for (int isa = kJniBytesScalar; isa <= kJniBytesNeon; ++isa) {
+        for (size_t i = 0; i < NELEM(sizes); ++i) {
+            b->Args({ sizes[i], isa });
+        }
+    }
+}
+
+// Mixed-case text, so that case folding changes about half the bytes.
+static std::vector<char> TestBytes(size_t size) {
+    std::vector<char> bytes(size);
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = "Hello, World! 0123456789"[i % 24];
+    }
+    return bytes;
+}
+
+// Selects the benchmark's instruction set, or skips it. The default set is
+// restored on destruction.
+class IsaScope {
+public:
+    explicit IsaScope(benchmark::State& state) : mDefault(jniBytesIsa()) {
+        const JniBytesIsa isa = static_cast<JniBytesIsa>(state.range(1));
+        mSupported = (jniBytesSetIsa(isa) == isa);
+        if (!mSupported) {
+            state.SkipWithError("not supported on this CPU");
+        }
+        state.SetLabel(kIsaNames[isa]);
+    }
+
+    ~IsaScope() {
+        jniBytesSetIsa(mDefault);
+    }
+
+    bool supported() const {
+        return mSupported;
+    }
+
+private:
+    const JniBytesIsa mDefault;
+    bool mSupported;
+};
+
+static void BM_Crc32c(benchmark::State& state) {
+    IsaScope isa(state);
+    std::vector<char> bytes = TestBytes(state.range(0));
+    while (isa.supported() && state.KeepRunning()) {
+        benchmark::DoNotOptimize(jniBytesCrc32c(0, &bytes[0], bytes.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_Crc32c)->Apply(KernelArgs);
+
+static void BM_Adler32(benchmark::State& state) {
+    IsaScope isa(state);
+    std::vector<char> bytes = TestBytes(state.range(0));
+    while (isa.supported() && state.KeepRunning()) {
+        benchmark::DoNotOptimize(jniBytesAdler32(1, &bytes[0], bytes.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_Adler32)->Apply(KernelArgs);
+
+static void BM_ToHex(benchmark::State& state) {
+    IsaScope isa(state);
+    std::vector<char> bytes = TestBytes(state.range(0));
+    std::vector<char> hex(2 * bytes.size());
+    while (isa.supported() && state.KeepRunning()) {
+        jniBytesToHex(&hex[0], &bytes[0], bytes.size());
+        benchmark::DoNotOptimize(hex[0]);
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_ToHex)->Apply(KernelArgs);
+
+static void BM_ToLowerAscii(benchmark::State& state) {
+    IsaScope isa(state);
+    std::vector<char> bytes = TestBytes(state.range(0));
+    std::vector<char> lower(bytes.size());
+    while (isa.supported() && state.KeepRunning()) {
+        jniBytesToLowerAscii(&lower[0], &bytes[0], bytes.size());
+        benchmark::DoNotOptimize(lower[0]);
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_ToLowerAscii)->Apply(KernelArgs);
+
+// Bulk conversion of big-endian 32-bit fields, as JniByteReader::readBE does.
+static void BM_Swap32(benchmark::State& state) {
+    IsaScope isa(state);
+    std::vector<char> bytes = TestBytes(state.range(0));
+    std::vector<char> swapped(bytes.size());
+    while (isa.supported() && state.KeepRunning()) {
+        jniBytesSwap32(&swapped[0], &bytes[0], bytes.size() / 4);
+        benchmark::DoNotOptimize(swapped[0]);
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_Swap32)->Apply(KernelArgs);
+
+static void BM_StringHashCode(benchmark::State& state) {
+    IsaScope isa(state);
+    std::vector<char> bytes = TestBytes(state.range(0));
+    std::vector<jchar> chars(bytes.begin(), bytes.end());
+    while (isa.supported() && state.KeepRunning()) {
+        benchmark::DoNotOptimize(jniStringHashCode(&chars[0], chars.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * chars.size() * sizeof(jchar));
+}
+BENCHMARK(BM_StringHashCode)->Apply(KernelArgs);
+
+static void KeyLengths(benchmark::internal::Benchmark* b) {
+    const int lengths[] = { 8, 32, 256 };
+    for (size_t i = 0; i < NELEM(lengths); ++i) {
+        b->Arg(lengths[i]);
+    }
+}
+
+// Matching a jstring against a literal key, without and with conversion to
+// modified UTF-8.
+static void BM_StringEqualsAscii(benchmark::State& state) {
+    std::string key(state.range(0), 'k');
+    ScopedLocalRef<jstring> string(gEnv, gEnv->NewStringUTF(key.c_str()));
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(jniStringEqualsAscii(gEnv, string.get(), key.c_str()));
+    }
+}
+BENCHMARK(BM_StringEqualsAscii)->Apply(KeyLengths);
+
+static void BM_StringEqualsAsciiViaUtfChars(benchmark::State& state) {
+    std::string key(state.range(0), 'k');
+    ScopedLocalRef<jstring> string(gEnv, gEnv->NewStringUTF(key.c_str()));
+    while (state.KeepRunning()) {
+        ScopedUtfChars chars(gEnv, string.get());
+        benchmark::DoNotOptimize(strcmp(chars.c_str(), key.c_str()) == 0);
+    }
+}
+BENCHMARK(BM_StringEqualsAsciiViaUtfChars)->Apply(KeyLengths);
+
+static void EncoderSizes(benchmark::internal::Benchmark* b) {
+    const int sizes[] = { 16, 256, 4096, 65536 };
+    for (size_t i = 0; i < NELEM(sizes); ++i) {
+        b->Arg(sizes[i]);
+    }
+}
+
+// A byte[] to String, as a native toHex or toBase64 would do it.
+template<jstring (*Encode)(JNIEnv*, const void*, size_t)>
+static void BM_EncodeToString(benchmark::State& state) {
+    const jsize length = state.range(0);
+    std::vector<char> bytes = TestBytes(length);
+    ScopedLocalRef<jbyteArray> array(gEnv, gEnv->NewByteArray(length));
+    gEnv->SetByteArrayRegion(array.get(), 0, length, reinterpret_cast<jbyte*>(&bytes[0]));
+    while (state.KeepRunning()) {
+        ScopedBytesRO view(gEnv, array.get());
+        ScopedLocalRef<jstring> string(gEnv, Encode(gEnv, view.get(), view.size()));
+        benchmark::DoNotOptimize(string.get());
+    }
+    state.SetBytesProcessed(state.iterations() * length);
+}
+BENCHMARK_TEMPLATE(BM_EncodeToString, jniBytesToHexString)->Apply(EncoderSizes);
+BENCHMARK_TEMPLATE(BM_EncodeToString, jniBytesToBase64String)->Apply(EncoderSizes);
+
+int main(int argc, char** argv) {
+    JavaVM* vm;
+    if (!StartBenchmarkVm(&argc, argv, &vm, &gEnv)) {
+        return EXIT_FAILURE;
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return EXIT_FAILURE;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return EXIT_SUCCESS;
+}
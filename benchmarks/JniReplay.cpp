@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a trace written by JniCallRecorder against a JNI implementation.
+//
+//   JniReplay [--runtime=LIBRARY] [--vm-option=...] [--repeat=N] TRACE
+//
+// Each recorded call is made again, in order, with an argument of the
+// recorded size: arrays and strings are allocated once per type and size and
+// reused, and Get/Release pairs are matched up so that nothing is leaked.
+// RegisterNatives is not replayed since the trace does not say what was
+// registered. Reports, per function, the number of calls and the mean ns per
+// call as recorded and as replayed, so that a trace captured on a device can
+// be compared across runtimes, or before and after a change, on the host.
+
+#include <JNIHelp.h>
+#include <JniCallRecorder.h>
+#include <JniConstants.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BenchmarkVm.h"
+
+static const char* const kCallNames[kJniCallIdCount] = {
+    NULL,
+    "FindClass",
+    "ThrowNew",
+    "NewObject",
+    "IsInstanceOf",
+    "DeleteLocalRef",
+    "GetIntField",
+    "SetIntField",
+    "GetArrayLength",
+    "Get<Type>ArrayElements",
+    "Release<Type>ArrayElements",
+    "Get<Type>ArrayRegion",
+    "GetPrimitiveArrayCritical",
+    "ReleasePrimitiveArrayCritical",
+    "NewStringUTF",
+    "GetStringUTFChars",
+    "ReleaseStringUTFChars",
+    "GetStringChars",
+    "ReleaseStringChars",
+    "GetStringCritical",
+    "ReleaseStringCritical",
+    "NewObjectArray",
+    "SetObjectArrayElement",
+    "GetDirectBufferAddress",
+    "RegisterNatives",
+};
+
+struct Call {
+    uint8_t id;
+    uint8_t type;
+    uint64_t size;
+    uint64_t ns;
+};
+
+static uint64_t NanoTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+static bool GetLeb128(FILE* file, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF) {
+            return false;
+        }
+        *value |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ReadTrace(const char* path, std::vector<Call>* calls) {
+    FILE* file = fopen(path, "re");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    char header[5];
+    bool ok = fread(header, 1, sizeof(header), file) == sizeof(header) &&
+            memcmp(header, "JNIT", 4) == 0 && header[4] == 2;
+    if (!ok) {
+        fprintf(stderr, "%s: not a version 2 JNI call trace\n", path);
+    }
+    // Blocks of different threads are replayed one after the other, on this
+    // thread.
+    int c;
+    while (ok && (c = fgetc(file)) != EOF) {
+        ungetc(c, file);
+        uint64_t tid;
+        uint64_t length;
+        if (!GetLeb128(file, &tid) || !GetLeb128(file, &length)) {
+            fprintf(stderr, "%s: truncated block after %zu calls\n", path, calls->size());
+            ok = false;
+            break;
+        }
+        const long end = ftell(file) + static_cast<long>(length);
+        while (ok && ftell(file) < end) {
+            Call call;
+            int id = fgetc(file);
+            int type = fgetc(file);
+            if (id == EOF || type == EOF || !GetLeb128(file, &call.size) ||
+                    !GetLeb128(file, &call.ns) || ftell(file) > end) {
+                fprintf(stderr, "%s: truncated after %zu calls\n", path, calls->size());
+                ok = false;
+            } else if (id == 0 || id >= kJniCallIdCount) {
+                fprintf(stderr, "%s: unknown call id %d\n", path, id);
+                ok = false;
+            } else {
+                call.id = id;
+                call.type = type;
+                calls->push_back(call);
+            }
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+#define FOR_EACH_ARRAY_TYPE(V) \
+    V(kJniCallTypeBoolean, jboolean, Boolean) \
+    V(kJniCallTypeByte, jbyte, Byte) \
+    V(kJniCallTypeChar, jchar, Char) \
+    V(kJniCallTypeShort, jshort, Short) \
+    V(kJniCallTypeInt, jint, Int) \
+    V(kJniCallTypeLong, jlong, Long) \
+    V(kJniCallTypeFloat, jfloat, Float) \
+    V(kJniCallTypeDouble, jdouble, Double)
+
+// Makes the recorded calls. Setup and cleanup around each call, such as
+// allocating its argument or deleting its result, is not timed.
+class Replayer {
+public:
+    explicit Replayer(JNIEnv* env) : mEnv(env) {
+        mRuntimeExceptionClass = Global(env->FindClass("java/lang/RuntimeException"));
+        jclass fdClass = JniConstants::fileDescriptorClass;
+        mFileDescriptorInit = env->GetMethodID(fdClass, "<init>", "()V");
+        mDescriptorField = env->GetFieldID(fdClass, "descriptor", "I");
+        mFileDescriptor = Global(env->NewObject(fdClass, mFileDescriptorInit));
+        mObjectArray = Global(env->NewObjectArray(1, JniConstants::stringClass, NULL));
+        mDirectBuffer = Global(env->NewDirectByteBuffer(mDirectStorage, sizeof(mDirectStorage)));
+    }
+
+    ~Replayer() {
+        while (!mPending.empty()) {
+            Release(mPending.back());
+            mPending.pop_back();
+        }
+        for (size_t i = 0; i < mGlobals.size(); ++i) {
+            mEnv->DeleteGlobalRef(mGlobals[i]);
+        }
+    }
+
+    // Makes call and returns its duration, or -1 if it was skipped.
+    int64_t Replay(const Call& call) {
+        JNIEnv* env = mEnv;
+        uint64_t start;
+        uint64_t end;
+        switch (call.id) {
+        case kJniCallFindClass: {
+            start = NanoTime();
+            jclass c = env->FindClass("java/lang/String");
+            end = NanoTime();
+            env->DeleteLocalRef(c);
+            break;
+        }
+        case kJniCallThrowNew:
+            start = NanoTime();
+            env->ThrowNew(mRuntimeExceptionClass, "replayed");
+            end = NanoTime();
+            env->ExceptionClear();
+            break;
+        case kJniCallNewObject: {
+            start = NanoTime();
+            jobject object = env->NewObject(JniConstants::fileDescriptorClass,
+                                            mFileDescriptorInit);
+            end = NanoTime();
+            env->DeleteLocalRef(object);
+            break;
+        }
+        case kJniCallIsInstanceOf: {
+            jstring string = String(0);
+            start = NanoTime();
+            env->IsInstanceOf(string, JniConstants::stringClass);
+            end = NanoTime();
+            break;
+        }
+        case kJniCallDeleteLocalRef: {
+            jobject local = env->NewLocalRef(mFileDescriptor);
+            start = NanoTime();
+            env->DeleteLocalRef(local);
+            end = NanoTime();
+            break;
+        }
+        case kJniCallGetIntField:
+            start = NanoTime();
+            env->GetIntField(mFileDescriptor, mDescriptorField);
+            end = NanoTime();
+            break;
+        case kJniCallSetIntField:
+            start = NanoTime();
+            env->SetIntField(mFileDescriptor, mDescriptorField, -1);
+            end = NanoTime();
+            break;
+        case kJniCallGetArrayLength: {
+            jarray array = Array(kJniCallTypeInt, 0);
+            start = NanoTime();
+            env->GetArrayLength(array);
+            end = NanoTime();
+            break;
+        }
+        case kJniCallGetArrayElements:
+        case kJniCallGetPrimitiveArrayCritical: {
+            jarray array = Array(call.type, call.size);
+            if (array == NULL) {
+                return -1;
+            }
+            Pending pending = { call.id, call.type, array, NULL };
+            start = NanoTime();
+            pending.elements = Acquire(pending);
+            end = NanoTime();
+            mPending.push_back(pending);
+            break;
+        }
+        case kJniCallGetStringUTFChars:
+        case kJniCallGetStringChars:
+        case kJniCallGetStringCritical: {
+            Pending pending = { call.id, kJniCallTypeNone, String(call.size), NULL };
+            start = NanoTime();
+            pending.elements = Acquire(pending);
+            end = NanoTime();
+            mPending.push_back(pending);
+            break;
+        }
+        case kJniCallReleaseArrayElements:
+        case kJniCallReleasePrimitiveArrayCritical:
+        case kJniCallReleaseStringUTFChars:
+        case kJniCallReleaseStringChars:
+        case kJniCallReleaseStringCritical: {
+            // Each release id directly follows its get id.
+            size_t i = mPending.size();
+            while (i > 0 && (mPending[i - 1].id != call.id - 1 ||
+                             mPending[i - 1].type != call.type)) {
+                --i;
+            }
+            if (i == 0) {
+                return -1;
+            }
+            start = NanoTime();
+            Release(mPending[i - 1]);
+            end = NanoTime();
+            mPending.erase(mPending.begin() + (i - 1));
+            break;
+        }
+        case kJniCallGetArrayRegion: {
+            jarray array = Array(call.type, call.size);
+            if (array == NULL) {
+                return -1;
+            }
+            mRegion.resize(call.size + 1);
+            start = NanoTime();
+            GetRegion(call.type, array, call.size, &mRegion[0]);
+            end = NanoTime();
+            break;
+        }
+        case kJniCallNewStringUTF: {
+            std::string utf(call.size, 'a');
+            start = NanoTime();
+            jstring string = env->NewStringUTF(utf.c_str());
+            end = NanoTime();
+            env->DeleteLocalRef(string);
+            break;
+        }
+        case kJniCallNewObjectArray: {
+            start = NanoTime();
+            jobjectArray array = env->NewObjectArray(call.size, JniConstants::stringClass, NULL);
+            end = NanoTime();
+            env->DeleteLocalRef(array);
+            break;
+        }
+        case kJniCallSetObjectArrayElement: {
+            jstring string = String(0);
+            start = NanoTime();
+            env->SetObjectArrayElement(mObjectArray, 0, string);
+            end = NanoTime();
+            break;
+        }
+        case kJniCallGetDirectBufferAddress:
+            start = NanoTime();
+            env->GetDirectBufferAddress(mDirectBuffer);
+            end = NanoTime();
+            break;
+        default:
+            return -1;
+        }
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+            return -1;
+        }
+        return end - start;
+    }
+
+private:
+    // An acquired array or string, waiting for its release call.
+    struct Pending {
+        uint8_t id;
+        uint8_t type;
+        jobject object;
+        const void* elements;
+    };
+
+    template<typename T>
+    T Global(T local) {
+        T global = static_cast<T>(mEnv->NewGlobalRef(local));
+        mEnv->DeleteLocalRef(local);
+        mGlobals.push_back(global);
+        return global;
+    }
+
+    jarray Array(uint8_t type, uint64_t size) {
+        jarray& array = mArrays[std::make_pair(type, size)];
+        if (array == NULL) {
+            switch (type) {
+#define NEW_ARRAY(CALL_TYPE, PRIMITIVE_TYPE, NAME) \
+            case CALL_TYPE: \
+                array = Global<jarray>(mEnv->New ## NAME ## Array(size)); \
+                break;
+            FOR_EACH_ARRAY_TYPE(NEW_ARRAY)
+#undef NEW_ARRAY
+            case kJniCallTypeNone:
+                array = Global<jarray>(mEnv->NewByteArray(size));
+                break;
+            }
+        }
+        return array;
+    }
+
+    jstring String(uint64_t size) {
+        jstring& string = mStrings[size];
+        if (string == NULL) {
+            string = Global(mEnv->NewStringUTF(std::string(size, 'a').c_str()));
+        }
+        return string;
+    }
+
+    const void* Acquire(const Pending& pending) {
+        jstring string = static_cast<jstring>(pending.object);
+        jarray array = static_cast<jarray>(pending.object);
+        switch (pending.id) {
+        case kJniCallGetStringUTFChars:
+            return mEnv->GetStringUTFChars(string, NULL);
+        case kJniCallGetStringChars:
+            return mEnv->GetStringChars(string, NULL);
+        case kJniCallGetStringCritical:
+            return mEnv->GetStringCritical(string, NULL);
+        case kJniCallGetPrimitiveArrayCritical:
+            return mEnv->GetPrimitiveArrayCritical(array, NULL);
+        }
+        switch (pending.type) {
+#define GET_ELEMENTS(CALL_TYPE, PRIMITIVE_TYPE, NAME) \
+        case CALL_TYPE: \
+            return mEnv->Get ## NAME ## ArrayElements( \
+                    static_cast<PRIMITIVE_TYPE ## Array>(array), NULL);
+        FOR_EACH_ARRAY_TYPE(GET_ELEMENTS)
+#undef GET_ELEMENTS
+        }
+        return NULL;
+    }
+
+    void Release(const Pending& pending) {
+        jstring string = static_cast<jstring>(pending.object);
+        jarray array = static_cast<jarray>(pending.object);
+        void* elements = const_cast<void*>(pending.elements);
+        switch (pending.id) {
+        case kJniCallGetStringUTFChars:
+            mEnv->ReleaseStringUTFChars(string, static_cast<const char*>(elements));
+            return;
+        case kJniCallGetStringChars:
+            mEnv->ReleaseStringChars(string, static_cast<const jchar*>(elements));
+            return;
+        case kJniCallGetStringCritical:
+            mEnv->ReleaseStringCritical(string, static_cast<const jchar*>(elements));
+            return;
+        case kJniCallGetPrimitiveArrayCritical:
+            mEnv->ReleasePrimitiveArrayCritical(array, elements, JNI_ABORT);
+            return;
+        }
+        switch (pending.type) {
+#define RELEASE_ELEMENTS(CALL_TYPE, PRIMITIVE_TYPE, NAME) \
+        case CALL_TYPE: \
+            mEnv->Release ## NAME ## ArrayElements(static_cast<PRIMITIVE_TYPE ## Array>(array), \
+                    static_cast<PRIMITIVE_TYPE*>(elements), JNI_ABORT); \
+            return;
+        FOR_EACH_ARRAY_TYPE(RELEASE_ELEMENTS)
+#undef RELEASE_ELEMENTS
+        }
+    }
+
+    void GetRegion(uint8_t type, jarray array, jsize length, jdouble* buffer) {
+        switch (type) {
+#define GET_REGION(CALL_TYPE, PRIMITIVE_TYPE, NAME) \
+        case CALL_TYPE: \
+            mEnv->Get ## NAME ## ArrayRegion(static_cast<PRIMITIVE_TYPE ## Array>(array), 0, \
+                    length, reinterpret_cast<PRIMITIVE_TYPE*>(buffer)); \
+            break;
+        FOR_EACH_ARRAY_TYPE(GET_REGION)
+#undef GET_REGION
+        }
+    }
+
+    JNIEnv* const mEnv;
+    jclass mRuntimeExceptionClass;
+    jmethodID mFileDescriptorInit;
+    jfieldID mDescriptorField;
+    jobject mFileDescriptor;
+    jobjectArray mObjectArray;
+    jobject mDirectBuffer;
+    jbyte mDirectStorage[64];
+    std::map<std::pair<uint8_t, uint64_t>, jarray> mArrays;
+    std::map<uint64_t, jstring> mStrings;
+    std::vector<jobject> mGlobals;
+    std::vector<Pending> mPending;
+    std::vector<jdouble> mRegion;
+
+    DISALLOW_COPY_AND_ASSIGN(Replayer);
+};
+
+struct Totals {
+    uint64_t calls;
+    uint64_t recordedNs;
+    uint64_t replayedCalls;
+    uint64_t replayedNs;
+};
+
+int main(int argc, char** argv) {
+    JavaVM* vm;
+    JNIEnv* env;
+    if (!StartBenchmarkVm(&argc, argv, &vm, &env)) {
+        return EXIT_FAILURE;
+    }
+
+    int repeat = 1;
+    const char* path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--repeat=", 9) == 0) {
+            repeat = atoi(argv[i] + 9);
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "unknown argument: %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (path == NULL || repeat < 1) {
+        fprintf(stderr, "usage: %s [--repeat=N] TRACE\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Call> calls;
+    if (!ReadTrace(path, &calls)) {
+        return EXIT_FAILURE;
+    }
+
+    Totals totals[kJniCallIdCount];
+    memset(totals, 0, sizeof(totals));
+    for (size_t i = 0; i < calls.size(); ++i) {
+        totals[calls[i].id].calls++;
+        totals[calls[i].id].recordedNs += calls[i].ns;
+    }
+    uint64_t skipped = 0;
+    {
+        Replayer replayer(env);
+        for (int r = 0; r < repeat; ++r) {
+            for (size_t i = 0; i < calls.size(); ++i) {
+                int64_t ns = replayer.Replay(calls[i]);
+                if (ns < 0) {
+                    ++skipped;
+                } else {
+                    totals[calls[i].id].replayedCalls++;
+                    totals[calls[i].id].replayedNs += ns;
+                }
+            }
+        }
+    }
+
+    printf("%-30s %10s %14s %14s\n", "function", "calls", "recorded ns", "replayed ns");
+    for (int id = 1; id < kJniCallIdCount; ++id) {
+        const Totals& t = totals[id];
+        if (t.calls == 0) {
+            continue;
+        }
+        printf("%-30s %10" PRIu64 " %14.1f", kCallNames[id], t.calls,
+               static_cast<double>(t.recordedNs) / t.calls);
+        if (t.replayedCalls > 0) {
+            printf(" %14.1f\n", static_cast<double>(t.replayedNs) / t.replayedCalls);
+        } else {
+            printf(" %14s\n", "-");
+        }
+    }
+    printf("%zu calls, %" PRIu64 " replays skipped\n", calls.size(), skipped);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Java-to-native-to-Java round trips through the helpers.
+//
+//   JniTransition_benchmark --vm-option=-Xbootclasspath:...
+//       --vm-option=-Djava.class.path=libnativehelper-benchmarks.jar
+//       [--samples=N] [--batch=N] [--strings=N] [--json]
+//
+// Each sample is one call into JniTransition.run(), which makes 'batch'
+// native calls from a Java loop, timed as a whole less the cost of reading
+// the clock. The mean is per call. The percentiles are of the per-sample
+// means, not of single calls: batching smooths out outliers, so p99 and max
+// understate the tail unless --batch=1, where each sample is one native call
+// plus the Java entry into run(). The no-op native is the baseline.
+// jniLogException writes every trace to the log, so redirect it when running
+// that scenario.
+
+#define LOG_TAG "JniTransition_benchmark"
+
+#include <JNIHelp.h>
+#include <ScopedLocalRef.h>
+#include <android/log.h>
+#include <toStringArray.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "BenchmarkVm.h"
+
+static const char* kClassName = "libnativehelper/benchmark/JniTransition";
+
+// Keep in sync with the constants in JniTransition.java.
+enum Scenario {
+    kNoop,
+    kThrowException,
+    kCreateFileDescriptor,
+    kToStringArray,
+    kLogException,
+    kScenarioCount,
+};
+
+static const char* const kScenarioNames[] = {
+    "noop",
+    "jniThrowException",
+    "jniCreateFileDescriptor",
+    "toStringArray",
+    "jniLogException",
+};
+
+static std::vector<std::string> gStrings;
+
+static void JniTransition_noop(JNIEnv*, jclass) {
+}
+
+static void JniTransition_throwException(JNIEnv* env, jclass) {
+    jniThrowException(env, "java/lang/IllegalStateException", "thrown by JniTransition");
+}
+
+static jobject JniTransition_createFileDescriptor(JNIEnv* env, jclass, jint fd) {
+    return jniCreateFileDescriptor(env, fd);
+}
+
+static jobjectArray JniTransition_toStringArray(JNIEnv* env, jclass) {
+    return toStringArray(env, gStrings);
+}
+
+static void JniTransition_logException(JNIEnv* env, jclass, jthrowable exception) {
+    jniLogException(env, ANDROID_LOG_VERBOSE, LOG_TAG, exception);
+}
+
+static JNINativeMethod gMethods[] = {
+    { "noop", "()V", reinterpret_cast<void*>(JniTransition_noop) },
+    { "throwException", "()V", reinterpret_cast<void*>(JniTransition_throwException) },
+    { "createFileDescriptor", "(I)Ljava/io/FileDescriptor;",
+      reinterpret_cast<void*>(JniTransition_createFileDescriptor) },
+    { "toStringArray", "()[Ljava/lang/String;",
+      reinterpret_cast<void*>(JniTransition_toStringArray) },
+    { "logException", "(Ljava/lang/Throwable;)V",
+      reinterpret_cast<void*>(JniTransition_logException) },
+};
+
+static uint64_t NanoTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+struct Summary {
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+static double Percentile(const std::vector<double>& sorted, double p) {
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+static Summary Summarize(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    Summary summary;
+    double total = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        total += samples[i];
+    }
+    summary.mean = total / samples.size();
+    summary.p50 = Percentile(samples, 0.50);
+    summary.p90 = Percentile(samples, 0.90);
+    summary.p99 = Percentile(samples, 0.99);
+    summary.max = samples.back();
+    return summary;
+}
+
+// Returns the median cost of one pair of NanoTime calls.
+static uint64_t TimerOverhead() {
+    std::vector<uint64_t> costs(1001);
+    for (size_t i = 0; i < costs.size(); ++i) {
+        uint64_t start = NanoTime();
+        costs[i] = NanoTime() - start;
+    }
+    std::nth_element(costs.begin(), costs.begin() + costs.size() / 2, costs.end());
+    return costs[costs.size() / 2];
+}
+
+// Returns the mean ns per native call for each sample, or an empty vector if
+// Java threw.
+static std::vector<double> RunScenario(JNIEnv* env, jclass c, jmethodID run, Scenario scenario,
+                                       int samples, int batch, uint64_t timer_overhead) {
+    std::vector<double> result;
+    // Warm up so that the first samples don't include JIT or class init.
+    env->CallStaticVoidMethod(c, run, scenario, batch);
+    for (int i = 0; i < samples && !env->ExceptionCheck(); ++i) {
+        uint64_t start = NanoTime();
+        env->CallStaticVoidMethod(c, run, scenario, batch);
+        uint64_t elapsed = NanoTime() - start;
+        elapsed -= std::min(elapsed, timer_overhead);
+        result.push_back(static_cast<double>(elapsed) / batch);
+    }
+    if (env->ExceptionCheck()) {
+        jniLogException(env, ANDROID_LOG_ERROR, LOG_TAG);
+        env->ExceptionClear();
+        result.clear();
+    }
+    return result;
+}
+
+static bool ParseIntFlag(const char* arg, const char* name, int* value) {
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0) {
+        return false;
+    }
+    *value = atoi(arg + length);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    JavaVM* vm;
+    JNIEnv* env;
+    if (!StartBenchmarkVm(&argc, argv, &vm, &env)) {
+        return EXIT_FAILURE;
+    }
+
+    int samples = 1000;
+    int batch = 100;
+    int string_count = 16;
+    bool json = false;
+    for (int i = 1; i < argc; ++i) {
+        if (ParseIntFlag(argv[i], "--samples=", &samples) ||
+            ParseIntFlag(argv[i], "--batch=", &batch) ||
+            ParseIntFlag(argv[i], "--strings=", &string_count)) {
+            continue;
+        }
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+            continue;
+        }
+        fprintf(stderr, "unknown argument: %s\n", argv[i]);
+        return EXIT_FAILURE;
+    }
+    if (samples < 1 || batch < 1 || string_count < 0) {
+        fprintf(stderr, "--samples and --batch must be positive\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < string_count; ++i) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "string-%d", i);
+        gStrings.push_back(buffer);
+    }
+
+    jniRegisterNativeMethods(env, kClassName, gMethods, NELEM(gMethods));
+    ScopedLocalRef<jclass> c(env, env->FindClass(kClassName));
+    jmethodID run = env->GetStaticMethodID(c.get(), "run", "(II)V");
+    if (run == NULL) {
+        jniLogException(env, ANDROID_LOG_ERROR, LOG_TAG);
+        return EXIT_FAILURE;
+    }
+
+    const uint64_t timer_overhead = TimerOverhead();
+    if (json) {
+        printf("{\n  \"samples\": %d,\n  \"batch\": %d,\n  \"strings\": %d,\n"
+               "  \"timer_overhead_ns\": %" PRIu64 ",\n  \"results\": [\n",
+               samples, batch, string_count, timer_overhead);
+    } else {
+        printf("%-24s %10s %10s %10s %10s %10s  (ns/call; percentiles of %d-call means)\n",
+               "scenario", "mean", "p50", "p90", "p99", "max", batch);
+    }
+    bool ok = true;
+    bool first = true;
+    for (int scenario = 0; scenario < kScenarioCount; ++scenario) {
+        std::vector<double> result = RunScenario(env, c.get(), run,
+                                                 static_cast<Scenario>(scenario), samples, batch,
+                                                 timer_overhead);
+        if (result.empty()) {
+            fprintf(stderr, "%s failed\n", kScenarioNames[scenario]);
+            ok = false;
+            continue;
+        }
+        Summary s = Summarize(result);
+        if (json) {
+            printf("%s    {\"name\": \"%s\", \"mean_ns\": %.1f, \"batch_mean_p50_ns\": %.1f, "
+                   "\"batch_mean_p90_ns\": %.1f, \"batch_mean_p99_ns\": %.1f, "
+                   "\"batch_mean_max_ns\": %.1f}",
+                   first ? "" : ",\n", kScenarioNames[scenario], s.mean, s.p50, s.p90,
+                   s.p99, s.max);
+            first = false;
+        } else {
+            printf("%-24s %10.1f %10.1f %10.1f %10.1f %10.1f\n", kScenarioNames[scenario],
+                   s.mean, s.p50, s.p90, s.p99, s.max);
+        }
+    }
+    if (json) {
+        printf("\n  ]\n}\n");
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Acquire/release cost of the Scoped* helpers.
+//
+//   ScopedHelpers_benchmark --vm-option=-Xbootclasspath:...
+//       --benchmark_format=json --benchmark_out=scoped.json
+//
+// Each benchmark reports ns per acquire/release pair and the bytes per second
+// made available to native code. Use --runtime= to compare JNI
+// implementations; see BenchmarkVm.h.
+
+#include <JNIHelp.h>
+#include <JniBufferPool.h>
+#include <JniConstants.h>
+#include <ScopedBytes.h>
+#include <ScopedLocalRef.h>
+#include <ScopedPrimitiveArray.h>
+#include <ScopedStringChars.h>
+#include <ScopedUtfChars.h>
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include "BenchmarkVm.h"
+
+static JNIEnv* gEnv;
+
+// Array sizes around ScopedPrimitiveArrayRO's 1024-element inline buffer.
+static void ArraySizes(benchmark::internal::Benchmark* b) {
+    const int sizes[] = { 16, 256, 1023, 1024, 1025, 4096, 65536, 1 << 20 };
+    for (size_t i = 0; i < NELEM(sizes); ++i) {
+        b->Arg(sizes[i]);
+    }
+}
+
+template<typename T> struct ArrayTraits;
+
+#define DEFINE_ARRAY_TRAITS(PRIMITIVE_TYPE, NAME) \
+    template<> struct ArrayTraits<PRIMITIVE_TYPE> { \
+        typedef PRIMITIVE_TYPE ## Array JavaArray; \
+        typedef Scoped ## NAME ## ArrayRO RO; \
+        typedef Scoped ## NAME ## ArrayRW RW; \
+        static JavaArray New(JNIEnv* env, jsize length) { \
+            return env->New ## NAME ## Array(length); \
+        } \
+    }
+
+DEFINE_ARRAY_TRAITS(jboolean, Boolean);
+DEFINE_ARRAY_TRAITS(jbyte, Byte);
+DEFINE_ARRAY_TRAITS(jchar, Char);
+DEFINE_ARRAY_TRAITS(jshort, Short);
+DEFINE_ARRAY_TRAITS(jint, Int);
+DEFINE_ARRAY_TRAITS(jlong, Long);
+DEFINE_ARRAY_TRAITS(jfloat, Float);
+DEFINE_ARRAY_TRAITS(jdouble, Double);
+
+#undef DEFINE_ARRAY_TRAITS
+
+template<typename T, typename Scoped>
+static void BM_ScopedArray(benchmark::State& state) {
+    typedef typename ArrayTraits<T>::JavaArray JavaArray;
+    const jsize length = state.range(0);
+    ScopedLocalRef<JavaArray> array(gEnv, ArrayTraits<T>::New(gEnv, length));
+    if (array.get() == NULL) {
+        gEnv->ExceptionClear();
+        state.SkipWithError("array allocation failed");
+        return;
+    }
+    while (state.KeepRunning()) {
+        Scoped scoped(gEnv, array.get());
+        benchmark::DoNotOptimize(scoped.get());
+    }
+    state.SetBytesProcessed(state.iterations() * length * sizeof(T));
+}
+
+#define REGISTER_ARRAY_BENCHMARKS(PRIMITIVE_TYPE) \
+    BENCHMARK_TEMPLATE(BM_ScopedArray, PRIMITIVE_TYPE, ArrayTraits<PRIMITIVE_TYPE>::RO) \
+        ->Apply(ArraySizes); \
+    BENCHMARK_TEMPLATE(BM_ScopedArray, PRIMITIVE_TYPE, ArrayTraits<PRIMITIVE_TYPE>::RW) \
+        ->Apply(ArraySizes)
+
+REGISTER_ARRAY_BENCHMARKS(jboolean);
+REGISTER_ARRAY_BENCHMARKS(jbyte);
+REGISTER_ARRAY_BENCHMARKS(jchar);
+REGISTER_ARRAY_BENCHMARKS(jshort);
+REGISTER_ARRAY_BENCHMARKS(jint);
+REGISTER_ARRAY_BENCHMARKS(jlong);
+REGISTER_ARRAY_BENCHMARKS(jfloat);
+REGISTER_ARRAY_BENCHMARKS(jdouble);
+
+#undef REGISTER_ARRAY_BENCHMARKS
+
+// ScopedBytes over a byte[] and over a direct ByteBuffer of the same size.
+static void BM_ScopedBytesRO_ByteArray(benchmark::State& state) {
+    const jsize length = state.range(0);
+    ScopedLocalRef<jbyteArray> array(gEnv, gEnv->NewByteArray(length));
+    while (state.KeepRunning()) {
+        ScopedBytesRO bytes(gEnv, array.get());
+        benchmark::DoNotOptimize(bytes.get());
+    }
+    state.SetBytesProcessed(state.iterations() * length);
+}
+BENCHMARK(BM_ScopedBytesRO_ByteArray)->Apply(ArraySizes);
+
+static void BM_ScopedBytesRO_DirectBuffer(benchmark::State& state) {
+    const jsize length = state.range(0);
+    std::vector<jbyte> storage(length);
+    ScopedLocalRef<jobject> buffer(gEnv, gEnv->NewDirectByteBuffer(&storage[0], length));
+    while (state.KeepRunning()) {
+        ScopedBytesRO bytes(gEnv, buffer.get());
+        benchmark::DoNotOptimize(bytes.get());
+    }
+    state.SetBytesProcessed(state.iterations() * length);
+}
+BENCHMARK(BM_ScopedBytesRO_DirectBuffer)->Apply(ArraySizes);
+
+static void BM_ScopedBytesRO_PooledBuffer(benchmark::State& state) {
+    JniPooledBuffer buffer;
+    if (jniAllocatePooledBuffer(gEnv, 4096, &buffer) != 0) {
+        state.SkipWithError("jniAllocatePooledBuffer failed");
+        return;
+    }
+    while (state.KeepRunning()) {
+        ScopedBytesRO bytes(gEnv, buffer);
+        benchmark::DoNotOptimize(bytes.get());
+    }
+    jniReleasePooledBuffer(gEnv, &buffer);
+}
+BENCHMARK(BM_ScopedBytesRO_PooledBuffer);
+
+// A transient direct buffer per operation: malloc'd, or from the pool.
+static void BM_TransientBuffer_Malloc(benchmark::State& state) {
+    const size_t capacity = state.range(0);
+    while (state.KeepRunning()) {
+        void* address = malloc(capacity);
+        jobject buffer = gEnv->NewDirectByteBuffer(address, capacity);
+        benchmark::DoNotOptimize(buffer);
+        gEnv->DeleteLocalRef(buffer);
+        free(address);
+    }
+}
+BENCHMARK(BM_TransientBuffer_Malloc)->Arg(512)->Arg(8192)->Arg(65536)->Arg(1 << 20);
+
+static void BM_TransientBuffer_Pooled(benchmark::State& state) {
+    const size_t capacity = state.range(0);
+    while (state.KeepRunning()) {
+        JniPooledBuffer buffer;
+        if (jniAllocatePooledBuffer(gEnv, capacity, &buffer) != 0) {
+            state.SkipWithError("jniAllocatePooledBuffer failed");
+            return;
+        }
+        benchmark::DoNotOptimize(buffer.buffer);
+        jniReleasePooledBuffer(gEnv, &buffer);
+    }
+}
+BENCHMARK(BM_TransientBuffer_Pooled)->Arg(512)->Arg(8192)->Arg(65536)->Arg(1 << 20);
+
+// Strings are built from a repeating code unit so that the encoding, not the
+// content, determines the modified UTF-8 size: ASCII is one byte per char,
+// Latin-1 supplement two, CJK three.
+enum StringEncoding {
+    kAscii,
+    kLatin1,
+    kCjk,
+};
+
+static const jchar kEncodingChars[] = { 'a', 0xe9, 0x4e2d };
+static const char* const kEncodingNames[] = { "ascii", "latin1", "cjk" };
+
+static jstring NewTestString(JNIEnv* env, StringEncoding encoding, jsize length) {
+    std::vector<jchar> chars(length, kEncodingChars[encoding]);
+    return env->NewString(length > 0 ? &chars[0] : NULL, length);
+}
+
+static void StringArgs(benchmark::internal::Benchmark* b) {
+    const int lengths[] = { 8, 64, 512, 4096, 65536 };
+    for (int encoding = kAscii; encoding <= kCjk; ++encoding) {
+        for (size_t i = 0; i < NELEM(lengths); ++i) {
+            b->Args({ lengths[i], encoding });
+        }
+    }
+}
+
+static size_t ByteSize(const ScopedUtfChars& chars) {
+    return chars.size();
+}
+
+static size_t ByteSize(const ScopedStringChars& chars) {
+    return chars.size() * sizeof(jchar);
+}
+
+template<typename Scoped>
+static void BM_ScopedString(benchmark::State& state) {
+    const jsize length = state.range(0);
+    const StringEncoding encoding = static_cast<StringEncoding>(state.range(1));
+    ScopedLocalRef<jstring> string(gEnv, NewTestString(gEnv, encoding, length));
+    size_t bytes = 0;
+    while (state.KeepRunning()) {
+        Scoped scoped(gEnv, string.get());
+        bytes = ByteSize(scoped);
+        benchmark::DoNotOptimize(bytes);
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetLabel(kEncodingNames[encoding]);
+}
+
+// ScopedUtfChars::size() is a strlen, so it is part of what callers pay.
+BENCHMARK_TEMPLATE(BM_ScopedString, ScopedUtfChars)->Apply(StringArgs);
+BENCHMARK_TEMPLATE(BM_ScopedString, ScopedStringChars)->Apply(StringArgs);
+
+int main(int argc, char** argv) {
+    JavaVM* vm;
+    if (!StartBenchmarkVm(&argc, argv, &vm, &gEnv)) {
+        return EXIT_FAILURE;
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return EXIT_FAILURE;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return EXIT_SUCCESS;
+}
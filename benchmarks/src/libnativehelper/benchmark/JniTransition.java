@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package libnativehelper.benchmark;
+
+import java.io.FileDescriptor;
+
+/**
+ * Java half of JniTransition_benchmark. The natives are registered by the
+ * benchmark binary through jniRegisterNativeMethods; {@link #run} is called
+ * from native code and loops in Java so that every iteration is a full
+ * Java-to-native-to-Java round trip.
+ */
+public final class JniTransition {
+    // Keep in sync with the Scenario enum in JniTransition_benchmark.cpp.
+    private static final int NOOP = 0;
+    private static final int THROW_EXCEPTION = 1;
+    private static final int CREATE_FILE_DESCRIPTOR = 2;
+    private static final int TO_STRING_ARRAY = 3;
+    private static final int LOG_EXCEPTION = 4;
+
+    private static final Throwable LOGGED = new RuntimeException("logged by JniTransition");
+
+    // Sinks so the results stay live.
+    private static FileDescriptor lastFd;
+    private static String[] lastStrings;
+
+    private JniTransition() {
+    }
+
+    private static native void noop();
+    private static native void throwException();
+    private static native FileDescriptor createFileDescriptor(int fd);
+    private static native String[] toStringArray();
+    private static native void logException(Throwable t);
+
+    public static void run(int scenario, int iterations) {
+        switch (scenario) {
+            case NOOP:
+                for (int i = 0; i < iterations; ++i) {
+                    noop();
+                }
+                break;
+            case THROW_EXCEPTION:
+                for (int i = 0; i < iterations; ++i) {
+                    try {
+                        throwException();
+                    } catch (IllegalStateException expected) {
+                    }
+                }
+                break;
+            case CREATE_FILE_DESCRIPTOR:
+                for (int i = 0; i < iterations; ++i) {
+                    lastFd = createFileDescriptor(i);
+                }
+                break;
+            case TO_STRING_ARRAY:
+                for (int i = 0; i < iterations; ++i) {
+                    lastStrings = toStringArray();
+                }
+                break;
+            case LOG_EXCEPTION:
+                for (int i = 0; i < iterations; ++i) {
+                    logException(LOGGED);
+                }
+                break;
+            default:
+                throw new IllegalArgumentException("unknown scenario " + scenario);
+        }
+    }
+}
@@ -27,6 +27,7 @@
 
 #include "jni.h"
 #include <errno.h>
+#include <stdint.h>
 #include <unistd.h>
 
 #ifndef NELEM
@@ -109,6 +110,45 @@ jobject jniGetReferent(C_JNIEnv* env, jobject ref);
  */
 void jniLogException(C_JNIEnv* env, int priority, const char* tag, jthrowable exception);
 
+/*
+ * Counters kept by the helpers since the library was loaded. Threads count
+ * into their own shards, which jniHelpGetStats sums, so the values are not a
+ * consistent snapshot while other threads are using the helpers.
+ */
+typedef struct {
+    uint64_t exceptionsThrown;            /* by jniThrowException and friends */
+    uint64_t pendingExceptionsDiscarded;  /* cleared to throw another */
+    uint64_t stackTracesFormatted;        /* by jniLogException */
+    uint64_t nativeMethodsRegistered;     /* by jniRegisterNativeMethods */
+    uint64_t fileDescriptorsCreated;      /* by jniCreateFileDescriptor */
+    uint64_t constantsGlobalRefs;         /* held by JniConstants */
+    uint64_t arrayBytesCopied;            /* acquired by the Scoped* helpers as copies */
+    uint64_t arrayBytesPinned;            /* acquired by the Scoped* helpers in place */
+} JniHelpStats;
+
+/*
+ * The array byte counts cover the helpers that know an array's length
+ * without asking for it; ScopedXxxArrayRW and ScopedBytes count an array
+ * only if their size() was called.
+ */
+
+void jniHelpGetStats(JniHelpStats* stats);
+
+/*
+ * Calls visit once per exception class thrown by jniThrowException, with the
+ * class name as passed to it and the number of exceptions thrown. Classes
+ * past the first 255, or with names of 124 bytes or more, are counted
+ * together as "(other)".
+ */
+void jniHelpGetExceptionCounts(void (*visit)(const char* className, uint64_t count, void* context),
+                               void* context);
+
+/*
+ * Accounts for array bytes made available to native code; used by the
+ * Scoped* helpers.
+ */
+void jniHelpCountArrayBytes(size_t bytes, jboolean isCopy);
+
 #ifdef __cplusplus
 }
 #endif
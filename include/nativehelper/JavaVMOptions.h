@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JAVA_VM_OPTIONS_H_included
+#define JAVA_VM_OPTIONS_H_included
+
+#include <jni.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Builds the JavaVMInitArgs for JNI_CreateJavaVM, typically one exported by
+// JniInvocation:
+//
+//   JavaVMOptions options;
+//   options.LoadFile("/system/etc/launcher.options");
+//   options.Add("-Xmx256m");
+//   std::string error;
+//   if (!options.Validate(&error)) ...
+//   options.CreateJavaVM(&vm, &env, "/data/local/tmp/launcher.startup");
+//
+// An option replaces an earlier one with the same key, which is "-Dname=" for
+// system properties, "-Xms", "-Xmx", "-Xss" and "-Xmn" for the sizes, the
+// prefix through '=' for other "name=value" options, and the whole string
+// otherwise, so that repeatable options such as -Xplugin: or -verbose: are
+// only deduplicated when identical. The replacement takes the position of
+// the later option.
+//
+// Option strings live in a single arena owned by this object, or in a
+// read-only mapping of a blob written by WriteBlob, which a launcher can load
+// without parsing or copying.
+class JavaVMOptions {
+ public:
+  JavaVMOptions();
+
+  ~JavaVMOptions();
+
+  // Adds an option. extra_info is passed through for the "vfprintf", "exit"
+  // and "abort" hooks, which require it.
+  void Add(const char* option, void* extra_info = NULL);
+
+  // Adds the options in a text file, one per line. Blank lines and lines
+  // starting with '#' are ignored and surrounding whitespace is trimmed.
+  bool LoadFile(const char* path);
+
+  // Maps a file written by WriteBlob and adds its options, which are used
+  // in place. Only one blob can be loaded into an instance.
+  bool LoadBlob(const char* path);
+
+  // Writes the current options, minus any hooks, in the format read by
+  // LoadBlob.
+  bool WriteBlob(const char* path) const;
+
+  // Checks that every option is well formed: non-empty, starting with '-'
+  // unless it is a hook with its extra_info set, free of control
+  // characters, and with a valid size for -Xms, -Xmx, -Xss and -Xmn. On
+  // failure, describes the first problem in error if it is non-null.
+  bool Validate(std::string* error) const;
+
+  size_t size() const {
+    return entries_.size();
+  }
+
+  // Returns the i-th option string.
+  const char* Get(size_t i) const;
+
+  // Returns arguments for JNI_CreateJavaVM. They refer to this object and
+  // stay valid until it is modified or destroyed.
+  const JavaVMInitArgs* GetInitArgs(jint version = JNI_VERSION_1_6,
+                                    bool ignore_unrecognized = false);
+
+  // Identifies the option set: a 64-bit FNV-1a hash of the options in order.
+  uint64_t Fingerprint() const;
+
+  // Calls JNI_CreateJavaVM with these options. If stats_path is non-null
+  // and the VM starts, the startup time is recorded there against
+  // Fingerprint().
+  jint CreateJavaVM(JavaVM** p_vm, JNIEnv** p_env, const char* stats_path = NULL);
+
+  // Records a startup time for an option set in stats_path, a text file of
+  // "fingerprint best_ns" lines that keeps the fastest time for each set.
+  static bool RecordStartup(const char* stats_path, uint64_t fingerprint, uint64_t ns);
+
+  // Finds the option set with the fastest recorded startup in stats_path.
+  static bool GetFastestStartup(const char* stats_path, uint64_t* fingerprint, uint64_t* ns);
+
+ private:
+  struct Entry {
+    // Offset of the NUL-terminated string in the arena, or in the blob.
+    size_t offset;
+    bool in_blob;
+    void* extra_info;
+  };
+
+  const char* String(const Entry& entry) const;
+
+  void AddEntry(const Entry& entry);
+
+  std::vector<char> arena_;
+  std::vector<Entry> entries_;
+  const char* blob_;
+  size_t blob_size_;
+  std::vector<JavaVMOption> options_;
+  JavaVMInitArgs init_args_;
+
+  // Disallow copy and assignment.
+  JavaVMOptions(const JavaVMOptions&);
+  void operator=(const JavaVMOptions&);
+};
+
+#endif  // JAVA_VM_OPTIONS_H_included
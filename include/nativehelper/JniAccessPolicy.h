@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Access strategy selection for the views in ScopedArrayView.h.
+ *
+ * A view reaches array or string data in one of three ways: a region copy
+ * into a buffer inside the view, Get<Type>ArrayElements/GetStringChars, or
+ * critical access. Which is cheapest depends on the runtime (whether it
+ * pins or copies), the size, and the caller. Each call site declares a
+ * JniAccessSite; under the adaptive policy (the default) a site tries each
+ * strategy it is eligible for a few times per size class, then uses the one
+ * with the lowest measured acquire plus release time, retrying the others
+ * now and then as conditions change. Measurement costs four clock reads per
+ * view.
+ *
+ * Building with -DNATIVEHELPER_FIXED_ACCESS_POLICY compiles the views down to
+ * the Scoped*ArrayRO rule (a region copy if it fits the view's buffer, else
+ * the elements) with no selection or telemetry, for builds that must behave
+ * the same on every run. At run time, jniSetAccessPolicy selects the same
+ * fixed rule or forces one strategy.
+ */
+#ifndef NATIVEHELPER_JNIACCESSPOLICY_H_
+#define NATIVEHELPER_JNIACCESSPOLICY_H_
+
+#include "jni.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    kJniAccessRegion,
+    kJniAccessElements,
+    kJniAccessCritical,
+    kJniAccessStrategyCount,
+} JniAccessStrategy;
+
+typedef enum {
+    kJniAccessAdaptive,
+    kJniAccessFixed,
+    kJniAccessForceRegion,
+    kJniAccessForceElements,
+    kJniAccessForceCritical,
+} JniAccessPolicy;
+
+/*
+ * Flags describing how a view is used. Critical access is only considered
+ * for views declared JNI_ACCESS_NO_JNI_CALLS: the caller makes no JNI calls
+ * and does not block while the view is alive.
+ */
+#define JNI_ACCESS_READ_ONLY 0x1
+#define JNI_ACCESS_NO_JNI_CALLS 0x2
+
+/* Size classes: up to 256 bytes, 4KiB, 64KiB, and larger. */
+#define JNI_ACCESS_SIZE_CLASSES 4
+
+typedef struct {
+    uint64_t calls;
+    uint64_t ns;      /* Acquire plus release. */
+    uint64_t copies;  /* Acquisitions the runtime reported as copies. */
+} JniAccessStats;
+
+/*
+ * Per call site state. Declare one static instance per site with
+ * JNI_ACCESS_SITE; it registers itself for reporting on first use. Counts
+ * are updated without locks and are approximate under contention; they are
+ * halved once a strategy reaches 1024 calls so that recent behavior
+ * dominates.
+ */
+typedef struct JniAccessSite {
+    const char* name;
+    struct JniAccessSite* next;
+    int registered;
+    JniAccessStats stats[JNI_ACCESS_SIZE_CLASSES][kJniAccessStrategyCount];
+} JniAccessSite;
+
+#define JNI_ACCESS_SITE(name) { (name), NULL, 0, { { { 0, 0, 0 } } } }
+
+void jniSetAccessPolicy(JniAccessPolicy policy);
+
+/*
+ * Picks the strategy for a view of the given size at site. regionFits says
+ * whether the data fits the view's buffer. If the choice is to be measured,
+ * *startNs is set to the current time, else to 0.
+ */
+JniAccessStrategy jniAccessChoose(JniAccessSite* site, size_t bytes, int flags,
+                                  int regionFits, uint64_t* startNs);
+
+/* Records a measured view: its strategy, size, isCopy and total time. */
+void jniAccessRecord(JniAccessSite* site, JniAccessStrategy strategy, size_t bytes,
+                     jboolean isCopy, uint64_t ns);
+
+/* Monotonic nanoseconds, as used for measurements. */
+uint64_t jniAccessNow(void);
+
+/* Calls visit for each site that has recorded a measurement. */
+void jniGetAccessSites(void (*visit)(const JniAccessSite* site, void* context),
+                       void* context);
+
+/* Logs each site's per-strategy mean times, call counts and copy rates. */
+void jniLogAccessSites(int priority, const char* tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* NATIVEHELPER_JNIACCESSPOLICY_H_ */
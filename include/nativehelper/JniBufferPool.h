@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A pool of native memory for transient direct ByteBuffers, for I/O paths
+ * that would otherwise allocate and free a buffer per operation.
+ *
+ * Requests are rounded up to a power-of-two size class from 512 bytes to
+ * 1MiB, and served from 2MiB slabs carved into blocks of one class. Each
+ * thread keeps a few free blocks of each class, so that an allocation and
+ * release on the same thread take no locks; the rest are shared. Slabs are
+ * kept for the life of the process, and may be backed by huge pages.
+ *
+ * A pooled buffer is a direct ByteBuffer over a block, created with
+ * NewDirectByteBuffer. It must be released explicitly, and neither Java nor
+ * native code may touch it afterwards: the block goes to the next caller,
+ * with its contents as they were.
+ *
+ * Not part of libnativehelper_compat_libc++, the NDK build.
+ */
+#ifndef NATIVEHELPER_JNIBUFFERPOOL_H_
+#define NATIVEHELPER_JNIBUFFERPOOL_H_
+
+#include "jni.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JNI_BUFFER_POOL_CLASSES 12
+#define JNI_BUFFER_POOL_MAX_SIZE (1 << 20)
+
+/* Flags for jniSetBufferPoolFlags. */
+#define JNI_BUFFER_POOL_HUGEPAGES 0x1  /* madvise new slabs for huge pages. */
+
+typedef struct {
+    jobject buffer;   /* A local reference to the direct ByteBuffer. */
+    void* address;
+    size_t capacity;  /* As requested; the block may be larger. */
+} JniPooledBuffer;
+
+typedef struct {
+    size_t blockSize;
+    uint64_t allocations;
+    uint64_t cacheHits;    /* Allocations served by the thread's own free blocks. */
+    uint64_t releases;
+    size_t slabs;
+    size_t sharedBlocks;   /* Free blocks not held by any thread. */
+} JniBufferPoolStats;
+
+/*
+ * Allocates a block of at least capacity bytes and a direct ByteBuffer of
+ * that capacity over it. Returns 0 and fills in *buffer on success;
+ * otherwise returns -1 with an exception pending: IllegalArgumentException
+ * for a capacity of 0 or over JNI_BUFFER_POOL_MAX_SIZE, OutOfMemoryError if
+ * the pool is exhausted.
+ */
+int jniAllocatePooledBuffer(JNIEnv* env, size_t capacity, JniPooledBuffer* buffer);
+
+/* Returns the block to the pool and deletes the local reference. */
+void jniReleasePooledBuffer(JNIEnv* env, const JniPooledBuffer* buffer);
+
+/*
+ * Returns the block behind a pooled ByteBuffer that Java hands back, such
+ * as one returned from an earlier native call. Returns 0, or -1 without
+ * throwing if the buffer is not a pooled one.
+ */
+int jniReleasePooledByteBuffer(JNIEnv* env, jobject buffer);
+
+/* Takes effect for slabs allocated from then on. */
+void jniSetBufferPoolFlags(int flags);
+
+/* Fills in one entry per size class, smallest first. */
+void jniGetBufferPoolStats(JniBufferPoolStats stats[JNI_BUFFER_POOL_CLASSES]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* NATIVEHELPER_JNIBUFFERPOOL_H_ */
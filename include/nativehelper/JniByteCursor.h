@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVEHELPER_JNIBYTECURSOR_H_
+#define NATIVEHELPER_JNIBYTECURSOR_H_
+
+#include "JNIHelp.h"
+#include "JniBytes.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Cursors that read and write big- and little-endian integers and floats at
+ * any alignment, for parsing and building binary formats in the bytes of a
+ * ScopedBytesRO/RW, a byte array view, or any other memory.
+ *
+ *   ScopedBytesRO bytes(env, packet);
+ *   JniByteReader in(bytes);
+ *   uint16_t type = in.readBE<uint16_t>();
+ *   uint32_t length = in.readBE<uint32_t>();
+ *   const uint8_t* payload = in.take(length);
+ *   if (!in.checkOrThrow(env)) {
+ *       return;
+ *   }
+ *
+ * Each access is a bounds check and a memcpy, which compilers turn into an
+ * unaligned load or store and, for the non-native order, a byte swap. A
+ * failed check moves the cursor to the end and makes ok() false, so that a
+ * sequence of reads can be checked once at the end; failed reads return 0.
+ * Cursors cover all of a ByteBuffer's capacity, whatever its position and
+ * limit.
+ */
+
+template<size_t size> struct JniByteOrderBits;
+template<> struct JniByteOrderBits<1> {
+    typedef uint8_t Type;
+    static uint8_t swap(uint8_t value) { return value; }
+    static void swap(void* out, const void* in, size_t count) { memcpy(out, in, count); }
+};
+template<> struct JniByteOrderBits<2> {
+    typedef uint16_t Type;
+    static uint16_t swap(uint16_t value) { return __builtin_bswap16(value); }
+    static void swap(void* out, const void* in, size_t count) { jniBytesSwap16(out, in, count); }
+};
+template<> struct JniByteOrderBits<4> {
+    typedef uint32_t Type;
+    static uint32_t swap(uint32_t value) { return __builtin_bswap32(value); }
+    static void swap(void* out, const void* in, size_t count) { jniBytesSwap32(out, in, count); }
+};
+template<> struct JniByteOrderBits<8> {
+    typedef uint64_t Type;
+    static uint64_t swap(uint64_t value) { return __builtin_bswap64(value); }
+    static void swap(void* out, const void* in, size_t count) { jniBytesSwap64(out, in, count); }
+};
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define JNI_BYTE_ORDER_NATIVE_BIG true
+#else
+#define JNI_BYTE_ORDER_NATIVE_BIG false
+#endif
+
+// Loads or stores a T (an integer, float or double) in the given byte order.
+template<typename T, bool bigEndian>
+inline T jniLoadUnaligned(const void* p) {
+    typedef JniByteOrderBits<sizeof(T)> Bits;
+    typename Bits::Type bits;
+    memcpy(&bits, p, sizeof(bits));
+    if (bigEndian != JNI_BYTE_ORDER_NATIVE_BIG) {
+        bits = Bits::swap(bits);
+    }
+    T value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+template<typename T, bool bigEndian>
+inline void jniStoreUnaligned(void* p, T value) {
+    typedef JniByteOrderBits<sizeof(T)> Bits;
+    typename Bits::Type bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (bigEndian != JNI_BYTE_ORDER_NATIVE_BIG) {
+        bits = Bits::swap(bits);
+    }
+    memcpy(p, &bits, sizeof(bits));
+}
+
+// Position and bounds shared by the reader and writer.
+class JniByteCursor {
+public:
+    size_t position() const { return mPosition; }
+    size_t size() const { return mSize; }
+    size_t remaining() const { return mSize - mPosition; }
+    bool ok() const { return mOk; }
+
+    bool seek(size_t position) {
+        if (position > mSize) {
+            return fail();
+        }
+        mPosition = position;
+        return true;
+    }
+
+    bool skip(size_t bytes) {
+        uint8_t* p;
+        return claim(bytes, &p);
+    }
+
+protected:
+    JniByteCursor(uint8_t* data, size_t size)
+    : mData(data), mSize(data != NULL ? size : 0), mPosition(0), mOk(true)
+    {
+    }
+
+    // Sets *p to where the next bytes are and advances past them.
+    bool claim(size_t bytes, uint8_t** p) {
+        if (__builtin_expect(bytes > mSize - mPosition, 0)) {
+            return fail();
+        }
+        *p = mData + mPosition;
+        mPosition += bytes;
+        return true;
+    }
+
+    bool claimArray(size_t count, size_t elementSize, uint8_t** p) {
+        if (count > (mSize - mPosition) / elementSize) {
+            return fail();
+        }
+        return claim(count * elementSize, p);
+    }
+
+    bool fail() {
+        mPosition = mSize;
+        mOk = false;
+        return false;
+    }
+
+    bool checkOrThrow(JNIEnv* env, const char* className) const {
+        if (!mOk) {
+            jniThrowException(env, className, NULL);
+        }
+        return mOk;
+    }
+
+private:
+    uint8_t* mData;
+    size_t mSize;
+    size_t mPosition;
+    bool mOk;
+};
+
+class JniByteReader : public JniByteCursor {
+public:
+    JniByteReader(const void* data, size_t size)
+    : JniByteCursor(static_cast<uint8_t*>(const_cast<void*>(data)), size)
+    {
+    }
+
+    // From anything with get() and size(), such as ScopedBytesRO.
+    template<typename View>
+    explicit JniByteReader(const View& view)
+    : JniByteCursor(reinterpret_cast<uint8_t*>(const_cast<void*>(
+                            static_cast<const void*>(view.get()))),
+                    view.size() * sizeof(*view.get()))
+    {
+    }
+
+    template<typename T> T readBE() { return read<T, true>(); }
+    template<typename T> T readLE() { return read<T, false>(); }
+
+    // Reads count elements into out, swapping them in bulk as needed.
+    template<typename T> bool readBE(T* out, size_t count) { return read<T, true>(out, count); }
+    template<typename T> bool readLE(T* out, size_t count) { return read<T, false>(out, count); }
+
+    bool read(void* out, size_t bytes) {
+        uint8_t* p;
+        if (!claim(bytes, &p)) {
+            return false;
+        }
+        memcpy(out, p, bytes);
+        return true;
+    }
+
+    // Returns the next bytes in place, or NULL if there are not that many.
+    const uint8_t* take(size_t bytes) {
+        uint8_t* p;
+        return claim(bytes, &p) ? p : NULL;
+    }
+
+    // Throws BufferUnderflowException and returns false if a read failed.
+    bool checkOrThrow(JNIEnv* env) const {
+        return JniByteCursor::checkOrThrow(env, "java/nio/BufferUnderflowException");
+    }
+
+private:
+    template<typename T, bool bigEndian>
+    T read() {
+        uint8_t* p;
+        return claim(sizeof(T), &p) ? jniLoadUnaligned<T, bigEndian>(p) : T();
+    }
+
+    template<typename T, bool bigEndian>
+    bool read(T* out, size_t count) {
+        uint8_t* p;
+        if (!claimArray(count, sizeof(T), &p)) {
+            return false;
+        }
+        if (bigEndian != JNI_BYTE_ORDER_NATIVE_BIG) {
+            JniByteOrderBits<sizeof(T)>::swap(out, p, count);
+        } else {
+            memcpy(out, p, count * sizeof(T));
+        }
+        return true;
+    }
+};
+
+class JniByteWriter : public JniByteCursor {
+public:
+    JniByteWriter(void* data, size_t size)
+    : JniByteCursor(static_cast<uint8_t*>(data), size)
+    {
+    }
+
+    // From anything with a non-const get() and size(), such as ScopedBytesRW.
+    template<typename View>
+    explicit JniByteWriter(View& view)
+    : JniByteCursor(reinterpret_cast<uint8_t*>(view.get()), view.size() * sizeof(*view.get()))
+    {
+    }
+
+    template<typename T> bool writeBE(T value) { return write<T, true>(value); }
+    template<typename T> bool writeLE(T value) { return write<T, false>(value); }
+
+    template<typename T> bool writeBE(const T* values, size_t count) {
+        return write<T, true>(values, count);
+    }
+    template<typename T> bool writeLE(const T* values, size_t count) {
+        return write<T, false>(values, count);
+    }
+
+    bool write(const void* data, size_t bytes) {
+        uint8_t* p;
+        if (!claim(bytes, &p)) {
+            return false;
+        }
+        memcpy(p, data, bytes);
+        return true;
+    }
+
+    // Throws BufferOverflowException and returns false if a write failed.
+    bool checkOrThrow(JNIEnv* env) const {
+        return JniByteCursor::checkOrThrow(env, "java/nio/BufferOverflowException");
+    }
+
+private:
+    template<typename T, bool bigEndian>
+    bool write(T value) {
+        uint8_t* p;
+        if (!claim(sizeof(T), &p)) {
+            return false;
+        }
+        jniStoreUnaligned<T, bigEndian>(p, value);
+        return true;
+    }
+
+    template<typename T, bool bigEndian>
+    bool write(const T* values, size_t count) {
+        uint8_t* p;
+        if (!claimArray(count, sizeof(T), &p)) {
+            return false;
+        }
+        if (bigEndian != JNI_BYTE_ORDER_NATIVE_BIG) {
+            JniByteOrderBits<sizeof(T)>::swap(p, values, count);
+        } else {
+            memcpy(p, values, count * sizeof(T));
+        }
+        return true;
+    }
+};
+
+#endif  // NATIVEHELPER_JNIBYTECURSOR_H_
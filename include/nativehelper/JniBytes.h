@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Byte kernels for natives that scan or transform the contents of a byte[]
+ * or direct ByteBuffer, typically through ScopedBytesRO or a byte array view.
+ *
+ * The checksum, hex, case and byte swap kernels are picked once per process
+ * for the CPU: SSE4.2 (with SSSE3) or AVX2 on x86, NEON on arm64. Searching
+ * and comparison use the C library's memchr and memcmp, which are already
+ * vectorized; base64 is table driven on every CPU.
+ */
+#ifndef NATIVEHELPER_JNIBYTES_H_
+#define NATIVEHELPER_JNIBYTES_H_
+
+#include "jni.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    kJniBytesScalar,
+    kJniBytesSse42,
+    kJniBytesAvx2,
+    kJniBytesNeon,
+} JniBytesIsa;
+
+/* The instruction set the kernels currently use. */
+JniBytesIsa jniBytesIsa(void);
+
+/*
+ * Switches to the kernels for isa, or for kJniBytesScalar if this CPU does
+ * not support it, and returns the one now in use. For tests and benchmarks;
+ * not safe to call while kernels are running on other threads.
+ */
+JniBytesIsa jniBytesSetIsa(JniBytesIsa isa);
+
+/* Returns the index of the first byte equal to value, or -1. */
+ptrdiff_t jniBytesIndexOf(const void* data, size_t size, uint8_t value);
+
+/* Returns 1 if the two ranges hold the same bytes, else 0. */
+int jniBytesEqual(const void* a, const void* b, size_t size);
+
+/*
+ * Checksums, chained like zlib's: pass 0 as crc (1 as adler) for the first
+ * block and the previous result for the next.
+ */
+uint32_t jniBytesCrc32c(uint32_t crc, const void* data, size_t size);
+uint32_t jniBytesAdler32(uint32_t adler, const void* data, size_t size);
+
+/* Writes 2 * size lowercase hex digits, without a terminator. */
+void jniBytesToHex(char* out, const void* data, size_t size);
+
+/*
+ * Decodes length hex digits of either case into length / 2 bytes. Returns
+ * the number of bytes written, or -1 if length is odd or a digit is invalid.
+ */
+ptrdiff_t jniBytesFromHex(void* out, const char* hex, size_t length);
+
+#define JNI_BASE64_ENCODED_SIZE(size) (((size) + 2) / 3 * 4)
+
+/*
+ * Writes the padded base64 (RFC 4648) encoding of data, without a
+ * terminator, and returns its length.
+ */
+size_t jniBytesToBase64(char* out, const void* data, size_t size);
+
+/*
+ * Decodes padded base64, writing at most length / 4 * 3 bytes. Returns the
+ * number of bytes written, or -1 if the input is not valid padded base64.
+ */
+ptrdiff_t jniBytesFromBase64(void* out, const char* base64, size_t length);
+
+/* Case-fold ASCII letters, leaving other bytes alone; out may equal in. */
+void jniBytesToLowerAscii(void* out, const void* in, size_t size);
+void jniBytesToUpperAscii(void* out, const void* in, size_t size);
+
+/*
+ * Reverse the byte order of each of count 2, 4 or 8 byte elements, which
+ * need not be aligned; out may equal in. See also JniByteCursor.h.
+ */
+void jniBytesSwap16(void* out, const void* in, size_t count);
+void jniBytesSwap32(void* out, const void* in, size_t count);
+void jniBytesSwap64(void* out, const void* in, size_t count);
+
+/*
+ * Returns a new String holding the hex or base64 encoding of data, encoded
+ * in scratch storage (see JniScratch.h), or NULL with an exception pending.
+ */
+jstring jniBytesToHexString(JNIEnv* env, const void* data, size_t size);
+jstring jniBytesToBase64String(JNIEnv* env, const void* data, size_t size);
+
+#ifdef __cplusplus
+}
+
+/*
+ * Overloads for anything with get() and size() in bytes, such as
+ * ScopedBytesRO or ScopedByteArrayRO.
+ */
+template<typename View>
+inline uint32_t jniBytesCrc32c(const View& bytes, uint32_t crc = 0) {
+    return jniBytesCrc32c(crc, bytes.get(), bytes.size());
+}
+
+template<typename View>
+inline uint32_t jniBytesAdler32(const View& bytes, uint32_t adler = 1) {
+    return jniBytesAdler32(adler, bytes.get(), bytes.size());
+}
+
+template<typename View>
+inline jstring jniBytesToHexString(JNIEnv* env, const View& bytes) {
+    return jniBytesToHexString(env, bytes.get(), bytes.size());
+}
+
+template<typename View>
+inline jstring jniBytesToBase64String(JNIEnv* env, const View& bytes) {
+    return jniBytesToBase64String(env, bytes.get(), bytes.size());
+}
+
+#endif
+
+#endif  /* NATIVEHELPER_JNIBYTES_H_ */
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JNI_CALL_RECORDER_H_included
+#define JNI_CALL_RECORDER_H_included
+
+#include "jni.h"
+
+#include <stdint.h>
+
+// Functions recorded by JniCallRecorder: those the helpers use, which are
+// the bulk of what natives built on them do. Values are part of the trace
+// format; append only.
+enum JniCallId {
+  kJniCallFindClass = 1,
+  kJniCallThrowNew = 2,
+  kJniCallNewObject = 3,
+  kJniCallIsInstanceOf = 4,
+  kJniCallDeleteLocalRef = 5,
+  kJniCallGetIntField = 6,
+  kJniCallSetIntField = 7,
+  kJniCallGetArrayLength = 8,
+  kJniCallGetArrayElements = 9,  // type: JniCallType; size: elements
+  kJniCallReleaseArrayElements = 10,  // type: JniCallType; size: elements
+  kJniCallGetArrayRegion = 11,  // type: JniCallType; size: elements
+  kJniCallGetPrimitiveArrayCritical = 12,  // size: elements
+  kJniCallReleasePrimitiveArrayCritical = 13,  // size: 0; no JNI calls allowed to find it
+  kJniCallNewStringUTF = 14,  // size: bytes
+  kJniCallGetStringUTFChars = 15,  // size: UTF-16 length
+  kJniCallReleaseStringUTFChars = 16,  // size: UTF-16 length
+  kJniCallGetStringChars = 17,  // size: UTF-16 length
+  kJniCallReleaseStringChars = 18,  // size: UTF-16 length
+  kJniCallGetStringCritical = 19,  // size: UTF-16 length
+  kJniCallReleaseStringCritical = 20,  // size: 0, as for arrays
+  kJniCallNewObjectArray = 21,  // size: elements
+  kJniCallSetObjectArrayElement = 22,
+  kJniCallGetDirectBufferAddress = 23,
+  kJniCallRegisterNatives = 24,  // size: methods
+  kJniCallIdCount
+};
+
+// Element types of the per-type array calls.
+enum JniCallType {
+  kJniCallTypeNone,
+  kJniCallTypeBoolean,
+  kJniCallTypeByte,
+  kJniCallTypeChar,
+  kJniCallTypeShort,
+  kJniCallTypeInt,
+  kJniCallTypeLong,
+  kJniCallTypeFloat,
+  kJniCallTypeDouble,
+};
+
+// Records the JNI calls made through an env into a compact binary trace, for
+// replay with benchmarks/JniReplay against a fake or real runtime.
+//
+//   JniCallRecorder::Start("/data/local/tmp/jni.trace");
+//   JniCallRecorder::Attach(env);
+//   ... natives run ...
+//   JniCallRecorder::Detach(env);
+//   JniCallRecorder::Stop();
+//
+// Attach swaps env->functions for a copy of the runtime's table in which the
+// functions listed in JniCallId are wrapped; every other entry is the
+// runtime's own. Each wrapped call records its id, element type, size (see
+// JniCallId) and duration. Records are gathered per thread and written a
+// block at a time, so a call costs two clock reads and an uncontended lock
+// of the thread's own buffer; inside a critical region a thread holds off
+// writing until its buffer is full. This still perturbs fine-grained
+// timings: the trace is meant to capture the call mix.
+//
+// Trace format: the bytes "JNIT", a version byte (2), then blocks of one
+// thread's calls: the thread id and the block's length in bytes as unsigned
+// LEB128, then one record per call, in the order the thread made them: id
+// and type as one byte each, then size and duration in nanoseconds as
+// unsigned LEB128. Blocks of different threads are in the order they were
+// written, which only roughly follows the order of the calls in them.
+class JniCallRecorder {
+ public:
+  // Starts a trace at path, replacing any file there. Fails if a trace is
+  // already being recorded.
+  static bool Start(const char* path);
+
+  // Routes env's calls through the recorder. All attached envs must share
+  // one function table, as they do in a runtime without CheckJNI.
+  static bool Attach(JNIEnv* env);
+
+  // Restores env's original function table.
+  static void Detach(JNIEnv* env);
+
+  // Writes out every thread's pending records, ends the trace and closes the
+  // file. Envs still attached keep working but are no longer recorded.
+  // Returns the number of calls recorded.
+  static uint64_t Stop();
+
+ private:
+  JniCallRecorder();
+};
+
+#endif  // JNI_CALL_RECORDER_H_included
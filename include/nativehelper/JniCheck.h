@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Light checks: cheap misuse detection in the JNIHelp functions and the
+ * Scoped helpers, meant to stay on where CheckJNI would be too slow.
+ *
+ * When enabled, each helper entry point checks that
+ *   - the JNIEnv belongs to the calling thread. The env last seen on this
+ *     thread is kept in thread-local state, so the usual cost is a TLS
+ *     lookup, a load and a compare; a different env is verified through
+ *     JavaVM::GetEnv before being accepted.
+ *   - no critical region opened by ScopedPrimitiveArrayCritical or
+ *     ScopedStringCritical is open on this thread.
+ * It also tracks a per-thread high-water mark of the local references held
+ * by ScopedLocalRef, and reports once per thread when it passes a limit.
+ * References that native code creates and holds without the helpers are
+ * invisible to this.
+ *
+ * Failures are logged with the helper's name and counted; they abort only if
+ * requested. With the checks off (the default), each entry point pays one
+ * load and branch.
+ */
+#ifndef NATIVEHELPER_JNICHECK_H_
+#define NATIVEHELPER_JNICHECK_H_
+
+#include "jni.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Non-zero while the checks are on. Read directly by the helpers. */
+extern int jniLightCheckEnabled;
+
+/* Turns the checks on or off; any thread, at any time. */
+void jniSetLightCheck(int enabled);
+
+/* Makes failures abort instead of only being logged. */
+void jniSetLightCheckAbort(int abortOnFailure);
+
+/* ScopedLocalRef-held references per thread above which a warning is logged. */
+void jniSetLightCheckLocalRefLimit(int limit);
+
+/* Number of failures reported since the library was loaded. */
+uint64_t jniLightCheckFailures(void);
+
+/* The calling thread's high-water mark of ScopedLocalRef-held references. */
+int jniLightCheckLocalRefHighWater(void);
+
+/* Hooks used by the helpers while the checks are on. */
+void jniLightCheckEntry(C_JNIEnv* env, const char* function);
+void jniLightCheckCriticalEnter(void);
+void jniLightCheckCriticalExit(void);
+void jniLightCheckLocalRef(int delta);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define JNI_LIGHT_CHECK_ENABLED() __builtin_expect(jniLightCheckEnabled != 0, 0)
+
+#if defined(__cplusplus)
+inline void jniLightCheckEntry(JNIEnv* env, const char* function) {
+    jniLightCheckEntry(&env->functions, function);
+}
+#endif
+
+/* Checks a helper entry point; env may be a JNIEnv* or, in C, a C_JNIEnv*. */
+#define JNI_LIGHT_CHECK(env, function) \
+    do { \
+        if (JNI_LIGHT_CHECK_ENABLED()) { \
+            jniLightCheckEntry(env, function); \
+        } \
+    } while (0)
+
+#endif  /* NATIVEHELPER_JNICHECK_H_ */
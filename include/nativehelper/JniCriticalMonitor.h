@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Hold-time monitor for the critical-access helpers
+ * (ScopedPrimitiveArrayCritical and ScopedStringCritical).
+ *
+ * While a native holds a critical region the runtime may be unable to run
+ * the GC, so long holds show up as pause-time spikes elsewhere. Once a
+ * threshold is set, the helpers timestamp acquire and release, and every
+ * hold at or above the threshold is counted in a log2 histogram and against
+ * the code that acquired it. Below the threshold a hold costs two clock reads
+ * and a call; with the monitor off (the default) it costs one load.
+ */
+#ifndef NATIVEHELPER_JNICRITICALMONITOR_H_
+#define NATIVEHELPER_JNICRITICALMONITOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * For the helpers' constructors, which must be inlined into the code that
+ * declares the helper for jniCriticalMonitorSite to see it.
+ */
+#define JNI_CRITICAL_ALWAYS_INLINE __attribute__((always_inline))
+
+/* Histogram bucket i counts holds of [2^i, 2^(i+1)) ns. */
+#define JNI_CRITICAL_HISTOGRAM_BUCKETS 64
+
+/*
+ * Holds at least this long, in nanoseconds, are recorded; 0 turns the
+ * monitor off. Read directly by the helpers; set it with
+ * jniSetCriticalHoldThreshold.
+ */
+extern uint64_t jniCriticalHoldThresholdNs;
+
+void jniSetCriticalHoldThreshold(uint64_t ns);
+
+/* Monotonic nanoseconds, as used for hold start times. */
+uint64_t jniCriticalMonitorNow(void);
+
+/*
+ * Returns its own return address. Called by the helpers on acquire, from an
+ * inlined constructor, to get an address in the function holding the region.
+ */
+const void* jniCriticalMonitorSite(void);
+
+/* Called by the helpers on release of a hold that started at startNs. */
+void jniCriticalMonitorRecord(const void* site, uint64_t startNs, size_t bytes);
+
+/* Copies the histogram of recorded holds into buckets. */
+void jniGetCriticalHoldHistogram(uint64_t buckets[JNI_CRITICAL_HISTOGRAM_BUCKETS]);
+
+/*
+ * Calls visit for each site with recorded holds: the acquire address, the
+ * nearest symbol if dladdr can find one (else NULL), the number of holds, and
+ * the longest hold with its size in bytes. Returns the number of holds that
+ * could not be attributed because the site table was full.
+ */
+uint64_t jniGetCriticalHoldSites(void (*visit)(const void* site, const char* symbol,
+                                               uint64_t count, uint64_t maxNs,
+                                               size_t maxBytes, void* context),
+                                 void* context);
+
+/* Logs the histogram and sites at the given priority. */
+void jniLogCriticalHolds(int priority, const char* tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* NATIVEHELPER_JNICRITICALMONITOR_H_ */
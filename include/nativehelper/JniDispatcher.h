@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Delivers native events to a Java method in batches, one call per batch
+ * instead of one per event.
+ *
+ * Events are fixed-size records that any native thread posts, attached or
+ * not. They queue in a multi-producer JniRingBuffer, without locks, and a
+ * dispatcher thread attached to the VM collects them into a batch and calls
+ * the Java method with it:
+ *
+ *   void onEvents(ByteBuffer events, int count)  // JNI_DISPATCH_BUFFER
+ *   void onEvents(long[] events, int count)      // JNI_DISPATCH_LONG_ARRAY
+ *
+ * The events are packed back to back in the platform's byte order. The
+ * buffer or array is reused for every batch, so Java must not keep it past
+ * the call. A batch is delivered when it is full, when its first event has
+ * waited maxLatencyNs, or when jniDispatcherFlush asks for it. If Java falls
+ * so far behind that queueBatches batches are waiting, posting blocks until
+ * there is room, or with JNI_DISPATCH_DROP_WHEN_FULL drops the event. The
+ * Java method's own posts are dropped rather than wait for themselves.
+ *
+ * Exceptions thrown by the Java method are logged and cleared; delivery goes
+ * on with the next batch.
+ *
+ * Not part of libnativehelper_compat_libc++, the NDK build.
+ */
+#ifndef NATIVEHELPER_JNIDISPATCHER_H_
+#define NATIVEHELPER_JNIDISPATCHER_H_
+
+#include "jni.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JNI_DISPATCH_BUFFER 0x0
+#define JNI_DISPATCH_LONG_ARRAY 0x1
+#define JNI_DISPATCH_DROP_WHEN_FULL 0x2
+
+/* Result of jniDispatcherPost when the event was not queued. */
+#define JNI_DISPATCH_DROPPED (-1)
+
+typedef struct {
+    size_t eventSize;       /* Bytes; a multiple of 8 for JNI_DISPATCH_LONG_ARRAY. */
+    size_t maxBatch;        /* Events per call at most. */
+    uint64_t maxLatencyNs;  /* How long an event may wait for its batch to fill. */
+    size_t queueBatches;    /* Batches that may wait before posting is held back. */
+    int flags;
+} JniDispatcherOptions;
+
+typedef struct {
+    uint64_t posted;
+    uint64_t dropped;
+    uint64_t stalls;         /* Posts that had to wait for room. */
+    uint64_t delivered;      /* Events passed to Java. */
+    uint64_t batches;
+    uint64_t fullBatches;    /* Batches delivered because they were full, */
+    uint64_t lateBatches;    /* because of maxLatencyNs, */
+    uint64_t flushedBatches; /* or because of a flush. */
+    uint64_t exceptions;
+} JniDispatcherStats;
+
+typedef struct JniDispatcher JniDispatcher;
+
+/*
+ * Starts a dispatcher that calls methodName on target, which is kept with a
+ * global reference. Returns NULL with an exception pending if the options
+ * are bad, the method does not exist, or the thread cannot be started.
+ */
+JniDispatcher* jniDispatcherCreate(JNIEnv* env, jobject target, const char* methodName,
+                                   const JniDispatcherOptions* options);
+
+/* Queues a copy of the eventSize bytes at event. Returns 0 or JNI_DISPATCH_DROPPED. */
+int jniDispatcherPost(JniDispatcher* dispatcher, const void* event);
+
+/*
+ * Returns once every event posted before the call has been delivered.
+ * Returns -1 at once if called from the Java method itself, else 0.
+ */
+int jniDispatcherFlush(JniDispatcher* dispatcher);
+
+/*
+ * Delivers what is queued, stops the thread, deletes the global references
+ * and frees the dispatcher. No thread may post to it any more.
+ */
+void jniDispatcherDestroy(JniDispatcher* dispatcher);
+
+void jniDispatcherGetStats(JniDispatcher* dispatcher, JniDispatcherStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* NATIVEHELPER_JNIDISPATCHER_H_ */
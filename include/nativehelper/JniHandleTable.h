@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Handles for native peers of Java objects, to keep in a long field instead
+ * of a raw pointer. A handle that outlives its peer is recognized and
+ * rejected, rather than dereferenced after the peer is freed.
+ *
+ * A handle packs a slot index (low 32 bits) with the slot's generation (high
+ * 32 bits), which changes every time the slot is freed. Resolving a handle
+ * takes no locks: it finds the slot and checks the generation. Slots live in
+ * chunks that are never freed or moved while the table exists, four to a
+ * cache line. Each thread keeps a few free slots per table, so adding and
+ * removing on the same thread seldom takes the table's lock. A slot whose
+ * generation would wrap is retired instead of reused. No valid handle is 0,
+ * so 0 can mean "no peer" in Java.
+ *
+ * The table only tells live handles from stale ones. Making sure that no
+ * thread is still using a peer when another removes it and frees it is up
+ * to the caller, as it would be with raw pointers.
+ */
+#ifndef NATIVEHELPER_JNIHANDLETABLE_H_
+#define NATIVEHELPER_JNIHANDLETABLE_H_
+
+#include "jni.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JNI_HANDLE_TABLE_MAX_HANDLES (1 << 24)
+
+typedef struct JniHandleTable JniHandleTable;
+
+/*
+ * Creates a table for up to maxHandles live handles. Returns NULL with an
+ * exception pending if maxHandles is 0 or more than
+ * JNI_HANDLE_TABLE_MAX_HANDLES, or if out of memory.
+ */
+JniHandleTable* jniHandleTableCreate(JNIEnv* env, size_t maxHandles);
+
+/*
+ * Frees the table. No thread may use it during or after the call, nor exit
+ * during the call having used it. Each thread that used it frees its cache
+ * of the table's slots the next time it uses another table, or at exit.
+ */
+void jniHandleTableDestroy(JniHandleTable* table);
+
+/*
+ * Returns a new handle for pointer, which must not be NULL. Returns 0 with an
+ * exception pending if the table is full.
+ */
+jlong jniHandleTableAdd(JNIEnv* env, JniHandleTable* table, void* pointer);
+
+/* Returns the pointer behind handle, or NULL if handle is stale or was never valid. */
+void* jniHandleTableGet(const JniHandleTable* table, jlong handle);
+
+/* Like jniHandleTableGet, but throws IllegalStateException when returning NULL. */
+void* jniHandleTableResolve(JNIEnv* env, const JniHandleTable* table, jlong handle);
+
+/*
+ * Makes handle stale and returns the pointer it had, for the caller to free.
+ * Returns NULL if it was already stale, so of several threads removing the
+ * same handle only one gets the pointer.
+ */
+void* jniHandleTableRemove(JniHandleTable* table, jlong handle);
+
+/* Live handles. */
+size_t jniHandleTableSize(JniHandleTable* table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* NATIVEHELPER_JNIHANDLETABLE_H_ */
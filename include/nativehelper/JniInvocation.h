@@ -18,6 +18,11 @@
 #define JNI_INVOCATION_H_included
 
 #include <jni.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
 
 // JniInvocation adds a layer of indirection for applications using
 // the JNI invocation API to allow the JNI implementation to be
@@ -25,7 +30,10 @@
 // be used by calling InitJniInvocation. If this is not done, the
 // library will chosen based on the value of Android system property
 // persist.sys.dalvik.vm.lib on the device, and otherwise fall back to
-// a hard-coded default implementation.
+// a hard-coded default implementation. On the host, the library is
+// taken from the JNI_INVOCATION_LIBRARY environment variable, or else
+// from the first entry of the file named by JNI_INVOCATION_CONFIG,
+// which lists one runtime library per line ('#' starts a comment).
 class JniInvocation {
  public:
   JniInvocation();
@@ -41,11 +49,58 @@ class JniInvocation {
   // Exposes which library is actually loaded from the given name. The
   // buffer of size PROPERTY_VALUE_MAX will be used to load the system
   // property for the default library, if necessary. If no buffer is
-  // provided, the fallback value will be used.
+  // provided, the fallback value will be used. On the host the buffer
+  // receives the JNI_INVOCATION_CONFIG entry instead.
   static const char* GetLibrary(const char* library, char* buffer);
 
+  // As above, with a buffer of buffer_size bytes. On the host, config
+  // entries that do not fit are skipped with a warning; on the device, a
+  // buffer smaller than PROPERTY_VALUE_MAX is not used.
+  static const char* GetLibrary(const char* library, char* buffer, size_t buffer_size);
+
+  // Returns the runtime libraries that could be selected, most preferred
+  // first and without duplicates: on the host JNI_INVOCATION_LIBRARY, the
+  // entries of JNI_INVOCATION_CONFIG, and the fallback; on the device the
+  // library GetLibrary would choose. Use this with ValidateLibrary to run
+  // the same binary against several runtimes.
+  static std::vector<std::string> GetCandidateLibraries();
+
+  // Checks that library can be loaded and exports the JNI invocation API,
+  // without creating a VM. On failure, describes the problem in error if it
+  // is non-null.
+  static bool ValidateLibrary(const char* library, std::string* error);
+
+  // Wall-clock durations, in nanoseconds, of the phases of VM bring-up.
+  // Phases that have not run yet are zero.
+  struct InitTimings {
+    // GetLibrary, plus locating the file when prefetching.
+    uint64_t resolve_library_ns;
+    // Starting reads of the library file ahead of dlopen, if enabled.
+    uint64_t prefetch_ns;
+    // dlopen: mapping, relocation with RTLD_NOW, and constructors.
+    uint64_t dlopen_ns;
+    // Looking up the three invocation API entry points.
+    uint64_t find_symbols_ns;
+    // The runtime's JNI_CreateJavaVM.
+    uint64_t create_java_vm_ns;
+  };
+
+  const InitTimings& GetInitTimings() const {
+    return timings_;
+  }
+
+  // If enabled, reads of the runtime library's file into the page cache are
+  // started before dlopen, so that relocation and constructors mostly fault
+  // in pages from memory instead of issuing small random reads. Off by
+  // default; must be set before Init.
+  void SetPrefetchLibrary(bool prefetch) {
+    prefetch_library_ = prefetch;
+  }
+
  private:
 
+  void PrefetchLibrary(const char* library);
+
   bool FindSymbol(void** pointer, const char* symbol);
 
   static JniInvocation& GetJniInvocation();
@@ -57,6 +112,8 @@ class JniInvocation {
   static JniInvocation* jni_invocation_;
 
   void* handle_;
+  bool prefetch_library_;
+  InitTimings timings_;
   jint (*JNI_GetDefaultJavaVMInitArgs_)(void*);
   jint (*JNI_CreateJavaVM_)(JavaVM**, JNIEnv**, void*);
   jint (*JNI_GetCreatedJavaVMs_)(JavaVM**, jsize, jsize*);
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A set of Java listeners, held by global references, that many threads can
+ * call out to at once without locks.
+ *
+ * Emitting threads iterate over an immutable snapshot of the set, announcing
+ * themselves in one of a few per-registry counters on the way in and out.
+ * Adding or removing a listener, which is expected to be rare, publishes a
+ * new snapshot under a lock and retires the old one. A removed listener's
+ * global reference is deleted, and the old snapshot freed, only once every
+ * iteration that started before the removal has finished. So a listener may
+ * still be called once after jniListenerRegistryRemove returns, by an
+ * iteration already under way, but never through a deleted reference.
+ * Listeners may add and remove listeners, themselves included, from their
+ * callbacks.
+ */
+#ifndef NATIVEHELPER_JNILISTENERREGISTRY_H_
+#define NATIVEHELPER_JNILISTENERREGISTRY_H_
+
+#include "jni.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct JniListenerRegistry JniListenerRegistry;
+
+/* Returns NULL with an OutOfMemoryError pending on failure. */
+JniListenerRegistry* jniListenerRegistryCreate(JNIEnv* env);
+
+/*
+ * Deletes every listener's global reference and frees the registry. No
+ * iteration may be under way, nor start afterwards.
+ */
+void jniListenerRegistryDestroy(JNIEnv* env, JniListenerRegistry* registry);
+
+/*
+ * Adds listener unless it is already there (per IsSameObject). Returns 0 if
+ * added, 1 if already there, or -1 with an exception pending.
+ */
+int jniListenerRegistryAdd(JNIEnv* env, JniListenerRegistry* registry, jobject listener);
+
+/* Removes listener. Returns 0, or -1 if it was not there. */
+int jniListenerRegistryRemove(JNIEnv* env, JniListenerRegistry* registry, jobject listener);
+
+/*
+ * Calls visit for each listener, in the order they were added, and returns
+ * how many were visited. Stops early, leaving the exception pending, if a
+ * call leaves one.
+ */
+size_t jniListenerRegistryForEach(JNIEnv* env, JniListenerRegistry* registry,
+                                  void (*visit)(JNIEnv* env, jobject listener, void* context),
+                                  void* context);
+
+size_t jniListenerRegistrySize(JniListenerRegistry* registry);
+
+/*
+ * Waits for every iteration under way to finish, then deletes the references
+ * of all removed listeners. Must not be called from a callback.
+ */
+void jniListenerRegistrySynchronize(JNIEnv* env, JniListenerRegistry* registry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* NATIVEHELPER_JNILISTENERREGISTRY_H_ */
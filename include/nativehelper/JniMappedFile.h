@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Maps part of a file into memory and hands it to Java as a direct
+ * ByteBuffer, so that large files can be read from Java and native code
+ * alike without copies; ScopedBytesRO/RW see the mapped bytes in place.
+ *
+ * A mapping outlives the buffer unless it is unmapped. Callers either unmap
+ * explicitly once Java is done with the buffer, or install a cleaner hook
+ * that arranges for jniUnmapAddress to be called when the buffer becomes
+ * unreachable, e.g. by registering a java.lang.ref.Cleaner or a finalizable
+ * owner whose native method calls it. Every live mapping is kept in a
+ * registry, so tests and debug builds can check that none leaked.
+ *
+ * Not part of libnativehelper_compat_libc++, the NDK build.
+ */
+#ifndef NATIVEHELPER_JNIMAPPEDFILE_H_
+#define NATIVEHELPER_JNIMAPPEDFILE_H_
+
+#include "jni.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Hints passed to madvise for the new mapping. */
+#define JNI_MAP_ADVISE_SEQUENTIAL 0x1  /* Read ahead aggressively, drop behind. */
+#define JNI_MAP_ADVISE_WILLNEED   0x2  /* Start reading the whole range in now. */
+#define JNI_MAP_ADVISE_HUGEPAGE   0x4  /* Back with huge pages where the kernel can. */
+
+typedef struct {
+    const void* address;  /* Of the buffer, i.e. of the byte at offset. */
+    size_t length;
+    int fd;               /* As it was at the time of mapping; it may be closed since. */
+    off64_t offset;
+    int prot;
+    const void* caller;   /* The return address of the jniMapFileDescriptor call. */
+} JniMapping;
+
+/*
+ * Maps length bytes of the file open on the java.io.FileDescriptor from
+ * offset, which need not be page-aligned, with the given PROT_READ and
+ * PROT_WRITE bits, and returns a local reference to a direct ByteBuffer
+ * over them. Writes go to the file (MAP_SHARED). A mapping without
+ * PROT_WRITE is returned as a read-only buffer. advice is a set of
+ * JNI_MAP_ADVISE_* hints; hints the kernel does not support are ignored.
+ * As with FileChannel.map, a read-write range that runs past the end of the
+ * file first extends the file to cover it.
+ *
+ * Returns NULL with an exception pending on failure: IllegalArgumentException
+ * for a bad range or protection, IOException for a read-only range past the
+ * end of the file or a failed fstat, ftruncate or mmap.
+ */
+jobject jniMapFileDescriptor(JNIEnv* env, jobject fileDescriptor, off64_t offset, size_t length,
+                             int prot, int advice);
+
+/*
+ * Called with each new buffer, its address and length, before it is
+ * returned; a non-zero result, or a pending exception, unmaps it again and
+ * makes jniMapFileDescriptor fail. NULL, the default, removes the hook.
+ */
+typedef int (*JniMappingCleanerHook)(JNIEnv* env, jobject buffer, void* address,
+                                     size_t length);
+void jniSetMappingCleanerHook(JniMappingCleanerHook hook);
+
+/*
+ * Unmaps the mapping behind a buffer returned by jniMapFileDescriptor, or the
+ * one starting at a buffer's address. The buffer must not be used again.
+ * Return 0 on success; -1 if there is no such mapping, as when it has already
+ * been unmapped, in which case nothing is thrown.
+ */
+int jniUnmapDirectBuffer(JNIEnv* env, jobject buffer);
+int jniUnmapAddress(const void* address);
+
+/* Returns the number of live mappings and calls visit for each, if non-NULL. */
+size_t jniGetMappings(void (*visit)(const JniMapping* mapping, void* context), void* context);
+
+/* Logs the live mappings at the given priority, e.g. to report leaks. */
+void jniLogMappings(int priority, const char* tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* NATIVEHELPER_JNIMAPPEDFILE_H_ */
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Data-parallel loops over native memory, such as a pinned Java array, on a
+ * pool of native worker threads.
+ *
+ * The workers are plain pthreads that are never attached to the VM, so a
+ * task must not make JNI calls. The calling thread works through chunks too,
+ * and returns once every chunk is done. The pool runs one loop at a time; a
+ * loop started while it is busy, including one started from inside a task,
+ * runs on the calling thread alone rather than waiting.
+ *
+ * Not part of libnativehelper_compat_libc++, the NDK build.
+ */
+#ifndef NATIVEHELPER_JNIPARALLEL_H_
+#define NATIVEHELPER_JNIPARALLEL_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A failure reported by a task, to be thrown once the loop is over. Both
+ * strings must outlive the loop, e.g. string literals.
+ */
+typedef struct {
+    const char* className;
+    const char* message;
+} JniParallelError;
+
+/*
+ * Sets the number of worker threads that join in loops; the default is one
+ * less than the number of online CPUs. Threads are started as needed and
+ * kept for the life of the process.
+ */
+void jniSetParallelWorkers(int count);
+
+int jniParallelWorkers(void);
+
+/*
+ * Calls task(begin, end, context, error) for chunks covering [0, count) of
+ * an array of count elements of elementSize bytes at base. Chunks hold at
+ * least grain elements (if there are that many), and every chunk but the
+ * first starts on a 64-byte cache line boundary, so that no two threads
+ * write to the same line. A task fails by setting error->className; the
+ * remaining chunks are then skipped and the first failure is copied to
+ * *error. Returns 0 on success and -1 on failure.
+ */
+int jniParallelRun(const void* base, size_t count, size_t elementSize, size_t grain,
+                   void (*task)(size_t begin, size_t end, void* context,
+                                JniParallelError* error),
+                   void* context, JniParallelError* error);
+
+#ifdef __cplusplus
+}
+
+#include "ScopedArrayView.h"
+
+template<typename T, typename Kernel>
+struct JniParallelArrayTask {
+    T* data;
+    Kernel* kernel;
+
+    static void run(size_t begin, size_t end, void* context, JniParallelError* error) {
+        JniParallelArrayTask* task = static_cast<JniParallelArrayTask*>(context);
+        (*task->kernel)(task->data, begin, end, error);
+    }
+};
+
+/*
+ * Runs kernel(data, begin, end, error) over chunks of a Java array in
+ * parallel, as jniParallelRun does, through one ScopedArrayView taken for
+ * the whole loop with the given site and flags. Pass JNI_ACCESS_NO_JNI_CALLS
+ * to allow critical access, bearing in mind that the GC may be held off for
+ * the whole loop. The view is released before a failure is thrown as a Java
+ * exception. Returns false, with an exception pending, on failure.
+ *
+ *   static JniAccessSite site = JNI_ACCESS_SITE("Stats.sum");
+ *   jniParallelForArray<jint>(env, values, &site, JNI_ACCESS_READ_ONLY, 4096,
+ *       [&](jint* data, size_t begin, size_t end, JniParallelError*) { ... });
+ */
+template<typename T, typename Kernel>
+bool jniParallelForArray(JNIEnv* env, typename JniArrayAccess<T>::JavaArray javaArray,
+                         JniAccessSite* site, int flags, size_t grain, Kernel kernel) {
+    JniParallelError error = { NULL, NULL };
+    {
+        ScopedArrayView<T> view(env, javaArray, site, flags);
+        if (view.get() == NULL) {
+            return false;
+        }
+        JniParallelArrayTask<T, Kernel> task = { view.get(), &kernel };
+        if (jniParallelRun(view.get(), view.size(), sizeof(T), grain,
+                           JniParallelArrayTask<T, Kernel>::run, &task, &error) == 0) {
+            return true;
+        }
+    }
+    jniThrowException(env, error.className, error.message);
+    return false;
+}
+
+#endif
+
+#endif  /* NATIVEHELPER_JNIPARALLEL_H_ */
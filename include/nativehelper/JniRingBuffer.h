@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A ring buffer of variable-length records in memory shared by native code
+ * and Java through a direct ByteBuffer, so that a stream of messages crosses
+ * between them with no JNI calls while both sides are busy. Producers
+ * append records without locks, either one at a time (single producer) or
+ * from any number of threads (JNI_RING_MPSC); a single consumer reads them
+ * in order. A consumer that runs dry can ask to be woken, and the next
+ * producer to commit is told to wake it.
+ *
+ * Layout, in the platform's byte order (Java: ByteOrder.nativeOrder()).
+ * Each field that changes has a 64-byte cache line to itself, so producers
+ * and the consumer do not invalidate each other's lines:
+ *
+ *   0    int32  magic, JNI_RING_MAGIC
+ *   4    int32  flags
+ *   8    int64  capacity of the data area in bytes, a power of two
+ *   64   int64  head: bytes consumed so far; written by the consumer only
+ *   128  int64  tail: bytes claimed so far by producers
+ *   192  int32  consumer waiting: 1 while the consumer is parked or about to
+ *   256         data area
+ *
+ * head and tail only grow; a position p is at data offset p & (capacity - 1).
+ * Records start at multiples of 8 and are laid out as:
+ *
+ *   0    int32  record length, header included; 0 before the record is
+ *               claimed and negated until it is committed, which is done
+ *               by writing this field last
+ *   4    int32  type; JNI_RING_PADDING marks filler up to the end of the
+ *               data area, which the consumer skips
+ *   8           payload, then padding to a multiple of 8
+ *
+ * A consumer, native or Java, loops: read the length at head with acquire
+ * semantics; if it is not positive, stop; else handle the record unless it
+ * is padding, zero all of its (rounded-up) bytes, and advance head past them
+ * with release semantics. In Java the acquire and release accesses go
+ * through MethodHandles.byteBufferViewVarHandle (getAcquire, setRelease);
+ * everything else is a plain ByteBuffer get. To park, the consumer sets the
+ * waiting field to 1, re-checks the length at head with a volatile read,
+ * and parks only if it is still not positive.
+ *
+ * A Java producer, allowed only for single-producer rings, does the
+ * reverse: it checks that tail - head leaves room, writes the type and
+ * payload, advances tail, and writes the length last with release
+ * semantics. It pads the end of the data area itself when a record would
+ * not fit before it.
+ */
+#ifndef NATIVEHELPER_JNIRINGBUFFER_H_
+#define NATIVEHELPER_JNIRINGBUFFER_H_
+
+#include "jni.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JNI_RING_MAGIC 0x4a524231  /* "JRB1" */
+#define JNI_RING_MPSC 0x1
+
+#define JNI_RING_HEAD_OFFSET 64
+#define JNI_RING_TAIL_OFFSET 128
+#define JNI_RING_WAITING_OFFSET 192
+#define JNI_RING_DATA_OFFSET 256
+#define JNI_RING_RECORD_HEADER 8
+#define JNI_RING_PADDING (-1)
+
+/* Results of jniRingBufferCommit and jniRingBufferWrite. */
+#define JNI_RING_FULL (-1)
+#define JNI_RING_WAKE 1  /* Committed, and the consumer must be woken. */
+
+/* The shared memory itself; see the layout above. */
+typedef struct JniRingBuffer JniRingBuffer;
+
+/*
+ * Allocates a ring with a data area of capacity bytes, a power of two of at
+ * least 4096. If buffer is non-NULL, sets it to a local reference to a
+ * direct ByteBuffer over the whole ring, header included, for Java. Returns
+ * NULL with an exception pending on failure.
+ */
+JniRingBuffer* jniRingBufferCreate(JNIEnv* env, size_t capacity, int flags, jobject* buffer);
+
+/*
+ * Returns the ring behind a ByteBuffer from jniRingBufferCreate, as when Java
+ * passes it back; throws IllegalArgumentException and returns NULL if it
+ * is not one.
+ */
+JniRingBuffer* jniRingBufferFromBuffer(JNIEnv* env, jobject buffer);
+
+/* Frees the ring. Neither side may use it, or its ByteBuffer, afterwards. */
+void jniRingBufferDestroy(JniRingBuffer* ring);
+
+/* The largest payload a record may have: an eighth of the data area, less the header. */
+size_t jniRingBufferMaxPayload(const JniRingBuffer* ring);
+
+/*
+ * Producers. jniRingBufferClaim returns where to write a payload of length
+ * bytes, or NULL if the ring is too full or the payload too long. The record
+ * stays invisible to the consumer, and blocks those after it, until the
+ * claimed pointer is passed to jniRingBufferCommit, which returns
+ * JNI_RING_WAKE if the caller should wake the consumer, else 0.
+ */
+void* jniRingBufferClaim(JniRingBuffer* ring, int32_t type, size_t length);
+int jniRingBufferCommit(JniRingBuffer* ring, void* payload);
+
+/* Claims, copies and commits; returns JNI_RING_FULL, 0 or JNI_RING_WAKE. */
+int jniRingBufferWrite(JniRingBuffer* ring, int32_t type, const void* data, size_t length);
+
+/*
+ * The consumer. Calls handle for up to limit committed records, in order,
+ * and returns how many it handled. The payload is only valid during the
+ * call.
+ */
+size_t jniRingBufferRead(JniRingBuffer* ring,
+                         void (*handle)(int32_t type, const void* data, size_t length,
+                                        void* context),
+                         void* context, size_t limit);
+
+/*
+ * Before parking, the consumer calls jniRingBufferPrepareWait: if it returns
+ * 1 the ring is empty and the next commit will return JNI_RING_WAKE; if 0,
+ * records arrived meanwhile and the consumer should read instead.
+ */
+int jniRingBufferPrepareWait(JniRingBuffer* ring);
+
+/* Bytes claimed but not yet consumed, for monitoring and back-pressure. */
+size_t jniRingBufferBacklog(const JniRingBuffer* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* NATIVEHELPER_JNIRINGBUFFER_H_ */
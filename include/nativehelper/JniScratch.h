@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Per-thread scratch memory for temporaries that live within one call, such
+ * as long exception messages and transcoding buffers.
+ *
+ * Each thread has a bump arena of 64KiB chunks, allocated on first use and
+ * kept warm between calls, so a temporary buffer costs a pointer bump rather
+ * than a malloc or a large stack frame. Blocks are normally freed in the
+ * reverse order of allocation, either one at a time or all at once back to a
+ * checkpoint. A block freed out of order is reclaimed once every block above
+ * it has been freed too. Up to 256KiB of chunks stay with a thread while its
+ * arena is empty; the rest is returned to the heap, and everything is freed
+ * when the thread exits.
+ */
+#ifndef NATIVEHELPER_JNISCRATCH_H_
+#define NATIVEHELPER_JNISCRATCH_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns a 16-byte aligned block, or NULL if memory is exhausted. */
+void* jniScratchAlloc(size_t bytes);
+
+/*
+ * Frees a block from jniScratchAlloc on the same thread. Logs an error and
+ * does nothing if the block is not live in this thread's arena, because it
+ * came from another thread or a checkpoint below it was released.
+ */
+void jniScratchFree(void* block);
+
+/* Returns a checkpoint for jniScratchRelease. */
+size_t jniScratchMark(void);
+
+/* Frees every block allocated since mark, which must still be live. */
+void jniScratchRelease(size_t mark);
+
+/* Returns the bytes of chunk memory the calling thread holds. */
+size_t jniScratchRetainedBytes(void);
+
+#ifdef __cplusplus
+}
+
+// Frees the scratch blocks allocated in its scope, in any order, on
+// destruction. Only for stack instances, which are destroyed in reverse
+// order of construction; nothing allocated in its scope may be used after.
+class ScopedScratch {
+public:
+    ScopedScratch() : mMark(jniScratchMark()) {}
+
+    ~ScopedScratch() {
+        jniScratchRelease(mMark);
+    }
+
+    template<typename T>
+    T* alloc(size_t count) {
+        return static_cast<T*>(jniScratchAlloc(count * sizeof(T)));
+    }
+
+private:
+    const size_t mMark;
+
+    // Disallow copy and assignment.
+    ScopedScratch(const ScopedScratch&);
+    void operator=(const ScopedScratch&);
+};
+
+#endif
+
+#endif  /* NATIVEHELPER_JNISCRATCH_H_ */
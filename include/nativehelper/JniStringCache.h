@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A process-wide cache of Strings for native strings that recur, such as
+ * locale IDs, header names and enum-like tokens, so that returning one costs
+ * a NewLocalRef instead of a transcode and an allocation.
+ *
+ * Lookups take no locks: a hit hashes the bytes, scans one bucket of eight
+ * entries and takes a local reference to the cached global one. Misses
+ * create the String and insert it under a lock. The cache holds at most
+ * 8192 Strings within a memory budget; past either, entries that have not
+ * been hit since the last sweep are evicted first. The global references of
+ * evicted entries are deleted by a later call, once the lookups that were in
+ * progress when they were evicted have finished; no lookup waits for that.
+ *
+ * Cached Strings are shared: the same instance is returned every time, so
+ * only strings whose identity does not matter to Java callers belong here.
+ */
+#ifndef NATIVEHELPER_JNISTRINGCACHE_H_
+#define NATIVEHELPER_JNISTRINGCACHE_H_
+
+#include "jni.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;    /* Estimated native and Java heap bytes held. */
+    size_t budget;
+} JniStringCacheStats;
+
+/*
+ * Returns a local reference to a String holding the length bytes of
+ * modified UTF-8 at utf8, from the cache if possible. Returns NULL with an
+ * exception pending if the String could not be created.
+ */
+jstring jniGetCachedString(JNIEnv* env, const char* utf8, size_t length);
+
+/* As above for a NUL-terminated string; returns NULL for a NULL utf8. */
+jstring jniGetCachedStringUTF(JNIEnv* env, const char* utf8);
+
+/* Sets the memory budget; the default is 256KiB. Evicts down to it. */
+void jniSetStringCacheBudget(JNIEnv* env, size_t bytes);
+
+void jniGetStringCacheStats(JniStringCacheStats* stats);
+
+/* Empties the cache, deleting its global references. */
+void jniClearStringCache(JNIEnv* env);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* NATIVEHELPER_JNISTRINGCACHE_H_ */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Kernels over UTF-16 string data, such as that of a ScopedStringChars,
+ * ScopedStringCritical or ScopedStringView, that give the same results as
+ * String.hashCode, equals and compareTo without calling into Java or
+ * converting to UTF-8. They use the instruction set chosen for the JniBytes.h
+ * kernels.
+ */
+#ifndef NATIVEHELPER_JNISTRINGKERNELS_H_
+#define NATIVEHELPER_JNISTRINGKERNELS_H_
+
+#include "jni.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns what String.hashCode would for these chars. */
+jint jniStringHashCode(const jchar* chars, size_t length);
+
+/*
+ * Returns what String.compareTo would: the difference between the first
+ * pair of chars that differ, else the difference in length.
+ */
+jint jniStringCompare(const jchar* a, size_t aLength, const jchar* b, size_t bLength);
+
+/*
+ * Return 1 if chars hold the same string as the ASCII or UTF-8 literal,
+ * else 0. UTF-8 outside the BMP matches a surrogate pair; malformed UTF-8
+ * matches nothing.
+ */
+int jniStringEqualsAsciiChars(const jchar* chars, size_t length, const char* ascii,
+                              size_t asciiLength);
+int jniStringEqualsUtf8Chars(const jchar* chars, size_t length, const char* utf8,
+                             size_t utf8Length);
+
+/*
+ * The same for a jstring, compared or hashed through GetStringRegion into a
+ * stack or scratch buffer. A NULL string equals nothing and hashes to 0.
+ */
+jboolean jniStringEqualsAscii(JNIEnv* env, jstring string, const char* ascii);
+jboolean jniStringEqualsUtf8(JNIEnv* env, jstring string, const char* utf8);
+jint jniStringHashCodeOf(JNIEnv* env, jstring string);
+
+#ifdef __cplusplus
+}
+
+/* Overloads for anything with get() and size() in chars. */
+template<typename View>
+inline jint jniStringHashCode(const View& chars) {
+    return jniStringHashCode(chars.get(), chars.size());
+}
+
+template<typename View>
+inline int jniStringEqualsAsciiChars(const View& chars, const char* ascii, size_t asciiLength) {
+    return jniStringEqualsAsciiChars(chars.get(), chars.size(), ascii, asciiLength);
+}
+
+template<typename View>
+inline int jniStringEqualsUtf8Chars(const View& chars, const char* utf8, size_t utf8Length) {
+    return jniStringEqualsUtf8Chars(chars.get(), chars.size(), utf8, utf8Length);
+}
+
+#endif
+
+#endif  /* NATIVEHELPER_JNISTRINGKERNELS_H_ */
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Static tracepoints (USDT probes) in the helpers' hot paths.
+ *
+ * Building with -DNATIVEHELPER_ENABLE_USDT, which needs <sys/sdt.h>
+ * (systemtap-sdt-dev), places a single nop at each probe site and records its
+ * location and arguments in the ELF .note.stapsdt section, so that perf,
+ * bpftrace or stap can attach without rebuilding:
+ *
+ *   bpftrace -e 'usdt:libnativehelper.so:libnativehelper:throw_exception
+ *       { printf("%s: %s\n", str(arg0), str(arg1)); }'
+ *
+ * Without it the macros expand to nothing. Probes in the Scoped* headers are
+ * compiled into the including binary, under the same provider name.
+ *
+ * Each probe has a semaphore that the tracer raises while it is attached to
+ * the probe, and a probe site evaluates its arguments, which may cost a JNI
+ * call or a strlen, only while the semaphore is up. Each binary has its own
+ * semaphores, hidden, since each has its own probe notes. JNI_TRACE_ARMED
+ * lets a site skip work it does only for a probe, such as taking a start
+ * time.
+ *
+ * Probes, with their arguments:
+ *   throw_exception(className, msg)
+ *   register_natives(className, numMethods, ns)
+ *   log_exception(priority, tag)
+ *   constants_init(ns)
+ *   invocation_init(library, ok, ns)
+ *   array_acquire(bytes, isCopy), array_release(bytes)
+ *   string_acquire(length, isCopy), string_release(length)
+ */
+#ifndef NATIVEHELPER_JNITRACE_H_
+#define NATIVEHELPER_JNITRACE_H_
+
+#ifdef NATIVEHELPER_ENABLE_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#include <stdint.h>
+#include <time.h>
+
+#define JNI_TRACE_SEMAPHORE(name) \
+    __attribute__((weak, visibility("hidden"), section(".probes"))) \
+    volatile unsigned short libnativehelper_ ## name ## _semaphore
+
+JNI_TRACE_SEMAPHORE(throw_exception);
+JNI_TRACE_SEMAPHORE(register_natives);
+JNI_TRACE_SEMAPHORE(log_exception);
+JNI_TRACE_SEMAPHORE(constants_init);
+JNI_TRACE_SEMAPHORE(invocation_init);
+JNI_TRACE_SEMAPHORE(array_acquire);
+JNI_TRACE_SEMAPHORE(array_release);
+JNI_TRACE_SEMAPHORE(string_acquire);
+JNI_TRACE_SEMAPHORE(string_release);
+
+#undef JNI_TRACE_SEMAPHORE
+
+#define JNI_TRACE_ENABLED 1
+#define JNI_TRACE_ARMED(name) __builtin_expect(libnativehelper_ ## name ## _semaphore != 0, 0)
+#define JNI_TRACE1(name, a) \
+    do { if (JNI_TRACE_ARMED(name)) DTRACE_PROBE1(libnativehelper, name, a); } while (0)
+#define JNI_TRACE2(name, a, b) \
+    do { if (JNI_TRACE_ARMED(name)) DTRACE_PROBE2(libnativehelper, name, a, b); } while (0)
+#define JNI_TRACE3(name, a, b, c) \
+    do { if (JNI_TRACE_ARMED(name)) DTRACE_PROBE3(libnativehelper, name, a, b, c); } while (0)
+
+/* Monotonic nanoseconds, for probes that report a duration. */
+static inline uint64_t jniTraceNanoTime(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+#else
+
+#define JNI_TRACE_ENABLED 0
+#define JNI_TRACE_ARMED(name) 0
+#define JNI_TRACE1(name, a) ((void) 0)
+#define JNI_TRACE2(name, a, b) ((void) 0)
+#define JNI_TRACE3(name, a, b, c) ((void) 0)
+
+#endif
+
+#endif  /* NATIVEHELPER_JNITRACE_H_ */
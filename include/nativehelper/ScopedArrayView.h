@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCOPED_ARRAY_VIEW_H_included
+#define SCOPED_ARRAY_VIEW_H_included
+
+#include "JNIHelp.h"
+#include "JniAccessPolicy.h"
+#include "JniCheck.h"
+#include "JniCriticalMonitor.h"
+
+// The per-type JNI array calls, for templates over the element type.
+template<typename T> struct JniArrayAccess;
+
+#define INSTANTIATE_JNI_ARRAY_ACCESS(PRIMITIVE_TYPE, NAME) \
+    template<> struct JniArrayAccess<PRIMITIVE_TYPE> { \
+        typedef PRIMITIVE_TYPE ## Array JavaArray; \
+        static void getRegion(JNIEnv* env, JavaArray array, jsize start, jsize length, \
+                              PRIMITIVE_TYPE* buffer) { \
+            env->Get ## NAME ## ArrayRegion(array, start, length, buffer); \
+        } \
+        static void setRegion(JNIEnv* env, JavaArray array, jsize start, jsize length, \
+                              const PRIMITIVE_TYPE* buffer) { \
+            env->Set ## NAME ## ArrayRegion(array, start, length, buffer); \
+        } \
+        static PRIMITIVE_TYPE* getElements(JNIEnv* env, JavaArray array, jboolean* isCopy) { \
+            return env->Get ## NAME ## ArrayElements(array, isCopy); \
+        } \
+        static void releaseElements(JNIEnv* env, JavaArray array, PRIMITIVE_TYPE* elements, \
+                                    jint mode) { \
+            env->Release ## NAME ## ArrayElements(array, elements, mode); \
+        } \
+    }
+
+INSTANTIATE_JNI_ARRAY_ACCESS(jboolean, Boolean);
+INSTANTIATE_JNI_ARRAY_ACCESS(jbyte, Byte);
+INSTANTIATE_JNI_ARRAY_ACCESS(jchar, Char);
+INSTANTIATE_JNI_ARRAY_ACCESS(jdouble, Double);
+INSTANTIATE_JNI_ARRAY_ACCESS(jfloat, Float);
+INSTANTIATE_JNI_ARRAY_ACCESS(jint, Int);
+INSTANTIATE_JNI_ARRAY_ACCESS(jlong, Long);
+INSTANTIATE_JNI_ARRAY_ACCESS(jshort, Short);
+
+#undef INSTANTIATE_JNI_ARRAY_ACCESS
+
+// Access to a Java primitive array through whichever of a region copy,
+// Get<Type>ArrayElements or GetPrimitiveArrayCritical JniAccessPolicy.h
+// picks for the call site:
+//
+//   static JniAccessSite site = JNI_ACCESS_SITE("Codec.decode");
+//   ScopedIntArrayView samples(env, javaSamples, &site, JNI_ACCESS_READ_ONLY);
+//   if (samples.get() == NULL) {
+//       return;
+//   }
+//
+// Changes are written back on release unless the view is JNI_ACCESS_READ_ONLY,
+// in which case they may or may not reach the Java array. A view declared
+// JNI_ACCESS_NO_JNI_CALLS may be critical, with the restrictions of
+// ScopedPrimitiveArrayCritical. Like the other Scoped helpers, a null array
+// throws NullPointerException and get() returns NULL.
+template<typename T>
+class ScopedArrayView {
+public:
+    typedef typename JniArrayAccess<T>::JavaArray JavaArray;
+
+    JNI_CRITICAL_ALWAYS_INLINE ScopedArrayView(JNIEnv* env, JavaArray javaArray,
+                                               JniAccessSite* site, int flags = 0)
+    : mEnv(env), mJavaArray(javaArray), mSite(site), mFlags(flags), mRawArray(NULL), mSize(0),
+      mStrategy(kJniAccessElements), mIsCopy(JNI_FALSE), mStartNs(0), mAcquireNs(0),
+      mHoldSite(NULL), mHoldStartNs(0) {
+        JNI_LIGHT_CHECK(mEnv, "ScopedArrayView");
+        if (mJavaArray == NULL) {
+            jniThrowNullPointerException(mEnv, NULL);
+            return;
+        }
+        mSize = mEnv->GetArrayLength(mJavaArray);
+        const bool regionFits = mSize <= kBufferSize;
+#ifdef NATIVEHELPER_FIXED_ACCESS_POLICY
+        mStrategy = regionFits ? kJniAccessRegion : kJniAccessElements;
+#else
+        mStrategy = jniAccessChoose(mSite, mSize * sizeof(T), mFlags, regionFits, &mStartNs);
+#endif
+        switch (mStrategy) {
+        case kJniAccessRegion:
+            JniArrayAccess<T>::getRegion(mEnv, mJavaArray, 0, mSize, mBuffer);
+            mRawArray = mBuffer;
+            mIsCopy = JNI_TRUE;
+            break;
+        case kJniAccessCritical:
+            if (__atomic_load_n(&jniCriticalHoldThresholdNs, __ATOMIC_RELAXED) != 0) {
+                mHoldSite = jniCriticalMonitorSite();
+                mHoldStartNs = jniCriticalMonitorNow();
+            }
+            mRawArray = static_cast<T*>(mEnv->GetPrimitiveArrayCritical(mJavaArray, &mIsCopy));
+            if (mRawArray != NULL && JNI_LIGHT_CHECK_ENABLED()) {
+                jniLightCheckCriticalEnter();
+            }
+            break;
+        default:
+            mRawArray = JniArrayAccess<T>::getElements(mEnv, mJavaArray, &mIsCopy);
+            break;
+        }
+        if (mRawArray != NULL) {
+            jniHelpCountArrayBytes(mSize * sizeof(T), mIsCopy);
+            if (mStartNs != 0) {
+                mAcquireNs = jniAccessNow() - mStartNs;
+            }
+        }
+    }
+
+    ~ScopedArrayView() {
+        if (mRawArray == NULL) {
+            return;
+        }
+        const uint64_t releaseStartNs = (mStartNs != 0) ? jniAccessNow() : 0;
+        const jint mode = (mFlags & JNI_ACCESS_READ_ONLY) ? JNI_ABORT : 0;
+        switch (mStrategy) {
+        case kJniAccessRegion:
+            if (mode == 0) {
+                JniArrayAccess<T>::setRegion(mEnv, mJavaArray, 0, mSize, mBuffer);
+            }
+            break;
+        case kJniAccessCritical:
+            mEnv->ReleasePrimitiveArrayCritical(mJavaArray, mRawArray, mode);
+            if (JNI_LIGHT_CHECK_ENABLED()) {
+                jniLightCheckCriticalExit();
+            }
+            if (mHoldStartNs != 0) {
+                jniCriticalMonitorRecord(mHoldSite, mHoldStartNs, mSize * sizeof(T));
+            }
+            break;
+        default:
+            JniArrayAccess<T>::releaseElements(mEnv, mJavaArray, mRawArray, mode);
+            break;
+        }
+        if (mStartNs != 0) {
+            jniAccessRecord(mSite, mStrategy, mSize * sizeof(T), mIsCopy,
+                            mAcquireNs + (jniAccessNow() - releaseStartNs));
+        }
+    }
+
+    const T* get() const { return mRawArray; }
+    T* get() { return mRawArray; }
+    const T& operator[](size_t n) const { return mRawArray[n]; }
+    T& operator[](size_t n) { return mRawArray[n]; }
+    size_t size() const { return mSize; }
+    JniAccessStrategy strategy() const { return mStrategy; }
+
+private:
+    // The same threshold as ScopedPrimitiveArrayRO's inline buffer.
+    static const jsize kBufferSize = 1024;
+
+    JNIEnv* const mEnv;
+    const JavaArray mJavaArray;
+    JniAccessSite* const mSite;
+    const int mFlags;
+    T* mRawArray;
+    jsize mSize;
+    JniAccessStrategy mStrategy;
+    jboolean mIsCopy;
+    uint64_t mStartNs;
+    uint64_t mAcquireNs;
+    const void* mHoldSite;
+    uint64_t mHoldStartNs;
+    T mBuffer[kBufferSize];
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedArrayView);
+};
+
+typedef ScopedArrayView<jboolean> ScopedBooleanArrayView;
+typedef ScopedArrayView<jbyte> ScopedByteArrayView;
+typedef ScopedArrayView<jchar> ScopedCharArrayView;
+typedef ScopedArrayView<jdouble> ScopedDoubleArrayView;
+typedef ScopedArrayView<jfloat> ScopedFloatArrayView;
+typedef ScopedArrayView<jint> ScopedIntArrayView;
+typedef ScopedArrayView<jlong> ScopedLongArrayView;
+typedef ScopedArrayView<jshort> ScopedShortArrayView;
+
+// Read-only access to a Java string's UTF-16 chars through whichever of
+// GetStringRegion, GetStringChars or GetStringCritical JniAccessPolicy.h
+// picks for the call site; the ScopedArrayView counterpart of
+// ScopedStringChars. Only JNI_ACCESS_NO_JNI_CALLS is meaningful in flags.
+class ScopedStringView {
+public:
+    JNI_CRITICAL_ALWAYS_INLINE ScopedStringView(JNIEnv* env, jstring javaString,
+                                                JniAccessSite* site, int flags = 0)
+    : mEnv(env), mJavaString(javaString), mSite(site), mChars(NULL), mSize(0),
+      mStrategy(kJniAccessElements), mIsCopy(JNI_FALSE), mStartNs(0), mAcquireNs(0),
+      mHoldSite(NULL), mHoldStartNs(0) {
+        JNI_LIGHT_CHECK(mEnv, "ScopedStringView");
+        if (mJavaString == NULL) {
+            jniThrowNullPointerException(mEnv, NULL);
+            return;
+        }
+        mSize = mEnv->GetStringLength(mJavaString);
+        const bool regionFits = mSize <= kBufferSize;
+#ifdef NATIVEHELPER_FIXED_ACCESS_POLICY
+        mStrategy = regionFits ? kJniAccessRegion : kJniAccessElements;
+#else
+        mStrategy = jniAccessChoose(mSite, mSize * sizeof(jchar), flags | JNI_ACCESS_READ_ONLY,
+                                    regionFits, &mStartNs);
+#endif
+        switch (mStrategy) {
+        case kJniAccessRegion:
+            mEnv->GetStringRegion(mJavaString, 0, mSize, mBuffer);
+            mChars = mBuffer;
+            mIsCopy = JNI_TRUE;
+            break;
+        case kJniAccessCritical:
+            if (__atomic_load_n(&jniCriticalHoldThresholdNs, __ATOMIC_RELAXED) != 0) {
+                mHoldSite = jniCriticalMonitorSite();
+                mHoldStartNs = jniCriticalMonitorNow();
+            }
+            mChars = mEnv->GetStringCritical(mJavaString, &mIsCopy);
+            if (mChars != NULL && JNI_LIGHT_CHECK_ENABLED()) {
+                jniLightCheckCriticalEnter();
+            }
+            break;
+        default:
+            mChars = mEnv->GetStringChars(mJavaString, &mIsCopy);
+            break;
+        }
+        if (mChars != NULL && mStartNs != 0) {
+            mAcquireNs = jniAccessNow() - mStartNs;
+        }
+    }
+
+    ~ScopedStringView() {
+        if (mChars == NULL) {
+            return;
+        }
+        const uint64_t releaseStartNs = (mStartNs != 0) ? jniAccessNow() : 0;
+        switch (mStrategy) {
+        case kJniAccessRegion:
+            break;
+        case kJniAccessCritical:
+            mEnv->ReleaseStringCritical(mJavaString, mChars);
+            if (JNI_LIGHT_CHECK_ENABLED()) {
+                jniLightCheckCriticalExit();
+            }
+            if (mHoldStartNs != 0) {
+                jniCriticalMonitorRecord(mHoldSite, mHoldStartNs, mSize * sizeof(jchar));
+            }
+            break;
+        default:
+            mEnv->ReleaseStringChars(mJavaString, mChars);
+            break;
+        }
+        if (mStartNs != 0) {
+            jniAccessRecord(mSite, mStrategy, mSize * sizeof(jchar), mIsCopy,
+                            mAcquireNs + (jniAccessNow() - releaseStartNs));
+        }
+    }
+
+    const jchar* get() const { return mChars; }
+    const jchar& operator[](size_t n) const { return mChars[n]; }
+    size_t size() const { return mSize; }
+    JniAccessStrategy strategy() const { return mStrategy; }
+
+private:
+    static const jsize kBufferSize = 1024;
+
+    JNIEnv* const mEnv;
+    const jstring mJavaString;
+    JniAccessSite* const mSite;
+    const jchar* mChars;
+    jsize mSize;
+    JniAccessStrategy mStrategy;
+    jboolean mIsCopy;
+    uint64_t mStartNs;
+    uint64_t mAcquireNs;
+    const void* mHoldSite;
+    uint64_t mHoldStartNs;
+    jchar mBuffer[kBufferSize];
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedStringView);
+};
+
+#endif  // SCOPED_ARRAY_VIEW_H_included
@@ -18,6 +18,9 @@
 #define SCOPED_BYTES_H_included
 
 #include "JNIHelp.h"
+#include "JniBufferPool.h"
+#include "JniCheck.h"
+#include "JniTrace.h"
 
 /**
  * ScopedBytesRO and ScopedBytesRW attempt to paper over the differences between byte[]s and
@@ -29,31 +32,64 @@ template<bool readOnly>
 class ScopedBytes {
 public:
     ScopedBytes(JNIEnv* env, jobject object)
-    : mEnv(env), mObject(object), mByteArray(NULL), mPtr(NULL)
+    : mEnv(env), mObject(object), mByteArray(NULL), mIsCopy(JNI_FALSE), mPtr(NULL), mSize(0)
     {
+        JNI_LIGHT_CHECK(mEnv, "ScopedBytes");
         if (mObject == NULL) {
             jniThrowNullPointerException(mEnv, NULL);
         } else if (mEnv->IsInstanceOf(mObject, JniConstants::byteArrayClass)) {
             mByteArray = reinterpret_cast<jbyteArray>(mObject);
-            mPtr = mEnv->GetByteArrayElements(mByteArray, NULL);
+            mPtr = mEnv->GetByteArrayElements(mByteArray, &mIsCopy);
+            if (mPtr != NULL) {
+                mSize = kUnknownSize;
+                JNI_TRACE2(array_acquire, size(), mIsCopy);
+            }
         } else {
             mPtr = reinterpret_cast<jbyte*>(mEnv->GetDirectBufferAddress(mObject));
+            if (mPtr != NULL) {
+                mSize = kUnknownSize;
+            }
         }
     }
 
+    // A pooled buffer's address and size are already known, so this costs nothing.
+    ScopedBytes(JNIEnv* env, const JniPooledBuffer& buffer)
+    : mEnv(env), mObject(buffer.buffer), mByteArray(NULL), mIsCopy(JNI_FALSE),
+      mPtr(static_cast<jbyte*>(buffer.address)), mSize(buffer.capacity)
+    {
+    }
+
     ~ScopedBytes() {
         if (mByteArray != NULL) {
+            // Counted only if the length was fetched anyway.
+            if (mPtr != NULL && mSize != kUnknownSize) {
+                jniHelpCountArrayBytes(mSize, mIsCopy);
+            }
+            JNI_TRACE1(array_release, size());
             mEnv->ReleaseByteArrayElements(mByteArray, mPtr, readOnly ? JNI_ABORT : 0);
         }
     }
 
+    // The array's length or the buffer's capacity, in bytes; 0 if get() is NULL.
+    size_t size() const {
+        if (mSize == kUnknownSize) {
+            mSize = (mByteArray != NULL) ? mEnv->GetArrayLength(mByteArray)
+                                         : mEnv->GetDirectBufferCapacity(mObject);
+        }
+        return mSize;
+    }
+
 private:
+    static const size_t kUnknownSize = static_cast<size_t>(-1);
+
     JNIEnv* const mEnv;
     const jobject mObject;
     jbyteArray mByteArray;
+    jboolean mIsCopy;
 
 protected:
     jbyte* mPtr;
+    mutable size_t mSize;  // kUnknownSize until size() fetches it.
 
 private:
     DISALLOW_COPY_AND_ASSIGN(ScopedBytes);
@@ -62,6 +98,7 @@ private:
 class ScopedBytesRO : public ScopedBytes<true> {
 public:
     ScopedBytesRO(JNIEnv* env, jobject object) : ScopedBytes<true>(env, object) {}
+    ScopedBytesRO(JNIEnv* env, const JniPooledBuffer& buffer) : ScopedBytes<true>(env, buffer) {}
     const jbyte* get() const {
         return mPtr;
     }
@@ -70,6 +107,7 @@ public:
 class ScopedBytesRW : public ScopedBytes<false> {
 public:
     ScopedBytesRW(JNIEnv* env, jobject object) : ScopedBytes<false>(env, object) {}
+    ScopedBytesRW(JNIEnv* env, const JniPooledBuffer& buffer) : ScopedBytes<false>(env, buffer) {}
     jbyte* get() {
         return mPtr;
     }
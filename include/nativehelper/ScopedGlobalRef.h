@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCOPED_GLOBAL_REF_H_included
+#define SCOPED_GLOBAL_REF_H_included
+
+#include "jni.h"
+
+#include <stddef.h>
+#include "JNIHelp.h"  // for DISALLOW_COPY_AND_ASSIGN.
+
+// Owns a JNI global reference and deletes it on destruction, from whichever
+// thread that happens on: the reference keeps the JavaVM rather than a
+// JNIEnv, and a thread that is not attached is attached for the delete.
+// Ownership moves (in C++11) but is never copied, so a reference can be
+// handed between containers and threads without NewGlobalRef/DeleteGlobalRef
+// pairs.
+template<typename T>
+class ScopedGlobalRef {
+public:
+    ScopedGlobalRef() : mVm(NULL), mGlobalRef(NULL) {
+    }
+
+    // Takes a new global reference to object, which may be NULL.
+    ScopedGlobalRef(JNIEnv* env, T object) : mVm(NULL), mGlobalRef(NULL) {
+        if (object != NULL && env->GetJavaVM(&mVm) == JNI_OK) {
+            mGlobalRef = static_cast<T>(env->NewGlobalRef(object));
+        }
+    }
+
+#if __cplusplus >= 201103L
+    ScopedGlobalRef(ScopedGlobalRef&& other) : mVm(other.mVm), mGlobalRef(other.mGlobalRef) {
+        other.mGlobalRef = NULL;
+    }
+
+    ScopedGlobalRef& operator=(ScopedGlobalRef&& other) {
+        if (this != &other) {
+            reset();
+            swap(other);
+        }
+        return *this;
+    }
+#endif
+
+    ~ScopedGlobalRef() {
+        reset();
+    }
+
+    void reset() {
+        if (mGlobalRef == NULL) {
+            return;
+        }
+        JNIEnv* env;
+        if (mVm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) == JNI_OK) {
+            env->DeleteGlobalRef(mGlobalRef);
+        } else if (mVm->AttachCurrentThread(&env, NULL) == JNI_OK) {
+            env->DeleteGlobalRef(mGlobalRef);
+            mVm->DetachCurrentThread();
+        }
+        mGlobalRef = NULL;
+    }
+
+    // Gives up ownership; the caller must delete the returned reference.
+    T release() __attribute__((warn_unused_result)) {
+        T globalRef = mGlobalRef;
+        mGlobalRef = NULL;
+        return globalRef;
+    }
+
+    void swap(ScopedGlobalRef& other) {
+        JavaVM* vm = mVm;
+        T globalRef = mGlobalRef;
+        mVm = other.mVm;
+        mGlobalRef = other.mGlobalRef;
+        other.mVm = vm;
+        other.mGlobalRef = globalRef;
+    }
+
+    T get() const {
+        return mGlobalRef;
+    }
+
+private:
+    JavaVM* mVm;
+    T mGlobalRef;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedGlobalRef);
+};
+
+#endif  // SCOPED_GLOBAL_REF_H_included
@@ -21,12 +21,16 @@
 
 #include <stddef.h>
 #include "JNIHelp.h"  // for DISALLOW_COPY_AND_ASSIGN.
+#include "JniCheck.h"
 
 // A smart pointer that deletes a JNI local reference when it goes out of scope.
 template<typename T>
 class ScopedLocalRef {
 public:
     ScopedLocalRef(JNIEnv* env, T localRef) : mEnv(env), mLocalRef(localRef) {
+        if (mLocalRef != NULL && JNI_LIGHT_CHECK_ENABLED()) {
+            jniLightCheckLocalRef(1);
+        }
     }
 
     ~ScopedLocalRef() {
@@ -35,6 +39,9 @@ public:
 
     void reset(T ptr = NULL) {
         if (ptr != mLocalRef) {
+            if (JNI_LIGHT_CHECK_ENABLED()) {
+                jniLightCheckLocalRef((ptr != NULL) - (mLocalRef != NULL));
+            }
             if (mLocalRef != NULL) {
                 mEnv->DeleteLocalRef(mLocalRef);
             }
@@ -44,6 +51,9 @@ public:
 
     T release() __attribute__((warn_unused_result)) {
         T localRef = mLocalRef;
+        if (localRef != NULL && JNI_LIGHT_CHECK_ENABLED()) {
+            jniLightCheckLocalRef(-1);
+        }
         mLocalRef = NULL;
         return localRef;
     }
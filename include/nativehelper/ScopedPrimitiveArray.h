@@ -18,6 +18,8 @@
 #define SCOPED_PRIMITIVE_ARRAY_H_included
 
 #include "JNIHelp.h"
+#include "JniCheck.h"
+#include "JniTrace.h"
 
 // ScopedBooleanArrayRO, ScopedByteArrayRO, ScopedCharArrayRO, ScopedDoubleArrayRO,
 // ScopedFloatArrayRO, ScopedIntArrayRO, ScopedLongArrayRO, and ScopedShortArrayRO provide
@@ -40,18 +42,27 @@
             } \
         } \
         ~Scoped ## NAME ## ArrayRO() { \
+            if (mRawArray != NULL) { \
+                JNI_TRACE1(array_release, mSize * sizeof(PRIMITIVE_TYPE)); \
+            } \
             if (mRawArray != NULL && mRawArray != mBuffer) { \
                 mEnv->Release ## NAME ## ArrayElements(mJavaArray, mRawArray, JNI_ABORT); \
             } \
         } \
         void reset(PRIMITIVE_TYPE ## Array javaArray) { \
+            JNI_LIGHT_CHECK(mEnv, "Scoped" #NAME "ArrayRO"); \
             mJavaArray = javaArray; \
             mSize = mEnv->GetArrayLength(mJavaArray); \
+            jboolean isCopy = JNI_TRUE; \
             if (mSize <= buffer_size) { \
                 mEnv->Get ## NAME ## ArrayRegion(mJavaArray, 0, mSize, mBuffer); \
                 mRawArray = mBuffer; \
             } else { \
-                mRawArray = mEnv->Get ## NAME ## ArrayElements(mJavaArray, NULL); \
+                mRawArray = mEnv->Get ## NAME ## ArrayElements(mJavaArray, &isCopy); \
+            } \
+            if (mRawArray != NULL) { \
+                jniHelpCountArrayBytes(mSize * sizeof(PRIMITIVE_TYPE), isCopy); \
+                JNI_TRACE2(array_acquire, mSize * sizeof(PRIMITIVE_TYPE), isCopy); \
             } \
         } \
         const PRIMITIVE_TYPE* get() const { return mRawArray; } \
@@ -87,34 +98,55 @@ INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_RO(jshort, Short);
     class Scoped ## NAME ## ArrayRW { \
     public: \
         explicit Scoped ## NAME ## ArrayRW(JNIEnv* env) \
-        : mEnv(env), mJavaArray(NULL), mRawArray(NULL) {} \
+        : mEnv(env), mJavaArray(NULL), mRawArray(NULL), mSize(-1), mIsCopy(JNI_FALSE) {} \
         Scoped ## NAME ## ArrayRW(JNIEnv* env, PRIMITIVE_TYPE ## Array javaArray) \
-        : mEnv(env), mJavaArray(javaArray), mRawArray(NULL) { \
+        : mEnv(env), mJavaArray(javaArray), mRawArray(NULL), mSize(-1), mIsCopy(JNI_FALSE) { \
             if (mJavaArray == NULL) { \
                 jniThrowNullPointerException(mEnv, NULL); \
             } else { \
-                mRawArray = mEnv->Get ## NAME ## ArrayElements(mJavaArray, NULL); \
+                acquire(); \
             } \
         } \
         ~Scoped ## NAME ## ArrayRW() { \
             if (mRawArray) { \
+                /* Counted only if the length was fetched anyway. */ \
+                if (mSize >= 0) { \
+                    jniHelpCountArrayBytes(mSize * sizeof(PRIMITIVE_TYPE), mIsCopy); \
+                } \
+                JNI_TRACE1(array_release, size() * sizeof(PRIMITIVE_TYPE)); \
                 mEnv->Release ## NAME ## ArrayElements(mJavaArray, mRawArray, 0); \
             } \
         } \
         void reset(PRIMITIVE_TYPE ## Array javaArray) { \
             mJavaArray = javaArray; \
-            mRawArray = mEnv->Get ## NAME ## ArrayElements(mJavaArray, NULL); \
+            acquire(); \
         } \
         const PRIMITIVE_TYPE* get() const { return mRawArray; } \
         PRIMITIVE_TYPE ## Array getJavaArray() const { return mJavaArray; } \
         const PRIMITIVE_TYPE& operator[](size_t n) const { return mRawArray[n]; } \
         PRIMITIVE_TYPE* get() { return mRawArray; } \
         PRIMITIVE_TYPE& operator[](size_t n) { return mRawArray[n]; } \
-        size_t size() const { return mEnv->GetArrayLength(mJavaArray); } \
+        size_t size() const { \
+            if (mSize < 0) { \
+                mSize = mEnv->GetArrayLength(mJavaArray); \
+            } \
+            return mSize; \
+        } \
     private: \
+        void acquire() { \
+            JNI_LIGHT_CHECK(mEnv, "Scoped" #NAME "ArrayRW"); \
+            mSize = -1; \
+            mIsCopy = JNI_FALSE; \
+            mRawArray = mEnv->Get ## NAME ## ArrayElements(mJavaArray, &mIsCopy); \
+            if (mRawArray != NULL) { \
+                JNI_TRACE2(array_acquire, size() * sizeof(PRIMITIVE_TYPE), mIsCopy); \
+            } \
+        } \
         JNIEnv* const mEnv; \
         PRIMITIVE_TYPE ## Array mJavaArray; \
         PRIMITIVE_TYPE* mRawArray; \
+        mutable jsize mSize;  /* -1 until size() fetches it. */ \
+        jboolean mIsCopy; \
         DISALLOW_COPY_AND_ASSIGN(Scoped ## NAME ## ArrayRW); \
     }
 
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCOPED_PRIMITIVE_ARRAY_CRITICAL_H_included
+#define SCOPED_PRIMITIVE_ARRAY_CRITICAL_H_included
+
+#include "JNIHelp.h"
+#include "JniCheck.h"
+#include "JniCriticalMonitor.h"
+
+// Provides direct access to a Java primitive array through
+// GetPrimitiveArrayCritical, for short loops that must not copy. No JNI calls
+// may be made, and the thread must not block, while an instance is alive; the
+// runtime may hold off the GC until it is destroyed. Like the other Scoped
+// helpers, a null array throws NullPointerException and get() returns NULL.
+//
+// As with ScopedPrimitiveArray.h, there are read-only and read-write
+// flavors: ScopedXxxArrayCriticalRO gives const access and releases with
+// JNI_ABORT, so a runtime that handed out a copy need not write it back;
+// ScopedXxxArrayCriticalRW (also spelled ScopedXxxArrayCritical) writes
+// changes back on release.
+//
+// Hold times are reported through JniCriticalMonitor.h when enabled.
+template<typename T, typename JavaArrayT, jint kReleaseMode>
+class ScopedPrimitiveArrayCriticalBase {
+public:
+    JNI_CRITICAL_ALWAYS_INLINE ScopedPrimitiveArrayCriticalBase(JNIEnv* env, JavaArrayT javaArray)
+    : mEnv(env), mJavaArray(javaArray), mRawArray(NULL), mSize(0), mSite(NULL), mStartNs(0) {
+        JNI_LIGHT_CHECK(mEnv, "ScopedPrimitiveArrayCritical");
+        if (mJavaArray == NULL) {
+            jniThrowNullPointerException(mEnv, NULL);
+        } else {
+            // Outside the critical region, where JNI calls are still allowed.
+            mSize = mEnv->GetArrayLength(mJavaArray);
+            if (__atomic_load_n(&jniCriticalHoldThresholdNs, __ATOMIC_RELAXED) != 0) {
+                mSite = jniCriticalMonitorSite();
+                mStartNs = jniCriticalMonitorNow();
+            }
+            mRawArray = static_cast<T*>(mEnv->GetPrimitiveArrayCritical(mJavaArray, NULL));
+            if (mRawArray != NULL && JNI_LIGHT_CHECK_ENABLED()) {
+                jniLightCheckCriticalEnter();
+            }
+        }
+    }
+
+    ~ScopedPrimitiveArrayCriticalBase() {
+        if (mRawArray != NULL) {
+            mEnv->ReleasePrimitiveArrayCritical(mJavaArray, mRawArray, kReleaseMode);
+            if (JNI_LIGHT_CHECK_ENABLED()) {
+                jniLightCheckCriticalExit();
+            }
+            if (mStartNs != 0) {
+                jniCriticalMonitorRecord(mSite, mStartNs, mSize * sizeof(T));
+            }
+        }
+    }
+
+    const T* get() const { return mRawArray; }
+    const T& operator[](size_t n) const { return mRawArray[n]; }
+    JavaArrayT getJavaArray() const { return mJavaArray; }
+    size_t size() const { return mSize; }
+
+protected:
+    JNIEnv* const mEnv;
+    const JavaArrayT mJavaArray;
+    T* mRawArray;
+    size_t mSize;
+    const void* mSite;
+    uint64_t mStartNs;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(ScopedPrimitiveArrayCriticalBase);
+};
+
+template<typename T, typename JavaArrayT = jarray>
+class ScopedPrimitiveArrayCriticalRO
+        : public ScopedPrimitiveArrayCriticalBase<T, JavaArrayT, JNI_ABORT> {
+public:
+    JNI_CRITICAL_ALWAYS_INLINE ScopedPrimitiveArrayCriticalRO(JNIEnv* env, JavaArrayT javaArray)
+    : ScopedPrimitiveArrayCriticalBase<T, JavaArrayT, JNI_ABORT>(env, javaArray) {
+    }
+};
+
+template<typename T, typename JavaArrayT = jarray>
+class ScopedPrimitiveArrayCritical : public ScopedPrimitiveArrayCriticalBase<T, JavaArrayT, 0> {
+public:
+    JNI_CRITICAL_ALWAYS_INLINE ScopedPrimitiveArrayCritical(JNIEnv* env, JavaArrayT javaArray)
+    : ScopedPrimitiveArrayCriticalBase<T, JavaArrayT, 0>(env, javaArray) {
+    }
+
+    using ScopedPrimitiveArrayCriticalBase<T, JavaArrayT, 0>::get;
+    using ScopedPrimitiveArrayCriticalBase<T, JavaArrayT, 0>::operator[];
+    T* get() { return this->mRawArray; }
+    T& operator[](size_t n) { return this->mRawArray[n]; }
+};
+
+#define INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_CRITICAL(PRIMITIVE_TYPE, NAME) \
+    typedef ScopedPrimitiveArrayCriticalRO<PRIMITIVE_TYPE, PRIMITIVE_TYPE ## Array> \
+            Scoped ## NAME ## ArrayCriticalRO; \
+    typedef ScopedPrimitiveArrayCritical<PRIMITIVE_TYPE, PRIMITIVE_TYPE ## Array> \
+            Scoped ## NAME ## ArrayCriticalRW; \
+    typedef Scoped ## NAME ## ArrayCriticalRW Scoped ## NAME ## ArrayCritical
+
+INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_CRITICAL(jboolean, Boolean);
+INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_CRITICAL(jbyte, Byte);
+INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_CRITICAL(jchar, Char);
+INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_CRITICAL(jdouble, Double);
+INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_CRITICAL(jfloat, Float);
+INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_CRITICAL(jint, Int);
+INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_CRITICAL(jlong, Long);
+INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_CRITICAL(jshort, Short);
+
+#undef INSTANTIATE_SCOPED_PRIMITIVE_ARRAY_CRITICAL
+
+#endif  // SCOPED_PRIMITIVE_ARRAY_CRITICAL_H_included
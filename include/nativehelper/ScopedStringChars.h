@@ -18,6 +18,8 @@
 #define SCOPED_STRING_CHARS_H_included
 
 #include "JNIHelp.h"
+#include "JniCheck.h"
+#include "JniTrace.h"
 
 // A smart pointer that provides access to a jchar* given a JNI jstring.
 // Unlike GetStringChars, we throw NullPointerException rather than abort if
@@ -31,19 +33,23 @@
 class ScopedStringChars {
  public:
   ScopedStringChars(JNIEnv* env, jstring s) : env_(env), string_(s), size_(0) {
+    JNI_LIGHT_CHECK(env, "ScopedStringChars");
     if (s == NULL) {
       chars_ = NULL;
       jniThrowNullPointerException(env, NULL);
     } else {
-      chars_ = env->GetStringChars(string_, NULL);
+      jboolean is_copy = JNI_FALSE;
+      chars_ = env->GetStringChars(string_, &is_copy);
       if (chars_ != NULL) {
         size_ = env->GetStringLength(string_);
+        JNI_TRACE2(string_acquire, size_, is_copy);
       }
     }
   }
 
   ~ScopedStringChars() {
     if (chars_ != NULL) {
+      JNI_TRACE1(string_release, size_);
       env_->ReleaseStringChars(string_, chars_);
     }
   }
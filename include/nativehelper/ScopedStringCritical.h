@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCOPED_STRING_CRITICAL_H_included
+#define SCOPED_STRING_CRITICAL_H_included
+
+#include "JNIHelp.h"
+#include "JniCheck.h"
+#include "JniCriticalMonitor.h"
+
+// Like ScopedStringChars, but through GetStringCritical, with the same
+// restrictions as ScopedPrimitiveArrayCritical: no JNI calls and no blocking
+// while an instance is alive. Hold times are reported through
+// JniCriticalMonitor.h when enabled.
+class ScopedStringCritical {
+ public:
+  JNI_CRITICAL_ALWAYS_INLINE ScopedStringCritical(JNIEnv* env, jstring s)
+      : env_(env), string_(s), chars_(NULL), size_(0), site_(NULL), start_ns_(0) {
+    JNI_LIGHT_CHECK(env, "ScopedStringCritical");
+    if (s == NULL) {
+      jniThrowNullPointerException(env, NULL);
+    } else {
+      size_ = env->GetStringLength(s);
+      if (__atomic_load_n(&jniCriticalHoldThresholdNs, __ATOMIC_RELAXED) != 0) {
+        site_ = jniCriticalMonitorSite();
+        start_ns_ = jniCriticalMonitorNow();
+      }
+      chars_ = env->GetStringCritical(s, NULL);
+      if (chars_ != NULL && JNI_LIGHT_CHECK_ENABLED()) {
+        jniLightCheckCriticalEnter();
+      }
+    }
+  }
+
+  ~ScopedStringCritical() {
+    if (chars_ != NULL) {
+      env_->ReleaseStringCritical(string_, chars_);
+      if (JNI_LIGHT_CHECK_ENABLED()) {
+        jniLightCheckCriticalExit();
+      }
+      if (start_ns_ != 0) {
+        jniCriticalMonitorRecord(site_, start_ns_, size_ * sizeof(jchar));
+      }
+    }
+  }
+
+  const jchar* get() const {
+    return chars_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  const jchar& operator[](size_t n) const {
+    return chars_[n];
+  }
+
+ private:
+  JNIEnv* const env_;
+  const jstring string_;
+  const jchar* chars_;
+  size_t size_;
+  const void* site_;
+  uint64_t start_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedStringCritical);
+};
+
+#endif  // SCOPED_STRING_CRITICAL_H_included
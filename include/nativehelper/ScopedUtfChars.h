@@ -18,6 +18,8 @@
 #define SCOPED_UTF_CHARS_H_included
 
 #include "JNIHelp.h"
+#include "JniCheck.h"
+#include "JniTrace.h"
 #include <string.h>
 
 // A smart pointer that provides read-only access to a Java string's UTF chars.
@@ -32,16 +34,22 @@
 class ScopedUtfChars {
  public:
   ScopedUtfChars(JNIEnv* env, jstring s) : env_(env), string_(s) {
+    JNI_LIGHT_CHECK(env, "ScopedUtfChars");
     if (s == NULL) {
       utf_chars_ = NULL;
       jniThrowNullPointerException(env, NULL);
     } else {
-      utf_chars_ = env->GetStringUTFChars(s, NULL);
+      jboolean is_copy = JNI_FALSE;
+      utf_chars_ = env->GetStringUTFChars(s, &is_copy);
+      if (utf_chars_ != NULL) {
+        JNI_TRACE2(string_acquire, strlen(utf_chars_), is_copy);
+      }
     }
   }
 
   ~ScopedUtfChars() {
     if (utf_chars_) {
+      JNI_TRACE1(string_release, strlen(utf_chars_));
       env_->ReleaseStringUTFChars(string_, utf_chars_);
     }
   }
@@ -18,6 +18,7 @@
 #define TO_STRING_ARRAY_H_included
 
 #include "jni.h"
+#include "JniStringCache.h"
 #include "ScopedLocalRef.h"
 
 #include <string>
@@ -25,15 +26,18 @@
 
 jobjectArray newStringArray(JNIEnv* env, size_t count);
 
+// With cached set, the Strings come from JniStringCache.h.
 template <typename Counter, typename Getter>
-jobjectArray toStringArray(JNIEnv* env, Counter* counter, Getter* getter) {
+jobjectArray toStringArray(JNIEnv* env, Counter* counter, Getter* getter, bool cached = false) {
     size_t count = (*counter)();
     jobjectArray result = newStringArray(env, count);
     if (result == NULL) {
         return NULL;
     }
     for (size_t i = 0; i < count; ++i) {
-        ScopedLocalRef<jstring> s(env, env->NewStringUTF((*getter)(i)));
+        const char* utf8 = (*getter)(i);
+        ScopedLocalRef<jstring> s(env, cached ? jniGetCachedStringUTF(env, utf8)
+                                              : env->NewStringUTF(utf8));
         if (env->ExceptionCheck()) {
             return NULL;
         }
@@ -68,4 +72,13 @@ inline jobjectArray toStringArray(JNIEnv* env, const std::vector<std::string>& s
 
 JNIEXPORT jobjectArray toStringArray(JNIEnv* env, const char* const* strings);
 
+// As toStringArray, for strings that recur from call to call.
+inline jobjectArray toCachedStringArray(JNIEnv* env, const std::vector<std::string>& strings) {
+    VectorCounter counter(strings);
+    VectorGetter getter(strings);
+    return toStringArray<VectorCounter, VectorGetter>(env, &counter, &getter, true);
+}
+
+JNIEXPORT jobjectArray toCachedStringArray(JNIEnv* env, const char* const* strings);
+
 #endif  // TO_STRING_ARRAY_H_included
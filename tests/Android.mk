@@ -19,3 +19,59 @@ LOCAL_CLANG := true
 LOCAL_SRC_FILES := JniInvocation_test.cpp
 LOCAL_SHARED_LIBRARIES := libnativehelper
 include $(BUILD_HOST_NATIVE_TEST)
+
+# Fake JNI runtime, loaded through JniInvocation by the host tests below.
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libnativehelper_fakejni
+LOCAL_CLANG := true
+LOCAL_SRC_FILES := FakeJniRuntime.cpp
+LOCAL_CFLAGS := -Werror -fvisibility=hidden
+LOCAL_MULTILIB := both
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# Host unit test for the helpers, run against the fake runtime: one source file
+# per module, all on the JniTest fixture. It is built with the tracepoints when
+# the library is (NATIVEHELPER_ENABLE_USDT=true), so that the probes in the
+# Scoped* headers are compiled and tested that way too.
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := JNIHelp_test
+LOCAL_CLANG := true
+LOCAL_SRC_FILES := \
+    JNIHelp_test.cpp \
+    JniAccessPolicy_test.cpp \
+    JniBufferPool_test.cpp \
+    JniByteCursor_test.cpp \
+    JniBytes_test.cpp \
+    JniCallRecorder_test.cpp \
+    JniCheck_test.cpp \
+    JniCriticalMonitor_test.cpp \
+    JniDispatcher_test.cpp \
+    JniHandleTable_test.cpp \
+    JniListenerRegistry_test.cpp \
+    JniMappedFile_test.cpp \
+    JniParallel_test.cpp \
+    JniRingBuffer_test.cpp \
+    JniScratch_test.cpp \
+    JniStringCache_test.cpp \
+    JniStringKernels_test.cpp \
+    JniTrace_test.cpp \
+    ScopedHelpers_test.cpp \
+    JniTestEnvironment.cpp
+ifeq ($(NATIVEHELPER_ENABLE_USDT),true)
+LOCAL_CFLAGS := -DNATIVEHELPER_ENABLE_USDT
+endif
+LOCAL_SHARED_LIBRARIES := libnativehelper
+LOCAL_REQUIRED_MODULES := libnativehelper_fakejni
+include $(BUILD_HOST_NATIVE_TEST)
+
+# Host unit test for JavaVMOptions.
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := JavaVMOptions_test
+LOCAL_CLANG := true
+LOCAL_SRC_FILES := JavaVMOptions_test.cpp
+LOCAL_SHARED_LIBRARIES := libnativehelper
+LOCAL_REQUIRED_MODULES := libnativehelper_fakejni
+include $(BUILD_HOST_NATIVE_TEST)
@@ -0,0 +1,1381 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeJniRuntime.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum ObjectKind {
+    kInstance,
+    kClass,
+    kString,
+    kPrimitiveArray,
+    kObjectArray,
+    kDirectBuffer,
+};
+
+struct FakeMethod {
+    std::string name;
+    std::string signature;
+};
+
+struct FakeField {
+    std::string name;
+    std::string signature;
+};
+
+struct FakeObject {
+    FakeObject(ObjectKind kind, FakeObject* klass)
+    : kind(kind), klass(klass), length(0), address(NULL), capacity(0), pinCount(0), marked(false) {
+    }
+
+    ObjectKind kind;
+    FakeObject* klass;
+
+    // kClass: the binary name, e.g. "java/lang/String" or "[B".
+    std::string name;
+    // kClass: registered natives, keyed by name + signature.
+    std::map<std::string, void*> natives;
+
+    // kString contents, and the buffer of a java.io.StringWriter.
+    std::vector<jchar> chars;
+
+    // kPrimitiveArray and kObjectArray.
+    jsize length;
+    std::vector<jlong> storage;  // jlong keeps every element type aligned.
+    std::vector<FakeObject*> elements;
+
+    // kDirectBuffer.
+    void* address;
+    jlong capacity;
+
+    // kInstance fields, keyed by name.
+    std::map<std::string, jvalue> primitiveFields;
+    std::map<std::string, FakeObject*> objectFields;
+
+    int pinCount;
+    bool marked;
+
+    void* data() { return storage.empty() ? NULL : &storage[0]; }
+};
+
+struct FakeVm;
+
+struct FakeEnv {
+    JNIEnv jniEnv;  // Must be first: JNIEnv* and FakeEnv* are interchangeable.
+    FakeVm* vm;
+    std::vector<std::vector<FakeObject*> > frames;
+    jint localRefCount;
+    FakeObject* pendingException;
+};
+
+// A copy handed out by Get<Type>ArrayElements, Get*Chars or GetStringUTFChars.
+struct Copy {
+    FakeObject* source;
+    size_t byteCount;
+};
+
+struct FakeVm {
+    JavaVM javaVm;  // Must be first: JavaVM* and FakeVm* are interchangeable.
+    std::mutex lock;
+
+    bool copyMode;
+    jint maxLocalRefs;
+    std::set<std::string> hiddenClasses;
+
+    std::vector<std::unique_ptr<FakeObject> > heap;
+    size_t nextCollection;
+    std::map<std::string, FakeObject*> classes;
+    std::map<std::string, std::unique_ptr<FakeMethod> > methods;
+    std::map<std::string, std::unique_ptr<FakeField> > fields;
+    std::map<FakeObject*, int> globals;
+    std::map<const void*, Copy> copies;
+    std::set<FakeEnv*> envs;
+};
+
+const JNINativeInterface* gNativeInterface;
+const JNIInvokeInterface* gInvokeInterface;
+FakeVm* gVm = NULL;
+thread_local FakeEnv* gCurrentEnv = NULL;
+
+FakeEnv* fromEnv(JNIEnv* env) {
+    return reinterpret_cast<FakeEnv*>(env);
+}
+
+FakeVm* fromVm(JavaVM* vm) {
+    return reinterpret_cast<FakeVm*>(vm);
+}
+
+FakeObject* fromRef(jobject ref) {
+    return reinterpret_cast<FakeObject*>(ref);
+}
+
+void fatal(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "fake JNI: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    abort();
+}
+
+//
+// Heap.
+//
+
+void mark(FakeObject* object) {
+    std::vector<FakeObject*> stack;
+    stack.push_back(object);
+    while (!stack.empty()) {
+        FakeObject* o = stack.back();
+        stack.pop_back();
+        if (o == NULL || o->marked) {
+            continue;
+        }
+        o->marked = true;
+        stack.push_back(o->klass);
+        stack.insert(stack.end(), o->elements.begin(), o->elements.end());
+        for (std::map<std::string, FakeObject*>::iterator it = o->objectFields.begin();
+             it != o->objectFields.end(); ++it) {
+            stack.push_back(it->second);
+        }
+    }
+}
+
+// Mark-sweep over every reference the runtime can see. Only called on entry
+// to a JNI function, so no unrooted temporaries exist yet.
+void collect(FakeVm* vm) {
+    for (std::map<std::string, FakeObject*>::iterator it = vm->classes.begin();
+         it != vm->classes.end(); ++it) {
+        mark(it->second);
+    }
+    for (std::map<FakeObject*, int>::iterator it = vm->globals.begin();
+         it != vm->globals.end(); ++it) {
+        mark(it->first);
+    }
+    for (std::map<const void*, Copy>::iterator it = vm->copies.begin();
+         it != vm->copies.end(); ++it) {
+        mark(it->second.source);
+    }
+    for (std::set<FakeEnv*>::iterator it = vm->envs.begin(); it != vm->envs.end(); ++it) {
+        FakeEnv* env = *it;
+        mark(env->pendingException);
+        for (size_t i = 0; i < env->frames.size(); ++i) {
+            for (size_t j = 0; j < env->frames[i].size(); ++j) {
+                mark(env->frames[i][j]);
+            }
+        }
+    }
+    size_t live = 0;
+    for (size_t i = 0; i < vm->heap.size(); ++i) {
+        FakeObject* o = vm->heap[i].get();
+        if (o->marked || o->pinCount > 0) {
+            o->marked = false;
+            vm->heap[live++].swap(vm->heap[i]);
+        }
+    }
+    vm->heap.resize(live);
+    vm->nextCollection = live * 2 > 4096 ? live * 2 : 4096;
+}
+
+void maybeCollect(FakeVm* vm) {
+    if (vm->heap.size() >= vm->nextCollection) {
+        collect(vm);
+    }
+}
+
+FakeObject* allocate(FakeVm* vm, ObjectKind kind, FakeObject* klass) {
+    vm->heap.push_back(std::unique_ptr<FakeObject>(new FakeObject(kind, klass)));
+    return vm->heap.back().get();
+}
+
+FakeObject* findOrCreateClass(FakeVm* vm, const std::string& name) {
+    std::map<std::string, FakeObject*>::iterator it = vm->classes.find(name);
+    if (it != vm->classes.end()) {
+        return it->second;
+    }
+    FakeObject* classClass = NULL;
+    if (name != "java/lang/Class") {
+        classClass = findOrCreateClass(vm, "java/lang/Class");
+    }
+    FakeObject* klass = allocate(vm, kClass, classClass);
+    if (classClass == NULL) {
+        klass->klass = klass;
+    }
+    klass->name = name;
+    vm->classes[name] = klass;
+    return klass;
+}
+
+FakeObject* arrayClassOf(FakeVm* vm, FakeObject* elementClass) {
+    const std::string& name = elementClass->name;
+    if (name[0] == '[') {
+        return findOrCreateClass(vm, "[" + name);
+    }
+    return findOrCreateClass(vm, "[L" + name + ";");
+}
+
+//
+// Strings. The runtime stores UTF-16 and speaks modified UTF-8.
+//
+
+std::vector<jchar> decodeModifiedUtf8(const char* utf) {
+    std::vector<jchar> result;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(utf);
+    while (*p != 0) {
+        unsigned char c = *p++;
+        if (c < 0x80) {
+            result.push_back(c);
+        } else if ((c & 0xe0) == 0xc0 && *p != 0) {
+            result.push_back(((c & 0x1f) << 6) | (*p++ & 0x3f));
+        } else if ((c & 0xf0) == 0xe0 && p[0] != 0 && p[1] != 0) {
+            result.push_back(((c & 0x0f) << 12) | ((p[0] & 0x3f) << 6) | (p[1] & 0x3f));
+            p += 2;
+        } else if ((c & 0xf8) == 0xf0 && p[0] != 0 && p[1] != 0 && p[2] != 0) {
+            // Standard four-byte UTF-8 is accepted leniently, like ART does.
+            unsigned int cp = ((c & 0x07) << 18) | ((p[0] & 0x3f) << 12) |
+                    ((p[1] & 0x3f) << 6) | (p[2] & 0x3f);
+            p += 3;
+            cp -= 0x10000;
+            result.push_back(0xd800 | (cp >> 10));
+            result.push_back(0xdc00 | (cp & 0x3ff));
+        } else {
+            result.push_back(0xfffd);
+        }
+    }
+    return result;
+}
+
+std::string encodeModifiedUtf8(const jchar* chars, size_t length) {
+    std::string result;
+    for (size_t i = 0; i < length; ++i) {
+        jchar c = chars[i];
+        if (c != 0 && c < 0x80) {
+            result += static_cast<char>(c);
+        } else if (c < 0x800) {
+            result += static_cast<char>(0xc0 | (c >> 6));
+            result += static_cast<char>(0x80 | (c & 0x3f));
+        } else {
+            result += static_cast<char>(0xe0 | (c >> 12));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            result += static_cast<char>(0x80 | (c & 0x3f));
+        }
+    }
+    return result;
+}
+
+std::string toUtf8(const FakeObject* string) {
+    return encodeModifiedUtf8(string->chars.empty() ? NULL : &string->chars[0],
+                              string->chars.size());
+}
+
+FakeObject* newString(FakeVm* vm, const std::vector<jchar>& chars) {
+    FakeObject* string = allocate(vm, kString, findOrCreateClass(vm, "java/lang/String"));
+    string->chars = chars;
+    return string;
+}
+
+FakeObject* newStringUtf(FakeVm* vm, const char* utf) {
+    return newString(vm, decodeModifiedUtf8(utf));
+}
+
+//
+// References.
+//
+
+jobject addLocal(FakeEnv* env, FakeObject* object) {
+    if (object == NULL) {
+        return NULL;
+    }
+    if (env->localRefCount >= env->vm->maxLocalRefs) {
+        fatal("local reference table overflow (max=%d)", env->vm->maxLocalRefs);
+    }
+    env->frames.back().push_back(object);
+    ++env->localRefCount;
+    return reinterpret_cast<jobject>(object);
+}
+
+template<typename T>
+T addLocalAs(FakeEnv* env, FakeObject* object) {
+    return reinterpret_cast<T>(addLocal(env, object));
+}
+
+bool removeLocal(FakeEnv* env, FakeObject* object) {
+    for (size_t i = env->frames.size(); i-- > 0;) {
+        std::vector<FakeObject*>& frame = env->frames[i];
+        for (size_t j = frame.size(); j-- > 0;) {
+            if (frame[j] == object) {
+                frame.erase(frame.begin() + j);
+                --env->localRefCount;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void throwNew(FakeEnv* env, const char* className, const std::string& message) {
+    FakeVm* vm = env->vm;
+    FakeObject* throwable = allocate(vm, kInstance, findOrCreateClass(vm, className));
+    throwable->objectFields["detailMessage"] = newStringUtf(vm, message.c_str());
+    env->pendingException = throwable;
+}
+
+bool checkRange(FakeEnv* env, const char* exceptionClass, jsize length, jsize start, jsize count) {
+    if (start < 0 || count < 0 || start > length - count) {
+        char message[128];
+        snprintf(message, sizeof(message), "length=%d; regionStart=%d; regionLength=%d",
+                 length, start, count);
+        throwNew(env, exceptionClass, message);
+        return false;
+    }
+    return true;
+}
+
+typedef std::lock_guard<std::mutex> VmLock;
+
+#define LOCK_VM(env) FakeEnv* fenv = fromEnv(env); FakeVm* vm = fenv->vm; VmLock vmLock(vm->lock)
+
+//
+// JNINativeInterface.
+//
+
+jint GetVersion(JNIEnv*) {
+    return JNI_VERSION_1_6;
+}
+
+jclass FindClass(JNIEnv* env, const char* name) {
+    LOCK_VM(env);
+    maybeCollect(vm);
+    if (name == NULL || vm->hiddenClasses.count(name) != 0) {
+        throwNew(fenv, "java/lang/NoClassDefFoundError", name != NULL ? name : "null");
+        return NULL;
+    }
+    return addLocalAs<jclass>(fenv, findOrCreateClass(vm, name));
+}
+
+jclass GetSuperclass(JNIEnv* env, jclass clazz) {
+    LOCK_VM(env);
+    if (fromRef(clazz)->name == "java/lang/Object") {
+        return NULL;
+    }
+    return addLocalAs<jclass>(fenv, findOrCreateClass(vm, "java/lang/Object"));
+}
+
+jboolean isAssignable(FakeObject* from, FakeObject* to) {
+    return from == to || to->name == "java/lang/Object";
+}
+
+jboolean IsAssignableFrom(JNIEnv* env, jclass clazz1, jclass clazz2) {
+    LOCK_VM(env);
+    return isAssignable(fromRef(clazz1), fromRef(clazz2));
+}
+
+jint Throw(JNIEnv* env, jthrowable obj) {
+    LOCK_VM(env);
+    fenv->pendingException = fromRef(obj);
+    return JNI_OK;
+}
+
+jint ThrowNew(JNIEnv* env, jclass clazz, const char* message) {
+    LOCK_VM(env);
+    maybeCollect(vm);
+    FakeObject* throwable = allocate(vm, kInstance, fromRef(clazz));
+    if (message != NULL) {
+        throwable->objectFields["detailMessage"] = newStringUtf(vm, message);
+    }
+    fenv->pendingException = throwable;
+    return JNI_OK;
+}
+
+jthrowable ExceptionOccurred(JNIEnv* env) {
+    LOCK_VM(env);
+    return addLocalAs<jthrowable>(fenv, fenv->pendingException);
+}
+
+void ExceptionDescribe(JNIEnv* env) {
+    LOCK_VM(env);
+    FakeObject* exception = fenv->pendingException;
+    if (exception != NULL) {
+        FakeObject* message = exception->objectFields["detailMessage"];
+        fprintf(stderr, "%s: %s\n", exception->klass->name.c_str(),
+                message != NULL ? toUtf8(message).c_str() : "null");
+    }
+    fenv->pendingException = NULL;
+}
+
+void ExceptionClear(JNIEnv* env) {
+    LOCK_VM(env);
+    fenv->pendingException = NULL;
+}
+
+void FatalError(JNIEnv*, const char* msg) {
+    fatal("FatalError: %s", msg);
+}
+
+jint PushLocalFrame(JNIEnv* env, jint) {
+    LOCK_VM(env);
+    fenv->frames.push_back(std::vector<FakeObject*>());
+    return JNI_OK;
+}
+
+jobject PopLocalFrame(JNIEnv* env, jobject result) {
+    LOCK_VM(env);
+    if (fenv->frames.size() <= 1) {
+        fatal("PopLocalFrame without a matching PushLocalFrame");
+    }
+    fenv->localRefCount -= fenv->frames.back().size();
+    fenv->frames.pop_back();
+    return addLocal(fenv, fromRef(result));
+}
+
+jobject NewGlobalRef(JNIEnv* env, jobject obj) {
+    LOCK_VM(env);
+    if (obj == NULL) {
+        return NULL;
+    }
+    ++vm->globals[fromRef(obj)];
+    return obj;
+}
+
+void DeleteGlobalRef(JNIEnv* env, jobject globalRef) {
+    LOCK_VM(env);
+    std::map<FakeObject*, int>::iterator it = vm->globals.find(fromRef(globalRef));
+    if (it != vm->globals.end() && --it->second == 0) {
+        vm->globals.erase(it);
+    }
+}
+
+void DeleteLocalRef(JNIEnv* env, jobject localRef) {
+    LOCK_VM(env);
+    if (localRef != NULL) {
+        removeLocal(fenv, fromRef(localRef));
+    }
+}
+
+jboolean IsSameObject(JNIEnv*, jobject ref1, jobject ref2) {
+    return ref1 == ref2;
+}
+
+jobject NewLocalRef(JNIEnv* env, jobject ref) {
+    LOCK_VM(env);
+    return addLocal(fenv, fromRef(ref));
+}
+
+jint EnsureLocalCapacity(JNIEnv* env, jint capacity) {
+    LOCK_VM(env);
+    return fenv->localRefCount + capacity <= vm->maxLocalRefs ? JNI_OK : JNI_ERR;
+}
+
+jobject AllocObject(JNIEnv* env, jclass clazz) {
+    LOCK_VM(env);
+    maybeCollect(vm);
+    return addLocal(fenv, allocate(vm, kInstance, fromRef(clazz)));
+}
+
+jobject NewObjectV(JNIEnv* env, jclass clazz, jmethodID methodID, va_list args) {
+    LOCK_VM(env);
+    maybeCollect(vm);
+    FakeObject* object = allocate(vm, kInstance, fromRef(clazz));
+    const FakeMethod* method = reinterpret_cast<const FakeMethod*>(methodID);
+    if (method->signature == "(Ljava/io/Writer;)V") {
+        // java.io.PrintWriter(Writer out).
+        object->objectFields["out"] = fromRef(va_arg(args, jobject));
+    }
+    return addLocal(fenv, object);
+}
+
+jobject NewObject(JNIEnv* env, jclass clazz, jmethodID methodID, ...) {
+    va_list args;
+    va_start(args, methodID);
+    jobject result = NewObjectV(env, clazz, methodID, args);
+    va_end(args);
+    return result;
+}
+
+jclass GetObjectClass(JNIEnv* env, jobject obj) {
+    LOCK_VM(env);
+    return addLocalAs<jclass>(fenv, fromRef(obj)->klass);
+}
+
+jboolean IsInstanceOf(JNIEnv* env, jobject obj, jclass clazz) {
+    LOCK_VM(env);
+    if (obj == NULL) {
+        return JNI_TRUE;
+    }
+    return isAssignable(fromRef(obj)->klass, fromRef(clazz));
+}
+
+jmethodID GetMethodID(JNIEnv* env, jclass, const char* name, const char* sig) {
+    LOCK_VM(env);
+    std::unique_ptr<FakeMethod>& method = vm->methods[std::string(name) + sig];
+    if (method == NULL) {
+        method.reset(new FakeMethod);
+        method->name = name;
+        method->signature = sig;
+    }
+    return reinterpret_cast<jmethodID>(method.get());
+}
+
+// Implements the few library methods the helpers rely on. Everything else
+// returns zero.
+jvalue invokeBuiltin(FakeEnv* env, FakeObject* receiver, jmethodID methodID, va_list args) {
+    FakeVm* vm = env->vm;
+    const FakeMethod* method = reinterpret_cast<const FakeMethod*>(methodID);
+    jvalue result;
+    result.j = 0;
+    if (receiver == NULL) {
+        throwNew(env, "java/lang/NullPointerException", method->name);
+        return result;
+    }
+    const std::string& className = receiver->klass->name;
+    if (method->name == "getName" && receiver->kind == kClass) {
+        std::string name(receiver->name);
+        for (size_t i = 0; i < name.size(); ++i) {
+            if (name[i] == '/') {
+                name[i] = '.';
+            }
+        }
+        result.l = addLocal(env, newStringUtf(vm, name.c_str()));
+    } else if (method->name == "asReadOnlyBuffer" && receiver->kind == kDirectBuffer) {
+        FakeObject* view = allocate(vm, kDirectBuffer, receiver->klass);
+        view->address = receiver->address;
+        view->capacity = receiver->capacity;
+        result.l = addLocal(env, view);
+    } else if (method->name == "getMessage") {
+        result.l = addLocal(env, receiver->objectFields["detailMessage"]);
+    } else if (method->name == "get") {
+        result.l = addLocal(env, receiver->objectFields["referent"]);
+    } else if (method->name == "toString" && className == "java/io/StringWriter") {
+        result.l = addLocal(env, newString(vm, receiver->chars));
+    } else if (method->name == "printStackTrace") {
+        FakeObject* printWriter = fromRef(va_arg(args, jobject));
+        FakeObject* writer = printWriter != NULL ? printWriter->objectFields["out"] : NULL;
+        if (writer != NULL) {
+            std::string trace(className);
+            FakeObject* message = receiver->objectFields["detailMessage"];
+            if (message != NULL) {
+                trace += ": " + toUtf8(message);
+            }
+            trace += "\n\tat fake.Runtime.call(Native Method)\n";
+            for (size_t i = 0; i < trace.size(); ++i) {
+                writer->chars.push_back(trace[i] == '/' ? '.' : trace[i]);
+            }
+        }
+    }
+    return result;
+}
+
+#define DEFINE_CALL_METHOD(RETURN_TYPE, NAME, FIELD) \
+    RETURN_TYPE Call ## NAME ## MethodV(JNIEnv* env, jobject obj, jmethodID methodID, \
+                                        va_list args) { \
+        LOCK_VM(env); \
+        maybeCollect(vm); \
+        return static_cast<RETURN_TYPE>(invokeBuiltin(fenv, fromRef(obj), methodID, args).FIELD); \
+    } \
+    RETURN_TYPE Call ## NAME ## Method(JNIEnv* env, jobject obj, jmethodID methodID, ...) { \
+        va_list args; \
+        va_start(args, methodID); \
+        RETURN_TYPE result = Call ## NAME ## MethodV(env, obj, methodID, args); \
+        va_end(args); \
+        return result; \
+    }
+
+DEFINE_CALL_METHOD(jobject, Object, l)
+DEFINE_CALL_METHOD(jboolean, Boolean, z)
+DEFINE_CALL_METHOD(jint, Int, i)
+DEFINE_CALL_METHOD(jlong, Long, j)
+
+#undef DEFINE_CALL_METHOD
+
+// Returns the native registered for methodID on the receiver's class, if any.
+void* findRegisteredNative(FakeObject* receiver, jmethodID methodID) {
+    if (receiver == NULL) {
+        return NULL;
+    }
+    const FakeMethod* method = reinterpret_cast<const FakeMethod*>(methodID);
+    std::map<std::string, void*>::const_iterator it =
+            receiver->klass->natives.find(method->name + method->signature);
+    return (it != receiver->klass->natives.end()) ? it->second : NULL;
+}
+
+// Runs a registered native as if Java had called its method, without the VM
+// lock, since the native calls back in. Only reference, int-like and long
+// arguments are supported, up to four of them, passed as they would be on an
+// LP64 host: one integer register each.
+void callRegisteredNative(JNIEnv* env, jobject obj, void* fn, jmethodID methodID,
+                          va_list args) {
+    const std::string& signature = reinterpret_cast<const FakeMethod*>(methodID)->signature;
+    uintptr_t values[4] = { 0, 0, 0, 0 };
+    size_t count = 0;
+    for (size_t i = 1; i < signature.size() && signature[i] != ')'; ++i, ++count) {
+        if (count == 4) {
+            abort();
+        }
+        char type = signature[i];
+        if (type == '[') {
+            while (signature[i] == '[') {
+                ++i;
+            }
+            type = 'L';
+            if (signature[i] == 'L') {
+                i = signature.find(';', i);
+            }
+        } else if (type == 'L') {
+            i = signature.find(';', i);
+        }
+        if (type == 'L') {
+            values[count] = reinterpret_cast<uintptr_t>(va_arg(args, jobject));
+        } else if (type == 'J') {
+            values[count] = static_cast<uintptr_t>(va_arg(args, jlong));
+        } else if (type == 'F' || type == 'D') {
+            abort();
+        } else {
+            values[count] = static_cast<uintptr_t>(static_cast<intptr_t>(va_arg(args, int)));
+        }
+    }
+    typedef void (*Native)(JNIEnv*, jobject, uintptr_t, uintptr_t, uintptr_t, uintptr_t);
+    reinterpret_cast<Native>(fn)(env, obj, values[0], values[1], values[2], values[3]);
+}
+
+void CallVoidMethodV(JNIEnv* env, jobject obj, jmethodID methodID, va_list args) {
+    void* fn;
+    {
+        LOCK_VM(env);
+        maybeCollect(vm);
+        fn = findRegisteredNative(fromRef(obj), methodID);
+        if (fn == NULL) {
+            invokeBuiltin(fenv, fromRef(obj), methodID, args);
+            return;
+        }
+    }
+    callRegisteredNative(env, obj, fn, methodID, args);
+}
+
+void CallVoidMethod(JNIEnv* env, jobject obj, jmethodID methodID, ...) {
+    va_list args;
+    va_start(args, methodID);
+    CallVoidMethodV(env, obj, methodID, args);
+    va_end(args);
+}
+
+jfieldID GetFieldID(JNIEnv* env, jclass, const char* name, const char* sig) {
+    LOCK_VM(env);
+    std::unique_ptr<FakeField>& field = vm->fields[std::string(name) + sig];
+    if (field == NULL) {
+        field.reset(new FakeField);
+        field->name = name;
+        field->signature = sig;
+    }
+    return reinterpret_cast<jfieldID>(field.get());
+}
+
+const std::string& fieldName(jfieldID fieldID) {
+    return reinterpret_cast<const FakeField*>(fieldID)->name;
+}
+
+jobject GetObjectField(JNIEnv* env, jobject obj, jfieldID fieldID) {
+    LOCK_VM(env);
+    return addLocal(fenv, fromRef(obj)->objectFields[fieldName(fieldID)]);
+}
+
+void SetObjectField(JNIEnv* env, jobject obj, jfieldID fieldID, jobject value) {
+    LOCK_VM(env);
+    fromRef(obj)->objectFields[fieldName(fieldID)] = fromRef(value);
+}
+
+#define DEFINE_FIELD_ACCESSORS(TYPE, NAME, FIELD) \
+    TYPE Get ## NAME ## Field(JNIEnv* env, jobject obj, jfieldID fieldID) { \
+        LOCK_VM(env); \
+        std::map<std::string, jvalue>& fields = fromRef(obj)->primitiveFields; \
+        std::map<std::string, jvalue>::iterator it = fields.find(fieldName(fieldID)); \
+        return it != fields.end() ? it->second.FIELD : 0; \
+    } \
+    void Set ## NAME ## Field(JNIEnv* env, jobject obj, jfieldID fieldID, TYPE value) { \
+        LOCK_VM(env); \
+        jvalue v; \
+        v.j = 0; \
+        v.FIELD = value; \
+        fromRef(obj)->primitiveFields[fieldName(fieldID)] = v; \
+    }
+
+DEFINE_FIELD_ACCESSORS(jboolean, Boolean, z)
+DEFINE_FIELD_ACCESSORS(jint, Int, i)
+DEFINE_FIELD_ACCESSORS(jlong, Long, j)
+
+#undef DEFINE_FIELD_ACCESSORS
+
+jstring NewString(JNIEnv* env, const jchar* unicodeChars, jsize len) {
+    LOCK_VM(env);
+    maybeCollect(vm);
+    return addLocalAs<jstring>(fenv, newString(vm, std::vector<jchar>(unicodeChars,
+                                                                       unicodeChars + len)));
+}
+
+jsize GetStringLength(JNIEnv*, jstring string) {
+    return fromRef(string)->chars.size();
+}
+
+const jchar* GetStringChars(JNIEnv* env, jstring string, jboolean* isCopy) {
+    LOCK_VM(env);
+    FakeObject* s = fromRef(string);
+    static const jchar kEmpty = 0;
+    const jchar* chars = s->chars.empty() ? &kEmpty : &s->chars[0];
+    if (!vm->copyMode) {
+        ++s->pinCount;
+        if (isCopy != NULL) {
+            *isCopy = JNI_FALSE;
+        }
+        return chars;
+    }
+    size_t byteCount = s->chars.size() * sizeof(jchar);
+    jchar* copy = static_cast<jchar*>(malloc(byteCount + sizeof(jchar)));
+    memcpy(copy, chars, byteCount);
+    Copy& record = vm->copies[copy];
+    record.source = s;
+    record.byteCount = byteCount;
+    if (isCopy != NULL) {
+        *isCopy = JNI_TRUE;
+    }
+    return copy;
+}
+
+void releaseCopy(FakeVm* vm, const void* chars) {
+    std::map<const void*, Copy>::iterator it = vm->copies.find(chars);
+    if (it == vm->copies.end()) {
+        fatal("release of unknown buffer %p", chars);
+    }
+    vm->copies.erase(it);
+    free(const_cast<void*>(chars));
+}
+
+void ReleaseStringChars(JNIEnv* env, jstring string, const jchar* chars) {
+    LOCK_VM(env);
+    if (vm->copies.count(chars) != 0) {
+        releaseCopy(vm, chars);
+    } else {
+        --fromRef(string)->pinCount;
+    }
+}
+
+jstring NewStringUTF(JNIEnv* env, const char* bytes) {
+    LOCK_VM(env);
+    maybeCollect(vm);
+    if (bytes == NULL) {
+        return NULL;
+    }
+    return addLocalAs<jstring>(fenv, newStringUtf(vm, bytes));
+}
+
+jsize GetStringUTFLength(JNIEnv*, jstring string) {
+    return toUtf8(fromRef(string)).size();
+}
+
+const char* GetStringUTFChars(JNIEnv* env, jstring string, jboolean* isCopy) {
+    LOCK_VM(env);
+    FakeObject* s = fromRef(string);
+    std::string utf(toUtf8(s));
+    char* copy = static_cast<char*>(malloc(utf.size() + 1));
+    memcpy(copy, utf.c_str(), utf.size() + 1);
+    Copy& record = vm->copies[copy];
+    record.source = s;
+    record.byteCount = utf.size();
+    if (isCopy != NULL) {
+        *isCopy = JNI_TRUE;
+    }
+    return copy;
+}
+
+void ReleaseStringUTFChars(JNIEnv* env, jstring, const char* utf) {
+    LOCK_VM(env);
+    releaseCopy(vm, utf);
+}
+
+void GetStringRegion(JNIEnv* env, jstring str, jsize start, jsize len, jchar* buf) {
+    LOCK_VM(env);
+    FakeObject* s = fromRef(str);
+    if (checkRange(fenv, "java/lang/StringIndexOutOfBoundsException", s->chars.size(),
+                   start, len)) {
+        memcpy(buf, &s->chars[0] + start, len * sizeof(jchar));
+    }
+}
+
+void GetStringUTFRegion(JNIEnv* env, jstring str, jsize start, jsize len, char* buf) {
+    LOCK_VM(env);
+    FakeObject* s = fromRef(str);
+    if (checkRange(fenv, "java/lang/StringIndexOutOfBoundsException", s->chars.size(),
+                   start, len)) {
+        std::string utf(encodeModifiedUtf8(&s->chars[0] + start, len));
+        memcpy(buf, utf.c_str(), utf.size() + 1);
+    }
+}
+
+const jchar* GetStringCritical(JNIEnv* env, jstring string, jboolean* isCopy) {
+    LOCK_VM(env);
+    FakeObject* s = fromRef(string);
+    static const jchar kEmpty = 0;
+    ++s->pinCount;
+    if (isCopy != NULL) {
+        *isCopy = JNI_FALSE;
+    }
+    return s->chars.empty() ? &kEmpty : &s->chars[0];
+}
+
+void ReleaseStringCritical(JNIEnv* env, jstring string, const jchar*) {
+    LOCK_VM(env);
+    --fromRef(string)->pinCount;
+}
+
+jsize GetArrayLength(JNIEnv*, jarray array) {
+    return fromRef(array)->length;
+}
+
+jobjectArray NewObjectArray(JNIEnv* env, jsize length, jclass elementClass,
+                            jobject initialElement) {
+    LOCK_VM(env);
+    maybeCollect(vm);
+    if (length < 0) {
+        throwNew(fenv, "java/lang/NegativeArraySizeException", "negative array size");
+        return NULL;
+    }
+    FakeObject* array = allocate(vm, kObjectArray, arrayClassOf(vm, fromRef(elementClass)));
+    array->length = length;
+    array->elements.assign(length, fromRef(initialElement));
+    return addLocalAs<jobjectArray>(fenv, array);
+}
+
+jobject GetObjectArrayElement(JNIEnv* env, jobjectArray array, jsize index) {
+    LOCK_VM(env);
+    FakeObject* a = fromRef(array);
+    if (!checkRange(fenv, "java/lang/ArrayIndexOutOfBoundsException", a->length, index, 1)) {
+        return NULL;
+    }
+    return addLocal(fenv, a->elements[index]);
+}
+
+void SetObjectArrayElement(JNIEnv* env, jobjectArray array, jsize index, jobject value) {
+    LOCK_VM(env);
+    FakeObject* a = fromRef(array);
+    if (checkRange(fenv, "java/lang/ArrayIndexOutOfBoundsException", a->length, index, 1)) {
+        a->elements[index] = fromRef(value);
+    }
+}
+
+void* getElements(FakeVm* vm, FakeObject* array, size_t elementSize, jboolean* isCopy) {
+    size_t byteCount = array->length * elementSize;
+    if (!vm->copyMode) {
+        ++array->pinCount;
+        if (isCopy != NULL) {
+            *isCopy = JNI_FALSE;
+        }
+        return array->data();
+    }
+    void* copy = malloc(byteCount + 1);
+    memcpy(copy, array->data(), byteCount);
+    Copy& record = vm->copies[copy];
+    record.source = array;
+    record.byteCount = byteCount;
+    if (isCopy != NULL) {
+        *isCopy = JNI_TRUE;
+    }
+    return copy;
+}
+
+void releaseElements(FakeVm* vm, FakeObject* array, void* elems, jint mode) {
+    std::map<const void*, Copy>::iterator it = vm->copies.find(elems);
+    if (it == vm->copies.end()) {
+        // Pinned: JNI_COMMIT keeps the pin.
+        if (mode != JNI_COMMIT) {
+            --array->pinCount;
+        }
+        return;
+    }
+    if (mode != JNI_ABORT) {
+        memcpy(array->data(), elems, it->second.byteCount);
+    }
+    if (mode != JNI_COMMIT) {
+        releaseCopy(vm, elems);
+    }
+}
+
+#define DEFINE_PRIMITIVE_ARRAY(PRIMITIVE_TYPE, NAME, DESCRIPTOR) \
+    PRIMITIVE_TYPE ## Array New ## NAME ## Array(JNIEnv* env, jsize length) { \
+        LOCK_VM(env); \
+        maybeCollect(vm); \
+        if (length < 0) { \
+            throwNew(fenv, "java/lang/NegativeArraySizeException", "negative array size"); \
+            return NULL; \
+        } \
+        FakeObject* array = allocate(vm, kPrimitiveArray, findOrCreateClass(vm, DESCRIPTOR)); \
+        array->length = length; \
+        array->storage.assign((length * sizeof(PRIMITIVE_TYPE) + sizeof(jlong) - 1) / \
+                              sizeof(jlong), 0); \
+        return addLocalAs<PRIMITIVE_TYPE ## Array>(fenv, array); \
+    } \
+    PRIMITIVE_TYPE* Get ## NAME ## ArrayElements(JNIEnv* env, PRIMITIVE_TYPE ## Array array, \
+                                                 jboolean* isCopy) { \
+        LOCK_VM(env); \
+        return static_cast<PRIMITIVE_TYPE*>(getElements(vm, fromRef(array), \
+                                                        sizeof(PRIMITIVE_TYPE), isCopy)); \
+    } \
+    void Release ## NAME ## ArrayElements(JNIEnv* env, PRIMITIVE_TYPE ## Array array, \
+                                          PRIMITIVE_TYPE* elems, jint mode) { \
+        LOCK_VM(env); \
+        releaseElements(vm, fromRef(array), elems, mode); \
+    } \
+    void Get ## NAME ## ArrayRegion(JNIEnv* env, PRIMITIVE_TYPE ## Array array, jsize start, \
+                                    jsize len, PRIMITIVE_TYPE* buf) { \
+        LOCK_VM(env); \
+        FakeObject* a = fromRef(array); \
+        if (checkRange(fenv, "java/lang/ArrayIndexOutOfBoundsException", a->length, \
+                       start, len)) { \
+            memcpy(buf, static_cast<PRIMITIVE_TYPE*>(a->data()) + start, \
+                   len * sizeof(PRIMITIVE_TYPE)); \
+        } \
+    } \
+    void Set ## NAME ## ArrayRegion(JNIEnv* env, PRIMITIVE_TYPE ## Array array, jsize start, \
+                                    jsize len, const PRIMITIVE_TYPE* buf) { \
+        LOCK_VM(env); \
+        FakeObject* a = fromRef(array); \
+        if (checkRange(fenv, "java/lang/ArrayIndexOutOfBoundsException", a->length, \
+                       start, len)) { \
+            memcpy(static_cast<PRIMITIVE_TYPE*>(a->data()) + start, buf, \
+                   len * sizeof(PRIMITIVE_TYPE)); \
+        } \
+    }
+
+DEFINE_PRIMITIVE_ARRAY(jboolean, Boolean, "[Z")
+DEFINE_PRIMITIVE_ARRAY(jbyte, Byte, "[B")
+DEFINE_PRIMITIVE_ARRAY(jchar, Char, "[C")
+DEFINE_PRIMITIVE_ARRAY(jshort, Short, "[S")
+DEFINE_PRIMITIVE_ARRAY(jint, Int, "[I")
+DEFINE_PRIMITIVE_ARRAY(jlong, Long, "[J")
+DEFINE_PRIMITIVE_ARRAY(jfloat, Float, "[F")
+DEFINE_PRIMITIVE_ARRAY(jdouble, Double, "[D")
+
+#undef DEFINE_PRIMITIVE_ARRAY
+
+// The element size of a primitive array, from its class name ("[I" and so on).
+size_t elementSize(const FakeObject* array) {
+    switch (array->klass->name[1]) {
+        case 'Z': case 'B': return 1;
+        case 'C': case 'S': return 2;
+        case 'I': case 'F': return 4;
+        default: return 8;
+    }
+}
+
+void* GetPrimitiveArrayCritical(JNIEnv* env, jarray array, jboolean* isCopy) {
+    LOCK_VM(env);
+    FakeObject* a = fromRef(array);
+    return getElements(vm, a, elementSize(a), isCopy);
+}
+
+void ReleasePrimitiveArrayCritical(JNIEnv* env, jarray array, void* elems, jint mode) {
+    LOCK_VM(env);
+    releaseElements(vm, fromRef(array), elems, mode);
+}
+
+jint RegisterNatives(JNIEnv* env, jclass clazz, const JNINativeMethod* methods, jint nMethods) {
+    LOCK_VM(env);
+    FakeObject* klass = fromRef(clazz);
+    for (jint i = 0; i < nMethods; ++i) {
+        if (methods[i].name == NULL || methods[i].signature == NULL ||
+            methods[i].fnPtr == NULL) {
+            throwNew(fenv, "java/lang/NoSuchMethodError", klass->name);
+            return JNI_ERR;
+        }
+        klass->natives[std::string(methods[i].name) + methods[i].signature] = methods[i].fnPtr;
+    }
+    return JNI_OK;
+}
+
+jint UnregisterNatives(JNIEnv* env, jclass clazz) {
+    LOCK_VM(env);
+    fromRef(clazz)->natives.clear();
+    return JNI_OK;
+}
+
+jint MonitorEnter(JNIEnv*, jobject) {
+    return JNI_OK;
+}
+
+jint MonitorExit(JNIEnv*, jobject) {
+    return JNI_OK;
+}
+
+jint GetJavaVM(JNIEnv* env, JavaVM** vm) {
+    *vm = &fromEnv(env)->vm->javaVm;
+    return JNI_OK;
+}
+
+jboolean ExceptionCheck(JNIEnv* env) {
+    LOCK_VM(env);
+    return fenv->pendingException != NULL;
+}
+
+jobject NewDirectByteBuffer(JNIEnv* env, void* address, jlong capacity) {
+    LOCK_VM(env);
+    maybeCollect(vm);
+    FakeObject* buffer = allocate(vm, kDirectBuffer,
+                                  findOrCreateClass(vm, "java/nio/DirectByteBuffer"));
+    buffer->address = address;
+    buffer->capacity = capacity;
+    return addLocal(fenv, buffer);
+}
+
+void* GetDirectBufferAddress(JNIEnv*, jobject buf) {
+    FakeObject* b = fromRef(buf);
+    return b->kind == kDirectBuffer ? b->address : NULL;
+}
+
+jlong GetDirectBufferCapacity(JNIEnv*, jobject buf) {
+    FakeObject* b = fromRef(buf);
+    return b->kind == kDirectBuffer ? b->capacity : -1;
+}
+
+jobjectRefType GetObjectRefType(JNIEnv* env, jobject obj) {
+    LOCK_VM(env);
+    FakeObject* o = fromRef(obj);
+    for (size_t i = 0; i < fenv->frames.size(); ++i) {
+        for (size_t j = 0; j < fenv->frames[i].size(); ++j) {
+            if (fenv->frames[i][j] == o) {
+                return JNILocalRefType;
+            }
+        }
+    }
+    return vm->globals.count(o) != 0 ? JNIGlobalRefType : JNIInvalidRefType;
+}
+
+//
+// JNIInvokeInterface.
+//
+
+FakeEnv* newEnv(FakeVm* vm) {
+    FakeEnv* env = new FakeEnv;
+    env->jniEnv.functions = gNativeInterface;
+    env->vm = vm;
+    env->frames.push_back(std::vector<FakeObject*>());
+    env->localRefCount = 0;
+    env->pendingException = NULL;
+    vm->envs.insert(env);
+    gCurrentEnv = env;
+    return env;
+}
+
+void deleteEnv(FakeVm* vm, FakeEnv* env) {
+    vm->envs.erase(env);
+    delete env;
+    gCurrentEnv = NULL;
+}
+
+jint DestroyJavaVM(JavaVM* javaVm) {
+    FakeVm* vm = fromVm(javaVm);
+    {
+        VmLock vmLock(vm->lock);
+        if (gCurrentEnv != NULL) {
+            deleteEnv(vm, gCurrentEnv);
+        }
+        if (!vm->envs.empty()) {
+            fatal("DestroyJavaVM with %zu threads still attached", vm->envs.size());
+        }
+        for (std::map<const void*, Copy>::iterator it = vm->copies.begin();
+             it != vm->copies.end(); ++it) {
+            free(const_cast<void*>(it->first));
+        }
+    }
+    delete vm;
+    gVm = NULL;
+    return JNI_OK;
+}
+
+jint AttachCurrentThread(JavaVM* javaVm, JNIEnv** p_env, void*) {
+    FakeVm* vm = fromVm(javaVm);
+    VmLock vmLock(vm->lock);
+    if (gCurrentEnv == NULL) {
+        newEnv(vm);
+    }
+    *p_env = &gCurrentEnv->jniEnv;
+    return JNI_OK;
+}
+
+jint DetachCurrentThread(JavaVM* javaVm) {
+    FakeVm* vm = fromVm(javaVm);
+    VmLock vmLock(vm->lock);
+    if (gCurrentEnv == NULL) {
+        return JNI_EDETACHED;
+    }
+    deleteEnv(vm, gCurrentEnv);
+    return JNI_OK;
+}
+
+jint LocalRefCount(JNIEnv* env) {
+    LOCK_VM(env);
+    return fenv->localRefCount;
+}
+
+jint GlobalRefCount(JavaVM* javaVm) {
+    FakeVm* vm = fromVm(javaVm);
+    VmLock vmLock(vm->lock);
+    jint count = 0;
+    for (std::map<FakeObject*, int>::iterator it = vm->globals.begin();
+         it != vm->globals.end(); ++it) {
+        count += it->second;
+    }
+    return count;
+}
+
+jint OutstandingCopyCount(JavaVM* javaVm) {
+    FakeVm* vm = fromVm(javaVm);
+    VmLock vmLock(vm->lock);
+    return vm->copies.size();
+}
+
+void SetCopyMode(JavaVM* javaVm, jboolean copy) {
+    FakeVm* vm = fromVm(javaVm);
+    VmLock vmLock(vm->lock);
+    vm->copyMode = copy;
+}
+
+void HideClass(JavaVM* javaVm, const char* className) {
+    FakeVm* vm = fromVm(javaVm);
+    VmLock vmLock(vm->lock);
+    vm->hiddenClasses.insert(className);
+}
+
+jint RegisteredNativeCount(JavaVM* javaVm, const char* className) {
+    FakeVm* vm = fromVm(javaVm);
+    VmLock vmLock(vm->lock);
+    std::map<std::string, FakeObject*>::iterator it = vm->classes.find(className);
+    return it != vm->classes.end() ? it->second->natives.size() : 0;
+}
+
+const FakeJniIntrospection gIntrospection = {
+    LocalRefCount,
+    GlobalRefCount,
+    OutstandingCopyCount,
+    SetCopyMode,
+    HideClass,
+    RegisteredNativeCount,
+};
+
+jint GetEnv(JavaVM*, void** env, jint version) {
+    if (version == FAKE_JNI_INTROSPECTION_VERSION) {
+        *env = const_cast<FakeJniIntrospection*>(&gIntrospection);
+        return JNI_OK;
+    }
+    if (version < JNI_VERSION_1_1 || version > JNI_VERSION_1_6) {
+        *env = NULL;
+        return JNI_EVERSION;
+    }
+    if (gCurrentEnv == NULL) {
+        *env = NULL;
+        return JNI_EDETACHED;
+    }
+    *env = &gCurrentEnv->jniEnv;
+    return JNI_OK;
+}
+
+JNINativeInterface* makeNativeInterface() {
+    JNINativeInterface* ni = new JNINativeInterface;
+    memset(ni, 0, sizeof(*ni));
+#define SET(NAME) ni->NAME = NAME
+    SET(GetVersion);
+    SET(FindClass);
+    SET(GetSuperclass);
+    SET(IsAssignableFrom);
+    SET(Throw);
+    SET(ThrowNew);
+    SET(ExceptionOccurred);
+    SET(ExceptionDescribe);
+    SET(ExceptionClear);
+    SET(FatalError);
+    SET(PushLocalFrame);
+    SET(PopLocalFrame);
+    SET(NewGlobalRef);
+    SET(DeleteGlobalRef);
+    SET(DeleteLocalRef);
+    SET(IsSameObject);
+    SET(NewLocalRef);
+    SET(EnsureLocalCapacity);
+    SET(AllocObject);
+    SET(NewObject);
+    SET(NewObjectV);
+    SET(GetObjectClass);
+    SET(IsInstanceOf);
+    SET(GetMethodID);
+    SET(CallObjectMethod);
+    SET(CallObjectMethodV);
+    SET(CallBooleanMethod);
+    SET(CallBooleanMethodV);
+    SET(CallIntMethod);
+    SET(CallIntMethodV);
+    SET(CallLongMethod);
+    SET(CallLongMethodV);
+    SET(CallVoidMethod);
+    SET(CallVoidMethodV);
+    SET(GetFieldID);
+    SET(GetObjectField);
+    SET(SetObjectField);
+    SET(GetBooleanField);
+    SET(SetBooleanField);
+    SET(GetIntField);
+    SET(SetIntField);
+    SET(GetLongField);
+    SET(SetLongField);
+    SET(NewString);
+    SET(GetStringLength);
+    SET(GetStringChars);
+    SET(ReleaseStringChars);
+    SET(NewStringUTF);
+    SET(GetStringUTFLength);
+    SET(GetStringUTFChars);
+    SET(ReleaseStringUTFChars);
+    SET(GetStringRegion);
+    SET(GetStringUTFRegion);
+    SET(GetStringCritical);
+    SET(ReleaseStringCritical);
+    SET(GetArrayLength);
+    SET(NewObjectArray);
+    SET(GetObjectArrayElement);
+    SET(SetObjectArrayElement);
+#define SET_PRIMITIVE_ARRAY(NAME) \
+    SET(New ## NAME ## Array); \
+    SET(Get ## NAME ## ArrayElements); \
+    SET(Release ## NAME ## ArrayElements); \
+    SET(Get ## NAME ## ArrayRegion); \
+    SET(Set ## NAME ## ArrayRegion)
+    SET_PRIMITIVE_ARRAY(Boolean);
+    SET_PRIMITIVE_ARRAY(Byte);
+    SET_PRIMITIVE_ARRAY(Char);
+    SET_PRIMITIVE_ARRAY(Short);
+    SET_PRIMITIVE_ARRAY(Int);
+    SET_PRIMITIVE_ARRAY(Long);
+    SET_PRIMITIVE_ARRAY(Float);
+    SET_PRIMITIVE_ARRAY(Double);
+#undef SET_PRIMITIVE_ARRAY
+    SET(GetPrimitiveArrayCritical);
+    SET(ReleasePrimitiveArrayCritical);
+    SET(RegisterNatives);
+    SET(UnregisterNatives);
+    SET(MonitorEnter);
+    SET(MonitorExit);
+    SET(GetJavaVM);
+    SET(ExceptionCheck);
+    SET(NewDirectByteBuffer);
+    SET(GetDirectBufferAddress);
+    SET(GetDirectBufferCapacity);
+    SET(GetObjectRefType);
+#undef SET
+    return ni;
+}
+
+JNIInvokeInterface* makeInvokeInterface() {
+    JNIInvokeInterface* ii = new JNIInvokeInterface;
+    memset(ii, 0, sizeof(*ii));
+    ii->DestroyJavaVM = DestroyJavaVM;
+    ii->AttachCurrentThread = AttachCurrentThread;
+    ii->DetachCurrentThread = DetachCurrentThread;
+    ii->GetEnv = GetEnv;
+    ii->AttachCurrentThreadAsDaemon = AttachCurrentThread;
+    return ii;
+}
+
+bool parseOption(FakeVm* vm, const char* option) {
+    static const char kPrefix[] = "-Xfake:";
+    if (strncmp(option, kPrefix, sizeof(kPrefix) - 1) != 0) {
+        // Not ours; a real runtime's option such as -Xmx is accepted and ignored.
+        return true;
+    }
+    const char* value = option + sizeof(kPrefix) - 1;
+    if (strcmp(value, "copy") == 0) {
+        vm->copyMode = true;
+    } else if (strcmp(value, "pin") == 0) {
+        vm->copyMode = false;
+    } else if (strncmp(value, "max-local-refs=", 15) == 0) {
+        vm->maxLocalRefs = atoi(value + 15);
+    } else if (strncmp(value, "hide-class=", 11) == 0) {
+        vm->hiddenClasses.insert(value + 11);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+extern "C" JNIEXPORT jint JNI_GetDefaultJavaVMInitArgs(void* vm_args) {
+    JavaVMInitArgs* args = static_cast<JavaVMInitArgs*>(vm_args);
+    if (args->version < JNI_VERSION_1_2 || args->version > JNI_VERSION_1_6) {
+        return JNI_EVERSION;
+    }
+    return JNI_OK;
+}
+
+extern "C" JNIEXPORT jint JNI_CreateJavaVM(JavaVM** p_vm, JNIEnv** p_env, void* vm_args) {
+    if (gVm != NULL) {
+        return JNI_ERR;  // Only one VM per process, as with real runtimes.
+    }
+    if (gNativeInterface == NULL) {
+        gNativeInterface = makeNativeInterface();
+        gInvokeInterface = makeInvokeInterface();
+    }
+
+    std::unique_ptr<FakeVm> vm(new FakeVm);
+    vm->javaVm.functions = gInvokeInterface;
+    vm->copyMode = false;
+    vm->maxLocalRefs = 512;
+    vm->nextCollection = 4096;
+
+    const JavaVMInitArgs* args = static_cast<const JavaVMInitArgs*>(vm_args);
+    if (args != NULL) {
+        for (jint i = 0; i < args->nOptions; ++i) {
+            const char* option = args->options[i].optionString;
+            if (!parseOption(vm.get(), option) && !args->ignoreUnrecognized) {
+                fprintf(stderr, "fake JNI: unrecognized option '%s'\n", option);
+                return JNI_ERR;
+            }
+        }
+    }
+
+    gVm = vm.release();
+    *p_env = &newEnv(gVm)->jniEnv;
+    *p_vm = &gVm->javaVm;
+    return JNI_OK;
+}
+
+extern "C" JNIEXPORT jint JNI_GetCreatedJavaVMs(JavaVM** vms, jsize size, jsize* vm_count) {
+    jsize count = 0;
+    if (gVm != NULL && size > 0) {
+        vms[count++] = &gVm->javaVm;
+    }
+    *vm_count = count;
+    return JNI_OK;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FAKE_JNI_RUNTIME_H_included
+#define FAKE_JNI_RUNTIME_H_included
+
+#include <jni.h>
+
+// libnativehelper_fakejni is a minimal in-process JNI implementation that
+// lets the helpers be exercised on a host without a JVM. It is loaded like
+// any other runtime:
+//
+//   JniInvocation jni_invocation;
+//   jni_invocation.Init(kFakeJniLibrary);
+//   JNI_CreateJavaVM(&vm, &env, &init_args);
+//
+// It implements strings, primitive and object arrays, direct buffers, local
+// frames, global references, classes, fields, exceptions and native
+// registration. There is no bytecode: FindClass succeeds for every name that
+// has not been hidden, GetMethodID/GetFieldID always succeed, and only the
+// handful of library methods the helpers call (Class.getName,
+// Throwable.getMessage, Throwable.printStackTrace, StringWriter.toString,
+// Reference.get) have behavior. CallVoidMethod on an object whose class has a
+// registered native for the method runs that native, so that tests can stand
+// in for Java callbacks. Slots of JNINativeInterface that are not
+// implemented are NULL.
+//
+// Recognized JavaVMOption strings:
+//
+//   -Xfake:copy                Get<Type>ArrayElements, GetPrimitiveArrayCritical
+//                              and GetStringChars return copies
+//                              (isCopy == JNI_TRUE).
+//   -Xfake:pin                 They return the backing storage (default).
+//   -Xfake:max-local-refs=N    Abort on local reference table overflow.
+//   -Xfake:hide-class=NAME     FindClass(NAME) throws NoClassDefFoundError.
+
+static const char* const kFakeJniLibrary = "libnativehelper_fakejni.so";
+
+// Passing this version to JavaVM::GetEnv returns a FakeJniIntrospection
+// instead of a JNIEnv.
+#define FAKE_JNI_INTROSPECTION_VERSION 0x7fa70001
+
+struct FakeJniIntrospection {
+    // Returns the number of live local references in all frames of 'env'.
+    jint (*LocalRefCount)(JNIEnv* env);
+
+    // Returns the number of live global references.
+    jint (*GlobalRefCount)(JavaVM* vm);
+
+    // Returns the number of array/string copies that have not been released.
+    jint (*OutstandingCopyCount)(JavaVM* vm);
+
+    // Switches between the copying and pinning behavior at runtime.
+    void (*SetCopyMode)(JavaVM* vm, jboolean copy);
+
+    // Makes FindClass fail for 'className'.
+    void (*HideClass)(JavaVM* vm, const char* className);
+
+    // Returns how many native methods have been registered on 'className'.
+    jint (*RegisteredNativeCount)(JavaVM* vm, const char* className);
+};
+
+#endif  // FAKE_JNI_RUNTIME_H_included
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniConstants.h>
+#include <ScopedBytes.h>
+#include <ScopedLocalRef.h>
+#include <ScopedPrimitiveArray.h>
+#include <ScopedUtfChars.h>
+#include <toStringArray.h>
+#include <android/log.h>
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+static testing::Environment* const gJniEnvironment =
+        testing::AddGlobalTestEnvironment(new JniTestEnvironment(kFakeJniLibrary));
+
+class JNIHelpTest : public JniTest {
+};
+
+TEST_F(JNIHelpTest, InitTimings) {
+    const JniInvocation::InitTimings& timings =
+            JniTestEnvironment::Get().jni_invocation().GetInitTimings();
+    EXPECT_GT(timings.dlopen_ns, 0U);
+    EXPECT_GT(timings.find_symbols_ns, 0U);
+    EXPECT_GT(timings.create_java_vm_ns, 0U);
+}
+
+static void nativeNoop(JNIEnv*, jclass) {
+}
+
+TEST_F(JNIHelpTest, RegisterNativeMethods) {
+    static const JNINativeMethod methods[] = {
+        { "noop", "()V", reinterpret_cast<void*>(nativeNoop) },
+    };
+    EXPECT_EQ(0, jniRegisterNativeMethods(env_, "test/Natives", methods, NELEM(methods)));
+    EXPECT_EQ(1, fake_->RegisteredNativeCount(vm_, "test/Natives"));
+}
+
+TEST_F(JNIHelpTest, ThrowException) {
+    EXPECT_EQ(0, jniThrowException(env_, "java/lang/IllegalStateException", "bad state"));
+    EXPECT_EQ("java.lang.IllegalStateException: bad state", TakeException());
+
+    EXPECT_EQ(0, jniThrowNullPointerException(env_, NULL));
+    EXPECT_EQ("java.lang.NullPointerException", TakeException());
+
+    EXPECT_EQ(0, jniThrowExceptionFmt(env_, "java/lang/RuntimeException", "%d-%s", 42, "x"));
+    EXPECT_EQ("java.lang.RuntimeException: 42-x", TakeException());
+}
+
+TEST_F(JNIHelpTest, ThrowExceptionDiscardsPending) {
+    jniThrowRuntimeException(env_, "first");
+    jniThrowRuntimeException(env_, "second");
+    EXPECT_EQ("java.lang.RuntimeException: second", TakeException());
+}
+
+TEST_F(JNIHelpTest, ThrowExceptionMissingClass) {
+    fake_->HideClass(vm_, "test/MissingException");
+    EXPECT_NE(0, jniThrowException(env_, "test/MissingException", "unused"));
+    EXPECT_EQ("java.lang.NoClassDefFoundError: test/MissingException", TakeException());
+}
+
+TEST_F(JNIHelpTest, LogException) {
+    jniThrowRuntimeException(env_, "logged");
+    jniLogException(env_, ANDROID_LOG_DEBUG, "JNIHelpTest");
+    // The pending exception is rethrown after its stack trace is logged.
+    EXPECT_EQ("java.lang.RuntimeException: logged", TakeException());
+}
+
+TEST_F(JNIHelpTest, ThrowIOException) {
+    char buffer[80];
+    std::string expected("java.io.IOException: ");
+    expected += jniStrError(ENOENT, buffer, sizeof(buffer));
+    EXPECT_EQ(0, jniThrowIOException(env_, ENOENT));
+    EXPECT_EQ(expected, TakeException());
+}
+
+TEST_F(JNIHelpTest, FileDescriptor) {
+    ScopedLocalRef<jobject> fd(env_, jniCreateFileDescriptor(env_, 17));
+    ASSERT_TRUE(fd.get() != NULL);
+    EXPECT_EQ(17, jniGetFDFromFileDescriptor(env_, fd.get()));
+    jniSetFileDescriptorOfFD(env_, fd.get(), 3);
+    EXPECT_EQ(3, jniGetFDFromFileDescriptor(env_, fd.get()));
+    EXPECT_EQ(-1, jniGetFDFromFileDescriptor(env_, NULL));
+}
+
+TEST_F(JNIHelpTest, ToStringArray) {
+    std::vector<std::string> strings;
+    strings.push_back("en_US");
+    strings.push_back("caf\xc3\xa9");
+    ScopedLocalRef<jobjectArray> array(env_, toStringArray(env_, strings));
+    ASSERT_TRUE(array.get() != NULL);
+    ASSERT_EQ(2, env_->GetArrayLength(array.get()));
+    for (size_t i = 0; i < strings.size(); ++i) {
+        ScopedLocalRef<jstring> s(env_,
+                reinterpret_cast<jstring>(env_->GetObjectArrayElement(array.get(), i)));
+        EXPECT_STREQ(strings[i].c_str(), ScopedUtfChars(env_, s.get()).c_str());
+    }
+}
+
+static void collectExceptionCount(const char* className, uint64_t count, void* context) {
+    (*static_cast<std::map<std::string, uint64_t>*>(context))[className] = count;
+}
+
+static std::map<std::string, uint64_t> getExceptionCounts() {
+    std::map<std::string, uint64_t> counts;
+    jniHelpGetExceptionCounts(collectExceptionCount, &counts);
+    return counts;
+}
+
+static void* throwOnAttachedThread(void*) {
+    JniTestEnvironment& environment = JniTestEnvironment::Get();
+    JNIEnv* env = environment.AttachCurrentThread();
+    jniThrowException(env, "java/lang/IllegalArgumentException", "from another thread");
+    env->ExceptionClear();
+    environment.DetachCurrentThread();
+    return NULL;
+}
+
+TEST_F(JNIHelpTest, Stats) {
+    JniHelpStats before;
+    jniHelpGetStats(&before);
+    EXPECT_GT(before.constantsGlobalRefs, 0U);
+    std::map<std::string, uint64_t> exceptionsBefore = getExceptionCounts();
+
+    static const JNINativeMethod methods[] = {
+        { "noop", "()V", reinterpret_cast<void*>(nativeNoop) },
+    };
+    jniRegisterNativeMethods(env_, "test/StatsNatives", methods, NELEM(methods));
+    jniThrowRuntimeException(env_, "first");
+    jniThrowRuntimeException(env_, "second");
+    jniLogException(env_, ANDROID_LOG_DEBUG, "JNIHelpTest");
+    TakeException();
+    ScopedLocalRef<jobject> fd(env_, jniCreateFileDescriptor(env_, 5));
+    // Counts from exited threads are kept.
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, throwOnAttachedThread, NULL));
+    ASSERT_EQ(0, pthread_join(thread, NULL));
+
+    ScopedLocalRef<jintArray> small(env_, env_->NewIntArray(16));
+    ScopedLocalRef<jintArray> large(env_, env_->NewIntArray(2048));
+    {
+        ScopedIntArrayRO copied(env_, small.get());  // Copied into the inline buffer.
+        ScopedIntArrayRO pinned(env_, large.get());
+        // Counted only once size() has fetched the length.
+        ScopedIntArrayRW sized(env_, small.get());
+        EXPECT_EQ(16U, sized.size());
+        ScopedIntArrayRW unsized(env_, large.get());
+        ScopedLocalRef<jbyteArray> bytes(env_, env_->NewByteArray(4096));
+        ScopedBytesRO unsizedBytes(env_, bytes.get());
+    }
+
+    JniHelpStats after;
+    jniHelpGetStats(&after);
+    EXPECT_EQ(before.exceptionsThrown + 3, after.exceptionsThrown);
+    EXPECT_EQ(before.pendingExceptionsDiscarded + 1, after.pendingExceptionsDiscarded);
+    EXPECT_EQ(before.stackTracesFormatted + 1, after.stackTracesFormatted);
+    EXPECT_EQ(before.nativeMethodsRegistered + 1, after.nativeMethodsRegistered);
+    EXPECT_EQ(before.fileDescriptorsCreated + 1, after.fileDescriptorsCreated);
+    EXPECT_EQ(before.constantsGlobalRefs, after.constantsGlobalRefs);
+    EXPECT_EQ(before.arrayBytesCopied + before.arrayBytesPinned + (2 * 16 + 2048) * sizeof(jint),
+              after.arrayBytesCopied + after.arrayBytesPinned);
+    EXPECT_LE(before.arrayBytesCopied + 16 * sizeof(jint), after.arrayBytesCopied);
+    EXPECT_LE(before.arrayBytesPinned + 2048 * sizeof(jint), after.arrayBytesPinned);
+
+    std::map<std::string, uint64_t> exceptionsAfter = getExceptionCounts();
+    EXPECT_EQ(exceptionsBefore["java/lang/RuntimeException"] + 2,
+              exceptionsAfter["java/lang/RuntimeException"]);
+    EXPECT_EQ(exceptionsBefore["java/lang/IllegalArgumentException"] + 1,
+              exceptionsAfter["java/lang/IllegalArgumentException"]);
+}
+
+}  // namespace android
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JavaVMOptions.h>
+#include <JniInvocation.h>
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "FakeJniRuntime.h"
+
+static std::string TempPath(const char* name) {
+    const char* dir = getenv("TMPDIR");
+    char path[256];
+    snprintf(path, sizeof(path), "%s/JavaVMOptions_test-%d-%s",
+             (dir != NULL) ? dir : "/tmp", getpid(), name);
+    return path;
+}
+
+TEST(JavaVMOptions, LaterOptionReplacesEarlier) {
+    JavaVMOptions options;
+    options.Add("-Xmx128m");
+    options.Add("-Dfoo=1");
+    options.Add("-verbose:gc");
+    options.Add("-verbose:jni");
+    options.Add("-Xmx256m");
+    options.Add("-Dfoo=2");
+    options.Add("-verbose:gc");
+    ASSERT_EQ(4U, options.size());
+    EXPECT_STREQ("-verbose:jni", options.Get(0));
+    EXPECT_STREQ("-Xmx256m", options.Get(1));
+    EXPECT_STREQ("-Dfoo=2", options.Get(2));
+    EXPECT_STREQ("-verbose:gc", options.Get(3));
+
+    const JavaVMInitArgs* args = options.GetInitArgs();
+    ASSERT_EQ(4, args->nOptions);
+    EXPECT_STREQ("-Xmx256m", args->options[1].optionString);
+}
+
+TEST(JavaVMOptions, Validate) {
+    std::string error;
+    JavaVMOptions good;
+    good.Add("-Xms16m");
+    good.Add("vfprintf", reinterpret_cast<void*>(vfprintf));
+    EXPECT_TRUE(good.Validate(&error)) << error;
+
+    JavaVMOptions bad_size;
+    bad_size.Add("-Xmx12q");
+    EXPECT_FALSE(bad_size.Validate(&error));
+    EXPECT_EQ("invalid size: \"-Xmx12q\"", error);
+
+    JavaVMOptions bad_hook;
+    bad_hook.Add("exit");
+    EXPECT_FALSE(bad_hook.Validate(NULL));
+
+    JavaVMOptions bad_prefix;
+    bad_prefix.Add("Xmx16m");
+    EXPECT_FALSE(bad_prefix.Validate(NULL));
+}
+
+TEST(JavaVMOptions, LoadFileAndBlob) {
+    std::string text_path = TempPath("options");
+    FILE* file = fopen(text_path.c_str(), "w");
+    ASSERT_TRUE(file != NULL);
+    fputs("# launcher options\n  -Xmx64m  \n\n-Djava.io.tmpdir=/tmp\n", file);
+    // Longer than any fixed line buffer: it must stay one option.
+    std::string classpath = "-Djava.class.path=" + std::string(10000, 'c');
+    fprintf(file, "%s\n", classpath.c_str());
+    fclose(file);
+
+    JavaVMOptions options;
+    ASSERT_TRUE(options.LoadFile(text_path.c_str()));
+    options.Add("exit", reinterpret_cast<void*>(exit));
+    ASSERT_EQ(4U, options.size());
+    EXPECT_STREQ("-Xmx64m", options.Get(0));
+    EXPECT_EQ(classpath, options.Get(2));
+
+    std::string blob_path = TempPath("blob");
+    ASSERT_TRUE(options.WriteBlob(blob_path.c_str()));
+    JavaVMOptions loaded;
+    loaded.Add("-Xmx32m");
+    ASSERT_TRUE(loaded.LoadBlob(blob_path.c_str()));
+    EXPECT_FALSE(loaded.LoadBlob(blob_path.c_str()));
+    // The hook is not written, and the blob's -Xmx replaces the earlier one.
+    ASSERT_EQ(3U, loaded.size());
+    EXPECT_STREQ("-Xmx64m", loaded.Get(0));
+    EXPECT_STREQ("-Djava.io.tmpdir=/tmp", loaded.Get(1));
+    EXPECT_EQ(classpath, loaded.Get(2));
+
+    JavaVMOptions not_a_blob;
+    EXPECT_FALSE(not_a_blob.LoadBlob(text_path.c_str()));
+    EXPECT_EQ(0U, not_a_blob.size());
+
+    unlink(text_path.c_str());
+    unlink(blob_path.c_str());
+}
+
+TEST(JavaVMOptions, Fingerprint) {
+    JavaVMOptions a;
+    a.Add("-Xab");
+    a.Add("-Xc");
+    JavaVMOptions b;
+    b.Add("-Xa");
+    b.Add("-Xbc");
+    JavaVMOptions c;
+    c.Add("-Xab");
+    c.Add("-Xc");
+    EXPECT_NE(a.Fingerprint(), b.Fingerprint());
+    EXPECT_EQ(a.Fingerprint(), c.Fingerprint());
+}
+
+TEST(JavaVMOptions, StartupStats) {
+    std::string path = TempPath("stats");
+    uint64_t fingerprint;
+    uint64_t ns;
+    EXPECT_FALSE(JavaVMOptions::GetFastestStartup(path.c_str(), &fingerprint, &ns));
+
+    ASSERT_TRUE(JavaVMOptions::RecordStartup(path.c_str(), 1, 500));
+    ASSERT_TRUE(JavaVMOptions::RecordStartup(path.c_str(), 2, 300));
+    ASSERT_TRUE(JavaVMOptions::RecordStartup(path.c_str(), 1, 200));
+    ASSERT_TRUE(JavaVMOptions::RecordStartup(path.c_str(), 2, 900));
+    ASSERT_TRUE(JavaVMOptions::GetFastestStartup(path.c_str(), &fingerprint, &ns));
+    EXPECT_EQ(1U, fingerprint);
+    EXPECT_EQ(200U, ns);
+    unlink(path.c_str());
+}
+
+TEST(JavaVMOptions, CreateJavaVM) {
+    JniInvocation jni_invocation;
+    ASSERT_TRUE(jni_invocation.Init(kFakeJniLibrary));
+
+    std::string path = TempPath("create");
+    JavaVMOptions options;
+    options.Add("-Xfake:max-local-refs=64");
+    JavaVM* vm;
+    JNIEnv* env;
+    ASSERT_EQ(JNI_OK, options.CreateJavaVM(&vm, &env, path.c_str()));
+    uint64_t fingerprint;
+    uint64_t ns;
+    ASSERT_TRUE(JavaVMOptions::GetFastestStartup(path.c_str(), &fingerprint, &ns));
+    EXPECT_EQ(options.Fingerprint(), fingerprint);
+    EXPECT_GT(ns, 0U);
+    vm->DestroyJavaVM();
+    unlink(path.c_str());
+}
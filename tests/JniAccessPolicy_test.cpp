@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniAccessPolicy.h>
+#include <ScopedArrayView.h>
+#include <ScopedLocalRef.h>
+#include <ScopedPrimitiveArray.h>
+#include <android/log.h>
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniAccessPolicyTest : public JniTest {
+};
+
+static void findAccessSite(const JniAccessSite* site, void* context) {
+    if (strcmp(site->name, "StringView") == 0) {
+        *static_cast<bool*>(context) = true;
+    }
+}
+
+TEST_F(JniAccessPolicyTest, ArrayView) {
+    static JniAccessSite site = JNI_ACCESS_SITE("ArrayView");
+    ScopedLocalRef<jintArray> array(env_, env_->NewIntArray(4096));
+    int used[kJniAccessStrategyCount] = { 0, 0, 0 };
+    for (int i = 0; i < 32; ++i) {
+        ScopedIntArrayView view(env_, array.get(), &site, JNI_ACCESS_NO_JNI_CALLS);
+        ASSERT_TRUE(view.get() != NULL);
+        ASSERT_EQ(4096U, view.size());
+        view[i] += i;
+        used[view.strategy()]++;
+    }
+    // Too big for a region copy; the other two are both tried.
+    EXPECT_EQ(0, used[kJniAccessRegion]);
+    EXPECT_GE(used[kJniAccessElements], 4);
+    EXPECT_GE(used[kJniAccessCritical], 4);
+    std::vector<jint> values(4096);
+    env_->GetIntArrayRegion(array.get(), 0, values.size(), &values[0]);
+    for (int i = 0; i < 32; ++i) {
+        EXPECT_EQ(i, values[i]);
+    }
+    EXPECT_EQ(static_cast<uint64_t>(used[kJniAccessCritical]),
+              site.stats[2][kJniAccessCritical].calls);
+
+    // Read-only views don't write back their copies.
+    fake_->SetCopyMode(vm_, JNI_TRUE);
+    ScopedLocalRef<jbyteArray> small(env_, env_->NewByteArray(16));
+    for (int i = 0; i < 16; ++i) {
+        ScopedByteArrayView view(env_, small.get(), &site, JNI_ACCESS_READ_ONLY);
+        view[0] = 1;
+        EXPECT_NE(kJniAccessCritical, view.strategy());
+    }
+    EXPECT_EQ(0, ScopedByteArrayRO(env_, small.get())[0]);
+    fake_->SetCopyMode(vm_, JNI_FALSE);
+
+    jniSetAccessPolicy(kJniAccessFixed);
+    {
+        ScopedIntArrayView view(env_, array.get(), &site);
+        EXPECT_EQ(kJniAccessElements, view.strategy());
+        ScopedByteArrayView smallView(env_, small.get(), &site);
+        EXPECT_EQ(kJniAccessRegion, smallView.strategy());
+    }
+    jniSetAccessPolicy(kJniAccessForceCritical);
+    {
+        ScopedIntArrayView view(env_, array.get(), &site);
+        EXPECT_EQ(kJniAccessElements, view.strategy());
+    }
+    jniSetAccessPolicy(kJniAccessAdaptive);
+
+    ScopedIntArrayView null_view(env_, NULL, &site);
+    EXPECT_TRUE(null_view.get() == NULL);
+    EXPECT_EQ("java.lang.NullPointerException", TakeException());
+}
+
+TEST_F(JniAccessPolicyTest, StringView) {
+    static JniAccessSite site = JNI_ACCESS_SITE("StringView");
+    ScopedLocalRef<jstring> s(env_, env_->NewStringUTF("h\xc3\xa9llo"));
+    for (int i = 0; i < 16; ++i) {
+        ScopedStringView view(env_, s.get(), &site);
+        ASSERT_EQ(5U, view.size());
+        EXPECT_EQ(0xe9, view[1]);
+        EXPECT_NE(kJniAccessCritical, view.strategy());
+    }
+    EXPECT_GE(site.stats[0][kJniAccessRegion].calls, 4U);
+    EXPECT_GE(site.stats[0][kJniAccessElements].calls, 4U);
+
+    bool found = false;
+    jniGetAccessSites(findAccessSite, &found);
+    EXPECT_TRUE(found);
+    jniLogAccessSites(ANDROID_LOG_DEBUG, "JNIHelpTest");
+}
+
+}  // namespace android
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniBufferPool.h>
+#include <JniConstants.h>
+#include <ScopedBytes.h>
+#include <ScopedLocalRef.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <string.h>
+
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniBufferPoolTest : public JniTest {
+};
+
+static void* churnBufferPool(void* arg) {
+    const size_t capacity = *static_cast<size_t*>(arg);
+    JniTestEnvironment& environment = JniTestEnvironment::Get();
+    JNIEnv* env = environment.AttachCurrentThread();
+    bool ok = true;
+    JniPooledBuffer buffers[40];
+    for (int round = 0; round < 50 && ok; ++round) {
+        for (size_t i = 0; i < NELEM(buffers) && ok; ++i) {
+            ok = jniAllocatePooledBuffer(env, capacity, &buffers[i]) == 0;
+            if (ok) {
+                memset(buffers[i].address, static_cast<int>(i), capacity);
+            }
+        }
+        for (size_t i = 0; i < NELEM(buffers) && ok; ++i) {
+            ok = static_cast<jbyte*>(buffers[i].address)[capacity - 1] == static_cast<jbyte>(i);
+            jniReleasePooledBuffer(env, &buffers[i]);
+        }
+    }
+    environment.DetachCurrentThread();
+    return ok ? arg : NULL;
+}
+
+TEST_F(JniBufferPoolTest, BufferPool) {
+    JniBufferPoolStats before[JNI_BUFFER_POOL_CLASSES];
+    jniGetBufferPoolStats(before);
+    EXPECT_EQ(512U, before[0].blockSize);
+    EXPECT_EQ(static_cast<size_t>(JNI_BUFFER_POOL_MAX_SIZE),
+              before[JNI_BUFFER_POOL_CLASSES - 1].blockSize);
+
+    JniPooledBuffer buffer;
+    ASSERT_EQ(0, jniAllocatePooledBuffer(env_, 1000, &buffer));
+    EXPECT_EQ(1000U, buffer.capacity);
+    EXPECT_EQ(buffer.address, env_->GetDirectBufferAddress(buffer.buffer));
+    EXPECT_EQ(1000, env_->GetDirectBufferCapacity(buffer.buffer));
+    {
+        ScopedBytesRW bytes(env_, buffer);
+        ASSERT_EQ(1000U, bytes.size());
+        memcpy(bytes.get(), "pooled", 6);
+    }
+    {
+        ScopedBytesRO bytes(env_, buffer.buffer);
+        EXPECT_EQ(0, memcmp("pooled", bytes.get(), 6));
+    }
+    void* address = buffer.address;
+    jniReleasePooledBuffer(env_, &buffer);
+
+    // The same thread gets the block straight back from its cache.
+    ASSERT_EQ(0, jniAllocatePooledBuffer(env_, 1024, &buffer));
+    EXPECT_EQ(address, buffer.address);
+    JniBufferPoolStats stats[JNI_BUFFER_POOL_CLASSES];
+    jniGetBufferPoolStats(stats);
+    EXPECT_EQ(before[1].allocations + 2, stats[1].allocations);
+    EXPECT_EQ(before[1].cacheHits + 1, stats[1].cacheHits);
+    EXPECT_EQ(before[1].releases + 1, stats[1].releases);
+    EXPECT_GE(stats[1].slabs, 1U);
+
+    // Java may hand the buffer back instead.
+    jobject object = buffer.buffer;
+    EXPECT_EQ(0, jniReleasePooledByteBuffer(env_, object));
+    env_->DeleteLocalRef(object);
+    std::vector<jbyte> storage(64);
+    ScopedLocalRef<jobject> other(env_, env_->NewDirectByteBuffer(&storage[0], storage.size()));
+    EXPECT_EQ(-1, jniReleasePooledByteBuffer(env_, other.get()));
+    EXPECT_EQ(-1, jniReleasePooledByteBuffer(env_, NULL));
+
+    EXPECT_EQ(-1, jniAllocatePooledBuffer(env_, 0, &buffer));
+    EXPECT_EQ("java.lang.IllegalArgumentException: Bad pooled buffer capacity: 0",
+              TakeException());
+    EXPECT_EQ(-1, jniAllocatePooledBuffer(env_, JNI_BUFFER_POOL_MAX_SIZE + 1, &buffer));
+    EXPECT_EQ("java.lang.IllegalArgumentException: Bad pooled buffer capacity: 1048577",
+              TakeException());
+
+    // Blocks move between threads' caches and the shared lists, and the
+    // counters of exited threads are kept.
+    jniSetBufferPoolFlags(JNI_BUFFER_POOL_HUGEPAGES);
+    jniGetBufferPoolStats(before);
+    pthread_t threads[4];
+    size_t capacities[4] = { 100, 4000, 65536, 300000 };
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, churnBufferPool, &capacities[i]));
+    }
+    for (int i = 0; i < 4; ++i) {
+        void* result;
+        ASSERT_EQ(0, pthread_join(threads[i], &result));
+        EXPECT_TRUE(result != NULL);
+    }
+    jniSetBufferPoolFlags(0);
+    jniGetBufferPoolStats(stats);
+    const size_t classes[4] = { 0, 3, 7, 10 };
+    for (int i = 0; i < 4; ++i) {
+        const size_t c = classes[i];
+        EXPECT_EQ(before[c].allocations + 2000, stats[c].allocations) << c;
+        EXPECT_EQ(before[c].releases + 2000, stats[c].releases) << c;
+        EXPECT_GT(stats[c].sharedBlocks, 0U) << c;
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniByteCursor.h>
+#include <JniBytes.h>
+#include <JniConstants.h>
+#include <ScopedBytes.h>
+#include <ScopedLocalRef.h>
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniByteCursorTest : public JniTest {
+};
+
+TEST_F(JniByteCursorTest, ByteCursor) {
+    jbyte native[32];
+    memset(native, 0, sizeof(native));
+    ScopedLocalRef<jobject> buffer(env_, env_->NewDirectByteBuffer(native, sizeof(native)));
+    {
+        ScopedBytesRW bytes(env_, buffer.get());
+        ASSERT_EQ(32U, bytes.size());
+        JniByteWriter out(bytes);
+        EXPECT_TRUE(out.writeBE<uint8_t>(0xca));
+        EXPECT_TRUE(out.writeBE<uint16_t>(0x1234));
+        EXPECT_TRUE(out.writeLE<uint32_t>(0x89abcdef));
+        EXPECT_TRUE(out.writeBE<int64_t>(-2));
+        EXPECT_TRUE(out.writeLE<float>(1.5f));
+        EXPECT_TRUE(out.writeBE<double>(-0.25));
+        EXPECT_EQ(27U, out.position());
+        EXPECT_FALSE(out.writeBE<uint64_t>(0));
+        EXPECT_FALSE(out.ok());
+        EXPECT_FALSE(out.checkOrThrow(env_));
+        EXPECT_EQ("java.nio.BufferOverflowException", TakeException());
+    }
+    const uint8_t expected[] = { 0xca, 0x12, 0x34, 0xef, 0xcd, 0xab, 0x89,
+                                 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe };
+    EXPECT_EQ(0, memcmp(expected, native, sizeof(expected)));
+
+    {
+        ScopedBytesRO bytes(env_, buffer.get());
+        JniByteReader in(bytes);
+        EXPECT_EQ(0xca, in.readBE<uint8_t>());
+        EXPECT_EQ(0x1234, in.readBE<uint16_t>());
+        EXPECT_EQ(0x89abcdefU, in.readLE<uint32_t>());
+        EXPECT_EQ(-2, in.readBE<int64_t>());
+        EXPECT_EQ(1.5f, in.readLE<float>());
+        EXPECT_EQ(-0.25, in.readBE<double>());
+        EXPECT_TRUE(in.take(5) != NULL);
+        EXPECT_TRUE(in.checkOrThrow(env_));
+        EXPECT_EQ(0U, in.readBE<uint32_t>());
+        EXPECT_FALSE(in.checkOrThrow(env_));
+        EXPECT_EQ("java.nio.BufferUnderflowException", TakeException());
+        EXPECT_TRUE(in.seek(1));
+        EXPECT_FALSE(in.seek(33));
+    }
+
+    // Bulk reads and writes swap through the vector kernels, whichever they are.
+    std::vector<uint8_t> wire(8 * 100 + 3);
+    std::vector<uint16_t> shorts(100);
+    std::vector<uint32_t> ints(100);
+    std::vector<uint64_t> longs(100);
+    for (size_t i = 0; i < 100; ++i) {
+        shorts[i] = static_cast<uint16_t>(i * 0x0101 + 1);
+        ints[i] = static_cast<uint32_t>(i * 0x01020304 + 5);
+        longs[i] = i * 0x0102030405060708ULL + 9;
+    }
+    const JniBytesIsa best = jniBytesIsa();
+    for (int isa = kJniBytesScalar; isa <= kJniBytesNeon; ++isa) {
+        if (jniBytesSetIsa(static_cast<JniBytesIsa>(isa)) != isa) {
+            continue;
+        }
+        JniByteWriter out(&wire[3], 800);
+        EXPECT_TRUE(out.writeBE(&longs[0], 100));
+        EXPECT_FALSE(out.writeBE(&longs[0], 1));
+        JniByteReader in(&wire[3], 800);
+        EXPECT_EQ(longs[1], (in.seek(8), in.readBE<uint64_t>()));
+        std::vector<uint64_t> readLongs(100);
+        in.seek(0);
+        EXPECT_TRUE(in.readBE(&readLongs[0], 100));
+        EXPECT_TRUE(readLongs == longs) << isa;
+
+        JniByteWriter out32(&wire[1], 800);
+        EXPECT_TRUE(out32.writeBE(&ints[0], 100));
+        EXPECT_TRUE(out32.writeLE(&shorts[0], 100));
+        JniByteReader in32(&wire[1], 800);
+        std::vector<uint32_t> readInts(100);
+        std::vector<uint16_t> readShorts(100);
+        EXPECT_TRUE(in32.readBE(&readInts[0], 100));
+        EXPECT_TRUE(in32.readLE(&readShorts[0], 100));
+        EXPECT_TRUE(readInts == ints) << isa;
+        EXPECT_TRUE(readShorts == shorts) << isa;
+        EXPECT_EQ(ints[7], JniByteReader(&wire[1 + 28], 4).readBE<uint32_t>());
+
+        jniBytesSwap16(&readShorts[0], &readShorts[0], 100);
+        EXPECT_EQ(__builtin_bswap16(shorts[99]), readShorts[99]);
+    }
+    jniBytesSetIsa(best);
+}
+
+}  // namespace android
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniBytes.h>
+#include <JniConstants.h>
+#include <ScopedBytes.h>
+#include <ScopedLocalRef.h>
+#include <ScopedUtfChars.h>
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniBytesTest : public JniTest {
+};
+
+TEST_F(JniBytesTest, ByteKernels) {
+    const char digits[] = "123456789";
+    EXPECT_EQ(0xe3069283U, jniBytesCrc32c(0, digits, 9));
+    EXPECT_EQ(0xe3069283U, jniBytesCrc32c(jniBytesCrc32c(0, digits, 4), digits + 4, 5));
+    EXPECT_EQ(0x11e60398U, jniBytesAdler32(1, "Wikipedia", 9));
+    EXPECT_EQ(4, jniBytesIndexOf(digits, 9, '5'));
+    EXPECT_EQ(-1, jniBytesIndexOf(digits, 9, 'x'));
+
+    char text[16];
+    EXPECT_EQ(8U, jniBytesToBase64(text, "foobar", 4));
+    EXPECT_EQ("Zm9vYg==", std::string(text, 8));
+    EXPECT_EQ(5, jniBytesFromBase64(text, "Zm9vYmE=", 8));
+    EXPECT_EQ("fooba", std::string(text, 5));
+    EXPECT_EQ(-1, jniBytesFromBase64(text, "Zm=v", 4));
+    EXPECT_EQ(-1, jniBytesFromHex(text, "0g", 2));
+    EXPECT_EQ(2, jniBytesFromHex(text, "aBcD", 4));
+    EXPECT_EQ(0, memcmp(text, "\xab\xcd", 2));
+
+    // Every instruction set this CPU has agrees with the scalar kernels, at
+    // every alignment and across the vector loop tails.
+    std::vector<uint8_t> data(70000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+    }
+    const JniBytesIsa best = jniBytesIsa();
+    const size_t sizes[] = { 0, 1, 15, 16, 33, 100, 5553, 65536 };
+    for (int isa = kJniBytesScalar; isa <= kJniBytesNeon; ++isa) {
+        for (size_t offset = 0; offset < 4; ++offset) {
+            for (size_t s = 0; s < NELEM(sizes); ++s) {
+                const uint8_t* p = &data[offset];
+                const size_t size = sizes[s];
+                jniBytesSetIsa(kJniBytesScalar);
+                uint32_t crc = jniBytesCrc32c(0, p, size);
+                uint32_t adler = jniBytesAdler32(1, p, size);
+                std::string hex(2 * size, ' ');
+                jniBytesToHex(&hex[0], p, size);
+                std::vector<uint8_t> upper(size + 1);
+                jniBytesToUpperAscii(&upper[0], p, size);
+                if (jniBytesSetIsa(static_cast<JniBytesIsa>(isa)) != isa) {
+                    continue;
+                }
+                EXPECT_EQ(crc, jniBytesCrc32c(0, p, size)) << isa << " " << size;
+                EXPECT_EQ(adler, jniBytesAdler32(1, p, size)) << isa << " " << size;
+                std::string vectorHex(2 * size, ' ');
+                jniBytesToHex(&vectorHex[0], p, size);
+                EXPECT_EQ(hex, vectorHex) << isa << " " << size;
+                std::vector<uint8_t> vectorUpper(size + 1);
+                jniBytesToUpperAscii(&vectorUpper[0], p, size);
+                EXPECT_TRUE(upper == vectorUpper) << isa << " " << size;
+                // Lowercasing the uppercased bytes brings back the letters.
+                jniBytesToLowerAscii(&vectorUpper[0], &vectorUpper[0], size);
+                for (size_t i = 0; i < size; ++i) {
+                    uint8_t c = p[i];
+                    uint8_t expected = (c >= 'A' && c <= 'Z') ? c + 32 : c;
+                    ASSERT_EQ(expected, vectorUpper[i]) << isa << " " << i;
+                }
+            }
+        }
+    }
+    EXPECT_EQ(best, jniBytesSetIsa(best));
+
+    // Round trips, and Strings straight from a view.
+    ScopedLocalRef<jbyteArray> array(env_, env_->NewByteArray(1000));
+    env_->SetByteArrayRegion(array.get(), 0, 1000, reinterpret_cast<jbyte*>(&data[0]));
+    {
+        ScopedBytesRO bytes(env_, array.get());
+        ASSERT_EQ(1000U, bytes.size());
+        ScopedLocalRef<jstring> hex(env_, jniBytesToHexString(env_, bytes));
+        ScopedUtfChars hexChars(env_, hex.get());
+        ASSERT_EQ(2000U, hexChars.size());
+        std::vector<uint8_t> decoded(1000);
+        EXPECT_EQ(1000, jniBytesFromHex(&decoded[0], hexChars.c_str(), hexChars.size()));
+        EXPECT_TRUE(jniBytesEqual(&decoded[0], bytes.get(), 1000));
+
+        ScopedLocalRef<jstring> base64(env_, jniBytesToBase64String(env_, bytes));
+        ScopedUtfChars base64Chars(env_, base64.get());
+        ASSERT_EQ(JNI_BASE64_ENCODED_SIZE(1000U), base64Chars.size());
+        std::fill(decoded.begin(), decoded.end(), 0);
+        EXPECT_EQ(1000, jniBytesFromBase64(&decoded[0], base64Chars.c_str(), base64Chars.size()));
+        EXPECT_TRUE(jniBytesEqual(&decoded[0], bytes.get(), 1000));
+        EXPECT_EQ(jniBytesCrc32c(0, &data[0], 1000), jniBytesCrc32c(bytes));
+    }
+}
+
+}  // namespace android
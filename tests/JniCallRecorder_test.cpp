@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniCallRecorder.h>
+#include <ScopedLocalRef.h>
+#include <ScopedPrimitiveArray.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniCallRecorderTest : public JniTest {
+};
+
+struct RecordedCall {
+    uint64_t tid;
+    int id;
+    int type;
+    uint64_t size;
+};
+
+static uint64_t readLeb128(FILE* file) {
+    uint64_t value = 0;
+    int c;
+    for (int shift = 0; (c = fgetc(file)) != EOF; shift += 7) {
+        value |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) {
+            break;
+        }
+    }
+    return value;
+}
+
+// Returns the calls in a JniCallRecorder trace, block by block, or nothing if
+// the header is wrong.
+static std::vector<RecordedCall> readCallTrace(const char* path) {
+    std::vector<RecordedCall> calls;
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return calls;
+    }
+    char header[5];
+    if (fread(header, 1, sizeof(header), file) == sizeof(header) &&
+            memcmp(header, "JNIT\2", sizeof(header)) == 0) {
+        int c;
+        while ((c = fgetc(file)) != EOF) {
+            ungetc(c, file);
+            const uint64_t tid = readLeb128(file);
+            const uint64_t length = readLeb128(file);
+            const long end = ftell(file) + static_cast<long>(length);
+            while (ftell(file) < end) {
+                RecordedCall call;
+                call.tid = tid;
+                call.id = fgetc(file);
+                call.type = fgetc(file);
+                call.size = readLeb128(file);
+                readLeb128(file);  // Duration.
+                calls.push_back(call);
+            }
+        }
+    }
+    fclose(file);
+    return calls;
+}
+
+struct RecordingThread {
+    jintArray array;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool recorded;
+    bool stopped;
+};
+
+// Makes recorded calls, then waits for the trace to be stopped before
+// detaching, so that Stop has to write out what it has gathered.
+static void* recordOnThread(void* arg) {
+    RecordingThread* thread = static_cast<RecordingThread*>(arg);
+    JNIEnv* env = JniTestEnvironment::Get().AttachCurrentThread();
+    JniCallRecorder::Attach(env);
+    for (int i = 0; i < 3000; ++i) {
+        env->GetArrayLength(thread->array);
+    }
+    pthread_mutex_lock(&thread->lock);
+    thread->recorded = true;
+    pthread_cond_broadcast(&thread->changed);
+    while (!thread->stopped) {
+        pthread_cond_wait(&thread->changed, &thread->lock);
+    }
+    pthread_mutex_unlock(&thread->lock);
+    JniCallRecorder::Detach(env);
+    JniTestEnvironment::Get().DetachCurrentThread();
+    return NULL;
+}
+
+TEST_F(JniCallRecorderTest, CallRecorder) {
+    const char* dir = getenv("TMPDIR");
+    char path[256];
+    snprintf(path, sizeof(path), "%s/JNIHelp_test-%d.trace", (dir != NULL) ? dir : "/tmp",
+             getpid());
+    ScopedLocalRef<jintArray> array(env_, env_->NewIntArray(2048));
+
+    ASSERT_TRUE(JniCallRecorder::Start(path));
+    EXPECT_FALSE(JniCallRecorder::Start(path));
+    ASSERT_TRUE(JniCallRecorder::Attach(env_));
+    ASSERT_TRUE(JniCallRecorder::Attach(env_));
+    {
+        ScopedIntArrayRO ints(env_, array.get());
+    }
+    jniThrowException(env_, "java/lang/IllegalStateException", "recorded");
+    env_->ExceptionClear();
+    JniCallRecorder::Detach(env_);
+    // Not recorded.
+    env_->GetArrayLength(array.get());
+    uint64_t records = JniCallRecorder::Stop();
+
+    std::vector<RecordedCall> calls = readCallTrace(path);
+    unlink(path);
+    ASSERT_EQ(records, calls.size());
+    ASSERT_GE(calls.size(), 5U);
+    // ScopedIntArrayRO asks for the length, then takes the elements.
+    EXPECT_EQ(kJniCallGetArrayLength, calls[0].id);
+    EXPECT_EQ(kJniCallGetArrayElements, calls[1].id);
+    EXPECT_EQ(kJniCallTypeInt, calls[1].type);
+    EXPECT_EQ(2048U, calls[1].size);
+    EXPECT_EQ(kJniCallReleaseArrayElements, calls[2].id);
+    EXPECT_EQ(kJniCallFindClass, calls[3].id);
+    bool threw = false;
+    for (size_t i = 1; i < calls.size(); ++i) {
+        EXPECT_NE(kJniCallGetArrayLength, calls[i].id);
+        threw |= calls[i].id == kJniCallThrowNew;
+    }
+    EXPECT_TRUE(threw);
+
+    // Calls from another thread are tagged with its id, and those it has
+    // not written out yet are written by Stop.
+    ASSERT_TRUE(JniCallRecorder::Start(path));
+    ASSERT_TRUE(JniCallRecorder::Attach(env_));
+    RecordingThread recording;
+    recording.array = array.get();
+    pthread_mutex_init(&recording.lock, NULL);
+    pthread_cond_init(&recording.changed, NULL);
+    recording.recorded = false;
+    recording.stopped = false;
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, recordOnThread, &recording));
+    pthread_mutex_lock(&recording.lock);
+    while (!recording.recorded) {
+        pthread_cond_wait(&recording.changed, &recording.lock);
+    }
+    pthread_mutex_unlock(&recording.lock);
+    env_->GetArrayLength(array.get());
+    JniCallRecorder::Detach(env_);
+    records = JniCallRecorder::Stop();
+    pthread_mutex_lock(&recording.lock);
+    recording.stopped = true;
+    pthread_cond_broadcast(&recording.changed);
+    pthread_mutex_unlock(&recording.lock);
+    ASSERT_EQ(0, pthread_join(thread, NULL));
+    pthread_cond_destroy(&recording.changed);
+    pthread_mutex_destroy(&recording.lock);
+
+    calls = readCallTrace(path);
+    unlink(path);
+    ASSERT_EQ(3001U, records);
+    ASSERT_EQ(records, calls.size());
+    std::map<uint64_t, size_t> perThread;
+    for (size_t i = 0; i < calls.size(); ++i) {
+        EXPECT_EQ(kJniCallGetArrayLength, calls[i].id);
+        perThread[calls[i].tid]++;
+    }
+    ASSERT_EQ(2U, perThread.size());
+    EXPECT_EQ(1U, perThread[static_cast<uint64_t>(gettid())]);
+}
+
+}  // namespace android
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniCheck.h>
+#include <ScopedLocalRef.h>
+#include <ScopedPrimitiveArray.h>
+#include <ScopedPrimitiveArrayCritical.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniCheckTest : public JniTest {
+};
+
+struct WrongThreadArgs {
+    JNIEnv* env;
+    uint64_t failures;
+};
+
+static void* useEnvOnWrongThread(void* arg) {
+    WrongThreadArgs* args = static_cast<WrongThreadArgs*>(arg);
+    JniTestEnvironment& environment = JniTestEnvironment::Get();
+    environment.AttachCurrentThread();
+    uint64_t before = jniLightCheckFailures();
+    jniGetFDFromFileDescriptor(args->env, NULL);
+    args->failures = jniLightCheckFailures() - before;
+    environment.DetachCurrentThread();
+    return NULL;
+}
+
+TEST_F(JniCheckTest, LightCheck) {
+    jniSetLightCheck(1);
+    uint64_t failures = jniLightCheckFailures();
+
+    // Correct use reports nothing.
+    ScopedLocalRef<jintArray> array(env_, env_->NewIntArray(4));
+    {
+        ScopedIntArrayRO ro(env_, array.get());
+    }
+    EXPECT_EQ(failures, jniLightCheckFailures());
+
+    // A JNIHelp call while a critical region is open.
+    {
+        ScopedIntArrayCritical critical(env_, array.get());
+        jniGetFDFromFileDescriptor(env_, NULL);
+    }
+    EXPECT_EQ(failures + 1, jniLightCheckFailures());
+    jniGetFDFromFileDescriptor(env_, NULL);
+    EXPECT_EQ(failures + 1, jniLightCheckFailures());
+
+    // This thread's env used on another thread.
+    WrongThreadArgs args = { env_, 0 };
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, useEnvOnWrongThread, &args));
+    ASSERT_EQ(0, pthread_join(thread, NULL));
+    EXPECT_EQ(1U, args.failures);
+
+    // Local references held through ScopedLocalRef.
+    jniSetLightCheckLocalRefLimit(8);
+    failures = jniLightCheckFailures();
+    {
+        std::vector<ScopedLocalRef<jstring>*> refs;
+        for (int i = 0; i < 10; ++i) {
+            refs.push_back(new ScopedLocalRef<jstring>(env_, env_->NewStringUTF("held")));
+        }
+        EXPECT_EQ(11, jniLightCheckLocalRefHighWater());  // Including array.
+        for (size_t i = 0; i < refs.size(); ++i) {
+            delete refs[i];
+        }
+    }
+    EXPECT_EQ(failures + 1, jniLightCheckFailures());
+
+    jniSetLightCheckLocalRefLimit(256);
+    jniSetLightCheck(0);
+}
+
+}  // namespace android
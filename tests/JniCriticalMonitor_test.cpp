@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniCriticalMonitor.h>
+#include <ScopedLocalRef.h>
+#include <ScopedPrimitiveArrayCritical.h>
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniCriticalMonitorTest : public JniTest {
+};
+
+static void countCriticalSite(const void*, const char*, uint64_t count, uint64_t maxNs,
+                              size_t maxBytes, void* context) {
+    uint64_t* totals = static_cast<uint64_t*>(context);
+    totals[0] += count;
+    totals[1] = std::max<uint64_t>(totals[1], maxNs);
+    totals[2] = std::max<uint64_t>(totals[2], maxBytes);
+}
+
+static void collectCriticalSite(const void* site, const char*, uint64_t, uint64_t, size_t,
+                                void* context) {
+    static_cast<std::vector<const void*>*>(context)->push_back(site);
+}
+
+// Two places holding the same kind of region slowly, which must count as two sites.
+static __attribute__((noinline)) void holdSlowlyHere(JNIEnv* env, jintArray array) {
+    ScopedIntArrayCritical critical(env, array);
+    usleep(2000);
+}
+
+static __attribute__((noinline)) void holdSlowlyThere(JNIEnv* env, jintArray array) {
+    ScopedIntArrayCritical critical(env, array);
+    usleep(2000);
+}
+
+TEST_F(JniCriticalMonitorTest, CriticalHoldMonitor) {
+    uint64_t before[3] = { 0, 0, 0 };
+    jniGetCriticalHoldSites(countCriticalSite, before);
+
+    ScopedLocalRef<jintArray> array(env_, env_->NewIntArray(1000));
+    jniSetCriticalHoldThreshold(1000000);
+    {
+        ScopedIntArrayCritical quick(env_, array.get());
+    }
+    {
+        ScopedIntArrayCritical slow(env_, array.get());
+        usleep(2000);
+    }
+    jniSetCriticalHoldThreshold(0);
+    {
+        ScopedIntArrayCritical unmonitored(env_, array.get());
+        usleep(2000);
+    }
+
+    uint64_t after[3] = { 0, 0, 0 };
+    jniGetCriticalHoldSites(countCriticalSite, after);
+    EXPECT_EQ(before[0] + 1, after[0]);
+    EXPECT_GE(after[1], 2000000U);
+    EXPECT_EQ(1000 * sizeof(jint), after[2]);
+
+    uint64_t buckets[JNI_CRITICAL_HISTOGRAM_BUCKETS];
+    jniGetCriticalHoldHistogram(buckets);
+    uint64_t total = 0;
+    for (int i = 0; i < 20; ++i) {  // Below the 1ms threshold.
+        EXPECT_EQ(0U, buckets[i]) << i;
+    }
+    for (int i = 0; i < JNI_CRITICAL_HISTOGRAM_BUCKETS; ++i) {
+        total += buckets[i];
+    }
+    EXPECT_EQ(after[0], total);
+
+    // Holds are attributed to where they were acquired, not to the helper.
+    std::vector<const void*> sitesBefore;
+    jniGetCriticalHoldSites(collectCriticalSite, &sitesBefore);
+    jniSetCriticalHoldThreshold(1000000);
+    holdSlowlyHere(env_, array.get());
+    holdSlowlyThere(env_, array.get());
+    holdSlowlyHere(env_, array.get());
+    jniSetCriticalHoldThreshold(0);
+    std::vector<const void*> sitesAfter;
+    jniGetCriticalHoldSites(collectCriticalSite, &sitesAfter);
+    EXPECT_EQ(sitesBefore.size() + 2, sitesAfter.size());
+}
+
+}  // namespace android
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniDispatcher.h>
+#include <ScopedLocalRef.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniDispatcherTest : public JniTest {
+};
+
+struct EventSink {
+    pthread_mutex_t lock;
+    pthread_cond_t opened;
+    bool closed;
+    bool throwNext;
+    std::vector<uint64_t> events;
+    std::vector<int> batchSizes;
+};
+
+static EventSink gSink = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, false, false,
+                           std::vector<uint64_t>(), std::vector<int>() };
+
+static void receiveEvents(JNIEnv* env, const uint64_t* events, jint count) {
+    pthread_mutex_lock(&gSink.lock);
+    while (gSink.closed) {
+        pthread_cond_wait(&gSink.opened, &gSink.lock);
+    }
+    gSink.events.insert(gSink.events.end(), events, events + count);
+    gSink.batchSizes.push_back(count);
+    if (gSink.throwNext) {
+        gSink.throwNext = false;
+        jniThrowException(env, "java/lang/IllegalStateException", "listener failed");
+    }
+    pthread_mutex_unlock(&gSink.lock);
+}
+
+static void EventSink_onBufferEvents(JNIEnv* env, jobject, jobject buffer, jint count) {
+    EXPECT_GE(env->GetDirectBufferCapacity(buffer), count * 8);
+    receiveEvents(env, static_cast<const uint64_t*>(env->GetDirectBufferAddress(buffer)), count);
+}
+
+static void EventSink_onArrayEvents(JNIEnv* env, jobject, jlongArray array, jint count) {
+    std::vector<jlong> events(count);
+    env->GetLongArrayRegion(array, 0, count, &events[0]);
+    receiveEvents(env, reinterpret_cast<const uint64_t*>(&events[0]), count);
+}
+
+static void resetSink() {
+    pthread_mutex_lock(&gSink.lock);
+    gSink.events.clear();
+    gSink.batchSizes.clear();
+    pthread_mutex_unlock(&gSink.lock);
+}
+
+struct EventProducer {
+    JniDispatcher* dispatcher;
+    uint64_t id;
+};
+
+static void* postEvents(void* arg) {
+    EventProducer* producer = static_cast<EventProducer*>(arg);
+    for (uint64_t i = 0; i < 5000; ++i) {
+        const uint64_t event = (producer->id << 32) | i;
+        if (jniDispatcherPost(producer->dispatcher, &event) != 0) {
+            return NULL;
+        }
+    }
+    return arg;
+}
+
+// Waits up to a few seconds for the dispatcher to deliver count events.
+static bool awaitDelivered(JniDispatcher* dispatcher, uint64_t count) {
+    JniDispatcherStats stats;
+    for (int i = 0; i < 5000; ++i) {
+        jniDispatcherGetStats(dispatcher, &stats);
+        if (stats.delivered >= count) {
+            return stats.delivered == count;
+        }
+        usleep(1000);
+    }
+    return false;
+}
+
+TEST_F(JniDispatcherTest, Dispatcher) {
+    ScopedLocalRef<jclass> sinkClass(env_, env_->FindClass("test/EventSink"));
+    JNINativeMethod methods[] = {
+        { "onEvents", "(Ljava/nio/ByteBuffer;I)V",
+          reinterpret_cast<void*>(EventSink_onBufferEvents) },
+        { "onEvents", "([JI)V", reinterpret_cast<void*>(EventSink_onArrayEvents) },
+    };
+    ASSERT_EQ(JNI_OK, env_->RegisterNatives(sinkClass.get(), methods, NELEM(methods)));
+    ScopedLocalRef<jobject> sink(env_, env_->AllocObject(sinkClass.get()));
+
+    // Many producers; full batches go at once, and a flush delivers the rest.
+    JniDispatcherOptions options = { 8, 64, 1000000000, 4, JNI_DISPATCH_BUFFER };
+    resetSink();
+    JniDispatcher* dispatcher = jniDispatcherCreate(env_, sink.get(), "onEvents", &options);
+    ASSERT_TRUE(dispatcher != NULL);
+    EventProducer producers[4];
+    pthread_t threads[4];
+    for (int i = 0; i < 4; ++i) {
+        producers[i].dispatcher = dispatcher;
+        producers[i].id = i;
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, postEvents, &producers[i]));
+    }
+    for (int i = 0; i < 4; ++i) {
+        void* result;
+        ASSERT_EQ(0, pthread_join(threads[i], &result));
+        EXPECT_TRUE(result != NULL);
+    }
+    EXPECT_EQ(0, jniDispatcherFlush(dispatcher));
+    JniDispatcherStats stats;
+    jniDispatcherGetStats(dispatcher, &stats);
+    EXPECT_EQ(20000U, stats.posted);
+    EXPECT_EQ(20000U, stats.delivered);
+    EXPECT_GT(stats.fullBatches, 0U);
+    EXPECT_EQ(stats.batches, stats.fullBatches + stats.lateBatches + stats.flushedBatches);
+    pthread_mutex_lock(&gSink.lock);
+    ASSERT_EQ(20000U, gSink.events.size());
+    std::vector<uint64_t> next(4, 0);
+    for (size_t i = 0; i < gSink.events.size(); ++i) {
+        const uint64_t id = gSink.events[i] >> 32;
+        ASSERT_LT(id, 4U);
+        EXPECT_EQ(next[id]++, gSink.events[i] & 0xffffffff);
+    }
+    for (size_t i = 0; i < gSink.batchSizes.size(); ++i) {
+        EXPECT_LE(gSink.batchSizes[i], 64);
+    }
+    pthread_mutex_unlock(&gSink.lock);
+
+    // A lone event goes once it has waited long enough; an exception from
+    // Java is logged and delivery goes on.
+    jniDispatcherDestroy(dispatcher);
+    options.maxLatencyNs = 5000000;
+    dispatcher = jniDispatcherCreate(env_, sink.get(), "onEvents", &options);
+    ASSERT_TRUE(dispatcher != NULL);
+    gSink.throwNext = true;
+    uint64_t event = 42;
+    EXPECT_EQ(0, jniDispatcherPost(dispatcher, &event));
+    EXPECT_TRUE(awaitDelivered(dispatcher, 1));
+    EXPECT_EQ(0, jniDispatcherPost(dispatcher, &event));
+    EXPECT_TRUE(awaitDelivered(dispatcher, 2));
+    jniDispatcherGetStats(dispatcher, &stats);
+    EXPECT_EQ(2U, stats.lateBatches);
+    EXPECT_EQ(1U, stats.exceptions);
+    jniDispatcherDestroy(dispatcher);
+
+    // long[] batches, delivered as they fill.
+    resetSink();
+    JniDispatcherOptions arrayOptions = { 8, 10, 1000000000, 2, JNI_DISPATCH_LONG_ARRAY };
+    dispatcher = jniDispatcherCreate(env_, sink.get(), "onEvents", &arrayOptions);
+    ASSERT_TRUE(dispatcher != NULL);
+    for (event = 0; event < 25; ++event) {
+        EXPECT_EQ(0, jniDispatcherPost(dispatcher, &event));
+    }
+    EXPECT_TRUE(awaitDelivered(dispatcher, 20));
+    jniDispatcherDestroy(dispatcher);
+    pthread_mutex_lock(&gSink.lock);
+    ASSERT_EQ(25U, gSink.events.size());
+    for (size_t i = 0; i < 25; ++i) {
+        EXPECT_EQ(i, gSink.events[i]);
+    }
+    pthread_mutex_unlock(&gSink.lock);
+
+    // While Java is stuck, a full queue drops events if asked to.
+    JniDispatcherOptions dropOptions = { 8, 4, 1000, 1, JNI_DISPATCH_DROP_WHEN_FULL };
+    dispatcher = jniDispatcherCreate(env_, sink.get(), "onEvents", &dropOptions);
+    ASSERT_TRUE(dispatcher != NULL);
+    gSink.closed = true;
+    int dropped = 0;
+    for (event = 0; event < 1000; ++event) {
+        if (jniDispatcherPost(dispatcher, &event) == JNI_DISPATCH_DROPPED) {
+            ++dropped;
+        }
+    }
+    EXPECT_GT(dropped, 0);
+    pthread_mutex_lock(&gSink.lock);
+    gSink.closed = false;
+    pthread_cond_broadcast(&gSink.opened);
+    pthread_mutex_unlock(&gSink.lock);
+    EXPECT_EQ(0, jniDispatcherFlush(dispatcher));
+    jniDispatcherGetStats(dispatcher, &stats);
+    EXPECT_EQ(static_cast<uint64_t>(dropped), stats.dropped);
+    EXPECT_EQ(1000U - dropped, stats.delivered);
+    jniDispatcherDestroy(dispatcher);
+
+    JniDispatcherOptions badOptions = { 12, 4, 0, 1, JNI_DISPATCH_LONG_ARRAY };
+    EXPECT_TRUE(jniDispatcherCreate(env_, sink.get(), "onEvents", &badOptions) == NULL);
+    EXPECT_EQ("java.lang.IllegalArgumentException: Bad dispatcher options", TakeException());
+    env_->UnregisterNatives(sinkClass.get());
+}
+
+}  // namespace android
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniHandleTable.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniHandleTableTest : public JniTest {
+};
+
+struct HandleChurn {
+    JniHandleTable* table;
+    jlong shared;  // Looked up by every thread, never removed.
+    size_t failures;
+};
+
+void* churnHandles(void* context) {
+    HandleChurn* churn = static_cast<HandleChurn*>(context);
+    JNIEnv* env = JniTestEnvironment::Get().AttachCurrentThread();
+    int peers[16];
+    jlong handles[16];
+    size_t failures = 0;
+    for (int round = 0; round < 1000; ++round) {
+        for (int i = 0; i < 16; ++i) {
+            handles[i] = jniHandleTableAdd(env, churn->table, &peers[i]);
+        }
+        for (int i = 0; i < 16; ++i) {
+            failures += jniHandleTableGet(churn->table, handles[i]) != &peers[i];
+            failures += jniHandleTableGet(churn->table, churn->shared) != churn;
+            failures += jniHandleTableRemove(churn->table, handles[i]) != &peers[i];
+            failures += jniHandleTableGet(churn->table, handles[i]) != NULL;
+        }
+    }
+    __atomic_fetch_add(&churn->failures, failures, __ATOMIC_RELAXED);
+    JniTestEnvironment::Get().DetachCurrentThread();
+    return NULL;
+}
+
+TEST_F(JniHandleTableTest, HandleTable) {
+    EXPECT_TRUE(jniHandleTableCreate(env_, 0) == NULL);
+    EXPECT_EQ("java.lang.IllegalArgumentException: Bad handle table size: 0", TakeException());
+
+    JniHandleTable* table = jniHandleTableCreate(env_, 8);
+    ASSERT_TRUE(table != NULL);
+    int peers[9];
+    jlong handles[9];
+    for (int i = 0; i < 8; ++i) {
+        handles[i] = jniHandleTableAdd(env_, table, &peers[i]);
+        ASSERT_NE(0, handles[i]);
+    }
+    EXPECT_EQ(0, jniHandleTableAdd(env_, table, &peers[8]));
+    EXPECT_EQ("java.lang.IllegalStateException: Handle table full: 8 handles", TakeException());
+    EXPECT_EQ(0, jniHandleTableAdd(env_, table, NULL));
+    EXPECT_EQ("java.lang.NullPointerException: pointer == null", TakeException());
+    EXPECT_EQ(8U, jniHandleTableSize(table));
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_EQ(&peers[i], jniHandleTableGet(table, handles[i]));
+    }
+
+    // A removed handle goes stale, and stays stale once its slot is reused.
+    EXPECT_EQ(&peers[3], jniHandleTableRemove(table, handles[3]));
+    EXPECT_TRUE(jniHandleTableRemove(table, handles[3]) == NULL);
+    EXPECT_TRUE(jniHandleTableGet(table, handles[3]) == NULL);
+    EXPECT_TRUE(jniHandleTableResolve(env_, table, handles[3]) == NULL);
+    char stale[32];
+    snprintf(stale, sizeof(stale), "%#llx", static_cast<unsigned long long>(handles[3]));
+    EXPECT_EQ(std::string("java.lang.IllegalStateException: Stale native handle: ") + stale,
+              TakeException());
+    handles[8] = jniHandleTableAdd(env_, table, &peers[8]);
+    EXPECT_EQ(handles[3] & 0xffffffff, handles[8] & 0xffffffff);
+    EXPECT_NE(handles[3], handles[8]);
+    EXPECT_TRUE(jniHandleTableGet(table, handles[3]) == NULL);
+    EXPECT_EQ(&peers[8], jniHandleTableResolve(env_, table, handles[8]));
+
+    // Handles that were never issued.
+    EXPECT_TRUE(jniHandleTableGet(table, 0) == NULL);
+    EXPECT_TRUE(jniHandleTableGet(table, handles[0] + (1LL << 32)) == NULL);
+    EXPECT_TRUE(jniHandleTableGet(table, handles[0] | 0xffff) == NULL);
+    EXPECT_TRUE(jniHandleTableGet(table, -1) == NULL);
+    jniHandleTableDestroy(table);
+
+    // Threads adding and removing their own handles, all resolving a shared one.
+    HandleChurn churn;
+    churn.table = jniHandleTableCreate(env_, 1024);
+    ASSERT_TRUE(churn.table != NULL);
+    churn.shared = jniHandleTableAdd(env_, churn.table, &churn);
+    churn.failures = 0;
+    pthread_t threads[4];
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, churnHandles, &churn));
+    }
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(0, pthread_join(threads[i], NULL));
+    }
+    EXPECT_EQ(0U, churn.failures);
+    EXPECT_EQ(1U, jniHandleTableSize(churn.table));
+    EXPECT_EQ(&churn, jniHandleTableRemove(churn.table, churn.shared));
+    EXPECT_EQ(0U, jniHandleTableSize(churn.table));
+    jniHandleTableDestroy(churn.table);
+
+    // More live tables than a process has pthread keys, all used from one thread.
+    std::vector<JniHandleTable*> tables(1100);
+    for (size_t i = 0; i < tables.size(); ++i) {
+        tables[i] = jniHandleTableCreate(env_, 1);
+        ASSERT_TRUE(tables[i] != NULL);
+    }
+    for (size_t i = 0; i < tables.size(); i += 100) {
+        jlong handle = jniHandleTableAdd(env_, tables[i], &peers[0]);
+        ASSERT_NE(0, handle) << TakeException();
+        EXPECT_EQ(&peers[0], jniHandleTableRemove(tables[i], handle));
+    }
+    for (size_t i = 0; i < tables.size(); ++i) {
+        jniHandleTableDestroy(tables[i]);
+    }
+}
+
+}  // namespace android
@@ -22,6 +22,13 @@
 
 #include "string.h"
 
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
 #if defined(__ANDROID__) && defined(__BIONIC__)
 #define HAVE_TEST_STUFF 1
 #else
@@ -150,4 +157,83 @@ TEST_F(JNIInvocationTest, NonDebuggable) {
 #endif
 }
 
+#if !defined(__ANDROID__)
+#ifndef PROPERTY_VALUE_MAX
+#define PROPERTY_VALUE_MAX 92
+#endif
+
+TEST_F(JNIInvocationTest, HostEnvironmentVariable) {
+    unsetenv("JNI_INVOCATION_CONFIG");
+    setenv("JNI_INVOCATION_LIBRARY", "libfakejvm.so", 1);
+    char buffer[PROPERTY_VALUE_MAX];
+    EXPECT_STREQ("libfakejvm.so", JniInvocation::GetLibrary(NULL, buffer));
+    // An explicit library still wins.
+    EXPECT_STREQ("libartd.so", JniInvocation::GetLibrary("libartd.so", buffer));
+    unsetenv("JNI_INVOCATION_LIBRARY");
+    EXPECT_STREQ("libart.so", JniInvocation::GetLibrary(NULL, buffer));
+}
+
+TEST_F(JNIInvocationTest, HostConfigFile) {
+    char path[] = "/tmp/jni_invocation_test-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_NE(-1, fd);
+    const char config[] = "# runtimes to compare\n\n  libartd.so  \nlibart.so\nlibother.so\n";
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(config) - 1), write(fd, config, sizeof(config) - 1));
+    close(fd);
+
+    unsetenv("JNI_INVOCATION_LIBRARY");
+    setenv("JNI_INVOCATION_CONFIG", path, 1);
+    char buffer[PROPERTY_VALUE_MAX];
+    EXPECT_STREQ("libartd.so", JniInvocation::GetLibrary(NULL, buffer));
+    // Without a buffer the config file cannot be used.
+    EXPECT_STREQ("libart.so", JniInvocation::GetLibrary(NULL, NULL));
+
+    setenv("JNI_INVOCATION_LIBRARY", "libother.so", 1);
+    std::vector<std::string> candidates = JniInvocation::GetCandidateLibraries();
+    ASSERT_EQ(3U, candidates.size());
+    EXPECT_EQ("libother.so", candidates[0]);
+    EXPECT_EQ("libartd.so", candidates[1]);
+    EXPECT_EQ("libart.so", candidates[2]);
+
+    unsetenv("JNI_INVOCATION_LIBRARY");
+    unsetenv("JNI_INVOCATION_CONFIG");
+    unlink(path);
+}
+
+TEST_F(JNIInvocationTest, HostConfigFileLongEntry) {
+    char path[] = "/tmp/jni_invocation_test-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_NE(-1, fd);
+    const std::string longEntry = "/" + std::string(PROPERTY_VALUE_MAX, 'x') + "/libart.so";
+    const std::string config = longEntry + "\nlibartd.so\n";
+    ASSERT_EQ(static_cast<ssize_t>(config.size()), write(fd, config.data(), config.size()));
+    close(fd);
+
+    unsetenv("JNI_INVOCATION_LIBRARY");
+    setenv("JNI_INVOCATION_CONFIG", path, 1);
+    // Entries too long for the buffer are skipped, not truncated or overflowed.
+    char buffer[PROPERTY_VALUE_MAX + 1];
+    buffer[PROPERTY_VALUE_MAX] = '!';
+    EXPECT_STREQ("libartd.so", JniInvocation::GetLibrary(NULL, buffer));
+    EXPECT_EQ('!', buffer[PROPERTY_VALUE_MAX]);
+    char path_buffer[PATH_MAX];
+    EXPECT_EQ(longEntry,
+              JniInvocation::GetLibrary(NULL, path_buffer, sizeof(path_buffer)));
+
+    unsetenv("JNI_INVOCATION_CONFIG");
+    unlink(path);
+}
+
+TEST_F(JNIInvocationTest, ValidateLibrary) {
+    std::string error;
+    EXPECT_FALSE(JniInvocation::ValidateLibrary("libdoesnotexist.so", &error));
+    EXPECT_FALSE(error.empty());
+#if defined(__GLIBC__)
+    // Loadable, but not a JNI implementation.
+    EXPECT_FALSE(JniInvocation::ValidateLibrary("libc.so.6", &error));
+    EXPECT_EQ("missing symbol JNI_GetDefaultJavaVMInitArgs", error);
+#endif
+}
+#endif
+
 }  // namespace android
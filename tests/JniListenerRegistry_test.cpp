@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniListenerRegistry.h>
+#include <ScopedGlobalRef.h>
+#include <ScopedLocalRef.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniListenerRegistryTest : public JniTest {
+};
+
+struct ListenerVisits {
+    JniListenerRegistry* registry;
+    std::vector<jobject> seen;
+};
+
+void recordListener(JNIEnv*, jobject listener, void* context) {
+    static_cast<ListenerVisits*>(context)->seen.push_back(listener);
+}
+
+void removeListener(JNIEnv* env, jobject listener, void* context) {
+    ListenerVisits* visits = static_cast<ListenerVisits*>(context);
+    visits->seen.push_back(listener);
+    EXPECT_EQ(0, jniListenerRegistryRemove(env, visits->registry, listener));
+}
+
+void throwFromListener(JNIEnv* env, jobject, void*) {
+    jniThrowException(env, "java/lang/IllegalStateException", "listener failed");
+}
+
+struct ListenerEmitter {
+    JniListenerRegistry* registry;
+    jobject listeners[4];  // Global references.
+    int stop;
+    size_t visits;
+    size_t strangers;
+};
+
+void checkListener(JNIEnv* env, jobject listener, void* context) {
+    ListenerEmitter* emitter = static_cast<ListenerEmitter*>(context);
+    for (size_t i = 0; i < NELEM(emitter->listeners); ++i) {
+        if (env->IsSameObject(listener, emitter->listeners[i])) {
+            return;
+        }
+    }
+    __atomic_fetch_add(&emitter->strangers, 1, __ATOMIC_RELAXED);
+}
+
+void* emitToListeners(void* context) {
+    ListenerEmitter* emitter = static_cast<ListenerEmitter*>(context);
+    JNIEnv* env = JniTestEnvironment::Get().AttachCurrentThread();
+    while (__atomic_load_n(&emitter->stop, __ATOMIC_ACQUIRE) == 0) {
+        const size_t visits =
+                jniListenerRegistryForEach(env, emitter->registry, checkListener, emitter);
+        __atomic_fetch_add(&emitter->visits, visits, __ATOMIC_RELAXED);
+    }
+    JniTestEnvironment::Get().DetachCurrentThread();
+    return NULL;
+}
+
+TEST_F(JniListenerRegistryTest, ListenerRegistry) {
+    const jint globals = fake_->GlobalRefCount(vm_);
+    JniListenerRegistry* registry = jniListenerRegistryCreate(env_);
+    ASSERT_TRUE(registry != NULL);
+    ScopedLocalRef<jobject> a(env_, env_->NewStringUTF("a"));
+    ScopedLocalRef<jobject> b(env_, env_->NewStringUTF("b"));
+    ScopedLocalRef<jobject> c(env_, env_->NewStringUTF("c"));
+    EXPECT_EQ(0, jniListenerRegistryAdd(env_, registry, a.get()));
+    EXPECT_EQ(0, jniListenerRegistryAdd(env_, registry, b.get()));
+    EXPECT_EQ(0, jniListenerRegistryAdd(env_, registry, c.get()));
+    EXPECT_EQ(1, jniListenerRegistryAdd(env_, registry, b.get()));
+    EXPECT_EQ(-1, jniListenerRegistryAdd(env_, registry, NULL));
+    EXPECT_EQ("java.lang.NullPointerException: listener == null", TakeException());
+    EXPECT_EQ(3U, jniListenerRegistrySize(registry));
+    EXPECT_EQ(globals + 3, fake_->GlobalRefCount(vm_));
+
+    ListenerVisits visits;
+    visits.registry = registry;
+    EXPECT_EQ(3U, jniListenerRegistryForEach(env_, registry, recordListener, &visits));
+    ASSERT_EQ(3U, visits.seen.size());
+    EXPECT_TRUE(env_->IsSameObject(a.get(), visits.seen[0]));
+    EXPECT_TRUE(env_->IsSameObject(b.get(), visits.seen[1]));
+    EXPECT_TRUE(env_->IsSameObject(c.get(), visits.seen[2]));
+
+    // Removal keeps the order of the rest, and the reference is gone once
+    // no iteration can see it.
+    EXPECT_EQ(0, jniListenerRegistryRemove(env_, registry, b.get()));
+    EXPECT_EQ(-1, jniListenerRegistryRemove(env_, registry, b.get()));
+    jniListenerRegistrySynchronize(env_, registry);
+    EXPECT_EQ(globals + 2, fake_->GlobalRefCount(vm_));
+    visits.seen.clear();
+    EXPECT_EQ(2U, jniListenerRegistryForEach(env_, registry, recordListener, &visits));
+    ASSERT_EQ(2U, visits.seen.size());
+    EXPECT_TRUE(env_->IsSameObject(a.get(), visits.seen[0]));
+    EXPECT_TRUE(env_->IsSameObject(c.get(), visits.seen[1]));
+
+    // Listeners that remove themselves are each still called once.
+    visits.seen.clear();
+    EXPECT_EQ(2U, jniListenerRegistryForEach(env_, registry, removeListener, &visits));
+    EXPECT_EQ(2U, visits.seen.size());
+    EXPECT_EQ(0U, jniListenerRegistrySize(registry));
+    EXPECT_EQ(0U, jniListenerRegistryForEach(env_, registry, recordListener, &visits));
+
+    // An exception stops the iteration and stays pending.
+    jniListenerRegistryAdd(env_, registry, a.get());
+    jniListenerRegistryAdd(env_, registry, b.get());
+    EXPECT_EQ(1U, jniListenerRegistryForEach(env_, registry, throwFromListener, NULL));
+    EXPECT_EQ("java.lang.IllegalStateException: listener failed", TakeException());
+    jniListenerRegistryRemove(env_, registry, a.get());
+    jniListenerRegistryRemove(env_, registry, b.get());
+
+    // Emitters keep going while listeners come and go.
+    ScopedGlobalRef<jobject> listeners[4];
+    ListenerEmitter emitter;
+    memset(&emitter, 0, sizeof(emitter));
+    emitter.registry = registry;
+    for (int i = 0; i < 4; ++i) {
+        char name[16];
+        snprintf(name, sizeof(name), "l%d", i);
+        ScopedLocalRef<jobject> listener(env_, env_->NewStringUTF(name));
+        listeners[i] = ScopedGlobalRef<jobject>(env_, listener.get());
+        emitter.listeners[i] = listeners[i].get();
+    }
+    pthread_t threads[4];
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, emitToListeners, &emitter));
+    }
+    for (int i = 0; i < 2000 || __atomic_load_n(&emitter.visits, __ATOMIC_RELAXED) < 10000;
+            ++i) {
+        jniListenerRegistryAdd(env_, registry, emitter.listeners[i % 4]);
+        jniListenerRegistryRemove(env_, registry, emitter.listeners[(i + 2) % 4]);
+    }
+    __atomic_store_n(&emitter.stop, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(0, pthread_join(threads[i], NULL));
+    }
+    EXPECT_EQ(0U, emitter.strangers);
+    EXPECT_EQ(2U, jniListenerRegistrySize(registry));
+
+    jniListenerRegistryDestroy(env_, registry);
+    EXPECT_EQ(globals + 4, fake_->GlobalRefCount(vm_));
+}
+
+}  // namespace android
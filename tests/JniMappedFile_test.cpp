@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniConstants.h>
+#include <JniMappedFile.h>
+#include <ScopedBytes.h>
+#include <ScopedLocalRef.h>
+#include <android/log.h>
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniMappedFileTest : public JniTest {
+};
+
+static void* gCleanedAddress;
+
+static int recordCleaner(JNIEnv*, jobject, void* address, size_t) {
+    gCleanedAddress = address;
+    return 0;
+}
+
+static int refuseCleaner(JNIEnv*, jobject, void*, size_t) {
+    return -1;
+}
+
+static void findMapping(const JniMapping* mapping, void* context) {
+    const JniMapping** found = static_cast<const JniMapping**>(context);
+    if (mapping->address == (*found)->address) {
+        *found = mapping;
+    }
+}
+
+TEST_F(JniMappedFileTest, MappedFile) {
+    char path[] = "/tmp/JNIHelp_test.XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_NE(-1, fd);
+    unlink(path);
+    std::vector<char> contents(3 * 4096 + 100);
+    for (size_t i = 0; i < contents.size(); ++i) {
+        contents[i] = static_cast<char>(i * 7);
+    }
+    ASSERT_EQ(static_cast<ssize_t>(contents.size()),
+              write(fd, &contents[0], contents.size()));
+    ScopedLocalRef<jobject> fdObject(env_, jniCreateFileDescriptor(env_, fd));
+    const size_t liveBefore = jniGetMappings(NULL, NULL);
+
+    // An unaligned read-only window, advised.
+    ScopedLocalRef<jobject> buffer(env_, jniMapFileDescriptor(env_, fdObject.get(), 5000, 3000,
+            PROT_READ, JNI_MAP_ADVISE_SEQUENTIAL | JNI_MAP_ADVISE_WILLNEED |
+                       JNI_MAP_ADVISE_HUGEPAGE));
+    ASSERT_TRUE(buffer.get() != NULL);
+    {
+        ScopedBytesRO bytes(env_, buffer.get());
+        ASSERT_EQ(3000U, bytes.size());
+        EXPECT_EQ(0, memcmp(&contents[5000], bytes.get(), 3000));
+    }
+    EXPECT_EQ(liveBefore + 1, jniGetMappings(NULL, NULL));
+    JniMapping expected = { env_->GetDirectBufferAddress(buffer.get()), 0, 0, 0, 0, NULL };
+    const JniMapping* found = &expected;
+    jniGetMappings(findMapping, &found);
+    ASSERT_NE(&expected, found);
+    EXPECT_EQ(3000U, found->length);
+    EXPECT_EQ(fd, found->fd);
+    EXPECT_EQ(5000, found->offset);
+    EXPECT_EQ(PROT_READ, found->prot);
+    jniLogMappings(ANDROID_LOG_DEBUG, "JNIHelp_test");
+    EXPECT_EQ(0, jniUnmapDirectBuffer(env_, buffer.get()));
+    EXPECT_EQ(-1, jniUnmapDirectBuffer(env_, buffer.get()));
+    EXPECT_EQ(liveBefore, jniGetMappings(NULL, NULL));
+
+    // Writes reach the file; the cleaner hook sees each new mapping.
+    jniSetMappingCleanerHook(recordCleaner);
+    ScopedLocalRef<jobject> writable(env_, jniMapFileDescriptor(env_, fdObject.get(), 4096, 100,
+                                                                 PROT_READ | PROT_WRITE, 0));
+    ASSERT_TRUE(writable.get() != NULL);
+    EXPECT_EQ(env_->GetDirectBufferAddress(writable.get()), gCleanedAddress);
+    {
+        ScopedBytesRW bytes(env_, writable.get());
+        memcpy(bytes.get(), "mapped", 6);
+    }
+    EXPECT_EQ(0, jniUnmapAddress(gCleanedAddress));
+    EXPECT_EQ(-1, jniUnmapAddress(gCleanedAddress));
+    char readBack[6];
+    ASSERT_EQ(6, pread(fd, readBack, sizeof(readBack), 4096));
+    EXPECT_EQ(0, memcmp("mapped", readBack, 6));
+
+    // Past the end of the file, read-write mappings extend it and read-only ones fail.
+    const off64_t size = contents.size();
+    EXPECT_TRUE(jniMapFileDescriptor(env_, fdObject.get(), size - 100, 200, PROT_READ, 0) == NULL);
+    EXPECT_EQ("java.io.IOException: Read-only mapping ends at 12488, "
+              "past the end of the file at 12388", TakeException());
+    ScopedLocalRef<jobject> extended(env_, jniMapFileDescriptor(env_, fdObject.get(), size - 100,
+                                                                 200, PROT_READ | PROT_WRITE, 0));
+    ASSERT_TRUE(extended.get() != NULL);
+    EXPECT_EQ(size + 100, lseek64(fd, 0, SEEK_END));
+    {
+        ScopedBytesRW bytes(env_, extended.get());
+        ASSERT_EQ(200U, bytes.size());
+        EXPECT_EQ(0, memcmp(&contents[size - 100], bytes.get(), 100));
+        bytes.get()[199] = 'x';
+    }
+    EXPECT_EQ(0, jniUnmapDirectBuffer(env_, extended.get()));
+    ASSERT_EQ(1, pread(fd, readBack, 1, size + 99));
+    EXPECT_EQ('x', readBack[0]);
+
+    // A hook that fails undoes the mapping.
+    jniSetMappingCleanerHook(refuseCleaner);
+    EXPECT_TRUE(jniMapFileDescriptor(env_, fdObject.get(), 0, 100, PROT_READ, 0) == NULL);
+    EXPECT_EQ(liveBefore, jniGetMappings(NULL, NULL));
+    jniSetMappingCleanerHook(NULL);
+
+    EXPECT_TRUE(jniMapFileDescriptor(env_, fdObject.get(), 0, 0, PROT_READ, 0) == NULL);
+    EXPECT_EQ("java.lang.IllegalArgumentException: Bad mapping range: offset 0, length 0",
+              TakeException());
+    EXPECT_TRUE(jniMapFileDescriptor(env_, fdObject.get(), 0, 100, PROT_EXEC, 0) == NULL);
+    EXPECT_EQ("java.lang.IllegalArgumentException: Bad mapping protection: 0x4",
+              TakeException());
+    EXPECT_TRUE(jniMapFileDescriptor(env_, NULL, 0, 100, PROT_READ, 0) == NULL);
+    EXPECT_EQ("java.lang.NullPointerException: fileDescriptor == null", TakeException());
+    close(fd);
+    EXPECT_TRUE(jniMapFileDescriptor(env_, fdObject.get(), 0, 100, PROT_READ, 0) == NULL);
+    EXPECT_EQ("java.io.IOException: Bad file descriptor", TakeException());
+    EXPECT_EQ(liveBefore, jniGetMappings(NULL, NULL));
+}
+
+}  // namespace android
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniAccessPolicy.h>
+#include <JniParallel.h>
+#include <ScopedLocalRef.h>
+#include <ScopedPrimitiveArray.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniParallelTest : public JniTest {
+};
+
+static void recordChunk(size_t begin, size_t end, void* context, JniParallelError*) {
+    std::vector<size_t>* chunks = static_cast<std::vector<size_t>*>(context);
+    for (size_t i = begin; i < end; ++i) {
+        __atomic_fetch_add(&(*chunks)[i], 1, __ATOMIC_RELAXED);
+    }
+}
+
+struct PoolUse {
+    pthread_mutex_t lock;
+    std::vector<pthread_t> threads;
+};
+
+// Waits, for up to a second, for some other thread to run a chunk too.
+static void meetAnotherThread(size_t, size_t, void* context, JniParallelError*) {
+    PoolUse* use = static_cast<PoolUse*>(context);
+    pthread_mutex_lock(&use->lock);
+    bool known = false;
+    for (size_t i = 0; i < use->threads.size(); ++i) {
+        known = known || pthread_equal(use->threads[i], pthread_self());
+    }
+    if (!known) {
+        use->threads.push_back(pthread_self());
+    }
+    pthread_mutex_unlock(&use->lock);
+    for (int i = 0; i < 1000; ++i) {
+        pthread_mutex_lock(&use->lock);
+        size_t count = use->threads.size();
+        pthread_mutex_unlock(&use->lock);
+        if (count > 1) {
+            return;
+        }
+        usleep(1000);
+    }
+}
+
+static void* pollParallelWorkers(void* arg) {
+    int* stop = static_cast<int*>(arg);
+    while (__atomic_load_n(stop, __ATOMIC_RELAXED) == 0) {
+        jniParallelWorkers();
+    }
+    return NULL;
+}
+
+TEST_F(JniParallelTest, ParallelArray) {
+    jniSetParallelWorkers(3);
+    EXPECT_EQ(3, jniParallelWorkers());
+
+    // An idle pool is used even while other threads look at its settings.
+    int stop = 0;
+    pthread_t poller;
+    ASSERT_EQ(0, pthread_create(&poller, NULL, pollParallelWorkers, &stop));
+    for (int round = 0; round < 20; ++round) {
+        PoolUse use;
+        pthread_mutex_init(&use.lock, NULL);
+        JniParallelError noError = { NULL, NULL };
+        EXPECT_EQ(0, jniParallelRun(NULL, 8, 0, 1, meetAnotherThread, &use, &noError));
+        EXPECT_LT(1U, use.threads.size()) << "round " << round;
+        pthread_mutex_destroy(&use.lock);
+    }
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    ASSERT_EQ(0, pthread_join(poller, NULL));
+
+    jniSetParallelWorkers(3);
+    EXPECT_EQ(3, jniParallelWorkers());
+
+    // Every element is covered once.
+    std::vector<size_t> seen(10000);
+    JniParallelError error = { NULL, NULL };
+    EXPECT_EQ(0, jniParallelRun(&seen[0], seen.size(), sizeof(size_t), 16,
+                                recordChunk, &seen, &error));
+    EXPECT_EQ(seen.size(), static_cast<size_t>(std::count(seen.begin(), seen.end(), 1U)));
+
+    static JniAccessSite site = JNI_ACCESS_SITE("ParallelArray");
+    const jsize length = 100003;
+    ScopedLocalRef<jintArray> array(env_, env_->NewIntArray(length));
+    {
+        ScopedIntArrayRW values(env_, array.get());
+        for (jsize i = 0; i < length; ++i) {
+            values[i] = i % 1000;
+        }
+    }
+    int64_t sum = 0;
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    int misaligned = 0;
+    EXPECT_TRUE(jniParallelForArray<jint>(env_, array.get(), &site,
+            JNI_ACCESS_READ_ONLY | JNI_ACCESS_NO_JNI_CALLS, 1024,
+            [&](jint* data, size_t begin, size_t end, JniParallelError*) {
+                int64_t partial = 0;
+                for (size_t i = begin; i < end; ++i) {
+                    partial += data[i];
+                }
+                pthread_mutex_lock(&lock);
+                sum += partial;
+                if (begin != 0 && reinterpret_cast<uintptr_t>(data + begin) % 64 != 0) {
+                    misaligned++;
+                }
+                pthread_mutex_unlock(&lock);
+            }));
+    int64_t expected = 0;
+    for (jsize i = 0; i < length; ++i) {
+        expected += i % 1000;
+    }
+    EXPECT_EQ(expected, sum);
+    EXPECT_EQ(0, misaligned);
+
+    // Writes reach the array, copied or not.
+    fake_->SetCopyMode(vm_, JNI_TRUE);
+    EXPECT_TRUE(jniParallelForArray<jint>(env_, array.get(), &site, 0, 1024,
+            [](jint* data, size_t begin, size_t end, JniParallelError*) {
+                for (size_t i = begin; i < end; ++i) {
+                    data[i] = static_cast<jint>(i) * 2;
+                }
+            }));
+    fake_->SetCopyMode(vm_, JNI_FALSE);
+    {
+        ScopedIntArrayRO values(env_, array.get());
+        EXPECT_EQ(0, values[0]);
+        EXPECT_EQ(2 * (length - 1), values[length - 1]);
+    }
+
+    // A failure is thrown once the array is released.
+    EXPECT_FALSE(jniParallelForArray<jint>(env_, array.get(), &site, JNI_ACCESS_READ_ONLY, 1024,
+            [](jint*, size_t begin, size_t, JniParallelError* error) {
+                if (begin != 0) {
+                    error->className = "java/lang/IllegalArgumentException";
+                    error->message = "bad chunk";
+                }
+            }));
+    EXPECT_EQ("java.lang.IllegalArgumentException: bad chunk", TakeException());
+
+    // With no workers the loop runs inline.
+    jniSetParallelWorkers(0);
+    std::fill(seen.begin(), seen.end(), 0);
+    EXPECT_EQ(0, jniParallelRun(&seen[0], seen.size(), sizeof(size_t), 16,
+                                recordChunk, &seen, &error));
+    EXPECT_EQ(seen.size(), static_cast<size_t>(std::count(seen.begin(), seen.end(), 1U)));
+}
+
+}  // namespace android
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniConstants.h>
+#include <JniRingBuffer.h>
+#include <ScopedBytes.h>
+#include <ScopedLocalRef.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniRingBufferTest : public JniTest {
+};
+
+struct RingRecord {
+    int32_t type;
+    std::string payload;
+};
+
+static void collectRecord(int32_t type, const void* data, size_t length, void* context) {
+    RingRecord record = { type, std::string(static_cast<const char*>(data), length) };
+    static_cast<std::vector<RingRecord>*>(context)->push_back(record);
+}
+
+struct RingProducer {
+    JniRingBuffer* ring;
+    int32_t id;
+    int count;
+};
+
+static void* produceRecords(void* arg) {
+    RingProducer* producer = static_cast<RingProducer*>(arg);
+    for (int i = 0; i < producer->count; ++i) {
+        while (jniRingBufferWrite(producer->ring, producer->id, &i, sizeof(i)) == JNI_RING_FULL) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void checkSequence(int32_t type, const void* data, size_t length, void* context) {
+    std::vector<int>& next = *static_cast<std::vector<int>*>(context);
+    int value = -1;
+    if (length == sizeof(value)) {
+        memcpy(&value, data, sizeof(value));
+    }
+    EXPECT_EQ(next[type], value);
+    next[type]++;
+}
+
+TEST_F(JniRingBufferTest, RingBuffer) {
+    jobject object;
+    JniRingBuffer* ring = jniRingBufferCreate(env_, 4096, 0, &object);
+    ASSERT_TRUE(ring != NULL);
+    ScopedLocalRef<jobject> buffer(env_, object);
+    EXPECT_EQ(ring, jniRingBufferFromBuffer(env_, buffer.get()));
+    {
+        // The layout Java sees.
+        ScopedBytesRO bytes(env_, buffer.get());
+        ASSERT_EQ(static_cast<size_t>(JNI_RING_DATA_OFFSET + 4096), bytes.size());
+        int32_t magic;
+        int64_t capacity;
+        memcpy(&magic, bytes.get(), sizeof(magic));
+        memcpy(&capacity, bytes.get() + 8, sizeof(capacity));
+        EXPECT_EQ(JNI_RING_MAGIC, magic);
+        EXPECT_EQ(4096, capacity);
+    }
+    EXPECT_EQ(504U, jniRingBufferMaxPayload(ring));
+
+    std::vector<RingRecord> records;
+    EXPECT_EQ(0U, jniRingBufferRead(ring, collectRecord, &records, 100));
+    EXPECT_EQ(1, jniRingBufferPrepareWait(ring));
+    EXPECT_EQ(JNI_RING_WAKE, jniRingBufferWrite(ring, 7, "first", 5));
+    EXPECT_EQ(0, jniRingBufferWrite(ring, 8, "", 0));
+    EXPECT_EQ(0, jniRingBufferPrepareWait(ring));
+    // Claimed records block those after them until committed.
+    char* claimed = static_cast<char*>(jniRingBufferClaim(ring, 9, 3));
+    ASSERT_TRUE(claimed != NULL);
+    EXPECT_EQ(0, jniRingBufferWrite(ring, 10, "last", 4));
+    EXPECT_EQ(2U, jniRingBufferRead(ring, collectRecord, &records, 100));
+    memcpy(claimed, "mid", 3);
+    EXPECT_EQ(0, jniRingBufferCommit(ring, claimed));
+    EXPECT_EQ(1U, jniRingBufferRead(ring, collectRecord, &records, 1));
+    EXPECT_EQ(1U, jniRingBufferRead(ring, collectRecord, &records, 100));
+    ASSERT_EQ(4U, records.size());
+    EXPECT_EQ(7, records[0].type);
+    EXPECT_EQ("first", records[0].payload);
+    EXPECT_EQ("", records[1].payload);
+    EXPECT_EQ("mid", records[2].payload);
+    EXPECT_EQ(10, records[3].type);
+    EXPECT_EQ("last", records[3].payload);
+    EXPECT_EQ(0U, jniRingBufferBacklog(ring));
+
+    // Records wrap around the end of the data area, and a full ring refuses
+    // more until the consumer catches up.
+    records.clear();
+    std::string payload(100, 'x');
+    int written = 0;
+    while (jniRingBufferWrite(ring, written, payload.data(), payload.size()) != JNI_RING_FULL) {
+        ++written;
+    }
+    EXPECT_GT(jniRingBufferBacklog(ring), 4096U - 112);
+    for (int i = 0; i < 200; ++i) {
+        jniRingBufferRead(ring, collectRecord, &records, 7);
+        if (jniRingBufferWrite(ring, written, payload.data(), payload.size()) == 0) {
+            ++written;
+        }
+    }
+    jniRingBufferRead(ring, collectRecord, &records, 1000);
+    ASSERT_EQ(static_cast<size_t>(written), records.size());
+    for (int i = 0; i < written; ++i) {
+        EXPECT_EQ(i, records[i].type);
+    }
+    EXPECT_TRUE(jniRingBufferClaim(ring, 0, 505) == NULL);
+    jniRingBufferDestroy(ring);
+
+    EXPECT_TRUE(jniRingBufferCreate(env_, 5000, 0, NULL) == NULL);
+    EXPECT_EQ("java.lang.IllegalArgumentException: Bad ring buffer capacity: 5000",
+              TakeException());
+    std::vector<jbyte> storage(JNI_RING_DATA_OFFSET + 4096);
+    ScopedLocalRef<jobject> other(env_, env_->NewDirectByteBuffer(&storage[0], storage.size()));
+    EXPECT_TRUE(jniRingBufferFromBuffer(env_, other.get()) == NULL);
+    EXPECT_EQ("java.lang.IllegalArgumentException: Not a ring buffer", TakeException());
+
+    // Many producers, one consumer: each producer's records arrive in order.
+    ring = jniRingBufferCreate(env_, 8192, JNI_RING_MPSC, NULL);
+    ASSERT_TRUE(ring != NULL);
+    RingProducer producers[4];
+    pthread_t threads[4];
+    for (int i = 0; i < 4; ++i) {
+        producers[i].ring = ring;
+        producers[i].id = i;
+        producers[i].count = 20000;
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, produceRecords, &producers[i]));
+    }
+    std::vector<int> next(4, 0);
+    size_t total = 0;
+    while (total < 4 * 20000U) {
+        total += jniRingBufferRead(ring, checkSequence, &next, 64);
+    }
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(0, pthread_join(threads[i], NULL));
+        EXPECT_EQ(20000, next[i]);
+    }
+    EXPECT_EQ(0U, jniRingBufferBacklog(ring));
+    jniRingBufferDestroy(ring);
+}
+
+// Stands in for the Java side of a dispatcher.
+
+}  // namespace android
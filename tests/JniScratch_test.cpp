@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniScratch.h>
+#include <ScopedLocalRef.h>
+#include <ScopedPrimitiveArray.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniScratchTest : public JniTest {
+};
+
+static void* scratchOnOtherThread(void*) {
+    ScopedScratch scratch;
+    return scratch.alloc<char>(64);
+}
+
+static void* deleteIntArrayRO(void* arg) {
+    delete static_cast<ScopedIntArrayRO*>(arg);
+    return NULL;
+}
+
+TEST_F(JniScratchTest, Scratch) {
+    size_t mark = jniScratchMark();
+    char* a = static_cast<char*>(jniScratchAlloc(100));
+    ASSERT_TRUE(a != NULL);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(a) % 16);
+    {
+        ScopedScratch scratch;
+        jint* b = scratch.alloc<jint>(10);
+        ASSERT_TRUE(b != NULL);
+        EXPECT_GE(reinterpret_cast<char*>(b), a + 100);
+        // Bigger than a chunk.
+        EXPECT_TRUE(scratch.alloc<char>(1 << 20) != NULL);
+    }
+    // Storage is reused once everything above it is gone.
+    char* c = static_cast<char*>(jniScratchAlloc(16));
+    char* d = static_cast<char*>(jniScratchAlloc(16));
+    jniScratchFree(c);
+    char* e = static_cast<char*>(jniScratchAlloc(16));
+    EXPECT_GT(e, d);
+    jniScratchFree(e);
+    jniScratchFree(d);
+    EXPECT_EQ(c, jniScratchAlloc(16));
+    jniScratchRelease(mark);
+    EXPECT_EQ(a, jniScratchAlloc(1));
+    jniScratchRelease(mark);
+    // Chunks past the retained limit go back to the heap once the arena is empty.
+    EXPECT_LE(jniScratchRetainedBytes(), 256U * 1024);
+
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, scratchOnOtherThread, NULL));
+    void* other;
+    ASSERT_EQ(0, pthread_join(thread, &other));
+    EXPECT_TRUE(other != NULL);
+
+    // ScopedXxxArrayRO keeps its copy inline, so it may outlive a scratch
+    // scope it was reset in, or be destroyed on another thread.
+    ScopedLocalRef<jintArray> array(env_, env_->NewIntArray(100));
+    const jint value = 42;
+    env_->SetIntArrayRegion(array.get(), 99, 1, &value);
+    size_t before = jniScratchMark();
+    ScopedIntArrayRO outer(env_);
+    {
+        ScopedScratch scratch;
+        outer.reset(array.get());
+        EXPECT_TRUE(scratch.alloc<jint>(100) != NULL);
+    }
+    EXPECT_EQ(before, jniScratchMark());
+    EXPECT_EQ(42, outer[99]);
+    ScopedIntArrayRO* moved = new ScopedIntArrayRO(env_, array.get());
+    EXPECT_EQ(before, jniScratchMark());
+    ASSERT_EQ(0, pthread_create(&thread, NULL, deleteIntArrayRO, moved));
+    ASSERT_EQ(0, pthread_join(thread, NULL));
+    EXPECT_EQ(before, jniScratchMark());
+    std::string message(1000, 'x');
+    jniThrowExceptionFmt(env_, "java/lang/RuntimeException", "%s", message.c_str());
+    EXPECT_EQ("java.lang.RuntimeException: " + message, TakeException());
+    jniScratchRelease(mark);
+}
+
+}  // namespace android
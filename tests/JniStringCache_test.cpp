@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniStringCache.h>
+#include <ScopedLocalRef.h>
+#include <ScopedUtfChars.h>
+#include <toStringArray.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniStringCacheTest : public JniTest {
+};
+
+static int gHammerStringCache;
+
+static void* hammerStringCache(void*) {
+    JniTestEnvironment& environment = JniTestEnvironment::Get();
+    JNIEnv* env = environment.AttachCurrentThread();
+    while (__atomic_load_n(&gHammerStringCache, __ATOMIC_RELAXED) != 0) {
+        env->DeleteLocalRef(jniGetCachedStringUTF(env, "hot"));
+    }
+    environment.DetachCurrentThread();
+    return NULL;
+}
+
+static void* churnStringCache(void* arg) {
+    JniTestEnvironment& environment = JniTestEnvironment::Get();
+    JNIEnv* env = environment.AttachCurrentThread();
+    const int seed = *static_cast<int*>(arg);
+    char key[32];
+    bool ok = true;
+    for (int i = 0; i < 2000 && ok; ++i) {
+        snprintf(key, sizeof(key), "key%d", (i * 7 + seed) % 300);
+        jstring s = jniGetCachedStringUTF(env, key);
+        ok = (s != NULL) && strcmp(ScopedUtfChars(env, s).c_str(), key) == 0;
+        env->DeleteLocalRef(s);
+    }
+    environment.DetachCurrentThread();
+    return ok ? arg : NULL;
+}
+
+TEST_F(JniStringCacheTest, StringCache) {
+    jniClearStringCache(env_);
+    JniStringCacheStats before;
+    jniGetStringCacheStats(&before);
+
+    ScopedLocalRef<jstring> first(env_, jniGetCachedStringUTF(env_, "en_US"));
+    ScopedLocalRef<jstring> second(env_, jniGetCachedString(env_, "en_USA", 5));
+    ASSERT_TRUE(first.get() != NULL);
+    EXPECT_TRUE(env_->IsSameObject(first.get(), second.get()));
+    EXPECT_STREQ("en_US", ScopedUtfChars(env_, second.get()).c_str());
+    ScopedLocalRef<jstring> other(env_, jniGetCachedString(env_, "caf\xc3\xa9", 5));
+    EXPECT_STREQ("caf\xc3\xa9", ScopedUtfChars(env_, other.get()).c_str());
+    EXPECT_FALSE(env_->IsSameObject(first.get(), other.get()));
+    EXPECT_TRUE(jniGetCachedStringUTF(env_, NULL) == NULL);
+
+    JniStringCacheStats stats;
+    jniGetStringCacheStats(&stats);
+    EXPECT_EQ(before.hits + 1, stats.hits);
+    EXPECT_EQ(before.misses + 2, stats.misses);
+    EXPECT_EQ(2U, stats.entries);
+    EXPECT_EQ(256U * 1024, stats.budget);
+
+    std::vector<std::string> tokens;
+    tokens.push_back("en_US");
+    tokens.push_back("fr_FR");
+    ScopedLocalRef<jobjectArray> array(env_, toCachedStringArray(env_, tokens));
+    ASSERT_TRUE(array.get() != NULL);
+    ScopedLocalRef<jobject> element(env_, env_->GetObjectArrayElement(array.get(), 0));
+    EXPECT_TRUE(env_->IsSameObject(first.get(), element.get()));
+
+    // Over budget, entries go, and their global references with them.
+    jniSetStringCacheBudget(env_, 1000);
+    jniGetStringCacheStats(&stats);
+    EXPECT_LE(stats.bytes, 1000U);
+    char key[32];
+    for (int i = 0; i < 100; ++i) {
+        snprintf(key, sizeof(key), "token%d", i);
+        ScopedLocalRef<jstring> s(env_, jniGetCachedStringUTF(env_, key));
+        EXPECT_STREQ(key, ScopedUtfChars(env_, s.get()).c_str());
+    }
+    jniGetStringCacheStats(&stats);
+    EXPECT_LE(stats.bytes, 1000U);
+    EXPECT_GT(stats.evictions, before.evictions);
+
+    // Lookups race evictions on other threads, more of them than there are
+    // reader stripes, and every lookup is counted.
+    jniGetStringCacheStats(&before);
+    pthread_t threads[20];
+    int seeds[20];
+    for (int i = 0; i < 20; ++i) {
+        seeds[i] = i;
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, churnStringCache, &seeds[i]));
+    }
+    for (int i = 0; i < 20; ++i) {
+        void* result;
+        ASSERT_EQ(0, pthread_join(threads[i], &result));
+        EXPECT_TRUE(result != NULL);
+    }
+    jniGetStringCacheStats(&stats);
+    EXPECT_EQ(before.hits + before.misses + 20 * 2000, stats.hits + stats.misses);
+
+    jniSetStringCacheBudget(env_, 256 * 1024);
+    jniClearStringCache(env_);
+    jniGetStringCacheStats(&stats);
+    EXPECT_EQ(0U, stats.entries);
+    EXPECT_EQ(0U, stats.bytes);
+
+    // A steady stream of lookups does not keep jniClearStringCache from
+    // deleting the references of what it evicted.
+    const jint globalRefs = fake_->GlobalRefCount(vm_);
+    __atomic_store_n(&gHammerStringCache, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, hammerStringCache, NULL));
+    }
+    for (int i = 0; i < 20; ++i) {
+        snprintf(key, sizeof(key), "cold%d", i);
+        env_->DeleteLocalRef(jniGetCachedStringUTF(env_, key));
+        jniClearStringCache(env_);
+    }
+    __atomic_store_n(&gHammerStringCache, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(0, pthread_join(threads[i], NULL));
+    }
+    jniClearStringCache(env_);
+    EXPECT_EQ(globalRefs, fake_->GlobalRefCount(vm_));
+}
+
+}  // namespace android
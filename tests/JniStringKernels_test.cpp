@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniBytes.h>
+#include <JniStringKernels.h>
+#include <ScopedLocalRef.h>
+#include <ScopedStringChars.h>
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniStringKernelsTest : public JniTest {
+};
+
+static jint javaHashCode(const std::vector<jchar>& chars) {
+    uint32_t h = 0;
+    for (size_t i = 0; i < chars.size(); ++i) {
+        h = 31 * h + chars[i];
+    }
+    return static_cast<jint>(h);
+}
+
+TEST_F(JniStringKernelsTest, StringKernels) {
+    ScopedLocalRef<jstring> hello(env_, env_->NewStringUTF("hello"));
+    EXPECT_EQ(99162322, jniStringHashCodeOf(env_, hello.get()));
+    EXPECT_TRUE(jniStringEqualsAscii(env_, hello.get(), "hello"));
+    EXPECT_FALSE(jniStringEqualsAscii(env_, hello.get(), "hellO"));
+    EXPECT_FALSE(jniStringEqualsAscii(env_, hello.get(), "hell"));
+    EXPECT_FALSE(jniStringEqualsAscii(env_, NULL, "hello"));
+    EXPECT_EQ(0, jniStringHashCodeOf(env_, NULL));
+
+    // U+00E9, U+4E2D and U+1F600 (a surrogate pair) in UTF-8.
+    const char utf8[] = "caf\xc3\xa9 \xe4\xb8\xad \xf0\x9f\x98\x80!";
+    const jchar utf16[] = { 'c', 'a', 'f', 0xe9, ' ', 0x4e2d, ' ', 0xd83d, 0xde00, '!' };
+    ScopedLocalRef<jstring> mixed(env_, env_->NewString(utf16, NELEM(utf16)));
+    EXPECT_TRUE(jniStringEqualsUtf8(env_, mixed.get(), utf8));
+    EXPECT_FALSE(jniStringEqualsUtf8(env_, mixed.get(), "caf\xc3\xa9 \xe4\xb8\xad"));
+    EXPECT_FALSE(jniStringEqualsUtf8Chars(utf16, NELEM(utf16), "caf\xc3", 5));
+    EXPECT_FALSE(jniStringEqualsUtf8Chars(utf16, 4, "caf\xc3\x29", 5));
+    {
+        ScopedStringChars chars(env_, mixed.get());
+        EXPECT_TRUE(jniStringEqualsUtf8Chars(chars, utf8, strlen(utf8)));
+        EXPECT_EQ(javaHashCode(std::vector<jchar>(utf16, utf16 + NELEM(utf16))),
+                  jniStringHashCode(chars));
+    }
+
+    // Every instruction set agrees with String's definitions, across the
+    // vector widths and tails.
+    std::vector<jchar> a(300);
+    for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = static_cast<jchar>(0x20 + (i * 7919) % 0x5f);
+    }
+    std::string ascii(a.begin(), a.end());
+    const JniBytesIsa best = jniBytesIsa();
+    for (int isa = kJniBytesScalar; isa <= kJniBytesNeon; ++isa) {
+        if (jniBytesSetIsa(static_cast<JniBytesIsa>(isa)) != isa) {
+            continue;
+        }
+        for (size_t length = 0; length <= 40; ++length) {
+            std::vector<jchar> prefix(a.begin(), a.begin() + length);
+            EXPECT_EQ(javaHashCode(prefix), jniStringHashCode(&a[0], length)) << isa;
+            EXPECT_TRUE(jniStringEqualsAsciiChars(&a[0], length, ascii.c_str(), length));
+            EXPECT_EQ(0, jniStringCompare(&a[0], length, &a[0], length));
+            if (length > 0) {
+                std::vector<jchar> b(prefix);
+                b[length - 1] += 3;
+                EXPECT_EQ(-3, jniStringCompare(&a[0], length, &b[0], length)) << isa;
+                EXPECT_FALSE(jniStringEqualsAsciiChars(&b[0], length, ascii.c_str(), length));
+            }
+        }
+        EXPECT_EQ(javaHashCode(a), jniStringHashCode(&a[0], a.size())) << isa;
+        EXPECT_EQ(-1, jniStringCompare(&a[0], 99, &a[0], 100));
+        EXPECT_EQ(1, jniStringCompare(&a[0], 100, &a[0], 99));
+    }
+    jniBytesSetIsa(best);
+
+    std::string longAscii(1000, 'x');
+    ScopedLocalRef<jstring> longString(env_, env_->NewStringUTF(longAscii.c_str()));
+    EXPECT_TRUE(jniStringEqualsAscii(env_, longString.get(), longAscii.c_str()));
+    EXPECT_TRUE(jniStringEqualsUtf8(env_, longString.get(), longAscii.c_str()));
+}
+
+}  // namespace android
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JniTestEnvironment.h"
+
+#include <JniConstants.h>
+#include <JniStringCache.h>
+#include <ScopedLocalRef.h>
+#include <ScopedUtfChars.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+JniTestEnvironment* JniTestEnvironment::instance_ = NULL;
+
+JniTestEnvironment::JniTestEnvironment(const char* library,
+                                       const std::vector<std::string>& options)
+        : library_(library), options_(options), jni_invocation_(NULL), vm_(NULL), fake_(NULL) {
+    instance_ = this;
+}
+
+void JniTestEnvironment::SetUp() {
+    jni_invocation_ = new JniInvocation;
+    ASSERT_TRUE(jni_invocation_->Init(library_));
+
+    std::vector<JavaVMOption> options(options_.size());
+    for (size_t i = 0; i < options_.size(); ++i) {
+        options[i].optionString = options_[i].c_str();
+        options[i].extraInfo = NULL;
+    }
+    JavaVMInitArgs args;
+    args.version = JNI_VERSION_1_6;
+    args.nOptions = options.size();
+    args.options = options.empty() ? NULL : &options[0];
+    args.ignoreUnrecognized = JNI_FALSE;
+    JNIEnv* env;
+    ASSERT_EQ(JNI_OK, JNI_CreateJavaVM(&vm_, &env, &args));
+
+    // Only the fake runtime knows this version; others return JNI_EVERSION.
+    if (vm_->GetEnv(reinterpret_cast<void**>(&fake_), FAKE_JNI_INTROSPECTION_VERSION) != JNI_OK) {
+        fake_ = NULL;
+    }
+    // Its global references live as long as the VM, so create them before any
+    // test starts counting.
+    JniConstants::init(env);
+}
+
+void JniTestEnvironment::TearDown() {
+    if (vm_ != NULL) {
+        vm_->DestroyJavaVM();
+        vm_ = NULL;
+    }
+    delete jni_invocation_;
+    jni_invocation_ = NULL;
+}
+
+JniTestEnvironment& JniTestEnvironment::Get() {
+    if (instance_ == NULL || instance_->vm_ == NULL) {
+        fprintf(stderr, "JniTestEnvironment has not been registered and set up\n");
+        abort();
+    }
+    return *instance_;
+}
+
+JNIEnv* JniTestEnvironment::AttachCurrentThread() {
+    JNIEnv* env = NULL;
+    if (vm_->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) == JNI_OK) {
+        return env;
+    }
+    if (vm_->AttachCurrentThread(&env, NULL) != JNI_OK) {
+        return NULL;
+    }
+    return env;
+}
+
+void JniTestEnvironment::DetachCurrentThread() {
+    vm_->DetachCurrentThread();
+}
+
+JniTest::JniTest()
+        : vm_(JniTestEnvironment::Get().vm()),
+          env_(JniTestEnvironment::Get().AttachCurrentThread()),
+          fake_(JniTestEnvironment::Get().fake()),
+          local_refs_(0),
+          global_refs_(0) {
+}
+
+void JniTest::SetUp() {
+    ASSERT_EQ(JNI_OK, env_->PushLocalFrame(16));
+    if (fake_ != NULL) {
+        fake_->SetCopyMode(vm_, JNI_FALSE);
+        local_refs_ = fake_->LocalRefCount(env_);
+        global_refs_ = fake_->GlobalRefCount(vm_);
+    }
+}
+
+void JniTest::TearDown() {
+    if (env_->ExceptionCheck()) {
+        ADD_FAILURE() << "test returned with a pending exception";
+        env_->ExceptionDescribe();
+        env_->ExceptionClear();
+    }
+    // The string cache holds global references for the life of the process
+    // by design; drop them so that they neither count as leaks here nor
+    // carry over into the next test.
+    jniClearStringCache(env_);
+    if (fake_ != NULL) {
+        EXPECT_EQ(local_refs_, fake_->LocalRefCount(env_)) << "local references leaked";
+        EXPECT_EQ(global_refs_, fake_->GlobalRefCount(vm_)) << "global references leaked";
+        EXPECT_EQ(0, fake_->OutstandingCopyCount(vm_)) << "array or string copies not released";
+    }
+    env_->PopLocalFrame(NULL);
+}
+
+std::string JniTest::TakeException() {
+    ScopedLocalRef<jthrowable> exception(env_, env_->ExceptionOccurred());
+    if (exception.get() == NULL) {
+        return "";
+    }
+    env_->ExceptionClear();
+    std::string trace;
+    ScopedLocalRef<jclass> c(env_, env_->GetObjectClass(exception.get()));
+    ScopedLocalRef<jclass> cc(env_, env_->GetObjectClass(c.get()));
+    jmethodID getName = env_->GetMethodID(cc.get(), "getName", "()Ljava/lang/String;");
+    jmethodID getMessage = env_->GetMethodID(c.get(), "getMessage", "()Ljava/lang/String;");
+    ScopedLocalRef<jstring> name(env_,
+            reinterpret_cast<jstring>(env_->CallObjectMethod(c.get(), getName)));
+    ScopedLocalRef<jstring> message(env_,
+            reinterpret_cast<jstring>(env_->CallObjectMethod(exception.get(), getMessage)));
+    trace = ScopedUtfChars(env_, name.get()).c_str();
+    if (message.get() != NULL) {
+        trace += ": ";
+        trace += ScopedUtfChars(env_, message.get()).c_str();
+    }
+    return trace;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JNI_TEST_ENVIRONMENT_H_included
+#define JNI_TEST_ENVIRONMENT_H_included
+
+#include <JniInvocation.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "FakeJniRuntime.h"
+
+// Creates one VM per test process through JniInvocation, which only allows a
+// single instance. Register it once, typically from a static initializer:
+//
+//   static testing::Environment* const gJniEnvironment =
+//       testing::AddGlobalTestEnvironment(new JniTestEnvironment(kFakeJniLibrary));
+//
+// and derive fixtures from JniTest below.
+class JniTestEnvironment : public testing::Environment {
+ public:
+    // library is passed to JniInvocation::Init; NULL selects the default
+    // runtime. options are passed to JNI_CreateJavaVM.
+    explicit JniTestEnvironment(const char* library,
+                                const std::vector<std::string>& options =
+                                        std::vector<std::string>());
+
+    virtual void SetUp();
+    virtual void TearDown();
+
+    // Returns the registered environment; aborts if there is none.
+    static JniTestEnvironment& Get();
+
+    JniInvocation& jni_invocation() const {
+        return *jni_invocation_;
+    }
+
+    JavaVM* vm() const {
+        return vm_;
+    }
+
+    // Returns the calling thread's JNIEnv, attaching the thread if necessary.
+    JNIEnv* AttachCurrentThread();
+
+    // Detaches a thread attached by AttachCurrentThread.
+    void DetachCurrentThread();
+
+    // Returns the fake runtime's introspection table, or NULL when running
+    // against another runtime.
+    FakeJniIntrospection* fake() const {
+        return fake_;
+    }
+
+ private:
+    static JniTestEnvironment* instance_;
+
+    const char* const library_;
+    const std::vector<std::string> options_;
+    JniInvocation* jni_invocation_;
+    JavaVM* vm_;
+    FakeJniIntrospection* fake_;
+};
+
+// Fixture giving each test an attached env_ and a fresh local frame, with the
+// fake runtime pinning arrays rather than copying them. TearDown
+// empties the process-wide string cache, so that the global references it
+// holds do not outlive the test. On the fake runtime, TearDown also fails the
+// test if it returns with more local references than it started with (before
+// the frame is popped, which then frees them) or with more global references.
+class JniTest : public testing::Test {
+ protected:
+    JniTest();
+
+    virtual void SetUp();
+    virtual void TearDown();
+
+    // Returns "class: message" for the pending exception and clears it.
+    std::string TakeException();
+
+    JavaVM* const vm_;
+    JNIEnv* const env_;
+    FakeJniIntrospection* const fake_;
+
+    // Reference counts inside the test's frame when it started; fake runtime only.
+    jint local_refs_;
+    jint global_refs_;
+};
+
+#endif  // JNI_TEST_ENVIRONMENT_H_included
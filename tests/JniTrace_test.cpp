@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniConstants.h>
+#include <JniTrace.h>
+#include <ScopedBytes.h>
+#include <ScopedLocalRef.h>
+#include <ScopedUtfChars.h>
+#include <gtest/gtest.h>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class JniTraceTest : public JniTest {
+};
+
+int gTraceArgumentsEvaluated;
+
+int traceArgument(int value) {
+    ++gTraceArgumentsEvaluated;
+    return value;
+}
+
+TEST_F(JniTraceTest, TraceProbeArguments) {
+    // With no tracer attached, a probe site costs a test and a branch at most.
+    gTraceArgumentsEvaluated = 0;
+    JNI_TRACE1(array_release, traceArgument(1));
+    JNI_TRACE2(string_acquire, traceArgument(2), traceArgument(3));
+    EXPECT_EQ(0, gTraceArgumentsEvaluated);
+    EXPECT_FALSE(JNI_TRACE_ARMED(array_release));
+#if JNI_TRACE_ENABLED
+    // As a tracer does while attached to the probe.
+    ++libnativehelper_array_release_semaphore;
+    EXPECT_TRUE(JNI_TRACE_ARMED(array_release));
+    JNI_TRACE1(array_release, traceArgument(1));
+    JNI_TRACE2(string_acquire, traceArgument(2), traceArgument(3));
+    EXPECT_EQ(1, gTraceArgumentsEvaluated);
+    --libnativehelper_array_release_semaphore;
+#endif
+
+    // The Scoped* probes, in whichever configuration this was built.
+    ScopedLocalRef<jstring> s(env_, env_->NewStringUTF("traced"));
+    ScopedUtfChars utf(env_, s.get());
+    EXPECT_EQ(6U, utf.size());
+    ScopedLocalRef<jbyteArray> bytes(env_, env_->NewByteArray(4));
+    ScopedBytesRO ro(env_, bytes.get());
+    EXPECT_TRUE(ro.get() != NULL);
+}
+
+}  // namespace android
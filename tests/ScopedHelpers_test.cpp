@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <JNIHelp.h>
+#include <JniConstants.h>
+#include <ScopedBytes.h>
+#include <ScopedGlobalRef.h>
+#include <ScopedLocalFrame.h>
+#include <ScopedLocalRef.h>
+#include <ScopedPrimitiveArray.h>
+#include <ScopedPrimitiveArrayCritical.h>
+#include <ScopedStringChars.h>
+#include <ScopedStringCritical.h>
+#include <ScopedUtfChars.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <string.h>
+
+#include <vector>
+
+#include "JniTestEnvironment.h"
+
+namespace android {
+
+class ScopedHelpersTest : public JniTest {
+};
+
+TEST_F(ScopedHelpersTest, ScopedStrings) {
+    ScopedLocalRef<jstring> s(env_, env_->NewStringUTF("h\xc3\xa9llo"));
+    ScopedUtfChars utf(env_, s.get());
+    EXPECT_EQ(6U, utf.size());
+    ScopedStringChars chars(env_, s.get());
+    ASSERT_EQ(5U, chars.size());
+    EXPECT_EQ(0xe9, chars[1]);
+
+    ScopedUtfChars null_utf(env_, NULL);
+    EXPECT_TRUE(null_utf.c_str() == NULL);
+    EXPECT_EQ("java.lang.NullPointerException", TakeException());
+}
+
+TEST_F(ScopedHelpersTest, ScopedPrimitiveArrayRO) {
+    for (int copy = 0; copy <= 1; ++copy) {
+        fake_->SetCopyMode(vm_, copy);
+        // Both sides of the inline buffer threshold.
+        const jsize sizes[] = { 16, 4096 };
+        for (size_t i = 0; i < NELEM(sizes); ++i) {
+            ScopedLocalRef<jintArray> array(env_, env_->NewIntArray(sizes[i]));
+            std::vector<jint> values(sizes[i]);
+            for (jsize j = 0; j < sizes[i]; ++j) {
+                values[j] = j * 3;
+            }
+            env_->SetIntArrayRegion(array.get(), 0, sizes[i], &values[0]);
+
+            ScopedIntArrayRO ro(env_, array.get());
+            ASSERT_EQ(static_cast<size_t>(sizes[i]), ro.size());
+            EXPECT_EQ(0, memcmp(&values[0], ro.get(), sizes[i] * sizeof(jint)));
+        }
+    }
+}
+
+TEST_F(ScopedHelpersTest, ScopedPrimitiveArrayRW) {
+    for (int copy = 0; copy <= 1; ++copy) {
+        fake_->SetCopyMode(vm_, copy);
+        ScopedLocalRef<jbyteArray> array(env_, env_->NewByteArray(8));
+        {
+            ScopedByteArrayRW rw(env_, array.get());
+            rw[7] = 42;
+        }
+        jbyte b;
+        env_->GetByteArrayRegion(array.get(), 7, 1, &b);
+        EXPECT_EQ(42, b);
+    }
+}
+
+TEST_F(ScopedHelpersTest, ScopedBytes) {
+    ScopedLocalRef<jbyteArray> array(env_, env_->NewByteArray(4));
+    const jbyte values[] = { 1, 2, 3, 4 };
+    env_->SetByteArrayRegion(array.get(), 0, 4, values);
+    {
+        ScopedBytesRO bytes(env_, array.get());
+        EXPECT_EQ(0, memcmp(values, bytes.get(), sizeof(values)));
+    }
+
+    jbyte native[4] = { 0, 0, 0, 0 };
+    ScopedLocalRef<jobject> buffer(env_, env_->NewDirectByteBuffer(native, sizeof(native)));
+    {
+        ScopedBytesRW bytes(env_, buffer.get());
+        EXPECT_EQ(native, bytes.get());
+        // Fetched on first use, and the same afterwards.
+        EXPECT_EQ(sizeof(native), bytes.size());
+        EXPECT_EQ(sizeof(native), bytes.size());
+    }
+    {
+        ScopedBytesRO bytes(env_, array.get());
+        EXPECT_EQ(4U, bytes.size());
+    }
+    ScopedBytesRO null_bytes(env_, NULL);
+    EXPECT_EQ(0U, null_bytes.size());
+    EXPECT_EQ("java.lang.NullPointerException", TakeException());
+}
+
+TEST_F(ScopedHelpersTest, ScopedLocalFrame) {
+    {
+        ScopedLocalFrame frame(env_);
+        for (int i = 0; i < 100; ++i) {
+            env_->NewStringUTF("leaked into the frame");
+        }
+        EXPECT_EQ(local_refs_ + 100, fake_->LocalRefCount(env_));
+    }
+    EXPECT_EQ(local_refs_, fake_->LocalRefCount(env_));
+}
+
+TEST_F(ScopedHelpersTest, ScopedCritical) {
+    ScopedLocalRef<jintArray> array(env_, env_->NewIntArray(64));
+    {
+        ScopedIntArrayCritical critical(env_, array.get());
+        ASSERT_TRUE(critical.get() != NULL);
+        ASSERT_EQ(64U, critical.size());
+        critical[63] = 7;
+    }
+    jint value;
+    env_->GetIntArrayRegion(array.get(), 63, 1, &value);
+    EXPECT_EQ(7, value);
+
+    ScopedLocalRef<jstring> s(env_, env_->NewStringUTF("critical"));
+    {
+        ScopedStringCritical chars(env_, s.get());
+        ASSERT_EQ(8U, chars.size());
+        EXPECT_EQ('c', chars[0]);
+    }
+
+    ScopedIntArrayCritical null_array(env_, NULL);
+    EXPECT_TRUE(null_array.get() == NULL);
+    EXPECT_EQ("java.lang.NullPointerException", TakeException());
+
+    // A runtime that copies gets changes to an RW copy back, but not to an RO one.
+    fake_->SetCopyMode(vm_, JNI_TRUE);
+    {
+        ScopedIntArrayCriticalRW rw(env_, array.get());
+        rw[0] = 5;
+    }
+    {
+        ScopedIntArrayCriticalRO ro(env_, array.get());
+        ASSERT_EQ(64U, ro.size());
+        EXPECT_EQ(5, ro[0]);
+        EXPECT_EQ(7, ro[63]);
+        const_cast<jint*>(ro.get())[0] = 9;
+    }
+    fake_->SetCopyMode(vm_, JNI_FALSE);
+    env_->GetIntArrayRegion(array.get(), 0, 1, &value);
+    EXPECT_EQ(5, value);
+    EXPECT_EQ(0, fake_->OutstandingCopyCount(vm_));
+}
+
+void* releaseGlobalRef(void* ref) {
+    // This thread is not attached; reset() attaches it for the delete.
+    static_cast<ScopedGlobalRef<jobject>*>(ref)->reset();
+    return ref;
+}
+
+TEST_F(ScopedHelpersTest, ScopedGlobalRef) {
+    const jint globals = fake_->GlobalRefCount(vm_);
+    ScopedLocalRef<jobject> object(env_, env_->NewStringUTF("global"));
+    ScopedGlobalRef<jobject> first(env_, object.get());
+    ASSERT_TRUE(first.get() != NULL);
+    EXPECT_TRUE(env_->IsSameObject(object.get(), first.get()));
+    EXPECT_EQ(globals + 1, fake_->GlobalRefCount(vm_));
+
+    // Moves hand the one reference over without new ones.
+    ScopedGlobalRef<jobject> second(std::move(first));
+    EXPECT_TRUE(first.get() == NULL);
+    EXPECT_TRUE(env_->IsSameObject(object.get(), second.get()));
+    ScopedGlobalRef<jobject> third(env_, object.get());
+    EXPECT_EQ(globals + 2, fake_->GlobalRefCount(vm_));
+    third = std::move(second);
+    EXPECT_TRUE(second.get() == NULL);
+    EXPECT_EQ(globals + 1, fake_->GlobalRefCount(vm_));
+
+    jobject released = third.release();
+    EXPECT_TRUE(third.get() == NULL);
+    EXPECT_EQ(globals + 1, fake_->GlobalRefCount(vm_));
+    env_->DeleteGlobalRef(released);
+    EXPECT_EQ(globals, fake_->GlobalRefCount(vm_));
+
+    ScopedGlobalRef<jobject> null(env_, NULL);
+    EXPECT_TRUE(null.get() == NULL);
+
+    ScopedGlobalRef<jobject> elsewhere(env_, object.get());
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, releaseGlobalRef, &elsewhere));
+    ASSERT_EQ(0, pthread_join(thread, NULL));
+    EXPECT_TRUE(elsewhere.get() == NULL);
+    EXPECT_EQ(globals, fake_->GlobalRefCount(vm_));
+}
+
+}  // namespace android
@@ -14,10 +14,12 @@
  * limitations under the License.
  */
 
+#include "JniCheck.h"
 #include "JniConstants.h"
 #include "toStringArray.h"
 
 jobjectArray newStringArray(JNIEnv* env, size_t count) {
+    JNI_LIGHT_CHECK(env, "newStringArray");
     return env->NewObjectArray(count, JniConstants::stringClass, NULL);
 }
 
@@ -46,3 +48,9 @@ jobjectArray toStringArray(JNIEnv* env, const char* const* strings) {
     ArrayGetter getter(strings);
     return toStringArray(env, &counter, &getter);
 }
+
+jobjectArray toCachedStringArray(JNIEnv* env, const char* const* strings) {
+    ArrayCounter counter(strings);
+    ArrayGetter getter(strings);
+    return toStringArray(env, &counter, &getter, true);
+}